@@ -47,6 +47,10 @@ LOCAL_EXPORT_C_INCLUDES := \
 LOCAL_CFLAGS := $(LOCAL_C_INCLUDES:%=-I%)
 LOCAL_CFLAGS += -DANDROID_NDK
 LOCAL_CFLAGS += -msoft-float
+#JPOOL_IMAGEのメモリを次の画像用に保持して再利用する(jmemmgr.c)
+LOCAL_CFLAGS += -DIMAGE_ARENA
+#展開済みハフマンテーブルを同じ定義の次のスキャン/画像で再利用する(jdhuff.c)
+LOCAL_CFLAGS += -DHUFF_TABLE_CACHE
 
 #リンクするライブラリを指定(静的モジュールにする時は不要)
 #LOCAL_LDLIBS := -L$(SYSROOT)/usr/lib -ldl	# to avoid NDK issue(no need for static library)
@@ -144,6 +144,89 @@ start_pass_huff_decoder (j_decompress_ptr cinfo)
 }
 
 
+#ifdef HUFF_TABLE_CACHE
+
+/*
+ * Derived table cache.
+ *
+ * A stream of images from one source, such as the frames of an MJPEG
+ * camera, uses the same few Huffman tables in every image, usually the
+ * standard ones, yet the derived tables are rebuilt at the start of every
+ * scan.  Instead, the decompressor keeps the tables it has derived in its
+ * permanent pool together with a copy of the definition each came from, and
+ * an identical definition reuses the derived table after a compare.
+ * A scan derives at most 2 * NUM_HUFF_TBLS tables, so with that many
+ * entries the least recently used one is never a table the current scan
+ * has just set up.
+ */
+
+#define DERIVED_CACHE_SIZE  (2 * NUM_HUFF_TBLS)
+
+typedef struct {
+  unsigned int last_use;        /* 0 if the entry holds no valid table */
+  boolean isDC;                 /* DC tables pass an extra symbol check */
+  JHUFF_TBL def;                /* definition the table was derived from */
+  d_derived_tbl dtbl;
+} derived_cache_entry;
+
+typedef struct {
+  unsigned int clock;           /* use counter for the LRU replacement */
+  derived_cache_entry entry[DERIVED_CACHE_SIZE];
+} derived_tbl_cache;
+
+
+LOCAL(derived_cache_entry *)
+lookup_derived_tbl (j_decompress_ptr cinfo, boolean isDC, JHUFF_TBL *htbl,
+                    d_derived_tbl **pdtbl)
+/* Point *pdtbl at a cached table derived from htbl and return NULL, or
+ * return the entry to derive it into.
+ */
+{
+  derived_tbl_cache *cache =
+    (derived_tbl_cache *) cinfo->master->derived_tbl_cache;
+  derived_cache_entry *entry, *victim;
+  int l, i, numsymbols;
+
+  if (cache == NULL) {
+    cache = (derived_tbl_cache *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
+                                  sizeof(derived_tbl_cache));
+    MEMZERO(cache, sizeof(derived_tbl_cache));
+    cinfo->master->derived_tbl_cache = (void *) cache;
+  }
+
+  /* An overrun is caught when the table is derived */
+  numsymbols = 0;
+  for (l = 1; l <= 16; l++)
+    numsymbols += htbl->bits[l];
+  if (numsymbols > 256)
+    numsymbols = 256;
+
+  victim = &cache->entry[0];
+  for (i = 0; i < DERIVED_CACHE_SIZE; i++) {
+    entry = &cache->entry[i];
+    if (entry->last_use != 0 && entry->isDC == isDC &&
+        MEMCMP(entry->def.bits, htbl->bits, sizeof(htbl->bits)) == 0 &&
+        MEMCMP(entry->def.huffval, htbl->huffval, numsymbols) == 0) {
+      entry->last_use = ++cache->clock;
+      *pdtbl = &entry->dtbl;
+      return NULL;
+    }
+    if (entry->last_use < victim->last_use)
+      victim = entry;
+  }
+
+  /* Not valid until it has been derived, which may fail */
+  victim->last_use = 0;
+  victim->isDC = isDC;
+  MEMCOPY(&victim->def, htbl, sizeof(JHUFF_TBL));
+  *pdtbl = &victim->dtbl;
+  return victim;
+}
+
+#endif /* HUFF_TABLE_CACHE */
+
+
 /*
  * Compute the derived values for a Huffman table.
  * This routine also performs some validation checks on the table.
@@ -162,6 +245,9 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
   char huffsize[257];
   unsigned int huffcode[257];
   unsigned int code;
+#ifdef HUFF_TABLE_CACHE
+  derived_cache_entry *entry;
+#endif
 
   /* Note that huffsize[] and huffcode[] are filled in code-length order,
    * paralleling the order of the symbols themselves in htbl->huffval[].
@@ -175,11 +261,21 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
   if (htbl == NULL)
     ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
 
+#ifdef HUFF_TABLE_CACHE
+  /* Reuse a table derived from the same definition, or derive into the
+   * cache entry, whose copy of the definition becomes the back link.
+   */
+  entry = lookup_derived_tbl(cinfo, isDC, htbl, pdtbl);
+  if (entry == NULL)
+    return;
+  htbl = &entry->def;
+#else
   /* Allocate a workspace if we haven't already done so. */
   if (*pdtbl == NULL)
     *pdtbl = (d_derived_tbl *)
       (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
                                   sizeof(d_derived_tbl));
+#endif
   dtbl = *pdtbl;
   dtbl->pub = htbl;             /* fill in back link */
 
@@ -270,6 +366,11 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
         ERREXIT(cinfo, JERR_BAD_HUFF_TABLE);
     }
   }
+
+#ifdef HUFF_TABLE_CACHE
+  entry->last_use =
+    ++((derived_tbl_cache *) cinfo->master->derived_tbl_cache)->clock;
+#endif
 }
 
 
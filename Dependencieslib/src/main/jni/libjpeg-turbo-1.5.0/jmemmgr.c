@@ -135,6 +135,12 @@ typedef struct {
   /* This counts total space obtained from jpeg_get_small/large */
   size_t total_space_allocated;
 
+#ifdef IMAGE_ARENA
+  /* IMAGE pools released by the previous image, kept for the next one */
+  small_pool_ptr small_spare;
+  large_pool_ptr large_spare;
+#endif
+
   /* alloc_sarray and alloc_barray set this value for use by virtual
    * array routines.
    */
@@ -261,6 +267,117 @@ static const size_t extra_pool_slop[JPOOL_NUMPOOLS] =
 #define MIN_SLOP  50            /* greater than 0 to avoid futile looping */
 
 
+#ifdef IMAGE_ARENA
+
+/*
+ * Image arena.
+ *
+ * A decompressor or compressor that is reused for a stream of images of one
+ * geometry asks for the same IMAGE pools every time.  Instead of returning
+ * them to jpeg_free_small/large at the end of each image, free_pool moves
+ * the IMAGE lists onto the spare lists (a constant-time splice), and the
+ * next image takes its pools from there.  Spares that an image does not
+ * claim are released when it ends, so the arena holds at most one image's
+ * worth of pools and shrinks back after a change of geometry.  The first
+ * image of a geometry fills the arena; from then on, steady-state images
+ * do not touch the system allocator.
+ */
+
+LOCAL(small_pool_ptr)
+take_spare_small (my_mem_ptr mem, size_t sizeofobject)
+/* Unlink the smallest spare small pool that can hold the object, or NULL */
+{
+  small_pool_ptr *link_ptr, *best_ptr = NULL;
+  small_pool_ptr hdr_ptr;
+  size_t space, best_space = 0;
+
+  for (link_ptr = &mem->small_spare; *link_ptr != NULL;
+       link_ptr = &(*link_ptr)->next) {
+    space = (*link_ptr)->bytes_used + (*link_ptr)->bytes_left;
+    if (space >= sizeofobject && (best_ptr == NULL || space < best_space)) {
+      best_ptr = link_ptr;
+      best_space = space;
+    }
+  }
+  if (best_ptr == NULL)
+    return NULL;
+
+  hdr_ptr = *best_ptr;
+  *best_ptr = hdr_ptr->next;
+  hdr_ptr->next = NULL;
+  hdr_ptr->bytes_used = 0;
+  hdr_ptr->bytes_left = best_space;
+  return hdr_ptr;
+}
+
+
+LOCAL(large_pool_ptr)
+take_spare_large (my_mem_ptr mem, size_t sizeofobject)
+/* Unlink the smallest spare large pool that can hold the object, or NULL */
+{
+  large_pool_ptr *link_ptr, *best_ptr = NULL;
+  large_pool_ptr hdr_ptr;
+  size_t space, best_space = 0;
+
+  for (link_ptr = &mem->large_spare; *link_ptr != NULL;
+       link_ptr = &(*link_ptr)->next) {
+    space = (*link_ptr)->bytes_used + (*link_ptr)->bytes_left;
+    if (space >= sizeofobject && (best_ptr == NULL || space < best_space)) {
+      best_ptr = link_ptr;
+      best_space = space;
+    }
+  }
+  if (best_ptr == NULL)
+    return NULL;
+
+  hdr_ptr = *best_ptr;
+  *best_ptr = hdr_ptr->next;
+  hdr_ptr->next = NULL;
+  hdr_ptr->bytes_used = sizeofobject;
+  hdr_ptr->bytes_left = best_space - sizeofobject;
+  return hdr_ptr;
+}
+
+
+LOCAL(void)
+release_spares (j_common_ptr cinfo)
+/* Give the unclaimed spare pools back to the system */
+{
+  my_mem_ptr mem = (my_mem_ptr) cinfo->mem;
+  small_pool_ptr shdr_ptr;
+  large_pool_ptr lhdr_ptr;
+  size_t space_freed;
+
+  lhdr_ptr = mem->large_spare;
+  mem->large_spare = NULL;
+
+  while (lhdr_ptr != NULL) {
+    large_pool_ptr next_lhdr_ptr = lhdr_ptr->next;
+    space_freed = lhdr_ptr->bytes_used +
+                  lhdr_ptr->bytes_left +
+                  sizeof(large_pool_hdr);
+    jpeg_free_large(cinfo, (void *) lhdr_ptr, space_freed);
+    mem->total_space_allocated -= space_freed;
+    lhdr_ptr = next_lhdr_ptr;
+  }
+
+  shdr_ptr = mem->small_spare;
+  mem->small_spare = NULL;
+
+  while (shdr_ptr != NULL) {
+    small_pool_ptr next_shdr_ptr = shdr_ptr->next;
+    space_freed = shdr_ptr->bytes_used +
+                  shdr_ptr->bytes_left +
+                  sizeof(small_pool_hdr);
+    jpeg_free_small(cinfo, (void *) shdr_ptr, space_freed);
+    mem->total_space_allocated -= space_freed;
+    shdr_ptr = next_shdr_ptr;
+  }
+}
+
+#endif /* IMAGE_ARENA */
+
+
 METHODDEF(void *)
 alloc_small (j_common_ptr cinfo, int pool_id, size_t sizeofobject)
 /* Allocate a "small" object */
@@ -300,6 +417,19 @@ alloc_small (j_common_ptr cinfo, int pool_id, size_t sizeofobject)
     hdr_ptr = hdr_ptr->next;
   }
 
+#ifdef IMAGE_ARENA
+  /* Reuse a pool left by the previous image, if one is big enough */
+  if (hdr_ptr == NULL && pool_id == JPOOL_IMAGE) {
+    hdr_ptr = take_spare_small(mem, sizeofobject);
+    if (hdr_ptr != NULL) {
+      if (prev_hdr_ptr == NULL)
+        mem->small_list[pool_id] = hdr_ptr;
+      else
+        prev_hdr_ptr->next = hdr_ptr;
+    }
+  }
+#endif
+
   /* Time to make a new pool? */
   if (hdr_ptr == NULL) {
     /* min_request is what we need now, slop is what will be leftover */
@@ -386,21 +516,31 @@ alloc_large (j_common_ptr cinfo, int pool_id, size_t sizeofobject)
   if (pool_id < 0 || pool_id >= JPOOL_NUMPOOLS)
     ERREXIT1(cinfo, JERR_BAD_POOL_ID, pool_id); /* safety check */
 
-  hdr_ptr = (large_pool_ptr) jpeg_get_large(cinfo, sizeofobject +
-                                            sizeof(large_pool_hdr) +
-                                            ALIGN_SIZE - 1);
-  if (hdr_ptr == NULL)
-    out_of_memory(cinfo, 4);    /* jpeg_get_large failed */
-  mem->total_space_allocated += sizeofobject + sizeof(large_pool_hdr) +
-                                ALIGN_SIZE - 1;
+  hdr_ptr = NULL;
+#ifdef IMAGE_ARENA
+  /* Reuse a pool left by the previous image, if one is big enough */
+  if (pool_id == JPOOL_IMAGE)
+    hdr_ptr = take_spare_large(mem, sizeofobject);
+#endif
 
-  /* Success, initialize the new pool header and add to list */
+  if (hdr_ptr == NULL) {
+    hdr_ptr = (large_pool_ptr) jpeg_get_large(cinfo, sizeofobject +
+                                              sizeof(large_pool_hdr) +
+                                              ALIGN_SIZE - 1);
+    if (hdr_ptr == NULL)
+      out_of_memory(cinfo, 4);  /* jpeg_get_large failed */
+    mem->total_space_allocated += sizeofobject + sizeof(large_pool_hdr) +
+                                  ALIGN_SIZE - 1;
+
+    /* We maintain space counts in each pool header for statistical purposes,
+     * even though they are not needed for allocation.
+     */
+    hdr_ptr->bytes_used = sizeofobject;
+    hdr_ptr->bytes_left = 0;
+  }
+
+  /* Success, add the pool to the list */
   hdr_ptr->next = mem->large_list[pool_id];
-  /* We maintain space counts in each pool header for statistical purposes,
-   * even though they are not needed for allocation.
-   */
-  hdr_ptr->bytes_used = sizeofobject;
-  hdr_ptr->bytes_left = 0;
   mem->large_list[pool_id] = hdr_ptr;
 
   data_ptr = (char *) hdr_ptr; /* point to first data byte in pool... */
@@ -1014,6 +1154,18 @@ free_pool (j_common_ptr cinfo, int pool_id)
       }
     }
     mem->virt_barray_list = NULL;
+
+#ifdef IMAGE_ARENA
+    /* Release the spares this image did not claim, then keep its own pools
+     * as the spares for the next image.
+     */
+    release_spares(cinfo);
+    mem->large_spare = mem->large_list[pool_id];
+    mem->small_spare = mem->small_list[pool_id];
+    mem->large_list[pool_id] = NULL;
+    mem->small_list[pool_id] = NULL;
+    return;
+#endif
   }
 
   /* Release large objects */
@@ -1063,6 +1215,9 @@ self_destruct (j_common_ptr cinfo)
   for (pool = JPOOL_NUMPOOLS-1; pool >= JPOOL_PERMANENT; pool--) {
     free_pool(cinfo, pool);
   }
+#ifdef IMAGE_ARENA
+  release_spares(cinfo);
+#endif
 
   /* Release the memory manager control block too. */
   jpeg_free_small(cinfo, (void *) cinfo->mem, sizeof(my_memory_mgr));
@@ -1141,6 +1296,10 @@ jinit_memory_mgr (j_common_ptr cinfo)
   }
   mem->virt_sarray_list = NULL;
   mem->virt_barray_list = NULL;
+#ifdef IMAGE_ARENA
+  mem->small_spare = NULL;
+  mem->large_spare = NULL;
+#endif
 
   mem->total_space_allocated = sizeof(my_memory_mgr);
 
@@ -158,6 +158,11 @@ struct jpeg_decomp_master {
   JDIMENSION first_MCU_col[MAX_COMPS_IN_SCAN];
   JDIMENSION last_MCU_col[MAX_COMPS_IN_SCAN];
   boolean jinit_upsampler_no_alloc;
+
+#ifdef HUFF_TABLE_CACHE
+  /* Derived Huffman tables kept from one scan and image to the next */
+  void *derived_tbl_cache;      /* see jdhuff.c */
+#endif
 };
 
 /* Input control module */
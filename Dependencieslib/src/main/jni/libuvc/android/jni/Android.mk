@@ -67,7 +67,17 @@ LOCAL_SRC_FILES := \
 	src/device.c \
 	src/diag.c \
 	src/frame.c \
+	src/frame-bayer.c \
+	src/frame-convert.c \
+	src/frame-kernels.cpp \
 	src/frame-mjpeg.c \
+	src/frame-motion.c \
+	src/frame-pyramid.c \
+	src/frame-sharpness.c \
+	src/frame-stats.c \
+	src/frame-tensor.cpp \
+	src/frame-tonemap.c \
+	src/frame-yuv.c \
 	src/init.c \
 	src/stream.c
 
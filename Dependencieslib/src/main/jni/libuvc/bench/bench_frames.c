@@ -0,0 +1,325 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Synthetic source frames, see bench_frames.h
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_frames.h"
+#ifdef LIBUVC_HAS_JPEG
+#include <jpeglib.h>
+#endif
+
+/** @internal full range BT.601, the inverse of the factors in frame.c */
+static inline uint8_t _rgb2y(const int r, const int g, const int b) {
+	return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+static inline uint8_t _rgb2u(const int r, const int g, const int b) {
+	const int u = ((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128;
+	return u < 0 ? 0 : (u > 255 ? 255 : u);
+}
+
+static inline uint8_t _rgb2v(const int r, const int g, const int b) {
+	const int v = ((128 * r - 107 * g - 21 * b + 128) >> 8) + 128;
+	return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/** @internal gradient plus +-8 of LCG noise, packed RGB888 */
+static uint8_t *_make_rgb(const int width, const int height) {
+	uint8_t *rgb = malloc((size_t)width * height * 3);
+	uint32_t seed = 0x2545f491;
+	int x, y, c;
+
+	if (!rgb)
+		return NULL;
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			const int base[3] = {
+				x * 255 / width,
+				y * 255 / height,
+				(x + y) * 255 / (width + height) };
+			uint8_t *p = rgb + ((size_t)y * width + x) * 3;
+			for (c = 0; c < 3; c++) {
+				seed = seed * 1664525 + 1013904223;
+				const int v = base[c] + (int)(seed >> 28) - 8;
+				p[c] = v < 0 ? 0 : (v > 255 ? 255 : v);
+			}
+		}
+	}
+	return rgb;
+}
+
+/** @internal channel (0:R 1:G 2:B) at x, y for a Bayer order given by the
+ * position of the red sample within the 2x2 quad */
+static inline int _bayer_channel(const int x, const int y, const int rx, const int ry) {
+	const int red_row = (y & 1) == ry;
+	const int red_col = (x & 1) == rx;
+	if (red_row && red_col)
+		return 0;
+	if (!red_row && !red_col)
+		return 2;
+	return 1;
+}
+
+#ifdef LIBUVC_HAS_JPEG
+static size_t _encode_jpeg(const uint8_t *rgb, const int width, const int height,
+	const enum uvc_bench_jpeg_sampling sampling, unsigned char **out) {
+
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned long out_bytes = 0;
+	JSAMPROW row;
+
+	*out = NULL;
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, out, &out_bytes);
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, 85, TRUE);
+	cinfo.comp_info[0].h_samp_factor = 2;
+	cinfo.comp_info[0].v_samp_factor =
+		(sampling == UVC_BENCH_JPEG_420) || (sampling == UVC_BENCH_JPEG_420_RST) ? 2 : 1;
+	if (sampling == UVC_BENCH_JPEG_420_RST)
+		cinfo.restart_in_rows = 1;
+	// the standard tables are what a decoder substitutes when DHT is missing
+	cinfo.optimize_coding = sampling == UVC_BENCH_JPEG_422_OPT;
+	jpeg_start_compress(&cinfo, TRUE);
+	while (cinfo.next_scanline < cinfo.image_height) {
+		row = (JSAMPROW)(rgb + (size_t)cinfo.next_scanline * width * 3);
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	if (sampling == UVC_BENCH_JPEG_422_NO_DHT)
+		out_bytes = uvc_bench_strip_dht(*out, out_bytes);
+	return out_bytes;
+}
+#endif
+
+size_t uvc_bench_strip_dht(uint8_t *jpeg, size_t bytes) {
+	size_t src = 2, dst = 2;
+
+	if ((bytes < 4) || (jpeg[0] != 0xff) || (jpeg[1] != 0xd8))
+		return bytes;
+	while (src + 4 <= bytes) {
+		const uint8_t marker = jpeg[src + 1];
+		const size_t len = 2 + (((size_t)jpeg[src + 2] << 8) | jpeg[src + 3]);
+		if ((jpeg[src] != 0xff) || (marker == 0xda) || (src + len > bytes))
+			break;	// SOS or something unexpected: keep the rest as is
+		if (marker != 0xc4) {
+			memmove(jpeg + dst, jpeg + src, len);
+			dst += len;
+		}
+		src += len;
+	}
+	memmove(jpeg + dst, jpeg + src, bytes - src);
+	return dst + bytes - src;
+}
+
+uvc_frame_t *uvc_bench_make_frame(enum uvc_frame_format format,
+	enum uvc_bench_jpeg_sampling sampling, int width, int height) {
+
+	uint8_t *rgb = _make_rgb(width, height);
+	uvc_frame_t *frame = NULL;
+	size_t bytes, step;
+	int x, y, rx = 0, ry = 0;
+
+	if (!rgb)
+		return NULL;
+
+	switch (format) {
+	case UVC_FRAME_FORMAT_RGB:
+	case UVC_FRAME_FORMAT_BGR:
+		step = (size_t)width * 3;
+		bytes = step * height;
+		break;
+	case UVC_FRAME_FORMAT_RGBX:
+		step = (size_t)width * 4;
+		bytes = step * height;
+		break;
+	case UVC_FRAME_FORMAT_YUYV:
+	case UVC_FRAME_FORMAT_UYVY:
+	case UVC_FRAME_FORMAT_RGB565:
+	case UVC_FRAME_FORMAT_GRAY16:
+		step = (size_t)width * 2;
+		bytes = step * height;
+		break;
+	case UVC_FRAME_FORMAT_NV12:
+		step = width;
+		bytes = step * height + step * ((height + 1) / 2);
+		break;
+	case UVC_FRAME_FORMAT_P010:
+		step = (size_t)width * 2;
+		bytes = step * height + step * ((height + 1) / 2);
+		break;
+	case UVC_FRAME_FORMAT_GRAY8:
+	case UVC_FRAME_FORMAT_SRGGB8:
+	case UVC_FRAME_FORMAT_SGRBG8:
+	case UVC_FRAME_FORMAT_BY8:
+	case UVC_FRAME_FORMAT_SGBRG8:
+	case UVC_FRAME_FORMAT_SBGGR8:
+	case UVC_FRAME_FORMAT_BA81:
+		step = width;
+		bytes = step * height;
+		break;
+#ifdef LIBUVC_HAS_JPEG
+	case UVC_FRAME_FORMAT_MJPEG: {
+		unsigned char *jpeg;
+		bytes = _encode_jpeg(rgb, width, height, sampling, &jpeg);
+		frame = jpeg ? uvc_allocate_frame(bytes) : NULL;
+		if (frame) {
+			memcpy(frame->data, jpeg, bytes);
+			frame->step = 0;
+		}
+		free(jpeg);
+		goto done;
+	}
+#endif
+	default:
+		free(rgb);
+		return NULL;
+	}
+
+	frame = uvc_allocate_frame(bytes);
+	if (!frame)
+		goto done;
+	frame->step = step;
+
+	uint8_t *dst = frame->data;
+	for (y = 0; y < height; y++) {
+		const uint8_t *s = rgb + (size_t)y * width * 3;
+		uint8_t *d = dst + step * y;
+		for (x = 0; x < width; x++, s += 3) {
+			const int r = s[0], g = s[1], b = s[2];
+			switch (format) {
+			case UVC_FRAME_FORMAT_RGB:
+				d[x * 3] = r; d[x * 3 + 1] = g; d[x * 3 + 2] = b;
+				break;
+			case UVC_FRAME_FORMAT_BGR:
+				d[x * 3] = b; d[x * 3 + 1] = g; d[x * 3 + 2] = r;
+				break;
+			case UVC_FRAME_FORMAT_RGBX:
+				d[x * 4] = r; d[x * 4 + 1] = g; d[x * 4 + 2] = b; d[x * 4 + 3] = 0xff;
+				break;
+			case UVC_FRAME_FORMAT_RGB565: {
+				const int v = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+				d[x * 2] = v & 0xff;
+				d[x * 2 + 1] = v >> 8;
+				break;
+			}
+			case UVC_FRAME_FORMAT_YUYV:
+			case UVC_FRAME_FORMAT_UYVY: {
+				const int uyvy = format == UVC_FRAME_FORMAT_UYVY;
+				d[x * 2 + uyvy] = _rgb2y(r, g, b);
+				if (!(x & 1)) {
+					// chroma of the pair, the right neighbour exists for even widths
+					const uint8_t *n = x + 1 < width ? s + 3 : s;
+					const int ar = (r + n[0] + 1) >> 1, ag = (g + n[1] + 1) >> 1, ab = (b + n[2] + 1) >> 1;
+					d[x * 2 + 1 - uyvy] = _rgb2u(ar, ag, ab);
+					d[x * 2 + 3 - uyvy] = _rgb2v(ar, ag, ab);
+				}
+				break;
+			}
+			case UVC_FRAME_FORMAT_GRAY8:
+			case UVC_FRAME_FORMAT_NV12:
+				d[x] = _rgb2y(r, g, b);
+				break;
+			case UVC_FRAME_FORMAT_GRAY16:
+			case UVC_FRAME_FORMAT_P010: {
+				// 10 significant bits, MSB aligned as P010 stores them
+				const int y10 = (_rgb2y(r, g, b) << 2) | (b & 3);
+				const int v = format == UVC_FRAME_FORMAT_P010 ? y10 << 6 : (y10 << 6) | (y10 >> 4);
+				d[x * 2] = v & 0xff;
+				d[x * 2 + 1] = v >> 8;
+				break;
+			}
+			default: {
+				// Bayer: position of the red sample in the 2x2 quad
+				switch (format) {
+				case UVC_FRAME_FORMAT_SRGGB8: rx = 0; ry = 0; break;
+				case UVC_FRAME_FORMAT_SGRBG8:
+				case UVC_FRAME_FORMAT_BY8: rx = 1; ry = 0; break;
+				case UVC_FRAME_FORMAT_SGBRG8: rx = 0; ry = 1; break;
+				default: rx = 1; ry = 1; break;	// SBGGR8 / BA81
+				}
+				d[x] = s[_bayer_channel(x, y, rx, ry)];
+				break;
+			}
+			}
+		}
+	}
+
+	if ((format == UVC_FRAME_FORMAT_NV12) || (format == UVC_FRAME_FORMAT_P010)) {
+		const int p010 = format == UVC_FRAME_FORMAT_P010;
+		uint8_t *c = dst + step * height;
+		for (y = 0; y < height; y += 2) {
+			const int y1 = y + 1 < height ? y + 1 : y;
+			for (x = 0; x < width; x += 2) {
+				const int x1 = x + 1 < width ? x + 1 : x;
+				int sum[3] = { 0, 0, 0 }, i;
+				for (i = 0; i < 3; i++)
+					sum[i] = (rgb[((size_t)y * width + x) * 3 + i] + rgb[((size_t)y * width + x1) * 3 + i]
+						+ rgb[((size_t)y1 * width + x) * 3 + i] + rgb[((size_t)y1 * width + x1) * 3 + i] + 2) >> 2;
+				const int u = _rgb2u(sum[0], sum[1], sum[2]);
+				const int v = _rgb2v(sum[0], sum[1], sum[2]);
+				uint8_t *p = c + step * (y / 2);
+				if (p010) {
+					p[x * 2] = 0; p[x * 2 + 1] = u;
+					p[x * 2 + 2] = 0; p[x * 2 + 3] = v;
+				} else {
+					p[x] = u;
+					p[x + 1] = v;
+				}
+			}
+		}
+	}
+
+done:
+	free(rgb);
+	if (frame) {
+		frame->width = width;
+		frame->height = height;
+		frame->frame_format = format;
+		frame->actual_bytes = frame->data_bytes;
+	}
+	return frame;
+}
@@ -0,0 +1,78 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Synthetic source frames for the benchmark and the golden tests.
+ * Content is a smooth gradient with a little deterministic noise so that
+ * MJPEG sizes and entropy are close to a real camera rather than flat or
+ * random data.
+ */
+#ifndef UVC_BENCH_FRAMES_H
+#define UVC_BENCH_FRAMES_H
+
+#include "libuvc/libuvc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** MJPEG chroma subsampling of a synthesized frame */
+enum uvc_bench_jpeg_sampling {
+	UVC_BENCH_JPEG_422 = 0,
+	UVC_BENCH_JPEG_420 = 1,
+	/** 4:2:2 with the DHT segments removed, as most UVC cameras send it */
+	UVC_BENCH_JPEG_422_NO_DHT = 2,
+	/** 4:2:0 with a restart marker after every MCU row */
+	UVC_BENCH_JPEG_420_RST = 3,
+	/** 4:2:2 with Huffman tables optimised for the image, not the standard ones */
+	UVC_BENCH_JPEG_422_OPT = 4,
+};
+
+/** create a library owned frame of the given format filled with the test
+ * pattern; step and data_bytes are set as _uvc_populate_frame would.
+ * @param sampling only used for MJPEG
+ * @return NULL if the format is not supported or on allocation failure
+ */
+uvc_frame_t *uvc_bench_make_frame(enum uvc_frame_format format,
+	enum uvc_bench_jpeg_sampling sampling, int width, int height);
+
+/** remove every DHT segment in front of the scan, in place
+ * @return the new size of the JPEG stream
+ */
+size_t uvc_bench_strip_dht(uint8_t *jpeg, size_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UVC_BENCH_FRAMES_H
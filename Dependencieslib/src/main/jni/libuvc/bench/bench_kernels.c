@@ -0,0 +1,598 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Kernel table, see bench_kernels.h
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_kernels.h"
+
+#define K(name, src, dst, func) \
+	{ name, UVC_FRAME_FORMAT_##src, UVC_BENCH_JPEG_422, UVC_FRAME_FORMAT_##dst, func }
+#define KJ(name, sampling, dst, func) \
+	{ name, UVC_FRAME_FORMAT_MJPEG, UVC_BENCH_JPEG_##sampling, UVC_FRAME_FORMAT_##dst, func }
+
+/** the default three level pyramid, 1/2 to 1/8 */
+static uvc_error_t _luma_pyramid(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_luma_pyramid(in, out, NULL);
+}
+
+/** MJPEG decoded at quarter size with the reduced size IDCT */
+static uvc_error_t _mjpeg2rgbx_quarter(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_mjpeg_decoder_t *decoder = uvc_mjpeg_decoder_create();
+	const uvc_error_t result = decoder
+		? uvc_mjpeg_decoder_decode_scaled(decoder, in, out, UVC_FRAME_FORMAT_RGBX, 4)
+		: UVC_ERROR_NO_MEM;
+	uvc_mjpeg_decoder_destroy(decoder);
+	return result;
+}
+
+/** one decoder kept across frames whose DHT segments switch between
+ * optimised, missing and standard tables; every frame has to decode as it
+ * does on its own, the output is the last one */
+static uvc_error_t _mjpeg2rgbx_dht_switch(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_frame_t *nodht = uvc_bench_make_frame(UVC_FRAME_FORMAT_MJPEG, UVC_BENCH_JPEG_422_NO_DHT, in->width, in->height);
+	uvc_frame_t *standard = uvc_bench_make_frame(UVC_FRAME_FORMAT_MJPEG, UVC_BENCH_JPEG_422, in->width, in->height);
+	uvc_frame_t *once = uvc_allocate_frame(0);
+	uvc_mjpeg_decoder_t *decoder = uvc_mjpeg_decoder_create();
+	uvc_frame_t *const frames[] = { in, nodht, in, standard, in };
+	uvc_error_t result = nodht && standard && once && decoder ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+	size_t f;
+
+	for (f = 0; !result && (f < sizeof(frames) / sizeof(frames[0])); f++) {
+		result = uvc_mjpeg_decoder_decode(decoder, frames[f], out, UVC_FRAME_FORMAT_RGBX);
+		if (!result)
+			result = uvc_mjpeg2rgbx(frames[f], once);
+		if (!result && ((out->actual_bytes != once->actual_bytes)
+			|| memcmp(out->data, once->data, out->actual_bytes)))
+			result = UVC_ERROR_OTHER;
+	}
+	uvc_mjpeg_decoder_destroy(decoder);
+	if (once)
+		uvc_free_frame(once);
+	if (standard)
+		uvc_free_frame(standard);
+	if (nodht)
+		uvc_free_frame(nodht);
+	return result;
+}
+
+/** MJPEG decoded into a caller's frame with padded rows, sized to end at
+ * the last pixel; a frame one byte shorter is turned down */
+static uvc_error_t _mjpeg2rgbx_strided(uvc_frame_t *in, uvc_frame_t *out) {
+	const size_t row_bytes = (size_t)in->width * 4;
+	uvc_frame_t *padded = uvc_allocate_frame(0);
+	uvc_error_t result = padded ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+	uint32_t y;
+
+	if (!result) {
+		padded->library_owns_data = 0;
+		padded->step = row_bytes + 64;
+		padded->data_bytes = padded->step * (in->height - 1) + row_bytes - 1;
+		padded->data = malloc(padded->data_bytes + 1);
+		if (!padded->data)
+			result = UVC_ERROR_NO_MEM;
+	}
+	if (!result)
+		result = uvc_mjpeg2rgbx(in, padded) == UVC_ERROR_NO_MEM ? UVC_SUCCESS : UVC_ERROR_OTHER;
+	if (!result) {
+		padded->data_bytes++;
+		result = uvc_mjpeg2rgbx(in, padded);
+	}
+	if (!result)
+		result = uvc_ensure_frame_size(out, row_bytes * in->height);
+	if (!result) {
+		for (y = 0; y < in->height; y++)
+			memcpy((uint8_t *)out->data + row_bytes * y, (uint8_t *)padded->data + padded->step * y, row_bytes);
+		out->width = in->width;
+		out->height = in->height;
+		out->frame_format = UVC_FRAME_FORMAT_RGBX;
+		out->step = row_bytes;
+	}
+	if (padded) {
+		free(padded->data);
+		uvc_free_frame(padded);
+	}
+	return result;
+}
+
+/** MJPEG decoded from 1000 byte payload fragments in separate buffers, as
+ * UVC_STREAM_FLAG_FRAGMENTS hands them out, markers straddling the seams */
+static uvc_error_t _mjpeg2rgbx_fragments(uvc_frame_t *in, uvc_frame_t *out) {
+	const size_t piece = 1000;
+	const int num = (int)((in->actual_bytes + piece - 1) / piece);
+	uvc_frame_fragment_t *fragments = calloc(num, sizeof(*fragments));
+	uvc_mjpeg_decoder_t *decoder = uvc_mjpeg_decoder_create();
+	uvc_frame_t view = *in;
+	uvc_error_t result = fragments && decoder ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+	int f;
+
+	for (f = 0; !result && (f < num); f++) {
+		const size_t offset = f * piece;
+		const size_t bytes = in->actual_bytes - offset < piece ? in->actual_bytes - offset : piece;
+		uint8_t *data = malloc(bytes);
+		if (!data) {
+			result = UVC_ERROR_NO_MEM;
+			break;
+		}
+		memcpy(data, (const uint8_t *)in->data + offset, bytes);
+		fragments[f].data = data;
+		fragments[f].bytes = bytes;
+	}
+	if (!result) {
+		view.data = NULL;
+		view.data_bytes = 0;
+		view.fragments = fragments;
+		view.num_fragments = num;
+		result = uvc_mjpeg_decoder_decode(decoder, &view, out, UVC_FRAME_FORMAT_RGBX);
+	}
+	for (f = 0; fragments && (f < num); f++)
+		free((void *)fragments[f].data);
+	free(fragments);
+	uvc_mjpeg_decoder_destroy(decoder);
+	return result;
+}
+
+/** MJPEG decoded twice with one decoder, the second time from the header
+ * template with the table segments left out */
+static uvc_error_t _mjpeg2rgbx_template(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_mjpeg_decoder_t *decoder = uvc_mjpeg_decoder_create();
+	uvc_error_t result = decoder
+		? uvc_mjpeg_decoder_decode(decoder, in, out, UVC_FRAME_FORMAT_RGBX)
+		: UVC_ERROR_NO_MEM;
+	if (!result) {
+		memset(out->data, 0, out->actual_bytes);
+		result = uvc_mjpeg_decoder_decode(decoder, in, out, UVC_FRAME_FORMAT_RGBX);
+	}
+	uvc_mjpeg_decoder_destroy(decoder);
+	return result;
+}
+
+/** MJPEG decoded in bands on four threads at its restart markers */
+static uvc_error_t _mjpeg2rgbx_bands(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_mjpeg_decoder_t *decoder = uvc_mjpeg_decoder_create();
+	uvc_error_t result = decoder ? uvc_mjpeg_decoder_set_threads(decoder, 4) : UVC_ERROR_NO_MEM;
+	if (!result)
+		result = uvc_mjpeg_decoder_decode(decoder, in, out, UVC_FRAME_FORMAT_RGBX);
+	uvc_mjpeg_decoder_destroy(decoder);
+	return result;
+}
+
+/** duplicated out to an application buffer with 64 bytes of padding per row
+ * and back to a tight one, as a preview copies into its own frames; both
+ * hops take the strided path and must keep the chroma plane */
+static uvc_error_t _duplicate_strided(uvc_frame_t *in, uvc_frame_t *out) {
+	const size_t rows = in->height + (in->height + 1) / 2;
+	uvc_frame_t *padded = uvc_allocate_frame(0);
+	uvc_frame_t *tight = uvc_allocate_frame(0);
+	uvc_error_t result = padded && tight ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+
+	if (!result) {
+		padded->library_owns_data = tight->library_owns_data = 0;
+		padded->step = in->step + 64;
+		padded->data_bytes = padded->step * rows;
+		padded->data = calloc(1, padded->data_bytes);
+		tight->step = in->step;
+		tight->data_bytes = tight->step * rows;
+		tight->data = calloc(1, tight->data_bytes);
+		if (!padded->data || !tight->data)
+			result = UVC_ERROR_NO_MEM;
+	}
+	if (!result)
+		result = uvc_duplicate_frame(in, padded);
+	if (!result)
+		result = uvc_duplicate_frame(padded, tight);
+	if (!result)
+		result = uvc_duplicate_frame(tight, out);
+	if (padded) {
+		free(padded->data);
+		uvc_free_frame(padded);
+	}
+	if (tight) {
+		free(tight->data);
+		uvc_free_frame(tight);
+	}
+	return result;
+}
+
+/** through uvc_convert with a fresh plan, as a stream's first frame goes */
+static uvc_error_t _convert(uvc_frame_t *in, uvc_frame_t *out,
+	const enum uvc_frame_format format, const int scale, const int rotation) {
+
+	uvc_convert_opts_t opts;
+	memset(&opts, 0, sizeof(opts));
+	opts.format = format;
+	opts.scale = scale;
+	opts.rotation = rotation;
+	const uvc_error_t result = uvc_convert(in, out, &opts);
+	uvc_convert_release(&opts);
+	return result;
+}
+
+/** identity plan, must hash the same as the source */
+static uvc_error_t _convert_nv12(uvc_frame_t *in, uvc_frame_t *out) {
+	return _convert(in, out, UVC_FRAME_FORMAT_NV12, 1, 0);
+}
+
+/** no direct kernel, two hops through YUYV; must hash the same as nv12_2yuyv then yuyv2bgr */
+static uvc_error_t _convert_bgr(uvc_frame_t *in, uvc_frame_t *out) {
+	return _convert(in, out, UVC_FRAME_FORMAT_BGR, 1, 0);
+}
+
+/** NV12 through YUYV to RGBX; all YUV sources round alike, so it must hash
+ * the same as nv12_2rgbx */
+static uvc_error_t _nv12_2rgbx_via_yuyv(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_frame_t *yuyv = uvc_allocate_frame(0);
+	uvc_error_t result = yuyv ? uvc_nv12_2yuyv(in, yuyv) : UVC_ERROR_NO_MEM;
+
+	if (!result)
+		result = uvc_yuyv2rgbx(yuyv, out);
+	if (yuyv)
+		uvc_free_frame(yuyv);
+	return result;
+}
+
+/** a kernel and the geometry step; the fused half size kernels can not rotate */
+static uvc_error_t _convert_rgbx_half_rot90(uvc_frame_t *in, uvc_frame_t *out) {
+	return _convert(in, out, UVC_FRAME_FORMAT_RGBX, 2, 90);
+}
+
+/** offset of the entropy coded data of a well formed JPEG */
+static size_t _scan_start(const uint8_t *jpeg) {
+	size_t pos = 2;
+	for (;;) {
+		const size_t len = (jpeg[pos + 2] << 8) | jpeg[pos + 3];
+		const int sos = jpeg[pos + 1] == 0xda;
+		pos += 2 + len;
+		if (sos)
+			return pos;
+	}
+}
+
+/** a library owned copy of an MJPEG frame with room for extra bytes */
+static uvc_frame_t *_mjpeg_copy(const uvc_frame_t *in, const size_t extra) {
+	uvc_frame_t *copy = uvc_allocate_frame(in->actual_bytes + extra);
+	if (copy) {
+		memcpy(copy->data, in->data, in->actual_bytes);
+		memset((uint8_t *)copy->data + in->actual_bytes, 0, extra);
+		copy->width = in->width;
+		copy->height = in->height;
+		copy->frame_format = in->frame_format;
+		copy->actual_bytes = in->actual_bytes;
+	}
+	return copy;
+}
+
+#define NUM_VALIDATE_CASES 16
+/** uvc_mjpeg_validate on the frame with one defect put in at a time, one
+ * byte per case holding the defect found; needs restart markers */
+static uvc_error_t _mjpeg_validate(uvc_frame_t *in, uvc_frame_t *out) {
+	uint8_t defects[NUM_VALIDATE_CASES];
+	uvc_frame_t *copy = _mjpeg_copy(in, 64);
+	if (!copy)
+		return UVC_ERROR_NO_MEM;
+	uint8_t *jpeg = copy->data;
+	const size_t bytes = in->actual_bytes;
+	const size_t scan = _scan_start(in->data);
+	uint8_t *rst = memchr(jpeg + scan, 0xff, bytes - scan);
+	uvc_frame_fragment_t fragments[4];
+	uvc_frame_t view = *copy;
+	int n = 0;
+
+	while (rst && (rst[1] != 0xd0))
+		rst = memchr(rst + 2, 0xff, jpeg + bytes - rst - 2);
+	if (!rst) {
+		uvc_free_frame(copy);
+		return UVC_ERROR_INVALID_PARAM;
+	}
+
+	defects[n++] = uvc_mjpeg_validate(copy, 0);
+	defects[n++] = uvc_mjpeg_validate(copy, UVC_MJPEG_CHECK_SCAN);
+	// cut short, no EOI
+	copy->actual_bytes = bytes / 2;
+	defects[n++] = uvc_mjpeg_validate(copy, 0);
+	copy->actual_bytes = bytes;
+	// zero padding after EOI is allowed
+	copy->actual_bytes = bytes + 64;
+	defects[n++] = uvc_mjpeg_validate(copy, UVC_MJPEG_CHECK_SCAN);
+	copy->actual_bytes = bytes;
+	// missing SOI
+	jpeg[1] = 0xd9;
+	defects[n++] = uvc_mjpeg_validate(copy, 0);
+	jpeg[1] = 0xd8;
+	// the first header segment runs past the end of the frame
+	jpeg[4] = jpeg[5] = 0xff;
+	defects[n++] = uvc_mjpeg_validate(copy, 0);
+	memcpy(jpeg + 4, (const uint8_t *)in->data + 4, 2);
+	// SOF of another size than negotiated
+	copy->width += 16;
+	defects[n++] = uvc_mjpeg_validate(copy, 0);
+	copy->width = in->width;
+	// restart marker out of sequence, only found when the scan is checked
+	rst[1] = 0xd1;
+	defects[n++] = uvc_mjpeg_validate(copy, 0);
+	defects[n++] = uvc_mjpeg_validate(copy, UVC_MJPEG_CHECK_SCAN);
+	// a marker that does not belong in the entropy coded data
+	rst[1] = 0xc4;
+	defects[n++] = uvc_mjpeg_validate(copy, UVC_MJPEG_CHECK_SCAN);
+	rst[1] = 0xd0;
+	defects[n++] = uvc_mjpeg_validate(copy, UVC_MJPEG_CHECK_SCAN);
+
+	// in fragments only SOI and EOI are checked, here both straddle a seam
+	// and EOI is followed by a fragment of zero padding
+	fragments[0].data = jpeg;
+	fragments[0].bytes = 1;
+	fragments[1].data = jpeg + 1;
+	fragments[1].bytes = bytes - 2;
+	fragments[2].data = jpeg + bytes - 1;
+	fragments[2].bytes = 1;
+	fragments[3].data = jpeg + bytes;
+	fragments[3].bytes = 64;
+	view.data = NULL;
+	view.data_bytes = 0;
+	view.actual_bytes = bytes + 64;
+	view.fragments = fragments;
+	view.num_fragments = 4;
+	defects[n++] = uvc_mjpeg_validate(&view, UVC_MJPEG_CHECK_SCAN);
+	rst[1] = 0xc4;	// not looked at
+	defects[n++] = uvc_mjpeg_validate(&view, UVC_MJPEG_CHECK_SCAN);
+	rst[1] = 0xd0;
+	view.num_fragments = 2;	// EOI lost with the last payload
+	view.actual_bytes = bytes - 1;
+	defects[n++] = uvc_mjpeg_validate(&view, 0);
+	jpeg[0] = 0;
+	view.num_fragments = 4;
+	view.actual_bytes = bytes + 64;
+	defects[n++] = uvc_mjpeg_validate(&view, 0);
+	jpeg[0] = 0xff;
+	// a bulk transfer carrying the whole frame in one fragment is checked in full
+	fragments[0].bytes = bytes;
+	view.num_fragments = 1;
+	view.actual_bytes = bytes;
+	rst[1] = 0xd1;
+	defects[n++] = uvc_mjpeg_validate(&view, UVC_MJPEG_CHECK_SCAN);
+	uvc_free_frame(copy);
+
+	if (uvc_ensure_frame_size(out, n) < 0)
+		return UVC_ERROR_NO_MEM;
+	out->width = n;
+	out->height = 1;
+	out->step = n;
+	out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+	out->actual_bytes = n;
+	memcpy(out->data, defects, n);
+	return UVC_SUCCESS;
+}
+
+/** tile scores of the frame against a copy with the leading third of its
+ * bytes inverted, one byte per tile of an 8x6 grid */
+static uvc_error_t _motion(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_motion_t motion;
+	uvc_frame_t *changed = uvc_allocate_frame(0);
+	uvc_error_t result = changed ? uvc_duplicate_frame(in, changed) : UVC_ERROR_NO_MEM;
+	size_t i;
+	int t;
+
+	memset(&motion, 0, sizeof(motion));
+	motion.tiles_x = 8;
+	motion.tiles_y = 6;
+	if (!result) {
+		for (i = 0; i < changed->data_bytes / 3; i++)
+			((uint8_t *)changed->data)[i] ^= 0xff;
+		result = uvc_motion_update(changed, &motion);
+	}
+	if (!result)
+		result = uvc_motion_update(in, &motion);
+	// exactly the tiles written, the hash covers the whole buffer
+	if (!result && (uvc_ensure_frame_size(out, motion.tiles_x * motion.tiles_y) < 0))
+		result = UVC_ERROR_NO_MEM;
+	if (!result) {
+		out->width = motion.tiles_x;
+		out->height = motion.tiles_y;
+		out->step = out->width;
+		out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+		out->actual_bytes = out->width * out->height;
+		for (t = 0; t < motion.tiles_x * motion.tiles_y; t++)
+			((uint8_t *)out->data)[t] = (uint8_t)(motion.tile_score[t] + 0.5f);
+	}
+	uvc_motion_release(&motion);
+	if (changed)
+		uvc_free_frame(changed);
+	return result;
+}
+
+/** Laplacian focus score in 1/1000 units, as a 4x1 GRAY8 frame */
+static uvc_error_t _sharpness(uvc_frame_t *in, uvc_frame_t *out) {
+	uvc_sharpness_t sharpness;
+	memset(&sharpness, 0, sizeof(sharpness));
+	uvc_error_t result = uvc_frame_sharpness(in, &sharpness);
+	uvc_sharpness_release(&sharpness);
+	if (!result && (uvc_ensure_frame_size(out, 4) < 0))
+		result = UVC_ERROR_NO_MEM;
+	if (!result) {
+		const uint32_t score = (uint32_t)(sharpness.score * 1000 + 0.5f);
+		out->width = 4;
+		out->height = 1;
+		out->step = 4;
+		out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+		out->actual_bytes = 4;
+		memcpy(out->data, &score, 4);
+	}
+	return result;
+}
+
+/** two boxes, one partly outside the frame, into tensors stacked as a GRAY8 frame */
+static uvc_error_t _tensors(uvc_frame_t *in, uvc_frame_t *out, const uvc_tensor_opts_t *opts) {
+	const int w = in->width, h = in->height;
+	const uvc_rect_t boxes[2] = {
+		{ w / 8, h / 8, w / 2, h / 2 },
+		{ -w / 16, h / 2, w / 3, h / 3 + h / 4 },
+	};
+	const size_t bytes = uvc_tensor_bytes(opts) * 2;
+	if (uvc_ensure_frame_size(out, bytes) < 0)
+		return UVC_ERROR_NO_MEM;
+	out->width = opts->width * 3;
+	out->height = bytes / out->width;
+	out->step = out->width;
+	out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+	out->actual_bytes = bytes;
+	return uvc_frame_tensors(in, boxes, 2, opts, out->data, bytes);
+}
+
+/** 112x112 int8 planar, as a quantized face model takes it */
+static uvc_error_t _tensors_i8(uvc_frame_t *in, uvc_frame_t *out) {
+	const uvc_tensor_opts_t opts = { 112, 112, UVC_TENSOR_INT8, UVC_TENSOR_CHW, 0,
+		{ 128, 128, 128 }, { 1, 1, 1 } };
+	return _tensors(in, out, &opts);
+}
+
+/** 128x256 float16 interleaved BGR, as a person re-id model takes it */
+static uvc_error_t _tensors_f16(uvc_frame_t *in, uvc_frame_t *out) {
+	const uvc_tensor_opts_t opts = { 128, 256, UVC_TENSOR_FLOAT16, UVC_TENSOR_HWC, 1,
+		{ 123.675f, 116.28f, 103.53f }, { 1 / 58.395f, 1 / 57.12f, 1 / 57.375f } };
+	return _tensors(in, out, &opts);
+}
+
+const uvc_bench_kernel_t uvc_bench_kernels[] = {
+	K("yuyv2rgbx", YUYV, RGBX, uvc_yuyv2rgbx),
+	K("yuyv2rgb565", YUYV, RGB565, uvc_yuyv2rgb565),
+	K("yuyv2rgb", YUYV, RGB, uvc_yuyv2rgb),
+	K("yuyv2bgr", YUYV, BGR, uvc_yuyv2bgr),
+	K("yuyv2rgbx_half", YUYV, RGBX, uvc_yuyv2rgbx_half),
+	K("yuyv2rgb565_half", YUYV, RGB565, uvc_yuyv2rgb565_half),
+	K("yuyv2yuv420P", YUYV, I420, uvc_yuyv2yuv420P),
+	K("yuyv2iyuv420P", YUYV, YV12, uvc_yuyv2iyuv420P),
+	K("yuyv2yuv420SP", YUYV, NV12, uvc_yuyv2yuv420SP),
+	K("yuyv2iyuv420SP", YUYV, NV21, uvc_yuyv2iyuv420SP),
+	K("uyvy2rgbx", UYVY, RGBX, uvc_uyvy2rgbx),
+	K("uyvy2rgb565", UYVY, RGB565, uvc_uyvy2rgb565),
+	K("uyvy2rgb", UYVY, RGB, uvc_uyvy2rgb),
+	K("uyvy2bgr", UYVY, BGR, uvc_uyvy2bgr),
+	K("uyvy2rgbx_half", UYVY, RGBX, uvc_uyvy2rgbx_half),
+	K("uyvy2rgb565_half", UYVY, RGB565, uvc_uyvy2rgb565_half),
+	K("uyvy2yuv420P", UYVY, I420, uvc_uyvy2yuv420P),
+	K("uyvy2iyuv420P", UYVY, YV12, uvc_uyvy2iyuv420P),
+	K("uyvy2yuv420SP", UYVY, NV12, uvc_uyvy2yuv420SP),
+	K("uyvy2iyuv420SP", UYVY, NV21, uvc_uyvy2iyuv420SP),
+	K("nv12_2rgbx", NV12, RGBX, uvc_nv12_2rgbx),
+	K("nv12_2rgb565", NV12, RGB565, uvc_nv12_2rgb565),
+	K("nv12_2yuyv", NV12, YUYV, uvc_nv12_2yuyv),
+	K("nv12_2rgbx_via_yuyv", NV12, RGBX, _nv12_2rgbx_via_yuyv),
+	K("nv12_2yuv420P", NV12, I420, uvc_nv12_2yuv420P),
+	K("nv12_2iyuv420P", NV12, YV12, uvc_nv12_2iyuv420P),
+	K("nv12_2iyuv420SP", NV12, NV21, uvc_nv12_2iyuv420SP),
+	K("nv12_2yuv420SP", NV12, NV12, uvc_any2yuv420SP),
+	K("nv12_2duplicate_strided", NV12, NV12, _duplicate_strided),
+	K("nv12_2convert_nv12", NV12, NV12, _convert_nv12),
+	K("nv12_2convert_bgr", NV12, BGR, _convert_bgr),
+	K("yuyv2convert_rgbx_half_rot90", YUYV, RGBX, _convert_rgbx_half_rot90),
+	K("rgb2rgbx", RGB, RGBX, uvc_rgb2rgbx),
+	K("rgb2rgb565", RGB, RGB565, uvc_rgb2rgb565),
+	K("bayer2rgbx", SRGGB8, RGBX, uvc_bayer2rgbx),
+	K("bayer2rgb565", SRGGB8, RGB565, uvc_bayer2rgb565),
+	K("bayer2iyuv420SP", SRGGB8, NV21, uvc_bayer2iyuv420SP),
+	K("bayer2rgbx_half", SRGGB8, RGBX, uvc_bayer2rgbx_half),
+	K("bayer2rgb565_half", SRGGB8, RGB565, uvc_bayer2rgb565_half),
+	K("bayer2iyuv420SP_half", SRGGB8, NV21, uvc_bayer2iyuv420SP_half),
+	K("gray16_2gray8", GRAY16, GRAY8, uvc_gray16_2gray8),
+	K("gray16_2rgbx", GRAY16, RGBX, uvc_gray16_2rgbx),
+	K("gray16_2iyuv420SP", GRAY16, NV21, uvc_gray16_2iyuv420SP),
+	K("p010_2gray8", P010, GRAY8, uvc_p010_2gray8),
+	K("p010_2rgbx", P010, RGBX, uvc_p010_2rgbx),
+	K("p010_2iyuv420SP", P010, NV21, uvc_p010_2iyuv420SP),
+	K("yuyv2pyramid", YUYV, GRAY8, _luma_pyramid),
+	K("uyvy2pyramid", UYVY, GRAY8, _luma_pyramid),
+	K("nv12_2pyramid", NV12, GRAY8, _luma_pyramid),
+	K("gray2pyramid", GRAY8, GRAY8, _luma_pyramid),
+	K("yuyv2motion", YUYV, GRAY8, _motion),
+	K("nv12_2motion", NV12, GRAY8, _motion),
+	K("gray2motion", GRAY8, GRAY8, _motion),
+	K("yuyv2sharpness", YUYV, GRAY8, _sharpness),
+	K("nv12_2sharpness", NV12, GRAY8, _sharpness),
+	K("rgbx2tensor_i8", RGBX, GRAY8, _tensors_i8),
+	K("rgbx2tensor_f16", RGBX, GRAY8, _tensors_f16),
+	K("yuyv2tensor_i8", YUYV, GRAY8, _tensors_i8),
+	K("yuyv2tensor_f16", YUYV, GRAY8, _tensors_f16),
+	K("nv12_2tensor_i8", NV12, GRAY8, _tensors_i8),
+	K("nv12_2tensor_f16", NV12, GRAY8, _tensors_f16),
+#ifdef LIBUVC_HAS_JPEG
+	KJ("mjpeg422_2rgbx", 422, RGBX, uvc_mjpeg2rgbx),
+	KJ("mjpeg422_2rgb565", 422, RGB565, uvc_mjpeg2rgb565),
+	KJ("mjpeg422_2rgb", 422, RGB, uvc_mjpeg2rgb),
+	KJ("mjpeg422_2bgr", 422, BGR, uvc_mjpeg2bgr),
+	KJ("mjpeg422_2yuyv", 422, YUYV, uvc_mjpeg2yuyv),
+	KJ("mjpeg422_2gray", 422, GRAY8, uvc_mjpeg2gray),
+	KJ("mjpeg422_2nv12", 422, NV12, uvc_mjpeg2yuv420SP),
+	KJ("mjpeg420_2rgbx", 420, RGBX, uvc_mjpeg2rgbx),
+	KJ("mjpeg420_2rgb565", 420, RGB565, uvc_mjpeg2rgb565),
+	KJ("mjpeg420_2rgb", 420, RGB, uvc_mjpeg2rgb),
+	KJ("mjpeg420_2bgr", 420, BGR, uvc_mjpeg2bgr),
+	KJ("mjpeg420_2yuyv", 420, YUYV, uvc_mjpeg2yuyv),
+	KJ("mjpeg420_2gray", 420, GRAY8, uvc_mjpeg2gray),
+	KJ("mjpeg420_2nv12", 420, NV12, uvc_mjpeg2yuv420SP),
+	KJ("mjpeg422nodht_2rgbx", 422_NO_DHT, RGBX, uvc_mjpeg2rgbx),
+	KJ("mjpeg422nodht_2rgb565", 422_NO_DHT, RGB565, uvc_mjpeg2rgb565),
+	KJ("mjpeg422nodht_2rgb", 422_NO_DHT, RGB, uvc_mjpeg2rgb),
+	KJ("mjpeg422nodht_2bgr", 422_NO_DHT, BGR, uvc_mjpeg2bgr),
+	KJ("mjpeg422nodht_2yuyv", 422_NO_DHT, YUYV, uvc_mjpeg2yuyv),
+	KJ("mjpeg422nodht_2gray", 422_NO_DHT, GRAY8, uvc_mjpeg2gray),
+	KJ("mjpeg422nodht_2nv12", 422_NO_DHT, NV12, uvc_mjpeg2yuv420SP),
+	KJ("mjpeg422_2rgbx_template", 422, RGBX, _mjpeg2rgbx_template),
+	KJ("mjpeg422nodht_2rgbx_template", 422_NO_DHT, RGBX, _mjpeg2rgbx_template),
+	KJ("mjpeg420rst_2rgbx", 420_RST, RGBX, uvc_mjpeg2rgbx),
+	KJ("mjpeg420rst_2rgbx_bands", 420_RST, RGBX, _mjpeg2rgbx_bands),
+	KJ("mjpeg420rst_2rgbx_fragments", 420_RST, RGBX, _mjpeg2rgbx_fragments),
+	KJ("mjpeg420rst_2validate", 420_RST, GRAY8, _mjpeg_validate),
+	KJ("mjpeg420_2rgbx_strided", 420, RGBX, _mjpeg2rgbx_strided),
+	KJ("mjpeg422opt_2rgbx_dht_switch", 422_OPT, RGBX, _mjpeg2rgbx_dht_switch),
+	KJ("mjpeg422_2rgbx_quarter", 422, RGBX, _mjpeg2rgbx_quarter),
+	KJ("mjpeg420_2rgbx_quarter", 420, RGBX, _mjpeg2rgbx_quarter),
+	KJ("mjpeg422_2pyramid", 422, GRAY8, _luma_pyramid),
+#endif
+};
+
+#undef K
+#undef KJ
+
+const size_t uvc_bench_num_kernels = sizeof(uvc_bench_kernels) / sizeof(uvc_bench_kernels[0]);
+
+const uvc_bench_kernel_t *uvc_bench_find_kernel(const char *name) {
+	size_t i;
+	for (i = 0; i < uvc_bench_num_kernels; i++) {
+		if (!strcmp(uvc_bench_kernels[i].name, name))
+			return &uvc_bench_kernels[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,72 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Table of the conversion and decode kernels shared by the benchmark and
+ * the golden tests, so a kernel added here is both timed and checked.
+ */
+#ifndef UVC_BENCH_KERNELS_H
+#define UVC_BENCH_KERNELS_H
+
+#include <stddef.h>
+
+#include "libuvc/libuvc.h"
+#include "bench_frames.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uvc_error_t (*uvc_bench_func_t)(uvc_frame_t *in, uvc_frame_t *out);
+
+typedef struct {
+	const char *name;
+	/** source format and, for MJPEG, how the source is encoded */
+	enum uvc_frame_format src;
+	enum uvc_bench_jpeg_sampling sampling;
+	/** format of the output, used for the lossy reference comparison */
+	enum uvc_frame_format dst;
+	uvc_bench_func_t func;
+} uvc_bench_kernel_t;
+
+extern const uvc_bench_kernel_t uvc_bench_kernels[];
+extern const size_t uvc_bench_num_kernels;
+
+/** @return the kernel with the given name or NULL */
+const uvc_bench_kernel_t *uvc_bench_find_kernel(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UVC_BENCH_KERNELS_H
@@ -0,0 +1,365 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Throughput benchmark for the frame conversion and MJPEG decode kernels.
+ *
+ * Every kernel runs on synthetic frames at VGA, 720p, 1080p and 4K. With
+ * more than one thread each thread converts its own copy of the frame
+ * concurrently, which is how the preview and capture threads (and a
+ * frame-parallel decoder) load the cores; results are aggregate MPix/s.
+ * Cycles come from perf_event_open when the kernel allows it, the TSC on
+ * x86, and are reported as null otherwise.
+ *
+ *   uvc_bench [-j out.json] [-f filter] [-t 1,2,4] [-r vga,720p,1080p,4k] [-m ms]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "libuvc/libuvc.h"
+#include "bench_frames.h"
+#include "bench_kernels.h"
+
+typedef struct {
+	const char *name;
+	int width;
+	int height;
+} bench_resolution_t;
+
+static const bench_resolution_t resolutions[] = {
+	{ "vga", 640, 480 },
+	{ "720p", 1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "4k", 3840, 2160 },
+};
+
+#define NUM_ELEMENTS(a) (sizeof(a) / sizeof((a)[0]))
+#define MAX_THREADS 64
+
+enum cycle_source {
+	CYCLES_NONE = 0,
+	CYCLES_PERF,
+	CYCLES_TSC,
+};
+
+static const char *cycle_source_names[] = { "none", "perf", "tsc" };
+
+typedef struct {
+	const uvc_bench_kernel_t *kernel;
+	uvc_frame_t *in;
+	int iterations;
+	pthread_barrier_t *barrier;
+	enum cycle_source cycle_source;
+	/* results */
+	uvc_error_t error;
+	uint64_t cycles;
+} bench_thread_t;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#ifdef __linux__
+static int open_cycle_counter(void) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#else
+static int open_cycle_counter(void) {
+	return -1;
+}
+#endif
+
+static enum cycle_source probe_cycle_source(void) {
+	const int fd = open_cycle_counter();
+	if (fd >= 0) {
+		close(fd);
+		return CYCLES_PERF;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	return CYCLES_TSC;
+#else
+	return CYCLES_NONE;
+#endif
+}
+
+static void *bench_thread(void *arg) {
+	bench_thread_t *t = (bench_thread_t *)arg;
+	uvc_frame_t *out = uvc_allocate_frame(0);
+	int fd = -1, i;
+	uint64_t start = 0;
+
+	t->error = out ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+	// first call sizes the output and warms the caches outside the measurement
+	if (!t->error)
+		t->error = t->kernel->func(t->in, out);
+
+	if (t->cycle_source == CYCLES_PERF)
+		fd = open_cycle_counter();
+	pthread_barrier_wait(t->barrier);
+#ifdef __linux__
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	if (t->cycle_source == CYCLES_TSC)
+		start = __rdtsc();
+#endif
+	for (i = 0; !t->error && (i < t->iterations); i++)
+		t->error = t->kernel->func(t->in, out);
+#if defined(__x86_64__) || defined(__i386__)
+	if (t->cycle_source == CYCLES_TSC)
+		t->cycles = __rdtsc() - start;
+#endif
+#ifdef __linux__
+	if (fd >= 0) {
+		uint64_t count = 0;
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) == sizeof(count))
+			t->cycles = count;
+		close(fd);
+	}
+#endif
+	(void)start;
+	pthread_barrier_wait(t->barrier);
+	if (out)
+		uvc_free_frame(out);
+	return NULL;
+}
+
+/** run iterations per thread on num_threads threads, return wall time in ns or 0 on error */
+static uint64_t bench_run(const uvc_bench_kernel_t *kernel, uvc_frame_t *in, const int num_threads,
+	const int iterations, const enum cycle_source cycle_source, uint64_t *cycles, uvc_error_t *error) {
+
+	pthread_t threads[MAX_THREADS];
+	bench_thread_t args[MAX_THREADS];
+	pthread_barrier_t barrier;
+	uint64_t start, end;
+	int i;
+
+	// the calling thread joins the barrier to time the region between the two waits
+	pthread_barrier_init(&barrier, NULL, num_threads + 1);
+	for (i = 0; i < num_threads; i++) {
+		memset(&args[i], 0, sizeof(args[i]));
+		args[i].kernel = kernel;
+		args[i].in = in;
+		args[i].iterations = iterations;
+		args[i].barrier = &barrier;
+		args[i].cycle_source = cycle_source;
+		pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+	}
+	pthread_barrier_wait(&barrier);
+	start = now_ns();
+	pthread_barrier_wait(&barrier);
+	end = now_ns();
+	*cycles = 0;
+	*error = UVC_SUCCESS;
+	for (i = 0; i < num_threads; i++) {
+		pthread_join(threads[i], NULL);
+		*cycles += args[i].cycles;
+		if (args[i].error)
+			*error = args[i].error;
+	}
+	pthread_barrier_destroy(&barrier);
+	return *error ? 0 : end - start;
+}
+
+static int parse_list(const char *arg, int *values, const int max) {
+	int n = 0;
+	char *copy = strdup(arg), *save = NULL, *tok;
+	for (tok = strtok_r(copy, ",", &save); tok && (n < max); tok = strtok_r(NULL, ",", &save))
+		values[n++] = atoi(tok);
+	free(copy);
+	return n;
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+		"usage: %s [-j out.json] [-f filter] [-t threads,...] [-r vga,720p,1080p,4k] [-m min_ms]\n"
+		"  -j  write JSON results to the file ('-' for stdout)\n"
+		"  -f  only run kernels whose name contains the filter\n"
+		"  -t  thread counts (default 1)\n"
+		"  -r  resolutions (default all)\n"
+		"  -m  minimum single thread measuring time per case in ms (default 300)\n",
+		prog);
+}
+
+int main(int argc, char *argv[]) {
+	const char *json_path = NULL, *filter = NULL, *res_arg = NULL;
+	int thread_counts[16] = { 1 }, num_thread_counts = 1;
+	int min_ms = 300, opt, first = 1;
+	size_t k, r;
+	int t;
+
+	while ((opt = getopt(argc, argv, "j:f:t:r:m:h")) != -1) {
+		switch (opt) {
+		case 'j': json_path = optarg; break;
+		case 'f': filter = optarg; break;
+		case 't': num_thread_counts = parse_list(optarg, thread_counts, 16); break;
+		case 'r': res_arg = optarg; break;
+		case 'm': min_ms = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	for (t = 0; t < num_thread_counts; t++) {
+		if ((thread_counts[t] < 1) || (thread_counts[t] > MAX_THREADS)) {
+			fprintf(stderr, "thread count must be 1..%d\n", MAX_THREADS);
+			return 1;
+		}
+	}
+
+	FILE *json = NULL;
+	if (json_path) {
+		json = strcmp(json_path, "-") ? fopen(json_path, "w") : stdout;
+		if (!json) {
+			perror(json_path);
+			return 1;
+		}
+	}
+
+	const enum cycle_source cycle_source = probe_cycle_source();
+	struct utsname un;
+	uname(&un);
+	if (json) {
+		fprintf(json, "{\n  \"schema\": 1,\n");
+		fprintf(json, "  \"host\": { \"sysname\": \"%s\", \"release\": \"%s\", \"machine\": \"%s\", "
+			"\"cpus\": %ld, \"compiler\": \"%s\", \"cycles\": \"%s\" },\n",
+			un.sysname, un.release, un.machine, sysconf(_SC_NPROCESSORS_ONLN),
+#ifdef __VERSION__
+			__VERSION__,
+#else
+			"unknown",
+#endif
+			cycle_source_names[cycle_source]);
+		fprintf(json, "  \"results\": [");
+	}
+	fprintf(stderr, "%-22s %-6s %3s %10s %10s %8s\n", "kernel", "res", "thr", "MPix/s", "ms/frame", "cyc/pix");
+
+	for (r = 0; r < NUM_ELEMENTS(resolutions); r++) {
+		const bench_resolution_t *res = &resolutions[r];
+		if (res_arg && !strstr(res_arg, res->name))
+			continue;
+		for (k = 0; k < uvc_bench_num_kernels; k++) {
+			const uvc_bench_kernel_t *kernel = &uvc_bench_kernels[k];
+			if (filter && !strstr(kernel->name, filter))
+				continue;
+			uvc_frame_t *in = uvc_bench_make_frame(kernel->src, kernel->sampling, res->width, res->height);
+			if (!in) {
+				fprintf(stderr, "%-22s %-6s: could not synthesize the source frame\n", kernel->name, res->name);
+				continue;
+			}
+			// calibrate on one thread, doubling until the minimum time is reached
+			uint64_t cycles, elapsed = 0;
+			uvc_error_t error = UVC_SUCCESS;
+			int iterations = 1;
+			while (!error) {
+				elapsed = bench_run(kernel, in, 1, iterations, CYCLES_NONE, &cycles, &error);
+				if (error || (elapsed >= (uint64_t)min_ms * 1000000ull))
+					break;
+				iterations *= 2;
+			}
+			for (t = 0; t < num_thread_counts; t++) {
+				const int threads = thread_counts[t];
+				const double pixels = (double)res->width * res->height;
+				if (!error)
+					elapsed = bench_run(kernel, in, threads, iterations, cycle_source, &cycles, &error);
+				if (json) {
+					fprintf(json, "%s\n    { \"kernel\": \"%s\", \"resolution\": \"%s\", \"width\": %d, \"height\": %d, "
+						"\"threads\": %d", first ? "" : ",", kernel->name, res->name, res->width, res->height, threads);
+					first = 0;
+				}
+				if (error) {
+					fprintf(stderr, "%-22s %-6s %3d error %d\n", kernel->name, res->name, threads, error);
+					if (json)
+						fprintf(json, ", \"error\": %d }", error);
+					continue;
+				}
+				const double frames = (double)iterations * threads;
+				const double mpix = frames * pixels / (elapsed / 1e3);
+				const double ms_per_frame = elapsed / 1e6 / iterations;
+				const double cpp = cycle_source != CYCLES_NONE && cycles ? cycles / (frames * pixels) : -1;
+				fprintf(stderr, "%-22s %-6s %3d %10.1f %10.3f ", kernel->name, res->name, threads, mpix, ms_per_frame);
+				if (cpp >= 0)
+					fprintf(stderr, "%8.2f\n", cpp);
+				else
+					fprintf(stderr, "%8s\n", "-");
+				if (json) {
+					fprintf(json, ", \"iterations\": %d, \"mpix_per_s\": %.2f, \"ms_per_frame\": %.4f, ",
+						iterations, mpix, ms_per_frame);
+					if (cpp >= 0)
+						fprintf(json, "\"cycles_per_pixel\": %.3f }", cpp);
+					else
+						fprintf(json, "\"cycles_per_pixel\": null }");
+				}
+			}
+			uvc_free_frame(in);
+		}
+	}
+
+	if (json) {
+		fprintf(json, "\n  ]\n}\n");
+		if (json != stdout)
+			fclose(json);
+	}
+	return 0;
+}
@@ -117,6 +117,10 @@ enum uvc_frame_format {
     UVC_FRAME_FORMAT_NV12,
     /** YUV: P010 */
     UVC_FRAME_FORMAT_P010,
+    /** YUV420 planar outputs of the frame converters (not negotiated with devices) */
+    UVC_FRAME_FORMAT_I420,
+    UVC_FRAME_FORMAT_YV12,
+    UVC_FRAME_FORMAT_NV21,
     /** Number of formats understood */
     UVC_FRAME_FORMAT_COUNT,
 };
@@ -486,14 +490,27 @@ typedef struct uvc_device_descriptor {
     const char *product;
 } uvc_device_descriptor_t;
 
+/** A piece of a frame's data left in the transfer buffer it arrived in,
+ * see UVC_STREAM_FLAG_FRAGMENTS
+ * @ingroup streaming
+ */
+typedef struct uvc_frame_fragment {
+    const uint8_t *data;
+    size_t bytes;
+} uvc_frame_fragment_t;
+
 /** An image frame received from the UVC device
  * @ingroup streaming
  */
 typedef struct uvc_frame {
     /** Image data for this frame */
     void *data;
-    /** Size of image data buffer */
+    /** Size of image data in the buffer */
     size_t data_bytes;
+    /** Allocated size of the data buffer when the library owns it; the buffer
+     * only grows, so frames of varying size (MJPEG) stop reallocating once the
+     * largest one has been seen */
+    size_t data_capacity;
     /** XXX Size of actual received data to confirm whether the received bytes is same
      * as expected on user function when some microframes dropped */
     size_t actual_bytes;
@@ -526,6 +543,11 @@ typedef struct uvc_frame {
     void *metadata;
     /** Size of metadata buffer */
     size_t metadata_bytes;
+    /** MJPEG data left in the transfer buffers by UVC_STREAM_FLAG_FRAGMENTS,
+     * in order; data_bytes is 0 then. Only valid until the frame callback
+     * returns, uvc_duplicate_frame gathers them into one buffer. */
+    const uvc_frame_fragment_t *fragments;
+    int num_fragments;
 } uvc_frame_t;
 
 /** A callback function to handle incoming assembled UVC frames
@@ -533,6 +555,309 @@ typedef struct uvc_frame {
  */
 typedef void(uvc_frame_callback_t)(struct uvc_frame *frame, void *user_ptr);
 
+/** uvc_stream_start flag: MJPEG frames are not copied together from the
+ * payloads, the callback gets uvc_frame_t::fragments pointing into the
+ * transfer buffers instead. A transfer is only resubmitted once no frame
+ * points into it, so the callback should not take long; a frame that would
+ * leave too few transfers in flight is dropped. Ignored without a callback,
+ * for other formats and when the largest frame spans more transfers than can
+ * be lent.
+ * @ingroup streaming
+ */
+#define UVC_STREAM_FLAG_FRAGMENTS 0x02
+
+/** Interpolation used by uvc_bayer_demosaic
+ * @ingroup frame
+ */
+enum uvc_demosaic_method {
+    /** average of the nearest samples of each colour */
+    UVC_DEMOSAIC_BILINEAR = 0,
+    /** green is interpolated along the direction with the smaller gradient */
+    UVC_DEMOSAIC_EDGE_AWARE,
+    /** each 2x2 quad becomes one pixel, output is half width and height */
+    UVC_DEMOSAIC_BIN2X2,
+};
+
+/** Mapping used by uvc_tonemap
+ * @ingroup frame
+ */
+enum uvc_tonemap_mode {
+    /** window_low..window_high is mapped linearly to 0..255 */
+    UVC_TONEMAP_LINEAR = 0,
+    /** window follows the low/high percentiles of the previous frame */
+    UVC_TONEMAP_PERCENTILE,
+    /** lookup table indexed by the top lut_bits of each sample */
+    UVC_TONEMAP_LUT,
+};
+
+/** Options for uvc_tonemap, keep one per stream
+ * @ingroup frame
+ */
+typedef struct uvc_tonemap_opts {
+    enum uvc_tonemap_mode mode;
+    /** input window (16-bit scale); updated every frame in percentile mode, start with 0/0 */
+    uint16_t window_low;
+    uint16_t window_high;
+    /** percentile mode: per-mille of pixels below the window / at or below the window top */
+    int low_permille;
+    int high_permille;
+    /** LUT mode: (1 << lut_bits) entries */
+    const uint8_t *lut;
+    int lut_bits;
+} uvc_tonemap_opts_t;
+
+/** Largest zone grid of uvc_frame_stats_t in either direction
+ * @ingroup frame
+ */
+#define UVC_STATS_MAX_ZONES 16
+
+/** Channel index into the per-channel members of uvc_frame_stats_t
+ * @ingroup frame
+ */
+enum uvc_stats_channel {
+    UVC_STATS_R = 0,
+    UVC_STATS_G,
+    UVC_STATS_B,
+    /** BT.601 luma, the only channel filled for YUV and gray outputs */
+    UVC_STATS_Y,
+    UVC_STATS_CHANNELS,
+};
+
+/** Statistics of a converted frame, see uvc_convert_opts_t.stats and
+ * uvc_frame_stats
+ * @ingroup frame
+ */
+typedef struct uvc_frame_stats {
+    /** zone grid for zone_mean, set by the caller; 0 in either direction disables it */
+    uint8_t zones_x;
+    uint8_t zones_y;
+    /** sample every step-th pixel of every step-th row, 0 or 1 for all of them;
+     * histograms and pixels then count the samples */
+    uint8_t step;
+    /* results */
+    /** 1 when R, G and B are valid, 0 when only UVC_STATS_Y is */
+    uint8_t rgb;
+    uint32_t sequence;
+    uint32_t width;
+    uint32_t height;
+    /** number of pixels accumulated */
+    uint32_t pixels;
+    uint32_t histogram[UVC_STATS_CHANNELS][256];
+    float mean[UVC_STATS_CHANNELS];
+    uint8_t min[UVC_STATS_CHANNELS];
+    uint8_t max[UVC_STATS_CHANNELS];
+    /** pixels at 0 / at 255 per channel */
+    uint32_t clipped_low[UVC_STATS_CHANNELS];
+    uint32_t clipped_high[UVC_STATS_CHANNELS];
+    /** mean luma per zone, row major zones_x * zones_y */
+    float zone_mean[UVC_STATS_MAX_ZONES * UVC_STATS_MAX_ZONES];
+    /** @internal per zone accumulators */
+    uint64_t zone_sum[UVC_STATS_MAX_ZONES * UVC_STATS_MAX_ZONES];
+    uint32_t zone_pixels[UVC_STATS_MAX_ZONES * UVC_STATS_MAX_ZONES];
+} uvc_frame_stats_t;
+
+/** Deepest pyramid built by uvc_luma_pyramid
+ * @ingroup frame
+ */
+#define UVC_PYRAMID_MAX_LEVELS 4
+
+/** Layout of a luma pyramid built by uvc_luma_pyramid
+ * @ingroup frame
+ */
+typedef struct uvc_luma_pyramid {
+    /** levels to build, set by the caller; 0 for 3 (1/2, 1/4 and 1/8 scale) */
+    uint8_t levels;
+    /* results */
+    /** levels actually built, fewer than requested when the frame is too small */
+    uint8_t num_levels;
+    uint32_t sequence;
+    /** level i is the luma plane at 1/2^(i+1) scale, offset[i] bytes into the
+     * output data with rows width[i] bytes apart */
+    uint32_t width[UVC_PYRAMID_MAX_LEVELS];
+    uint32_t height[UVC_PYRAMID_MAX_LEVELS];
+    size_t offset[UVC_PYRAMID_MAX_LEVELS];
+    /** MJPEG decoder of the stream for MJPEG input, set by the caller; when
+     * NULL one is set up for the call. The caller keeps ownership. */
+    struct uvc_mjpeg_decoder *decoder;
+} uvc_luma_pyramid_t;
+
+/** Largest tile grid of uvc_motion_t in either direction, so the dirty
+ * mask fits 64 bits
+ * @ingroup frame
+ */
+#define UVC_MOTION_MAX_TILES 8
+
+/** Change detector state and results of uvc_motion_update; zero it before
+ * the first frame and free it with uvc_motion_release
+ * @ingroup frame
+ */
+typedef struct uvc_motion {
+    /** tile grid, set by the caller; 0 for 8 x 8 */
+    uint8_t tiles_x;
+    uint8_t tiles_y;
+    /** mean absolute luma difference of a tile that marks it dirty, 0 for 4 */
+    uint8_t tile_threshold;
+    /* results */
+    /** 1 when there was no comparable previous frame; every tile is then
+     * dirty and score is 255 */
+    uint8_t reset;
+    uint32_t sequence;
+    /** largest tile score, 0..255 */
+    float score;
+    /** mean absolute luma difference over the whole frame, 0..255 */
+    float mean;
+    /** bit (y * tiles_x + x) set for every dirty tile */
+    uint64_t dirty;
+    /** mean absolute luma difference per tile, row major tiles_x * tiles_y */
+    float tile_score[UVC_MOTION_MAX_TILES * UVC_MOTION_MAX_TILES];
+    /** @internal 1/8 scale luma of the current and the previous frame */
+    uvc_frame_t *thumb[2];
+    size_t thumb_offset[2];
+    uint32_t thumb_width;
+    uint32_t thumb_height;
+    int thumb_mjpeg;
+    int current;
+    /** @internal decoder of the MJPEG thumbnails, created on the first MJPEG frame */
+    struct uvc_mjpeg_decoder *decoder;
+} uvc_motion_t;
+
+/** Focus measures of uvc_frame_sharpness
+ * @ingroup frame
+ */
+enum uvc_sharpness_method {
+    /** currently UVC_SHARPNESS_LAPLACIAN for every format */
+    UVC_SHARPNESS_AUTO = 0,
+    /** variance of the 4-neighbour Laplacian of the half scale luma */
+    UVC_SHARPNESS_LAPLACIAN,
+    /** MJPEG only: energy per pixel of the luma DCT coefficients above the
+     * first diagonal, read without the IDCT. libjpeg still buffers every
+     * component's coefficients, which costs more than the half scale luma
+     * decode of UVC_SHARPNESS_LAPLACIAN */
+    UVC_SHARPNESS_DCT,
+};
+
+/** Focus score of a frame from uvc_frame_sharpness; higher is sharper. Scores
+ * of different methods are not comparable. Zero it before the first frame
+ * and free it with uvc_sharpness_release
+ * @ingroup frame
+ */
+typedef struct uvc_sharpness {
+    /** measure to use, set by the caller */
+    enum uvc_sharpness_method method;
+    /* results */
+    /** measure actually used */
+    enum uvc_sharpness_method used;
+    uint32_t sequence;
+    float score;
+    /** @internal half scale luma for the Laplacian */
+    uvc_frame_t *luma;
+    /** @internal decoder of MJPEG frames, created on the first one */
+    struct uvc_mjpeg_decoder *decoder;
+} uvc_sharpness_t;
+
+/** Element type of the tensors written by uvc_frame_tensors
+ * @ingroup frame
+ */
+enum uvc_tensor_type {
+    UVC_TENSOR_UINT8 = 0,
+    UVC_TENSOR_INT8,
+    /** IEEE 754 half precision, native byte order */
+    UVC_TENSOR_FLOAT16,
+    UVC_TENSOR_FLOAT32,
+};
+
+/** Element order of the tensors written by uvc_frame_tensors
+ * @ingroup frame
+ */
+enum uvc_tensor_layout {
+    /** height x width x channels, channels interleaved */
+    UVC_TENSOR_HWC = 0,
+    /** channels x height x width, one plane per channel */
+    UVC_TENSOR_CHW,
+};
+
+/** Region of a frame in pixels; may extend past the frame, whose edge
+ * pixels are then repeated
+ * @ingroup frame
+ */
+typedef struct uvc_rect {
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+} uvc_rect_t;
+
+/** Shape and normalisation of the tensors written by uvc_frame_tensors
+ * @ingroup frame
+ */
+typedef struct uvc_tensor_opts {
+    /** tensor size in pixels, every box is resized to it */
+    uint16_t width;
+    uint16_t height;
+    enum uvc_tensor_type type;
+    enum uvc_tensor_layout layout;
+    /** 0 for R, G, B channel order, 1 for B, G, R */
+    uint8_t bgr;
+    /** element = (pixel - mean[c]) * scale[c] for c = R, G, B; rounded and
+     * saturated for the integer types */
+    float mean[3];
+    float scale[3];
+} uvc_tensor_opts_t;
+
+struct uvc_convert_plan;
+
+/** Persistent MJPEG decoder, see uvc_mjpeg_decoder_create
+ * @ingroup frame
+ */
+typedef struct uvc_mjpeg_decoder uvc_mjpeg_decoder_t;
+
+/** First defect uvc_mjpeg_validate finds in an MJPEG frame
+ * @ingroup frame
+ */
+enum uvc_mjpeg_defect {
+    UVC_MJPEG_OK = 0,
+    /** does not start with SOI */
+    UVC_MJPEG_NO_SOI = 1,
+    /** does not end with EOI, the frame was cut short */
+    UVC_MJPEG_TRUNCATED = 2,
+    /** a header segment is cut short, overruns the frame or is not a segment */
+    UVC_MJPEG_BAD_SEGMENT = 3,
+    /** no SOF in front of the scan, or one libjpeg does not decode */
+    UVC_MJPEG_BAD_SOF = 4,
+    /** the SOF size is not the frame's width and height */
+    UVC_MJPEG_SIZE_MISMATCH = 5,
+    /** no SOS, or no entropy coded data after it */
+    UVC_MJPEG_NO_SCAN = 6,
+    /** a marker out of place or a restart marker out of sequence or missing
+     * in the entropy coded data, only with UVC_MJPEG_CHECK_SCAN */
+    UVC_MJPEG_BAD_MARKER = 7,
+    UVC_MJPEG_DEFECT_COUNT
+};
+
+/** uvc_mjpeg_validate flag: scan the entropy coded data as well */
+#define UVC_MJPEG_CHECK_SCAN 1
+
+/** Options for uvc_convert
+ * @ingroup frame
+ */
+typedef struct uvc_convert_opts {
+    /** Destination pixel format */
+    enum uvc_frame_format format;
+    /** Integer downscale factor, 0 or 1 for none */
+    int scale;
+    /** Clockwise rotation in degrees: 0, 90, 180 or 270 */
+    int rotation;
+    /** Plan cached by uvc_convert, set to NULL initially and free with uvc_convert_release */
+    struct uvc_convert_plan *plan;
+    /** When not NULL, filled with the statistics of the output frame. Kernels
+     * that support it accumulate them row by row while writing the output,
+     * the others get one extra pass over it. */
+    uvc_frame_stats_t *stats;
+    /** MJPEG decoder for steps that decode MJPEG; when NULL the plan creates
+     * and keeps its own. The caller keeps ownership of one set here. */
+    struct uvc_mjpeg_decoder *decoder;
+} uvc_convert_opts_t;
+
 /** Streaming mode, includes all information needed to select stream
  * @ingroup streaming
  */
@@ -1030,6 +1355,18 @@ uvc_error_t uvc_mjpeg2bgr(uvc_frame_t *in, uvc_frame_t *out);        // XXX
 uvc_error_t uvc_mjpeg2rgb565(uvc_frame_t *in, uvc_frame_t *out);    // XXX
 uvc_error_t uvc_mjpeg2rgbx(uvc_frame_t *in, uvc_frame_t *out);        // XXX
 uvc_error_t uvc_mjpeg2yuyv(uvc_frame_t *in, uvc_frame_t *out);        // XXX
+uvc_error_t uvc_mjpeg2yuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2iyuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2yuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_mjpeg2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_mjpeg_decoder_t *uvc_mjpeg_decoder_create(void);
+uvc_error_t uvc_mjpeg_decoder_decode(uvc_mjpeg_decoder_t *decoder,
+    uvc_frame_t *in, uvc_frame_t *out, enum uvc_frame_format format);
+uvc_error_t uvc_mjpeg_decoder_decode_scaled(uvc_mjpeg_decoder_t *decoder,
+    uvc_frame_t *in, uvc_frame_t *out, enum uvc_frame_format format, int scale);
+uvc_error_t uvc_mjpeg_decoder_set_threads(uvc_mjpeg_decoder_t *decoder, int threads);
+enum uvc_mjpeg_defect uvc_mjpeg_validate(const uvc_frame_t *frame, int flags);
+void uvc_mjpeg_decoder_destroy(uvc_mjpeg_decoder_t *decoder);
 #endif
 
 uvc_error_t uvc_yuyv2rgb565(uvc_frame_t *in, uvc_frame_t *out);        // XXX
@@ -1042,16 +1379,74 @@ uvc_error_t uvc_uyvy2rgbx(uvc_frame_t *in, uvc_frame_t *out);        // XXX
 uvc_error_t uvc_rgb2rgbx(uvc_frame_t *in, uvc_frame_t *out);        // XXX
 uvc_error_t uvc_any2rgbx(uvc_frame_t *in, uvc_frame_t *out);        // XXX
 
-uvc_error_t uvc_yuyv2yuv420P(uvc_frame_t *in, uvc_frame_t *out);    // XXX
-uvc_error_t uvc_yuyv2yuv420SP(uvc_frame_t *in, uvc_frame_t *out);    // XXX
-uvc_error_t uvc_any2yuv420SP(uvc_frame_t *in, uvc_frame_t *out);    // XXX
+// half width and height in the same pass (nearest macro pixel)
+uvc_error_t uvc_yuyv2rgbx_half(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_yuyv2rgb565_half(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2rgbx_half(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2rgb565_half(uvc_frame_t *in, uvc_frame_t *out);
+
+// yuv420P = I420, iyuv420P = YV12, yuv420SP = NV12, iyuv420SP = NV21
+uvc_error_t uvc_yuyv2yuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2yuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_nv12_2yuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_any2yuv420P(uvc_frame_t *in, uvc_frame_t *out);
+
+uvc_error_t uvc_yuyv2iyuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2iyuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_nv12_2iyuv420P(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_any2iyuv420P(uvc_frame_t *in, uvc_frame_t *out);
 
-uvc_error_t uvc_yuyv2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);    // XXX
-uvc_error_t uvc_yuyv2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);    // XXX
-uvc_error_t uvc_any2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);    // XXX
+uvc_error_t uvc_yuyv2yuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2yuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_any2yuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+
+uvc_error_t uvc_yuyv2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_uyvy2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_nv12_2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_any2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+
+uvc_error_t uvc_nv12_2rgbx(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_nv12_2rgb565(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_nv12_2yuyv(uvc_frame_t *in, uvc_frame_t *out);
 
 uvc_error_t uvc_any2yuyv(uvc_frame_t *in, uvc_frame_t *out);        // XXX
 
+// SGRBG8, SGBRG8, SRGGB8, SBGGR8, BA81(=BGGR) and BY8(assumed GRBG)
+uvc_error_t uvc_bayer_demosaic(uvc_frame_t *in, uvc_frame_t *out,
+        enum uvc_frame_format out_format, enum uvc_demosaic_method method);
+uvc_error_t uvc_bayer2rgbx(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_bayer2rgb565(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_bayer2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_bayer2rgbx_half(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_bayer2rgb565_half(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_bayer2iyuv420SP_half(uvc_frame_t *in, uvc_frame_t *out);
+
+uvc_error_t uvc_tonemap(uvc_frame_t *in, uvc_frame_t *out,
+        enum uvc_frame_format out_format, uvc_tonemap_opts_t *opts);
+uvc_error_t uvc_gray16_2gray8(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_gray16_2rgbx(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_gray16_2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_p010_2gray8(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_p010_2rgbx(uvc_frame_t *in, uvc_frame_t *out);
+uvc_error_t uvc_p010_2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out);
+
+uvc_error_t uvc_convert(uvc_frame_t *in, uvc_frame_t *out, uvc_convert_opts_t *opts);
+void uvc_convert_release(uvc_convert_opts_t *opts);
+
+uvc_error_t uvc_frame_stats(uvc_frame_t *frame, uvc_frame_stats_t *stats);
+
+uvc_error_t uvc_luma_pyramid(uvc_frame_t *in, uvc_frame_t *out, uvc_luma_pyramid_t *pyramid);
+
+uvc_error_t uvc_motion_update(uvc_frame_t *in, uvc_motion_t *motion);
+void uvc_motion_release(uvc_motion_t *motion);
+
+uvc_error_t uvc_frame_sharpness(uvc_frame_t *in, uvc_sharpness_t *sharpness);
+void uvc_sharpness_release(uvc_sharpness_t *sharpness);
+
+size_t uvc_tensor_bytes(const uvc_tensor_opts_t *opts);
+uvc_error_t uvc_frame_tensors(uvc_frame_t *in, const uvc_rect_t *boxes, int num_boxes,
+        const uvc_tensor_opts_t *opts, void *out, size_t out_bytes);
+
 uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes); // XXX
 
 //**********************************************************************
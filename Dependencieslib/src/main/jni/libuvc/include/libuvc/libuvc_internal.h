@@ -253,8 +253,22 @@ typedef struct uvc_device_info {
 #endif
 #endif
 
+/* transfers UVC_STREAM_FLAG_FRAGMENTS keeps in flight, a frame that would
+ * lend out more of them is dropped */
+#ifndef LIBUVC_NUM_TRANSFER_RESERVE
+#define LIBUVC_NUM_TRANSFER_RESERVE (LIBUVC_NUM_TRANSFER_BUFS / 4)
+#endif
+
 #define LIBUVC_XFER_META_BUF_SIZE ( 4 * 1024 )
 
+/** payload fragments of one frame, see UVC_STREAM_FLAG_FRAGMENTS */
+struct uvc_fragment_list {
+    uvc_frame_fragment_t *frags;
+    /** index of the transfer each fragment points into */
+    uint16_t *xfer;
+    int num, capacity;
+};
+
 struct uvc_stream_handle {
     struct uvc_device_handle *devh;
     struct uvc_stream_handle *prev, *next;
@@ -289,6 +303,21 @@ struct uvc_stream_handle {
     /* raw metadata buffer if available */
     uint8_t *meta_outbuf, *meta_holdbuf;
     size_t meta_got_bytes, meta_hold_bytes;
+
+    /* UVC_STREAM_FLAG_FRAGMENTS: frames stay in the transfer buffers, a transfer
+     * is lent out until no fragment list points into it. frag_out belongs to the
+     * transfer callback, the rest is guarded by cb_mutex. */
+    uint8_t fragments;
+    struct uvc_fragment_list frag_lists[3];
+    struct uvc_fragment_list *frag_out, *frag_hold, *frag_user;
+    /** fragments pointing into each transfer, outside the one being processed */
+    int xfer_refs[LIBUVC_NUM_TRANSFER_BUFS];
+    /** transfers lent out, at most LIBUVC_NUM_TRANSFER_BUFS - LIBUVC_NUM_TRANSFER_RESERVE */
+    int xfer_lent;
+    /** transfer failed or was cancelled, free it instead of resubmitting */
+    uint8_t xfer_failed[LIBUVC_NUM_TRANSFER_BUFS];
+    /** transfer the callback is processing (-1 for none) and fragments it added */
+    int cur_xfer, cur_xfer_added;
 };
 
 /** Handle on an open UVC device
@@ -341,6 +370,47 @@ uvc_error_t uvc_claim_if(uvc_device_handle_t *devh, int idx);
 
 uvc_error_t uvc_release_if(uvc_device_handle_t *devh, int idx);
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* frame statistics (frame-stats.c): a kernel calls begin once the output
+ * geometry and format are set, row for every output row right after writing
+ * it and end after the last one */
+void _uvc_stats_begin(uvc_frame_stats_t *stats, const uvc_frame_t *frame);
+void _uvc_stats_row(uvc_frame_stats_t *stats, const uvc_frame_t *frame, const uint8_t *row, uint32_t y);
+void _uvc_stats_end(uvc_frame_stats_t *stats);
+
+/* variants of the preview kernels that fill stats in the same pass, NULL stats is allowed */
+uvc_error_t _uvc_yuyv2rgbx_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_yuyv2rgb565_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_yuyv2rgbx_half_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_yuyv2rgb565_half_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_uyvy2rgbx_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_uyvy2rgb565_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_uyvy2rgbx_half_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_uyvy2rgb565_half_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_nv12_2rgbx_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_nv12_2rgb565_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_mjpeg2rgbx_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_mjpeg2rgb565_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+uvc_error_t _uvc_mjpeg_decoder_decode_stats(uvc_mjpeg_decoder_t *decoder,
+	uvc_frame_t *in, uvc_frame_t *out, enum uvc_frame_format format,
+	int scale, uvc_frame_stats_t *stats);
+
+/* per thread grow-only scratch of the stateless kernels (frame.c) */
+void *_uvc_frame_scratch(size_t bytes);
+
+/* luma only MJPEG decode, scaled by 1/scale_denom in the IDCT (frame-mjpeg.c) */
+uvc_error_t _uvc_mjpeg2gray_scaled(uvc_mjpeg_decoder_t *decoder, uvc_frame_t *in,
+	uint8_t *dst, size_t step, uint32_t width, uint32_t height, int scale_denom);
+/* luma high frequency DCT energy without the IDCT (frame-mjpeg.c) */
+uvc_error_t _uvc_mjpeg_ac_energy(uvc_mjpeg_decoder_t *decoder, uvc_frame_t *in, double *energy);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // !def(LIBUVC_INTERNAL_H)
 /** @endcond */
 
@@ -0,0 +1,575 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Demosaic of the 8-bit raw Bayer formats (SGRBG8, SGBRG8, SRGGB8, SBGGR8,
+ * BA81 = BGGR, BY8 which carries no order and is treated as GRBG).
+ *
+ * Each row is copied into a scratch line with one mirrored pixel on both
+ * sides, so the inner loops never branch on borders. From three such lines
+ * the SIMD core derives the horizontal, vertical, diagonal and cross
+ * averages of every pixel and selects R, G and B per lane parity into
+ * planar scratch rows, which are then packed into RGBX, RGB565 or NV21.
+ * The edge-aware variant picks the green interpolation direction with the
+ * smaller gradient at red/blue sites; red/blue stay bilinear.
+ * UVC_DEMOSAIC_BIN2X2 instead folds every 2x2 quad into one pixel, which
+ * demosaics and halves the image in a single pass.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define USE_NEON 1
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define USE_SSE2 1
+#endif
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+/** @internal position of the red pixel inside the 2x2 quad */
+typedef struct _bayer_order {
+	int rx;
+	int ry;
+} bayer_order_t;
+
+static int _uvc_bayer_order(enum uvc_frame_format format, bayer_order_t *order) {
+	switch (format) {
+	case UVC_FRAME_FORMAT_SRGGB8:
+		order->rx = 0; order->ry = 0;
+		return 0;
+	case UVC_FRAME_FORMAT_SGRBG8:
+	case UVC_FRAME_FORMAT_BY8:
+		order->rx = 1; order->ry = 0;
+		return 0;
+	case UVC_FRAME_FORMAT_SGBRG8:
+		order->rx = 0; order->ry = 1;
+		return 0;
+	case UVC_FRAME_FORMAT_SBGGR8:
+	case UVC_FRAME_FORMAT_BA81:
+		order->rx = 1; order->ry = 1;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+#define AVG(a, b) ((uint8_t)(((a) + (b) + 1) >> 1))
+#define ABSDIFF(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+
+/** @internal copy a raw row into a scratch line with mirrored borders at [0] and [width + 1] */
+static inline void _uvc_bayer_pad_row(const uint8_t *src, uint8_t *line, const int width) {
+	memcpy(line + 1, src, width);
+	line[0] = src[1];
+	line[width + 1] = src[width - 2];
+}
+
+/** @internal
+ * demosaic one row from padded lines into planar R, G, B rows
+ * @param red_row non-zero when the colour sites on this row are red
+ * @param cp parity of x of the colour (red/blue) sites on this row
+ */
+static void _uvc_bayer_row(const uint8_t *up, const uint8_t *cur, const uint8_t *dn,
+	uint8_t *r, uint8_t *g, uint8_t *b, const int width,
+	const int red_row, const int cp, const int edge_aware) {
+
+	uint8_t *own = red_row ? r : b;		// colour of the sites on this row
+	uint8_t *other = red_row ? b : r;	// colour on the rows above/below
+	int x = 0;
+#if USE_NEON
+	uint8_t lanes[16];
+	int i;
+	for (i = 0; i < 16; i++)
+		lanes[i] = ((i & 1) == cp) ? 0xff : 0;
+	const uint8x16_t site = vld1q_u8(lanes);
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t p = vld1q_u8(cur + x + 1);
+		const uint8x16_t h = vrhaddq_u8(vld1q_u8(cur + x), vld1q_u8(cur + x + 2));
+		const uint8x16_t v = vrhaddq_u8(vld1q_u8(up + x + 1), vld1q_u8(dn + x + 1));
+		const uint8x16_t d = vrhaddq_u8(
+			vrhaddq_u8(vld1q_u8(up + x), vld1q_u8(up + x + 2)),
+			vrhaddq_u8(vld1q_u8(dn + x), vld1q_u8(dn + x + 2)));
+		uint8x16_t c = vrhaddq_u8(h, v);
+		if (edge_aware) {
+			const uint8x16_t dh = vabdq_u8(vld1q_u8(cur + x), vld1q_u8(cur + x + 2));
+			const uint8x16_t dv = vabdq_u8(vld1q_u8(up + x + 1), vld1q_u8(dn + x + 1));
+			c = vbslq_u8(vcltq_u8(dh, dv), h, vbslq_u8(vcltq_u8(dv, dh), v, c));
+		}
+		vst1q_u8(own + x, vbslq_u8(site, p, h));
+		vst1q_u8(g + x, vbslq_u8(site, c, p));
+		vst1q_u8(other + x, vbslq_u8(site, d, v));
+	}
+#elif USE_SSE2
+	const __m128i site = cp ? _mm_set1_epi16((short)0xff00) : _mm_set1_epi16(0x00ff);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)(cur + x));
+		const __m128i rr = _mm_loadu_si128((const __m128i *)(cur + x + 2));
+		const __m128i u = _mm_loadu_si128((const __m128i *)(up + x + 1));
+		const __m128i dd = _mm_loadu_si128((const __m128i *)(dn + x + 1));
+		const __m128i p = _mm_loadu_si128((const __m128i *)(cur + x + 1));
+		const __m128i h = _mm_avg_epu8(l, rr);
+		const __m128i v = _mm_avg_epu8(u, dd);
+		const __m128i d = _mm_avg_epu8(
+			_mm_avg_epu8(_mm_loadu_si128((const __m128i *)(up + x)), _mm_loadu_si128((const __m128i *)(up + x + 2))),
+			_mm_avg_epu8(_mm_loadu_si128((const __m128i *)(dn + x)), _mm_loadu_si128((const __m128i *)(dn + x + 2))));
+		__m128i c = _mm_avg_epu8(h, v);
+		if (edge_aware) {
+			const __m128i dh = _mm_or_si128(_mm_subs_epu8(l, rr), _mm_subs_epu8(rr, l));
+			const __m128i dv = _mm_or_si128(_mm_subs_epu8(u, dd), _mm_subs_epu8(dd, u));
+			const __m128i zero = _mm_setzero_si128();
+			// dv - dh saturates to 0 unless dh < dv
+			const __m128i use_h = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(dv, dh), zero), _mm_set1_epi8(-1));
+			const __m128i use_v = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_subs_epu8(dh, dv), zero), _mm_set1_epi8(-1));
+			c = _mm_or_si128(_mm_and_si128(use_v, v), _mm_andnot_si128(use_v, c));
+			c = _mm_or_si128(_mm_and_si128(use_h, h), _mm_andnot_si128(use_h, c));
+		}
+		_mm_storeu_si128((__m128i *)(own + x), _mm_or_si128(_mm_and_si128(site, p), _mm_andnot_si128(site, h)));
+		_mm_storeu_si128((__m128i *)(g + x), _mm_or_si128(_mm_and_si128(site, c), _mm_andnot_si128(site, p)));
+		_mm_storeu_si128((__m128i *)(other + x), _mm_or_si128(_mm_and_si128(site, d), _mm_andnot_si128(site, v)));
+	}
+#endif
+	for (; x < width; x++) {
+		const uint8_t p = cur[x + 1];
+		const uint8_t h = AVG(cur[x], cur[x + 2]);
+		const uint8_t v = AVG(up[x + 1], dn[x + 1]);
+		if ((x & 1) == cp) {
+			uint8_t c = AVG(h, v);
+			if (edge_aware) {
+				const int dh = ABSDIFF(cur[x], cur[x + 2]);
+				const int dv = ABSDIFF(up[x + 1], dn[x + 1]);
+				if (dh < dv)
+					c = h;
+				else if (dv < dh)
+					c = v;
+			}
+			own[x] = p;
+			g[x] = c;
+			other[x] = AVG(AVG(up[x], up[x + 2]), AVG(dn[x], dn[x + 2]));
+		} else {
+			own[x] = h;
+			g[x] = p;
+			other[x] = v;
+		}
+	}
+}
+
+/** @internal planar R, G, B row to RGBX */
+static void _uvc_rgb_planes2rgbx(const uint8_t *r, const uint8_t *g, const uint8_t *b,
+	uint8_t *dst, const int width) {
+
+	int x = 0;
+#if USE_NEON
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t px;
+		px.val[0] = vld1q_u8(r + x);
+		px.val[1] = vld1q_u8(g + x);
+		px.val[2] = vld1q_u8(b + x);
+		px.val[3] = vdupq_n_u8(0xff);
+		vst4q_u8(dst + x * 4, px);
+	}
+#elif USE_SSE2
+	const __m128i ff = _mm_set1_epi8(-1);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i vr = _mm_loadu_si128((const __m128i *)(r + x));
+		const __m128i vg = _mm_loadu_si128((const __m128i *)(g + x));
+		const __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+		const __m128i rg_lo = _mm_unpacklo_epi8(vr, vg);
+		const __m128i rg_hi = _mm_unpackhi_epi8(vr, vg);
+		const __m128i bx_lo = _mm_unpacklo_epi8(vb, ff);
+		const __m128i bx_hi = _mm_unpackhi_epi8(vb, ff);
+		_mm_storeu_si128((__m128i *)(dst + x * 4), _mm_unpacklo_epi16(rg_lo, bx_lo));
+		_mm_storeu_si128((__m128i *)(dst + x * 4 + 16), _mm_unpackhi_epi16(rg_lo, bx_lo));
+		_mm_storeu_si128((__m128i *)(dst + x * 4 + 32), _mm_unpacklo_epi16(rg_hi, bx_hi));
+		_mm_storeu_si128((__m128i *)(dst + x * 4 + 48), _mm_unpackhi_epi16(rg_hi, bx_hi));
+	}
+#endif
+	for (; x < width; x++) {
+		dst[x * 4 + 0] = r[x];
+		dst[x * 4 + 1] = g[x];
+		dst[x * 4 + 2] = b[x];
+		dst[x * 4 + 3] = 0xff;
+	}
+}
+
+/** @internal planar R, G, B row to little endian RGB565 */
+static void _uvc_rgb_planes2rgb565(const uint8_t *r, const uint8_t *g, const uint8_t *b,
+	uint8_t *dst, const int width) {
+
+	int x = 0;
+#if USE_NEON
+	for (; x + 8 <= width; x += 8) {
+		uint16x8_t px = vshlq_n_u16(vmovl_u8(vshr_n_u8(vld1_u8(r + x), 3)), 11);
+		px = vorrq_u16(px, vshlq_n_u16(vmovl_u8(vshr_n_u8(vld1_u8(g + x), 2)), 5));
+		px = vorrq_u16(px, vmovl_u8(vshr_n_u8(vld1_u8(b + x), 3)));
+		vst1q_u16((uint16_t *)(dst + x * 2), px);
+	}
+#elif USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mask_r = _mm_set1_epi16((short)0xf800);
+	const __m128i mask_g = _mm_set1_epi16(0x07e0);
+	for (; x + 8 <= width; x += 8) {
+		const __m128i vr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(r + x)), zero);
+		const __m128i vg = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(g + x)), zero);
+		const __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b + x)), zero);
+		__m128i px = _mm_and_si128(_mm_slli_epi16(vr, 8), mask_r);
+		px = _mm_or_si128(px, _mm_and_si128(_mm_slli_epi16(vg, 3), mask_g));
+		px = _mm_or_si128(px, _mm_srli_epi16(vb, 3));
+		_mm_storeu_si128((__m128i *)(dst + x * 2), px);
+	}
+#endif
+	for (; x < width; x++) {
+		dst[x * 2 + 0] = ((g[x] << 3) & 0xe0) | (b[x] >> 3);
+		dst[x * 2 + 1] = (r[x] & 0xf8) | (g[x] >> 5);
+	}
+}
+
+/** @internal full range BT.601 luma, same matrix frame.c uses for YUV->RGB;
+ * chroma of pure red or blue would reach 256 and is saturated like the SIMD
+ * paths do it */
+#define RGB2Y(r, g, b) ((uint8_t)((77 * (r) + 150 * (g) + 29 * (b) + 128) >> 8))
+#define RGB2C(c) ((uint8_t)((c) > 127 ? 255 : (c) + 128))
+#define RGB2U(r, g, b) RGB2C((-43 * (r) - 85 * (g) + 128 * (b) + 128) >> 8)
+#define RGB2V(r, g, b) RGB2C((128 * (r) - 107 * (g) - 21 * (b) + 128) >> 8)
+
+/** @internal two planar RGB rows to two NV21 luma rows and one VU row */
+static void _uvc_rgb_planes2nv21(
+	const uint8_t *r0, const uint8_t *g0, const uint8_t *b0,
+	const uint8_t *r1, const uint8_t *g1, const uint8_t *b1,
+	uint8_t *y0, uint8_t *y1, uint8_t *vu, const int width) {
+
+	int x = 0, i;
+#if USE_NEON
+	const uint8x8_t k_yr = vdup_n_u8(77), k_yg = vdup_n_u8(150), k_yb = vdup_n_u8(29);
+	const int16x8_t c128 = vdupq_n_s16(128);
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t vr0 = vld1q_u8(r0 + x), vg0 = vld1q_u8(g0 + x), vb0 = vld1q_u8(b0 + x);
+		const uint8x16_t vr1 = vld1q_u8(r1 + x), vg1 = vld1q_u8(g1 + x), vb1 = vld1q_u8(b1 + x);
+#define NEON_Y(r, g, b, half) vrshrn_n_u16(vmlal_u8(vmlal_u8(vmull_u8(vget_##half##_u8(r), k_yr), \
+			vget_##half##_u8(g), k_yg), vget_##half##_u8(b), k_yb), 8)
+		vst1q_u8(y0 + x, vcombine_u8(NEON_Y(vr0, vg0, vb0, low), NEON_Y(vr0, vg0, vb0, high)));
+		vst1q_u8(y1 + x, vcombine_u8(NEON_Y(vr1, vg1, vb1, low), NEON_Y(vr1, vg1, vb1, high)));
+#undef NEON_Y
+		// 2x2 means, (sum + 2) >> 2
+		const int16x8_t r = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(vr0), vr1), 2));
+		const int16x8_t g = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(vg0), vg1), 2));
+		const int16x8_t b = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(vb0), vb1), 2));
+		const int16x8_t v = vmlaq_n_s16(vmlaq_n_s16(vshlq_n_s16(r, 7), g, -107), b, -21);
+		const int16x8_t u = vmlaq_n_s16(vmlaq_n_s16(vshlq_n_s16(b, 7), g, -85), r, -43);
+		uint8x8x2_t o;
+		o.val[0] = vqmovun_s16(vaddq_s16(vshrq_n_s16(vqaddq_s16(v, c128), 8), c128));
+		o.val[1] = vqmovun_s16(vaddq_s16(vshrq_n_s16(vqaddq_s16(u, c128), 8), c128));
+		vst2_u8(vu + x, o);
+	}
+#elif USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i c2 = _mm_set1_epi16(2);
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i k_yr = _mm_set1_epi16(77), k_yg = _mm_set1_epi16(150), k_yb = _mm_set1_epi16(29);
+	const __m128i k_vg = _mm_set1_epi16(-107), k_vb = _mm_set1_epi16(-21);
+	const __m128i k_ur = _mm_set1_epi16(-43), k_ug = _mm_set1_epi16(-85);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i vr0 = _mm_loadu_si128((const __m128i *)(r0 + x));
+		const __m128i vg0 = _mm_loadu_si128((const __m128i *)(g0 + x));
+		const __m128i vb0 = _mm_loadu_si128((const __m128i *)(b0 + x));
+		const __m128i vr1 = _mm_loadu_si128((const __m128i *)(r1 + x));
+		const __m128i vg1 = _mm_loadu_si128((const __m128i *)(g1 + x));
+		const __m128i vb1 = _mm_loadu_si128((const __m128i *)(b1 + x));
+		// luma sums reach 65280, fine as wrapping 16 bit with a logical shift
+#define SSE2_Y(r, g, b, half) _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16( \
+			_mm_mullo_epi16(_mm_unpack##half##_epi8(r, zero), k_yr), \
+			_mm_mullo_epi16(_mm_unpack##half##_epi8(g, zero), k_yg)), \
+			_mm_mullo_epi16(_mm_unpack##half##_epi8(b, zero), k_yb)), c128), 8)
+		_mm_storeu_si128((__m128i *)(y0 + x), _mm_packus_epi16(SSE2_Y(vr0, vg0, vb0, lo), SSE2_Y(vr0, vg0, vb0, hi)));
+		_mm_storeu_si128((__m128i *)(y1 + x), _mm_packus_epi16(SSE2_Y(vr1, vg1, vb1, lo), SSE2_Y(vr1, vg1, vb1, hi)));
+#undef SSE2_Y
+		// 2x2 means, (sum + 2) >> 2: rows added in 16 bits, pairs by pmaddwd
+#define SSE2_MEAN(p0, p1) _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32( \
+			_mm_madd_epi16(_mm_add_epi16(_mm_unpacklo_epi8(p0, zero), _mm_unpacklo_epi8(p1, zero)), ones), \
+			_mm_madd_epi16(_mm_add_epi16(_mm_unpackhi_epi8(p0, zero), _mm_unpackhi_epi8(p1, zero)), ones)), c2), 2)
+		const __m128i r = SSE2_MEAN(vr0, vr1);
+		const __m128i g = SSE2_MEAN(vg0, vg1);
+		const __m128i b = SSE2_MEAN(vb0, vb1);
+#undef SSE2_MEAN
+		const __m128i v = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(r, 7),
+			_mm_mullo_epi16(g, k_vg)), _mm_mullo_epi16(b, k_vb));
+		const __m128i u = _mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(b, 7),
+			_mm_mullo_epi16(g, k_ug)), _mm_mullo_epi16(r, k_ur));
+		// the saturating add caps the one sum that would round to 256
+		const __m128i v8 = _mm_add_epi16(_mm_srai_epi16(_mm_adds_epi16(v, c128), 8), c128);
+		const __m128i u8 = _mm_add_epi16(_mm_srai_epi16(_mm_adds_epi16(u, c128), 8), c128);
+		const __m128i vu8 = _mm_packus_epi16(v8, u8);
+		_mm_storeu_si128((__m128i *)(vu + x), _mm_unpacklo_epi8(vu8, _mm_srli_si128(vu8, 8)));
+	}
+#endif
+	for (i = x; i < width; i++) {
+		y0[i] = RGB2Y(r0[i], g0[i], b0[i]);
+		y1[i] = RGB2Y(r1[i], g1[i], b1[i]);
+	}
+	for (; x < width; x += 2) {
+		const int r = (r0[x] + r0[x + 1] + r1[x] + r1[x + 1] + 2) >> 2;
+		const int g = (g0[x] + g0[x + 1] + g1[x] + g1[x + 1] + 2) >> 2;
+		const int b = (b0[x] + b0[x + 1] + b1[x] + b1[x + 1] + 2) >> 2;
+		vu[x + 0] = RGB2V(r, g, b);
+		vu[x + 1] = RGB2U(r, g, b);
+	}
+}
+
+/** @internal set the output header and size the buffer */
+static uvc_error_t _uvc_bayer_prepare_out(uvc_frame_t *in, uvc_frame_t *out,
+	enum uvc_frame_format out_format, const int width, const int height, size_t *out_step) {
+
+	size_t step, need;
+	switch (out_format) {
+	case UVC_FRAME_FORMAT_RGBX:
+		step = width * 4;
+		break;
+	case UVC_FRAME_FORMAT_RGB565:
+		step = width * 2;
+		break;
+	case UVC_FRAME_FORMAT_NV21:
+		step = width;
+		break;
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+	if (!out->library_owns_data && out->step)
+		step = out->step;
+	need = step * height;
+	if (out_format == UVC_FRAME_FORMAT_NV21)
+		need += step * (height / 2);
+
+	if (UNLIKELY(uvc_ensure_frame_size(out, need) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	out->width = width;
+	out->height = height;
+	out->frame_format = out_format;
+	out->step = step;
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = need;
+	*out_step = step;
+
+	return UVC_SUCCESS;
+}
+
+/** @internal demosaic with a 3x3 neighbourhood, full resolution */
+static uvc_error_t _uvc_bayer_interpolate(uvc_frame_t *in, uvc_frame_t *out,
+	enum uvc_frame_format out_format, const bayer_order_t *order, const int edge_aware) {
+
+	const int width = in->width;
+	const int height = in->height;
+	const size_t in_step = in->step ? in->step : in->width;
+	size_t out_step;
+	uvc_error_t ret;
+
+	ret = _uvc_bayer_prepare_out(in, out, out_format, width, height, &out_step);
+	if (UNLIKELY(ret))
+		return ret;
+
+	// 3 padded lines + 2 sets of planar RGB rows (two are needed for NV21)
+	const size_t line_bytes = (width + 2 + 15) & ~15;
+	const size_t plane_bytes = (width + 15) & ~15;
+	uint8_t *scratch = _uvc_frame_scratch(line_bytes * 3 + plane_bytes * 6);
+	if (UNLIKELY(!scratch))
+		return UVC_ERROR_NO_MEM;
+	uint8_t *lines[3] = { scratch, scratch + line_bytes, scratch + line_bytes * 2 };
+	uint8_t *planes = scratch + line_bytes * 3;
+	uint8_t *rgb[2][3] = {
+		{ planes, planes + plane_bytes, planes + plane_bytes * 2 },
+		{ planes + plane_bytes * 3, planes + plane_bytes * 4, planes + plane_bytes * 5 },
+	};
+
+	const uint8_t *src = in->data;
+	uint8_t *dst = out->data;
+	uint8_t *vu = dst + out_step * height;
+	int y;
+	// lines[0..2] hold rows y-1, y, y+1; row -1 mirrors to row 1
+	_uvc_bayer_pad_row(src + in_step, lines[0], width);
+	_uvc_bayer_pad_row(src, lines[1], width);
+	_uvc_bayer_pad_row(src + in_step, lines[2], width);
+	for (y = 0; y < height; y++) {
+		if (y) {
+			uint8_t *t = lines[0];
+			lines[0] = lines[1];
+			lines[1] = lines[2];
+			lines[2] = t;
+			_uvc_bayer_pad_row(src + in_step * (y + 1 < height ? y + 1 : y - 1), lines[2], width);
+		}
+		const int red_row = (y & 1) == order->ry;
+		const int cp = red_row ? order->rx : 1 - order->rx;
+		uint8_t **row = rgb[y & 1];
+		_uvc_bayer_row(lines[0], lines[1], lines[2], row[0], row[1], row[2],
+			width, red_row, cp, edge_aware);
+		switch (out_format) {
+		case UVC_FRAME_FORMAT_RGBX:
+			_uvc_rgb_planes2rgbx(row[0], row[1], row[2], dst + out_step * y, width);
+			break;
+		case UVC_FRAME_FORMAT_RGB565:
+			_uvc_rgb_planes2rgb565(row[0], row[1], row[2], dst + out_step * y, width);
+			break;
+		default:	// NV21
+			if (y & 1)
+				_uvc_rgb_planes2nv21(rgb[0][0], rgb[0][1], rgb[0][2], rgb[1][0], rgb[1][1], rgb[1][2],
+					dst + out_step * (y - 1), dst + out_step * y, vu + out_step * (y / 2), width);
+			break;
+		}
+	}
+	return UVC_SUCCESS;
+}
+
+/** @internal demosaic and halve: every 2x2 quad becomes one output pixel */
+static uvc_error_t _uvc_bayer_bin2x2(uvc_frame_t *in, uvc_frame_t *out,
+	enum uvc_frame_format out_format, const bayer_order_t *order) {
+
+	const int width = in->width / 2;
+	const int height = in->height / 2;
+	const size_t in_step = in->step ? in->step : in->width;
+	size_t out_step;
+	uvc_error_t ret;
+
+	if (UNLIKELY((out_format == UVC_FRAME_FORMAT_NV21) && ((width & 1) || (height & 1))))
+		return UVC_ERROR_INVALID_PARAM;
+	ret = _uvc_bayer_prepare_out(in, out, out_format, width, height, &out_step);
+	if (UNLIKELY(ret))
+		return ret;
+
+	const size_t plane_bytes = (width + 15) & ~15;
+	uint8_t *planes = _uvc_frame_scratch(plane_bytes * 6);
+	if (UNLIKELY(!planes))
+		return UVC_ERROR_NO_MEM;
+	uint8_t *rgb[2][3] = {
+		{ planes, planes + plane_bytes, planes + plane_bytes * 2 },
+		{ planes + plane_bytes * 3, planes + plane_bytes * 4, planes + plane_bytes * 5 },
+	};
+
+	// byte offsets of the samples inside a quad
+	const int ro = order->ry * in_step + order->rx;
+	const int bo = (1 - order->ry) * in_step + (1 - order->rx);
+	const int g0o = order->ry * in_step + (1 - order->rx);
+	const int g1o = (1 - order->ry) * in_step + order->rx;
+	const uint8_t *src = in->data;
+	uint8_t *dst = out->data;
+	uint8_t *vu = dst + out_step * height;
+	int x, y;
+	for (y = 0; y < height; y++) {
+		const uint8_t *q = src + in_step * 2 * y;
+		uint8_t **row = rgb[y & 1];
+		for (x = 0; x < width; x++, q += 2) {
+			row[0][x] = q[ro];
+			row[1][x] = AVG(q[g0o], q[g1o]);
+			row[2][x] = q[bo];
+		}
+		switch (out_format) {
+		case UVC_FRAME_FORMAT_RGBX:
+			_uvc_rgb_planes2rgbx(row[0], row[1], row[2], dst + out_step * y, width);
+			break;
+		case UVC_FRAME_FORMAT_RGB565:
+			_uvc_rgb_planes2rgb565(row[0], row[1], row[2], dst + out_step * y, width);
+			break;
+		default:	// NV21
+			if (y & 1)
+				_uvc_rgb_planes2nv21(rgb[0][0], rgb[0][1], rgb[0][2], rgb[1][0], rgb[1][1], rgb[1][2],
+					dst + out_step * (y - 1), dst + out_step * y, vu + out_step * (y / 2), width);
+			break;
+		}
+	}
+	return UVC_SUCCESS;
+}
+
+/** @brief Demosaic a raw Bayer frame
+ * @ingroup frame
+ *
+ * @param in SGRBG8, SGBRG8, SRGGB8, SBGGR8, BA81 or BY8 frame
+ * @param out RGBX, RGB565 or NV21 frame
+ * @param out_format UVC_FRAME_FORMAT_RGBX, UVC_FRAME_FORMAT_RGB565 or UVC_FRAME_FORMAT_NV21
+ * @param method interpolation; UVC_DEMOSAIC_BIN2X2 halves width and height
+ */
+uvc_error_t uvc_bayer_demosaic(uvc_frame_t *in, uvc_frame_t *out,
+	enum uvc_frame_format out_format, enum uvc_demosaic_method method) {
+
+	bayer_order_t order;
+
+	if (UNLIKELY(_uvc_bayer_order(in->frame_format, &order)))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY((in->width < 2) || (in->height < 2) || (in->width & 1) || (in->height & 1)))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(in->data_bytes < (size_t)(in->step ? in->step : in->width) * in->height))
+		return UVC_ERROR_INVALID_PARAM;
+
+	switch (method) {
+	case UVC_DEMOSAIC_BIN2X2:
+		return _uvc_bayer_bin2x2(in, out, out_format, &order);
+	case UVC_DEMOSAIC_EDGE_AWARE:
+		return _uvc_bayer_interpolate(in, out, out_format, &order, 1);
+	default:
+		return _uvc_bayer_interpolate(in, out, out_format, &order, 0);
+	}
+}
+
+/** @brief Demosaic a raw Bayer frame to RGBX (bilinear)
+ * @ingroup frame
+ *
+ * @param in Bayer frame
+ * @param out RGBX frame
+ */
+uvc_error_t uvc_bayer2rgbx(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_bayer_demosaic(in, out, UVC_FRAME_FORMAT_RGBX, UVC_DEMOSAIC_BILINEAR);
+}
+
+/** @brief Demosaic a raw Bayer frame to RGB565 (bilinear)
+ * @ingroup frame
+ *
+ * @param in Bayer frame
+ * @param out RGB565 frame
+ */
+uvc_error_t uvc_bayer2rgb565(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_bayer_demosaic(in, out, UVC_FRAME_FORMAT_RGB565, UVC_DEMOSAIC_BILINEAR);
+}
+
+/** @brief Demosaic a raw Bayer frame to NV21(iyuv420SP) (bilinear)
+ * @ingroup frame
+ *
+ * @param in Bayer frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_bayer2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_bayer_demosaic(in, out, UVC_FRAME_FORMAT_NV21, UVC_DEMOSAIC_BILINEAR);
+}
+
+/** @brief Demosaic a raw Bayer frame to RGBX at half width and height
+ * @ingroup frame
+ *
+ * @param in Bayer frame
+ * @param out RGBX frame
+ */
+uvc_error_t uvc_bayer2rgbx_half(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_bayer_demosaic(in, out, UVC_FRAME_FORMAT_RGBX, UVC_DEMOSAIC_BIN2X2);
+}
+
+/** @brief Demosaic a raw Bayer frame to RGB565 at half width and height
+ * @ingroup frame
+ *
+ * @param in Bayer frame
+ * @param out RGB565 frame
+ */
+uvc_error_t uvc_bayer2rgb565_half(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_bayer_demosaic(in, out, UVC_FRAME_FORMAT_RGB565, UVC_DEMOSAIC_BIN2X2);
+}
+
+/** @brief Demosaic a raw Bayer frame to NV21 at half width and height
+ * @ingroup frame
+ *
+ * @param in Bayer frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_bayer2iyuv420SP_half(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_bayer_demosaic(in, out, UVC_FRAME_FORMAT_NV21, UVC_DEMOSAIC_BIN2X2);
+}
@@ -0,0 +1,506 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Conversion planner behind uvc_convert().
+ *
+ * Every direct kernel (including the fused MJPEG decode+convert ones) is an
+ * edge in a format graph weighted by an approximate per-pixel cost. A plan
+ * is the cheapest path from the source to the requested format found with
+ * Dijkstra; scale/rotation is an extra edge that can only be taken on a
+ * packed format, and every edge after it is charged for the smaller image.
+ * Plans are cached in uvc_convert_opts_t together with the intermediate
+ * frames, so a stream that keeps one opts around plans once and never
+ * allocates in the steady state.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+#include <limits.h>
+#include <stddef.h>
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+/** @internal longest chain a plan may hold (kernels + one geometry step) */
+#define UVC_CONVERT_MAX_STEPS 4
+/** @internal edge costs are kept in 1/64 units so that a downscale can discount them */
+#define COST_UNIT 64
+
+typedef uvc_error_t (*uvc_convert_func_t)(uvc_frame_t *in, uvc_frame_t *out);
+typedef uvc_error_t (*uvc_convert_stats_func_t)(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats);
+
+/** @internal one direct kernel in the format graph */
+typedef struct _convert_edge {
+	enum uvc_frame_format src;
+	enum uvc_frame_format dst;
+	/** approximate cost per source pixel */
+	int cost;
+	uvc_convert_func_t func;
+	/** non-zero when the kernel also downscales by this factor (fused geometry) */
+	int scale;
+	/** same kernel accumulating uvc_frame_stats_t as it writes, if there is one */
+	uvc_convert_stats_func_t stats_func;
+} convert_edge_t;
+
+static const convert_edge_t convert_edges[] = {
+#ifdef LIBUVC_HAS_JPEG
+	// fused decode+convert, the IDCT dominates
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 40, .func = uvc_mjpeg2rgbx, .stats_func = _uvc_mjpeg2rgbx_stats },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 40, .func = uvc_mjpeg2rgb565, .stats_func = _uvc_mjpeg2rgb565_stats },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_RGB, .cost = 38, .func = uvc_mjpeg2rgb },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_BGR, .cost = 38, .func = uvc_mjpeg2bgr },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_YUYV, .cost = 42, .func = uvc_mjpeg2yuyv },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_GRAY8, .cost = 30, .func = uvc_mjpeg2gray },
+	// raw planes, no colour conversion or upsampling
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_I420, .cost = 31, .func = uvc_mjpeg2yuv420P },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_YV12, .cost = 31, .func = uvc_mjpeg2iyuv420P },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_NV12, .cost = 31, .func = uvc_mjpeg2yuv420SP },
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = UVC_FRAME_FORMAT_NV21, .cost = 31, .func = uvc_mjpeg2iyuv420SP },
+	/* reduced size IDCT, only run by the plan's decoder; entropy decoding is
+	 * still paid for every source pixel */
+#define MJPEG_SCALED_EDGES(to, kernel, stats_kernel) \
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = to, .cost = 22, .func = kernel, .scale = 2, .stats_func = stats_kernel }, \
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = to, .cost = 15, .func = kernel, .scale = 4, .stats_func = stats_kernel }, \
+	{ .src = UVC_FRAME_FORMAT_MJPEG, .dst = to, .cost = 12, .func = kernel, .scale = 8, .stats_func = stats_kernel }
+	MJPEG_SCALED_EDGES(UVC_FRAME_FORMAT_RGBX, uvc_mjpeg2rgbx, _uvc_mjpeg2rgbx_stats),
+	MJPEG_SCALED_EDGES(UVC_FRAME_FORMAT_RGB565, uvc_mjpeg2rgb565, _uvc_mjpeg2rgb565_stats),
+	MJPEG_SCALED_EDGES(UVC_FRAME_FORMAT_RGB, uvc_mjpeg2rgb, NULL),
+	MJPEG_SCALED_EDGES(UVC_FRAME_FORMAT_BGR, uvc_mjpeg2bgr, NULL),
+	MJPEG_SCALED_EDGES(UVC_FRAME_FORMAT_GRAY8, uvc_mjpeg2gray, NULL),
+#undef MJPEG_SCALED_EDGES
+#endif
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 6, .func = uvc_yuyv2rgbx, .stats_func = _uvc_yuyv2rgbx_stats },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 7, .func = uvc_yuyv2rgb565, .stats_func = _uvc_yuyv2rgb565_stats },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_RGB, .cost = 6, .func = uvc_yuyv2rgb },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_BGR, .cost = 6, .func = uvc_yuyv2bgr },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 2, .func = uvc_yuyv2rgbx_half, .scale = 2, .stats_func = _uvc_yuyv2rgbx_half_stats },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 2, .func = uvc_yuyv2rgb565_half, .scale = 2, .stats_func = _uvc_yuyv2rgb565_half_stats },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_I420, .cost = 2, .func = uvc_yuyv2yuv420P },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_YV12, .cost = 2, .func = uvc_yuyv2iyuv420P },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_NV12, .cost = 2, .func = uvc_yuyv2yuv420SP },
+	{ .src = UVC_FRAME_FORMAT_YUYV, .dst = UVC_FRAME_FORMAT_NV21, .cost = 2, .func = uvc_yuyv2iyuv420SP },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 6, .func = uvc_uyvy2rgbx, .stats_func = _uvc_uyvy2rgbx_stats },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 7, .func = uvc_uyvy2rgb565, .stats_func = _uvc_uyvy2rgb565_stats },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_RGB, .cost = 6, .func = uvc_uyvy2rgb },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_BGR, .cost = 6, .func = uvc_uyvy2bgr },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 2, .func = uvc_uyvy2rgbx_half, .scale = 2, .stats_func = _uvc_uyvy2rgbx_half_stats },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 2, .func = uvc_uyvy2rgb565_half, .scale = 2, .stats_func = _uvc_uyvy2rgb565_half_stats },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_I420, .cost = 2, .func = uvc_uyvy2yuv420P },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_YV12, .cost = 2, .func = uvc_uyvy2iyuv420P },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_NV12, .cost = 2, .func = uvc_uyvy2yuv420SP },
+	{ .src = UVC_FRAME_FORMAT_UYVY, .dst = UVC_FRAME_FORMAT_NV21, .cost = 2, .func = uvc_uyvy2iyuv420SP },
+	{ .src = UVC_FRAME_FORMAT_NV12, .dst = UVC_FRAME_FORMAT_I420, .cost = 1, .func = uvc_nv12_2yuv420P },
+	{ .src = UVC_FRAME_FORMAT_NV12, .dst = UVC_FRAME_FORMAT_YV12, .cost = 1, .func = uvc_nv12_2iyuv420P },
+	{ .src = UVC_FRAME_FORMAT_NV12, .dst = UVC_FRAME_FORMAT_NV21, .cost = 1, .func = uvc_nv12_2iyuv420SP },
+	{ .src = UVC_FRAME_FORMAT_NV12, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 5, .func = uvc_nv12_2rgbx, .stats_func = _uvc_nv12_2rgbx_stats },
+	{ .src = UVC_FRAME_FORMAT_NV12, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 6, .func = uvc_nv12_2rgb565, .stats_func = _uvc_nv12_2rgb565_stats },
+	{ .src = UVC_FRAME_FORMAT_NV12, .dst = UVC_FRAME_FORMAT_YUYV, .cost = 2, .func = uvc_nv12_2yuyv },
+	{ .src = UVC_FRAME_FORMAT_RGB, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 2, .func = uvc_rgb2rgbx },
+	{ .src = UVC_FRAME_FORMAT_RGB, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 3, .func = uvc_rgb2rgb565 },
+	// one-shot percentile tone mapping; streams wanting temporal windows call uvc_tonemap()
+	{ .src = UVC_FRAME_FORMAT_GRAY16, .dst = UVC_FRAME_FORMAT_GRAY8, .cost = 4, .func = uvc_gray16_2gray8 },
+	{ .src = UVC_FRAME_FORMAT_GRAY16, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 5, .func = uvc_gray16_2rgbx },
+	{ .src = UVC_FRAME_FORMAT_GRAY16, .dst = UVC_FRAME_FORMAT_NV21, .cost = 4, .func = uvc_gray16_2iyuv420SP },
+	{ .src = UVC_FRAME_FORMAT_P010, .dst = UVC_FRAME_FORMAT_GRAY8, .cost = 4, .func = uvc_p010_2gray8 },
+	{ .src = UVC_FRAME_FORMAT_P010, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 7, .func = uvc_p010_2rgbx },
+	{ .src = UVC_FRAME_FORMAT_P010, .dst = UVC_FRAME_FORMAT_NV21, .cost = 4, .func = uvc_p010_2iyuv420SP },
+#define BAYER_EDGES(fmt) \
+	{ .src = fmt, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 8, .func = uvc_bayer2rgbx }, \
+	{ .src = fmt, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 8, .func = uvc_bayer2rgb565 }, \
+	{ .src = fmt, .dst = UVC_FRAME_FORMAT_NV21, .cost = 9, .func = uvc_bayer2iyuv420SP }, \
+	{ .src = fmt, .dst = UVC_FRAME_FORMAT_RGBX, .cost = 2, .func = uvc_bayer2rgbx_half, .scale = 2 }, \
+	{ .src = fmt, .dst = UVC_FRAME_FORMAT_RGB565, .cost = 2, .func = uvc_bayer2rgb565_half, .scale = 2 }, \
+	{ .src = fmt, .dst = UVC_FRAME_FORMAT_NV21, .cost = 3, .func = uvc_bayer2iyuv420SP_half, .scale = 2 }
+	BAYER_EDGES(UVC_FRAME_FORMAT_SGRBG8),
+	BAYER_EDGES(UVC_FRAME_FORMAT_SGBRG8),
+	BAYER_EDGES(UVC_FRAME_FORMAT_SRGGB8),
+	BAYER_EDGES(UVC_FRAME_FORMAT_SBGGR8),
+	BAYER_EDGES(UVC_FRAME_FORMAT_BA81),
+	BAYER_EDGES(UVC_FRAME_FORMAT_BY8),
+#undef BAYER_EDGES
+};
+#define NUM_CONVERT_EDGES ((int)(sizeof(convert_edges) / sizeof(convert_edges[0])))
+
+/** @internal one step of a plan; func == NULL means the geometry step */
+typedef struct _convert_step {
+	uvc_convert_func_t func;
+	uvc_convert_stats_func_t stats_func;
+	enum uvc_frame_format dst;
+	/** fused downscale of the kernel, 0 for none */
+	int scale;
+} convert_step_t;
+
+struct uvc_convert_plan {
+	/* key */
+	enum uvc_frame_format src;
+	enum uvc_frame_format dst;
+	int scale;
+	int rotation;
+	/* chosen chain */
+	int num_steps;
+	int cost;
+	convert_step_t steps[UVC_CONVERT_MAX_STEPS];
+	/** library owned intermediate frames, reused across calls */
+	uvc_frame_t *tmp[UVC_CONVERT_MAX_STEPS - 1];
+	/** MJPEG decoder used when opts->decoder is NULL, kept across replans */
+	uvc_mjpeg_decoder_t *decoder;
+};
+
+/** @internal bytes per pixel of formats the geometry step can handle, 0 otherwise */
+static inline int _uvc_packed_bpp(enum uvc_frame_format format) {
+	switch (format) {
+	case UVC_FRAME_FORMAT_GRAY8:
+		return 1;
+	case UVC_FRAME_FORMAT_RGB565:
+		return 2;
+	case UVC_FRAME_FORMAT_RGB:
+	case UVC_FRAME_FORMAT_BGR:
+		return 3;
+	case UVC_FRAME_FORMAT_RGBX:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/** @internal
+ * nearest-neighbour downscale by an integer factor combined with a clockwise
+ * rotation, for packed formats only
+ */
+static uvc_error_t _uvc_convert_geometry(uvc_frame_t *in, uvc_frame_t *out,
+	const int scale, const int rotation) {
+
+	const int bpp = _uvc_packed_bpp(in->frame_format);
+	if (UNLIKELY(!bpp))
+		return UVC_ERROR_NOT_SUPPORTED;
+
+	const int sw = in->width / scale;
+	const int sh = in->height / scale;
+	const int transpose = (rotation == 90) || (rotation == 270);
+	const int out_w = transpose ? sh : sw;
+	const int out_h = transpose ? sw : sh;
+	if (UNLIKELY(!out_w || !out_h))
+		return UVC_ERROR_INVALID_PARAM;
+
+	const size_t out_step = out->library_owns_data || !out->step ? (size_t)out_w * bpp : out->step;
+	if (UNLIKELY(uvc_ensure_frame_size(out, out_step * out_h) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	out->width = out_w;
+	out->height = out_h;
+	out->frame_format = in->frame_format;
+	out->step = out_step;
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = out_step * out_h;
+
+	const ptrdiff_t in_step = in->step ? (ptrdiff_t)in->step : (ptrdiff_t)in->width * bpp;
+	const ptrdiff_t dx = (ptrdiff_t)scale * bpp;	// one scaled pixel to the right
+	const ptrdiff_t dy = (ptrdiff_t)scale * in_step;	// one scaled pixel down
+	const uint8_t *base = in->data;
+	const uint8_t *row_start;
+	ptrdiff_t row_delta, pixel_delta;
+	// source pixel of output (0, 0), how it moves per output row and per output pixel
+	switch (rotation) {
+	case 90:
+		row_start = base + (sh - 1) * dy;
+		row_delta = dx;
+		pixel_delta = -dy;
+		break;
+	case 180:
+		row_start = base + (sh - 1) * dy + (sw - 1) * dx;
+		row_delta = -dy;
+		pixel_delta = -dx;
+		break;
+	case 270:
+		row_start = base + (sw - 1) * dx;
+		row_delta = -dx;
+		pixel_delta = dy;
+		break;
+	default:
+		row_start = base;
+		row_delta = dy;
+		pixel_delta = dx;
+		break;
+	}
+
+	uint8_t *dst_row = out->data;
+	int x, y;
+	for (y = 0; y < out_h; y++, row_start += row_delta, dst_row += out_step) {
+		const uint8_t *src = row_start;
+		uint8_t *dst = dst_row;
+		switch (bpp) {
+		case 1:
+			for (x = 0; x < out_w; x++, src += pixel_delta)
+				*dst++ = *src;
+			break;
+		case 2:
+			for (x = 0; x < out_w; x++, src += pixel_delta, dst += 2)
+				*(uint16_t *)dst = *(const uint16_t *)src;
+			break;
+		case 4:
+			for (x = 0; x < out_w; x++, src += pixel_delta, dst += 4)
+				*(uint32_t *)dst = *(const uint32_t *)src;
+			break;
+		default:
+			for (x = 0; x < out_w; x++, src += pixel_delta, dst += 3) {
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+			}
+			break;
+		}
+	}
+	return UVC_SUCCESS;
+}
+
+/** @internal
+ * find the cheapest chain from src to dst. A search state is a format plus
+ * whether the geometry step has been taken already.
+ * @return UVC_SUCCESS or UVC_ERROR_NOT_SUPPORTED when dst is unreachable
+ */
+static uvc_error_t _uvc_convert_build_plan(struct uvc_convert_plan *plan) {
+	enum { NUM_STATES = UVC_FRAME_FORMAT_COUNT * 2 };
+	int dist[NUM_STATES];
+	int prev[NUM_STATES];	// previous state
+	int via[NUM_STATES];	// edge index into convert_edges, -1 for the geometry step
+	uint8_t done[NUM_STATES];
+	const int need_geometry = (plan->scale > 1) || plan->rotation;
+	const int area = plan->scale > 1 ? plan->scale * plan->scale : 1;
+	int i, s;
+
+	for (s = 0; s < NUM_STATES; s++) {
+		dist[s] = INT_MAX;
+		prev[s] = -1;
+		via[s] = -1;
+		done[s] = 0;
+	}
+	// state = format * 2 + geometry_done; without geometry every path starts "done"
+	const int start = plan->src * 2 + (need_geometry ? 0 : 1);
+	const int goal = plan->dst * 2 + 1;
+	dist[start] = 0;
+
+	for (;;) {
+		int cur = -1;
+		for (s = 0; s < NUM_STATES; s++) {
+			if (!done[s] && (dist[s] != INT_MAX) && ((cur < 0) || (dist[s] < dist[cur])))
+				cur = s;
+		}
+		if ((cur < 0) || (cur == goal))
+			break;
+		done[cur] = 1;
+		const enum uvc_frame_format fmt = cur / 2;
+		const int geometry_done = cur & 1;
+		// kernels after the geometry step work on the smaller image
+		const int divisor = geometry_done && need_geometry ? area : 1;
+		for (i = 0; i < NUM_CONVERT_EDGES; i++) {
+			if (convert_edges[i].src != fmt)
+				continue;
+			int next;
+			if (convert_edges[i].scale) {
+				// fused downscale, can only stand in for the geometry step itself
+				if (geometry_done || (convert_edges[i].scale != plan->scale) || plan->rotation)
+					continue;
+				next = convert_edges[i].dst * 2 + 1;
+			} else {
+				next = convert_edges[i].dst * 2 + geometry_done;
+			}
+			const int d = dist[cur] + convert_edges[i].cost * COST_UNIT / divisor;
+			if (d < dist[next]) {
+				dist[next] = d;
+				prev[next] = cur;
+				via[next] = i;
+			}
+		}
+		if (!geometry_done) {
+			const int bpp = _uvc_packed_bpp(fmt);
+			if (bpp) {
+				const int next = cur + 1;
+				const int d = dist[cur] + (bpp + (plan->rotation ? 2 : 0)) * COST_UNIT;
+				if (d < dist[next]) {
+					dist[next] = d;
+					prev[next] = cur;
+					via[next] = -1;
+				}
+			}
+		}
+	}
+
+	if (dist[goal] == INT_MAX)
+		return UVC_ERROR_NOT_SUPPORTED;
+
+	// walk back from the goal, then reverse into the plan
+	convert_step_t steps[UVC_CONVERT_MAX_STEPS];
+	int n = 0;
+	for (s = goal; s != start; s = prev[s]) {
+		if (UNLIKELY(n >= UVC_CONVERT_MAX_STEPS))
+			return UVC_ERROR_NOT_SUPPORTED;
+		steps[n].func = via[s] >= 0 ? convert_edges[via[s]].func : NULL;
+		steps[n].stats_func = via[s] >= 0 ? convert_edges[via[s]].stats_func : NULL;
+		steps[n].dst = s / 2;
+		steps[n].scale = via[s] >= 0 ? convert_edges[via[s]].scale : 0;
+		n++;
+	}
+	plan->num_steps = n;
+	plan->cost = dist[goal];
+	for (i = 0; i < n; i++)
+		plan->steps[i] = steps[n - 1 - i];
+
+	return UVC_SUCCESS;
+}
+
+/** @internal drop the cached plan and its intermediate frames */
+static void _uvc_convert_free_plan(struct uvc_convert_plan *plan) {
+	int i;
+	for (i = 0; i < UVC_CONVERT_MAX_STEPS - 1; i++) {
+		if (plan->tmp[i])
+			uvc_free_frame(plan->tmp[i]);
+	}
+#ifdef LIBUVC_HAS_JPEG
+	uvc_mjpeg_decoder_destroy(plan->decoder);
+#endif
+	free(plan);
+}
+
+/** @internal
+ * statistics in a separate pass over the output; formats uvc_frame_stats()
+ * does not cover leave zero pixels rather than failing the conversion
+ */
+static void _uvc_convert_stats_pass(uvc_frame_t *out, uvc_frame_stats_t *stats) {
+	if (UNLIKELY(uvc_frame_stats(out, stats))) {
+		stats->sequence = out->sequence;
+		stats->pixels = 0;
+	}
+}
+
+/** @brief Convert a frame to the format, scale and rotation given in opts
+ * @ingroup frame
+ *
+ * The cheapest chain of direct kernels is planned on first use and cached in
+ * opts, keyed by (source format, destination format, scale, rotation). Keep
+ * one opts per stream/consumer and release it with uvc_convert_release().
+ * opts must not be shared between threads. When opts->stats is set it is
+ * filled with the statistics of out, see uvc_frame_stats_t.
+ *
+ * @param in source frame
+ * @param out destination frame
+ * @param opts conversion options, the plan member must be NULL initially
+ */
+uvc_error_t uvc_convert(uvc_frame_t *in, uvc_frame_t *out, uvc_convert_opts_t *opts) {
+	struct uvc_convert_plan *plan = opts->plan;
+	const int scale = opts->scale > 1 ? opts->scale : 1;
+	const int rotation = opts->rotation;
+	uvc_error_t ret;
+	int i;
+
+	if (UNLIKELY((rotation != 0) && (rotation != 90) && (rotation != 180) && (rotation != 270)))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY((in->frame_format >= UVC_FRAME_FORMAT_COUNT)
+		|| (opts->format >= UVC_FRAME_FORMAT_COUNT)))
+		return UVC_ERROR_INVALID_PARAM;
+
+	if (UNLIKELY(!plan || (plan->src != in->frame_format) || (plan->dst != opts->format)
+		|| (plan->scale != scale) || (plan->rotation != rotation))) {
+		// (re)plan
+		uvc_mjpeg_decoder_t *decoder = NULL;
+		if (plan) {
+			decoder = plan->decoder;	// still good for the new plan
+			plan->decoder = NULL;
+			_uvc_convert_free_plan(plan);
+			opts->plan = NULL;
+		}
+		plan = calloc(1, sizeof(*plan));
+		if (UNLIKELY(!plan)) {
+#ifdef LIBUVC_HAS_JPEG
+			uvc_mjpeg_decoder_destroy(decoder);
+#endif
+			return UVC_ERROR_NO_MEM;
+		}
+		plan->decoder = decoder;
+		plan->src = in->frame_format;
+		plan->dst = opts->format;
+		plan->scale = scale;
+		plan->rotation = rotation;
+		if ((plan->src == plan->dst) && (scale == 1) && !rotation) {
+			plan->num_steps = 0;	// plain copy
+		} else {
+			ret = _uvc_convert_build_plan(plan);
+			if (UNLIKELY(ret)) {
+				_uvc_convert_free_plan(plan);
+				return ret;
+			}
+		}
+		for (i = 0; i < plan->num_steps - 1; i++) {
+			uvc_frame_t *tmp = calloc(1, sizeof(*tmp));
+			if (UNLIKELY(!tmp)) {
+				_uvc_convert_free_plan(plan);
+				return UVC_ERROR_NO_MEM;
+			}
+			tmp->library_owns_data = 1;
+			plan->tmp[i] = tmp;
+		}
+		opts->plan = plan;
+	}
+
+	if (!plan->num_steps) {
+		ret = uvc_duplicate_frame(in, out);
+		if (!ret && opts->stats)
+			_uvc_convert_stats_pass(out, opts->stats);
+		return ret;
+	}
+
+	uvc_frame_t *src = in;
+	for (i = 0; i < plan->num_steps; i++) {
+		const int last = i == plan->num_steps - 1;
+		uvc_frame_t *dst = last ? out : plan->tmp[i];
+#ifdef LIBUVC_HAS_JPEG
+		if (src->frame_format == UVC_FRAME_FORMAT_MJPEG) {
+			// decode with the stream's decoder instead of setting up libjpeg per frame
+			if (!opts->decoder && !plan->decoder)
+				plan->decoder = uvc_mjpeg_decoder_create();
+			uvc_mjpeg_decoder_t *decoder = opts->decoder ? opts->decoder : plan->decoder;
+			if (LIKELY(decoder && plan->steps[i].func)) {
+				ret = _uvc_mjpeg_decoder_decode_stats(decoder, src, dst, plan->steps[i].dst,
+					plan->steps[i].scale > 1 ? plan->steps[i].scale : 1,
+					last && plan->steps[i].stats_func ? opts->stats : NULL);
+				if (UNLIKELY(ret))
+					return ret;
+				if (last && opts->stats && !plan->steps[i].stats_func)
+					_uvc_convert_stats_pass(out, opts->stats);
+				src = dst;
+				continue;
+			}
+			if (UNLIKELY(plan->steps[i].scale))
+				return UVC_ERROR_NO_MEM;	// the scaled decode needs a decoder
+		}
+#endif
+		if (last && opts->stats && plan->steps[i].stats_func)
+			ret = plan->steps[i].stats_func(src, dst, opts->stats);
+		else if (plan->steps[i].func)
+			ret = plan->steps[i].func(src, dst);
+		else
+			ret = _uvc_convert_geometry(src, dst, scale, rotation);
+		if (UNLIKELY(ret))
+			return ret;
+		if (last && opts->stats && !plan->steps[i].stats_func)
+			_uvc_convert_stats_pass(out, opts->stats);	// no fused variant for this kernel
+		src = dst;
+	}
+	return UVC_SUCCESS;
+}
+
+/** @brief Release the plan cached in opts by uvc_convert()
+ * @ingroup frame
+ *
+ * @param opts conversion options, may be reused afterwards
+ */
+void uvc_convert_release(uvc_convert_opts_t *opts) {
+	if (opts && opts->plan) {
+		_uvc_convert_free_plan(opts->plan);
+		opts->plan = NULL;
+	}
+}
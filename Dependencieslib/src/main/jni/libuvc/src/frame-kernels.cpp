@@ -0,0 +1,163 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Packed pixel conversions generated from one template.
+ *
+ * A kernel is convert<Src, Dst, Matrix, Scale>(): the layout structs say at
+ * which byte offset each channel lives, Matrix holds the fixed point
+ * YUV->RGB factors and Scale is an integer decimation (nearest sample).
+ * Rows are plain per-pixel loops with compile time offsets, which clang and
+ * gcc turn into interleaved NEON/SSE loads and stores at -O2 and above.
+ * A new format pair is one UVC_KERNEL() line plus its prototype in libuvc.h.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+#include "frame-layouts.h"
+
+extern "C" uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+namespace {
+
+using namespace uvc_layout;
+
+/** @internal one output row, specialised on whether the source is YUV */
+template<class Src, class Dst, class M, int Scale, bool Yuv = Src::yuv>
+struct Row;
+
+template<class Src, class Dst, class M, int Scale>
+struct Row<Src, Dst, M, Scale, true> {
+	static_assert(Scale == 1 || !(Scale & 1), "4:2:2 sources decimate by 1 or an even factor");
+
+	static inline void chroma(const uint8_t *s, int &r, int &g, int &b) {
+		const int u = s[Src::u] - 128;
+		const int v = s[Src::v] - 128;
+		r = (M::RV * v) >> 14;
+		g = (M::GU * u + M::GV * v) >> 14;
+		b = (M::BU * u) >> 14;
+	}
+
+	static void run(const uint8_t *__restrict src, uint8_t *__restrict dst, const int width) {
+		int r, g, b;
+		if (Scale == 1) {
+			for (int i = 0; i < width / 2; i++) {
+				const uint8_t *s = src + i * 4;
+				uint8_t *d = dst + i * 2 * Dst::pixel_bytes;
+				chroma(s, r, g, b);
+				Dst::store(d, clamp255(s[Src::y0] + r), clamp255(s[Src::y0] + g), clamp255(s[Src::y0] + b));
+				Dst::store(d + Dst::pixel_bytes,
+					clamp255(s[Src::y1] + r), clamp255(s[Src::y1] + g), clamp255(s[Src::y1] + b));
+			}
+		} else {
+			// every output pixel is the first sample of one macro pixel
+			for (int i = 0; i < width; i++) {
+				const uint8_t *s = src + i * Scale * Src::pixel_bytes;
+				chroma(s, r, g, b);
+				Dst::store(dst + i * Dst::pixel_bytes,
+					clamp255(s[Src::y0] + r), clamp255(s[Src::y0] + g), clamp255(s[Src::y0] + b));
+			}
+		}
+	}
+};
+
+template<class Src, class Dst, class M, int Scale>
+struct Row<Src, Dst, M, Scale, false> {
+	static void run(const uint8_t *__restrict src, uint8_t *__restrict dst, const int width) {
+		int r, g, b;
+		for (int i = 0; i < width; i++) {
+			Src::load(src + i * Scale * Src::pixel_bytes, r, g, b);
+			Dst::store(dst + i * Dst::pixel_bytes, r, g, b);
+		}
+	}
+};
+
+/** @internal
+ * validate, size the output (the caller's step is kept for frames the
+ * library does not own) and run the row kernel over the image, feeding
+ * each row to stats while it is still in cache when stats is not NULL
+ */
+template<class Src, class Dst, class M, int Scale>
+uvc_error_t convert(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats) {
+	if (UNLIKELY(in->frame_format != Src::format))
+		return UVC_ERROR_INVALID_PARAM;
+
+	const int width = in->width / Scale;
+	const int height = in->height / Scale;
+	const size_t src_row = (size_t)in->width * Src::pixel_bytes;
+	const size_t src_step = in->step ? in->step : src_row;
+	if (UNLIKELY(!width || !height || (Src::yuv && (in->width & 1)) || (src_step < src_row)
+		|| (in->data_bytes < src_step * (in->height - 1) + src_row)))
+		return UVC_ERROR_INVALID_PARAM;
+
+	const size_t dst_row = (size_t)width * Dst::pixel_bytes;
+	const size_t dst_step = out->library_owns_data || !out->step ? dst_row : out->step;
+	if (UNLIKELY(dst_step < dst_row))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(uvc_ensure_frame_size(out, dst_step * height) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	out->width = width;
+	out->height = height;
+	out->frame_format = Dst::format;
+	out->step = dst_step;
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = dst_step * height;
+
+	const uint8_t *src = static_cast<const uint8_t *>(in->data);
+	uint8_t *dst = static_cast<uint8_t *>(out->data);
+	if (!stats) {
+		for (int h = 0; h < height; h++)
+			Row<Src, Dst, M, Scale>::run(src + src_step * h * Scale, dst + dst_step * h, width);
+	} else {
+		_uvc_stats_begin(stats, out);
+		for (int h = 0; h < height; h++) {
+			Row<Src, Dst, M, Scale>::run(src + src_step * h * Scale, dst + dst_step * h, width);
+			_uvc_stats_row(stats, out, dst + dst_step * h, h);
+		}
+		_uvc_stats_end(stats);
+	}
+
+	return UVC_SUCCESS;
+}
+
+}	// namespace
+
+#define UVC_KERNEL(name, Src, Dst, Scale) \
+	extern "C" uvc_error_t name(uvc_frame_t *in, uvc_frame_t *out) { \
+		return convert<Src, Dst, Bt601Full, Scale>(in, out, NULL); \
+	}
+
+/** @internal kernel that also accumulates frame statistics, see libuvc_internal.h */
+#define UVC_KERNEL_STATS(name, Src, Dst, Scale) \
+	UVC_KERNEL(name, Src, Dst, Scale) \
+	extern "C" uvc_error_t _##name##_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats) { \
+		return convert<Src, Dst, Bt601Full, Scale>(in, out, stats); \
+	}
+
+/** @brief packed RGB / YUV 4:2:2 conversions, see libuvc.h
+ * @ingroup frame
+ * _half variants decimate to half width and height in the same pass. The
+ * RGBX/RGB565 preview outputs also get a _stats variant for uvc_convert().
+ */
+UVC_KERNEL(uvc_rgb2rgbx, Rgb, Rgbx, 1)
+UVC_KERNEL(uvc_rgb2rgb565, Rgb, Rgb565, 1)
+
+UVC_KERNEL(uvc_yuyv2rgb, Yuyv, Rgb, 1)
+UVC_KERNEL(uvc_yuyv2bgr, Yuyv, Bgr, 1)
+UVC_KERNEL_STATS(uvc_yuyv2rgbx, Yuyv, Rgbx, 1)
+UVC_KERNEL_STATS(uvc_yuyv2rgb565, Yuyv, Rgb565, 1)
+UVC_KERNEL_STATS(uvc_yuyv2rgbx_half, Yuyv, Rgbx, 2)
+UVC_KERNEL_STATS(uvc_yuyv2rgb565_half, Yuyv, Rgb565, 2)
+
+UVC_KERNEL(uvc_uyvy2rgb, Uyvy, Rgb, 1)
+UVC_KERNEL(uvc_uyvy2bgr, Uyvy, Bgr, 1)
+UVC_KERNEL_STATS(uvc_uyvy2rgbx, Uyvy, Rgbx, 1)
+UVC_KERNEL_STATS(uvc_uyvy2rgb565, Uyvy, Rgb565, 1)
+UVC_KERNEL_STATS(uvc_uyvy2rgbx_half, Uyvy, Rgbx, 2)
+UVC_KERNEL_STATS(uvc_uyvy2rgb565_half, Uyvy, Rgb565, 2)
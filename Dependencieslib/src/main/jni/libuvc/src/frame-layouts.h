@@ -0,0 +1,110 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Pixel layouts and YUV->RGB factors shared by the C++ frame kernels
+ * (frame-kernels.cpp, frame-tensor.cpp); internal, not installed.
+ */
+#ifndef LIBUVC_FRAME_LAYOUTS_H
+#define LIBUVC_FRAME_LAYOUTS_H
+
+#include "libuvc/libuvc.h"
+
+namespace uvc_layout {
+
+/** @internal JFIF (full range BT.601) factors in 1/16384 */
+struct Bt601Full {
+	static const int RV = 22987;
+	static const int GU = -5636;
+	static const int GV = -11698;
+	static const int BU = 29049;
+};
+
+/** @internal packed 4:2:2 source, one chroma pair per two pixels */
+template<enum uvc_frame_format F, int OY0, int OU, int OY1, int OV>
+struct Packed422 {
+	static const enum uvc_frame_format format = F;
+	static const bool yuv = true;
+	static const int pixel_bytes = 2;
+	static const int y0 = OY0, u = OU, y1 = OY1, v = OV;
+};
+
+typedef Packed422<UVC_FRAME_FORMAT_YUYV, 0, 1, 2, 3> Yuyv;
+typedef Packed422<UVC_FRAME_FORMAT_UYVY, 1, 0, 3, 2> Uyvy;
+
+/** @internal 8 bit per channel RGB layouts, OX >= 0 is an opaque filler byte */
+template<enum uvc_frame_format F, int OR, int OG, int OB, int Bytes, int OX = -1>
+struct Packed888 {
+	static const enum uvc_frame_format format = F;
+	static const bool yuv = false;
+	static const int pixel_bytes = Bytes;
+	static const int r = OR, g = OG, b = OB;
+
+	static inline void load(const uint8_t *p, int &r, int &g, int &b) {
+		r = p[OR];
+		g = p[OG];
+		b = p[OB];
+	}
+
+	static inline void store(uint8_t *p, const int r, const int g, const int b) {
+		p[OR] = r;
+		p[OG] = g;
+		p[OB] = b;
+		if (OX >= 0)
+			p[OX] = 0xff;
+	}
+};
+
+typedef Packed888<UVC_FRAME_FORMAT_RGB, 0, 1, 2, 3> Rgb;
+typedef Packed888<UVC_FRAME_FORMAT_BGR, 2, 1, 0, 3> Bgr;
+typedef Packed888<UVC_FRAME_FORMAT_RGBX, 0, 1, 2, 4, 3> Rgbx;
+
+/** @internal little endian RGB565 */
+struct Rgb565 {
+	static const enum uvc_frame_format format = UVC_FRAME_FORMAT_RGB565;
+	static const bool yuv = false;
+	static const int pixel_bytes = 2;
+
+	static inline void store(uint8_t *p, const int r, const int g, const int b) {
+		p[0] = ((g << 3) & 0xe0) | (b >> 3);
+		p[1] = (r & 0xf8) | (g >> 5);
+	}
+};
+
+static inline int clamp255(const int v) {
+	return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+}	// namespace uvc_layout
+
+#endif // LIBUVC_FRAME_LAYOUTS_H
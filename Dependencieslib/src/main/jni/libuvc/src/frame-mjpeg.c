@@ -38,6 +38,7 @@
 #include "libuvc/libuvc.h"
 #include "libuvc/libuvc_internal.h"
 #include <jpeglib.h>
+#include <jerror.h>
 #include <setjmp.h>
 
 extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
@@ -45,6 +46,9 @@ extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
 struct error_mgr {
     struct jpeg_error_mgr super;
     jmp_buf jmp;
+    /** libjpeg's own emit_message and whether image data was missing */
+    void (*emit_message)(j_common_ptr dinfo, int msg_level);
+    int partial;
 };
 
 static void _error_exit(j_common_ptr dinfo) {
@@ -53,6 +57,16 @@ static void _error_exit(j_common_ptr dinfo) {
     longjmp(myerr->jmp, 1);
 }
 
+static void _emit_message(j_common_ptr dinfo, int msg_level) {
+    struct error_mgr *myerr = (struct error_mgr *) dinfo->err;
+    // libjpeg fills in missing data and carries on: the frame ended early, a
+    // marker cut the scan short or restart markers had to be resynced
+    if ((msg_level < 0) && ((dinfo->err->msg_code == JWRN_JPEG_EOF)
+        || (dinfo->err->msg_code == JWRN_HIT_MARKER) || (dinfo->err->msg_code == JWRN_MUST_RESYNC)))
+        myerr->partial = 1;
+    myerr->emit_message(dinfo, msg_level);
+}
+
 /* ISO/IEC 10918-1:1993(E) K.3.3. Default Huffman tables used by MJPEG UVC devices
    which don't specify a Huffman table in the JPEG stream. */
 static const unsigned char dc_lumi_len[] =
@@ -137,420 +151,1510 @@ static void insert_huff_tables(j_decompress_ptr dinfo) {
 #define MAX_READLINE 1
 #endif
 
-static uvc_error_t uvc_mjpeg_convert(uvc_frame_t *in, uvc_frame_t *out) {
-    struct jpeg_decompress_struct dinfo;
-    struct error_mgr jerr;
-    size_t lines_read;
-    dinfo.err = jpeg_std_error(&jerr.super);
-    jerr.super.error_exit = _error_exit;
+/** @internal
+ * source manager reading a frame in place: the buffer of an assembled frame,
+ * or the payload fragments UVC_STREAM_FLAG_FRAGMENTS leaves in the transfers
+ * one after the other, so they never have to be copied together
+ */
+struct uvc_mjpeg_src {
+	struct jpeg_source_mgr pub;
+	const uvc_frame_fragment_t *fragments;
+	int num_fragments, next;
+	uvc_frame_fragment_t whole;
+};
 
-    if (setjmp(jerr.jmp)) {
-        goto fail;
-    }
+static const JOCTET _uvc_mjpeg_eoi[2] = { 0xff, JPEG_EOI };
 
-    jpeg_create_decompress(&dinfo);
-    jpeg_mem_src(&dinfo, in->data, in->data_bytes);
-    jpeg_read_header(&dinfo, TRUE);
+static void _uvc_mjpeg_src_init(j_decompress_ptr dinfo) {
+	(void) dinfo;
+}
 
-    if (dinfo.dc_huff_tbl_ptrs[0] == NULL) {
-        /* This frame is missing the Huffman tables: fill in the standard ones */
-        insert_huff_tables(&dinfo);
-    }
+static boolean _uvc_mjpeg_src_fill(j_decompress_ptr dinfo) {
+	struct uvc_mjpeg_src *src = (struct uvc_mjpeg_src *) dinfo->src;
 
-    if (out->frame_format == UVC_FRAME_FORMAT_RGB)
-        dinfo.out_color_space = JCS_RGB;
-    else if (out->frame_format == UVC_FRAME_FORMAT_GRAY8)
-        dinfo.out_color_space = JCS_GRAYSCALE;
-    else
-        goto fail;
+	while (src->next < src->num_fragments) {
+		const uvc_frame_fragment_t *fragment = src->fragments + src->next++;
+		if (LIKELY(fragment->bytes)) {
+			src->pub.next_input_byte = fragment->data;
+			src->pub.bytes_in_buffer = fragment->bytes;
+			return TRUE;
+		}
+	}
+	// out of data: end the image like jpeg_mem_src, which _emit_message notices
+	WARNMS(dinfo, JWRN_JPEG_EOF);
+	src->pub.next_input_byte = _uvc_mjpeg_eoi;
+	src->pub.bytes_in_buffer = sizeof(_uvc_mjpeg_eoi);
+	return TRUE;
+}
 
-    dinfo.dct_method = JDCT_IFAST;
+static void _uvc_mjpeg_src_skip(j_decompress_ptr dinfo, long num_bytes) {
+	struct jpeg_source_mgr *src = dinfo->src;
 
-    jpeg_start_decompress(&dinfo);
+	if (num_bytes <= 0)
+		return;
+	while (num_bytes > (long) src->bytes_in_buffer) {
+		num_bytes -= (long) src->bytes_in_buffer;
+		(void) (*src->fill_input_buffer)(dinfo);
+	}
+	src->next_input_byte += num_bytes;
+	src->bytes_in_buffer -= num_bytes;
+}
 
-    lines_read = 0;
-    while (dinfo.output_scanline < dinfo.output_height) {
-        unsigned char *buffer[1] = {(unsigned char *) out->data + lines_read * out->step};
-        int num_scanlines;
+static void _uvc_mjpeg_src_term(j_decompress_ptr dinfo) {
+	(void) dinfo;
+}
 
-        num_scanlines = jpeg_read_scanlines(&dinfo, buffer, 1);
-        lines_read += num_scanlines;
-    }
+/** @internal point dinfo at the data of in, src lives as long as the decode */
+static void _uvc_mjpeg_src(j_decompress_ptr dinfo, struct uvc_mjpeg_src *src, const uvc_frame_t *in) {
+	src->pub.init_source = _uvc_mjpeg_src_init;
+	src->pub.fill_input_buffer = _uvc_mjpeg_src_fill;
+	src->pub.skip_input_data = _uvc_mjpeg_src_skip;
+	src->pub.resync_to_restart = jpeg_resync_to_restart;
+	src->pub.term_source = _uvc_mjpeg_src_term;
+	src->pub.next_input_byte = NULL;
+	src->pub.bytes_in_buffer = 0;
+	if (in->num_fragments) {
+		src->fragments = in->fragments;
+		src->num_fragments = in->num_fragments;
+	} else {
+		src->whole.data = in->data;
+		src->whole.bytes = in->actual_bytes/*in->data_bytes*/;	// XXX
+		src->fragments = &src->whole;
+		src->num_fragments = 1;
+	}
+	src->next = 0;
+	dinfo->src = &src->pub;
+}
 
-    jpeg_finish_decompress(&dinfo);
-    jpeg_destroy_decompress(&dinfo);
-    return 0;
+#define MAX_TABLE_SEGMENTS 8
+
+/** @internal what _uvc_mjpeg_parse finds in front of the scan */
+struct uvc_mjpeg_header {
+	size_t header_bytes;	// up to and including SOS, 0 when not parsed
+	size_t sof_height;	// offset of the height in SOF
+	size_t eoi;	// offset of EOI, trailing zero padding excluded
+	uint32_t width;
+	uint32_t height;
+	/** a single interleaved sequential scan, the only one the scan check covers */
+	int sequential;
+	/** MCUs between restart markers, 0 without them */
+	uint32_t interval;
+	/** restart markers a complete sequential scan has */
+	uint32_t restarts;
+	uint32_t mcus_per_row;
+	uint32_t mcu_rows;
+	uint32_t mcu_height;
+	/** DQT and DHT segments from their marker on, -1 for more than MAX_TABLE_SEGMENTS */
+	int num_tables;
+	size_t table_pos[MAX_TABLE_SEGMENTS];
+	size_t table_bytes[MAX_TABLE_SEGMENTS];
+};
 
-    fail:
-    jpeg_destroy_decompress(&dinfo);
-    return UVC_ERROR_OTHER;
-}
+#define MAX_TEMPLATE_BYTES 2048
 
-/** @brief Convert an MJPEG frame to RGB
- * @ingroup frame
- *
- * @param in MJPEG frame
- * @param out RGB frame
+/** @internal
+ * header template: the DQT and DHT segments of the last frame libjpeg read
+ * whole, and the tables they left in the decompress object. Cameras send
+ * the same ones with every frame (or none, for the standard Huffman tables),
+ * so a frame whose segments match is handed to libjpeg without them and
+ * gets the tables from here: only SOF, DRI and SOS are parsed again.
  */
-uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
-    if (in->frame_format != UVC_FRAME_FORMAT_MJPEG)
-        return UVC_ERROR_INVALID_PARAM;
-
-    if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
-        return UVC_ERROR_NO_MEM;
+struct uvc_mjpeg_template {
+	/** the segments back to back, none when there is no template */
+	uint8_t segments[MAX_TEMPLATE_BYTES];
+	size_t segment_bytes;
+	JQUANT_TBL quant[NUM_QUANT_TBLS];
+	JHUFF_TBL dc_huff[NUM_HUFF_TBLS];
+	JHUFF_TBL ac_huff[NUM_HUFF_TBLS];
+	uint8_t has_quant[NUM_QUANT_TBLS];
+	uint8_t has_dc_huff[NUM_HUFF_TBLS];
+	uint8_t has_ac_huff[NUM_HUFF_TBLS];
+	/** the frame with the segments left out */
+	uvc_frame_fragment_t fragments[MAX_TABLE_SEGMENTS + 1];
+};
 
-    out->width = in->width;
-    out->height = in->height;
-    out->frame_format = UVC_FRAME_FORMAT_RGB;
-    out->step = in->width * 3;
-    out->sequence = in->sequence;
-    out->capture_time = in->capture_time;
-    out->capture_time_finished = in->capture_time_finished;
-    out->source = in->source;
+/** @internal
+ * MJPEG decoder that lives as long as a stream: the decompress object with
+ * its permanent pool, source manager and table storage, plus the row
+ * buffer of the YUYV repack, are set up once instead of for every frame.
+ * libjpeg still allocates its per image state in jpeg_start_decompress.
+ */
+struct uvc_mjpeg_decoder {
+	struct jpeg_decompress_struct dinfo;
+	struct error_mgr jerr;
+	struct uvc_mjpeg_src src;
+	/** YCbCr rows for the YUYV repack / raw planes, grown on demand */
+	uint8_t *rows;
+	size_t rows_bytes;
+	/** YUYV frame for 4:2:0 output of sampling the raw path does not handle */
+	uvc_frame_t *yuyv;
+	/** restart interval band decode, NULL unless uvc_mjpeg_decoder_set_threads */
+	struct uvc_mjpeg_bands *bands;
+	struct uvc_mjpeg_template template;
+};
 
-    return uvc_mjpeg_convert(in, out);
+static void _uvc_mjpeg_bands_destroy(struct uvc_mjpeg_bands *bands);
+static enum uvc_mjpeg_defect _uvc_mjpeg_validate(const uvc_frame_t *frame, int flags,
+	struct uvc_mjpeg_header *hdr);
+static void _uvc_mjpeg_read_header(uvc_mjpeg_decoder_t *decoder, const uvc_frame_t *in,
+	const struct uvc_mjpeg_header *hdr);
+
+/** @internal set up a decoder in place, @return 0 on success */
+static int _uvc_mjpeg_decoder_init(uvc_mjpeg_decoder_t *decoder) {
+	memset(decoder, 0, sizeof(*decoder));
+	decoder->dinfo.err = jpeg_std_error(&decoder->jerr.super);
+	decoder->jerr.super.error_exit = _error_exit;
+	decoder->jerr.emit_message = decoder->jerr.super.emit_message;
+	decoder->jerr.super.emit_message = _emit_message;
+	if (setjmp(decoder->jerr.jmp))
+		return -1;	// out of memory, nothing to destroy
+	jpeg_create_decompress(&decoder->dinfo);
+	return 0;
 }
 
-/** @brief Convert an MJPEG frame to GRAY8
- * @ingroup frame
- *
- * @param in MJPEG frame
- * @param out GRAY8 frame
- */
-uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out) {
-    if (in->frame_format != UVC_FRAME_FORMAT_MJPEG)
-        return UVC_ERROR_INVALID_PARAM;
-
-    if (uvc_ensure_frame_size(out, in->width * in->height) < 0)
-        return UVC_ERROR_NO_MEM;
+/** @internal counterpart of _uvc_mjpeg_decoder_init */
+static void _uvc_mjpeg_decoder_term(uvc_mjpeg_decoder_t *decoder) {
+	jpeg_destroy_decompress(&decoder->dinfo);
+	free(decoder->rows);
+	decoder->rows = NULL;
+	decoder->rows_bytes = 0;
+	if (decoder->yuyv)
+		uvc_free_frame(decoder->yuyv);
+	decoder->yuyv = NULL;
+	_uvc_mjpeg_bands_destroy(decoder->bands);
+	decoder->bands = NULL;
+}
 
-    out->width = in->width;
-    out->height = in->height;
-    out->frame_format = UVC_FRAME_FORMAT_GRAY8;
-    out->step = in->width;
-    out->sequence = in->sequence;
-    out->capture_time = in->capture_time;
-    out->capture_time_finished = in->capture_time_finished;
-    out->source = in->source;
+/** @internal grow the scratch rows of a decoder, @return NULL when out of memory */
+static uint8_t *_uvc_mjpeg_decoder_rows(uvc_mjpeg_decoder_t *decoder, const size_t bytes) {
+	if (decoder->rows_bytes < bytes) {
+		uint8_t *rows = realloc(decoder->rows, bytes);
+		if (UNLIKELY(!rows))
+			return NULL;
+		decoder->rows = rows;
+		decoder->rows_bytes = bytes;
+	}
+	return decoder->rows;
+}
 
-    return uvc_mjpeg_convert(in, out);
+/** @internal
+ * one 4:2:0 chroma row from two rows of Cb/Cr samples (the same row twice
+ * for 4:2:0 input, two rows averaged for 4:2:2)
+ * @param pv NULL for interleaved output into pu, VU order when swap_uv
+ */
+static inline void _uvc_raw_chroma_row(const uint8_t *u0, const uint8_t *u1,
+	const uint8_t *v0, const uint8_t *v1, uint8_t *pu, uint8_t *pv,
+	const int width, const int swap_uv) {
+
+	int x;
+	if (pv) {
+		for (x = 0; x < width; x++) {
+			pu[x] = (u0[x] + u1[x] + 1) >> 1;
+			pv[x] = (v0[x] + v1[x] + 1) >> 1;
+		}
+	} else {
+		uint8_t *pa = swap_uv ? pu + 1 : pu;
+		uint8_t *pb = swap_uv ? pu : pu + 1;
+		for (x = 0; x < width; x++) {
+			pa[2 * x] = (u0[x] + u1[x] + 1) >> 1;
+			pb[2 * x] = (v0[x] + v1[x] + 1) >> 1;
+		}
+	}
 }
 
-/** @brief Convert an MJPEG frame to BGR
- * @ingroup frame
- *
- * @param in MJPEG frame
- * @param out BGR frame
+/** @internal
+ * MJPEG to I420/YV12/NV12/NV21 from the decoded Y/Cb/Cr planes
+ * (jpeg_read_raw_data): no colour conversion and no chroma upsampling,
+ * 4:2:2 chroma is only averaged down vertically. Luma is decoded straight
+ * into the output when its stride holds the padded MCU width.
+ * Other sampling goes through YUYV.
  */
-uvc_error_t uvc_mjpeg2bgr(uvc_frame_t *in, uvc_frame_t *out) {
-	struct jpeg_decompress_struct dinfo;
-	struct error_mgr jerr;
-	size_t lines_read;
+static uvc_error_t _uvc_mjpeg_decode_planar(uvc_mjpeg_decoder_t *decoder,
+	uvc_frame_t *in, uvc_frame_t *out, const enum uvc_frame_format format) {
 
-	int num_scanlines, i;
-	lines_read = 0;
-	unsigned char *buffer[MAX_READLINE];
+	struct jpeg_decompress_struct *dinfo = &decoder->dinfo;
+	const int semi = (format == UVC_FRAME_FORMAT_NV12) || (format == UVC_FRAME_FORMAT_NV21);
+	const int swap_uv = (format == UVC_FRAME_FORMAT_YV12) || (format == UVC_FRAME_FORMAT_NV21);
+	const uint32_t width = in->width;
+	const uint32_t height = in->height;
 
 	out->actual_bytes = 0;	// XXX
-	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
+	if (UNLIKELY((in->frame_format != UVC_FRAME_FORMAT_MJPEG) || !width || !height || (width & 1)))
 		return UVC_ERROR_INVALID_PARAM;
-
-	if (uvc_ensure_frame_size(out, in->width * in->height * 3) < 0)
+	// a broken frame is turned down before libjpeg spends any time on it
+	struct uvc_mjpeg_header hdr;
+	if (UNLIKELY(_uvc_mjpeg_validate(in, 0, &hdr)))
+		return UVC_ERROR_OTHER;
+
+	// same layout as the 4:2:0 kernels of frame-yuv.c
+	const size_t y_stride = out->library_owns_data || !out->step ? width : out->step;
+	if (UNLIKELY(y_stride < width))
+		return UVC_ERROR_INVALID_PARAM;
+	const size_t c_stride = semi ? y_stride : y_stride / 2;
+	const uint32_t ch = (height + 1) / 2;
+	const size_t need = y_stride * height + c_stride * ch * (semi ? 1 : 2);
+	if (UNLIKELY(uvc_ensure_frame_size(out, need) < 0))
 		return UVC_ERROR_NO_MEM;
 
-	out->width = in->width;
-	out->height = in->height;
-	out->frame_format = UVC_FRAME_FORMAT_BGR;
-	out->step = in->width * 3;
+	out->width = width;
+	out->height = height;
+	out->frame_format = format;
+	out->step = y_stride;
 	out->sequence = in->sequence;
 	out->capture_time = in->capture_time;
+	out->capture_time_finished = in->capture_time_finished;
 	out->source = in->source;
 
-	dinfo.err = jpeg_std_error(&jerr.super);
-	jerr.super.error_exit = _error_exit;
+	uint8_t *plane_y = out->data;
+	uint8_t *plane_u = plane_y + y_stride * height;
+	uint8_t *plane_v = semi ? NULL : plane_u + c_stride * ch;
+	if (swap_uv && !semi) {
+		uint8_t *t = plane_u;
+		plane_u = plane_v;
+		plane_v = t;
+	}
+
+	if (setjmp(decoder->jerr.jmp)) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
+	}
 
-	if (setjmp(jerr.jmp)) {
-		goto fail;
+	decoder->jerr.partial = 0;
+	_uvc_mjpeg_read_header(decoder, in, &hdr);
+
+	const jpeg_component_info *comp = dinfo->comp_info;
+	if (UNLIKELY((dinfo->num_components != 3)
+		|| (comp[0].h_samp_factor != 2) || (comp[0].v_samp_factor > 2)
+		|| (comp[1].h_samp_factor != 1) || (comp[1].v_samp_factor != 1)
+		|| (comp[2].h_samp_factor != 1) || (comp[2].v_samp_factor != 1))) {
+		// not 4:2:2 or 4:2:0, go through the (upsampling) YUYV path
+		jpeg_abort_decompress(dinfo);
+		if (!decoder->yuyv && !(decoder->yuyv = uvc_allocate_frame(0)))
+			return UVC_ERROR_NO_MEM;
+		uvc_error_t ret = _uvc_mjpeg_decoder_decode_stats(decoder, in, decoder->yuyv, UVC_FRAME_FORMAT_YUYV, 1, NULL);
+		if (LIKELY(!ret)) {
+			switch (format) {
+			case UVC_FRAME_FORMAT_I420: ret = uvc_yuyv2yuv420P(decoder->yuyv, out); break;
+			case UVC_FRAME_FORMAT_YV12: ret = uvc_yuyv2iyuv420P(decoder->yuyv, out); break;
+			case UVC_FRAME_FORMAT_NV12: ret = uvc_yuyv2yuv420SP(decoder->yuyv, out); break;
+			default: ret = uvc_yuyv2iyuv420SP(decoder->yuyv, out); break;
+			}
+		}
+		return ret;
 	}
 
-	jpeg_create_decompress(&dinfo);
-	jpeg_mem_src(&dinfo, in->data, in->actual_bytes/*in->data_bytes*/);
-	jpeg_read_header(&dinfo, TRUE);
+	dinfo->raw_data_out = TRUE;
+	dinfo->dct_method = JDCT_IFAST;
+	jpeg_start_decompress(dinfo);
 
-	if (dinfo.dc_huff_tbl_ptrs[0] == NULL) {
-		/* This frame is missing the Huffman tables: fill in the standard ones */
-		insert_huff_tables(&dinfo);
+	if (UNLIKELY((dinfo->output_width != width) || (dinfo->output_height != height))) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
 	}
 
-	dinfo.out_color_space = JCS_EXT_BGR;
-	dinfo.dct_method = JDCT_IFAST;
+	const int v420 = comp[0].v_samp_factor == 2;
+	const int rows_per_imcu = comp[0].v_samp_factor * DCTSIZE;
+	const size_t y_pad = (size_t)comp[0].width_in_blocks * DCTSIZE;
+	const size_t c_pad = (size_t)comp[1].width_in_blocks * DCTSIZE;
+	const int direct = y_stride >= y_pad;
+	uint8_t *scratch = _uvc_mjpeg_decoder_rows(decoder, y_pad * rows_per_imcu + c_pad * DCTSIZE * 2);
+	if (UNLIKELY(!scratch)) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_NO_MEM;
+	}
+	uint8_t *scratch_u = scratch + y_pad * rows_per_imcu;
+	uint8_t *scratch_v = scratch_u + c_pad * DCTSIZE;
+	JSAMPROW rows_y[2 * DCTSIZE], rows_u[DCTSIZE], rows_v[DCTSIZE];
+	JSAMPARRAY planes[3] = { rows_y, rows_u, rows_v };
+	const int cw = width / 2;
+	int i;
+
+	for (i = 0; i < DCTSIZE; i++) {
+		rows_u[i] = scratch_u + c_pad * i;
+		rows_v[i] = scratch_v + c_pad * i;
+	}
+	while (dinfo->output_scanline < height) {
+		const uint32_t y0 = dinfo->output_scanline;
+		for (i = 0; i < rows_per_imcu; i++) {
+			// rows past the image (MCU padding) always land in scratch
+			rows_y[i] = direct && (y0 + i < height)
+				? plane_y + y_stride * (y0 + i) : scratch + y_pad * i;
+		}
+		if (UNLIKELY(jpeg_read_raw_data(dinfo, planes, rows_per_imcu) != (JDIMENSION)rows_per_imcu)) {
+			jpeg_abort_decompress(dinfo);
+			return UVC_ERROR_OTHER;
+		}
+		if (!direct) {
+			for (i = 0; i < rows_per_imcu && y0 + i < height; i++)
+				memcpy(plane_y + y_stride * (y0 + i), rows_y[i], width);
+		}
+		// DCTSIZE chroma rows per iMCU row; 4:2:0 keeps each, 4:2:2 averages pairs
+		const int out_rows = v420 ? DCTSIZE : DCTSIZE / 2;
+		for (i = 0; i < out_rows; i++) {
+			const uint32_t r = y0 / 2 + i;
+			if (r >= ch)
+				break;
+			const int s0 = v420 ? i : 2 * i;
+			const int s1 = v420 || (y0 + s0 + 1 >= height) ? s0 : s0 + 1;
+			_uvc_raw_chroma_row(rows_u[s0], rows_u[s1], rows_v[s0], rows_v[s1],
+				plane_u + c_stride * r, plane_v ? plane_v + c_stride * r : NULL, cw, semi && swap_uv);
+		}
+	}
+	jpeg_finish_decompress(dinfo);
+	out->actual_bytes = need;	// XXX
+	// filled in by libjpeg, the image is there but not all of it is the frame's
+	return decoder->jerr.partial ? UVC_ERROR_OTHER : UVC_SUCCESS;
+}
 
-	jpeg_start_decompress(&dinfo);
+/** @internal
+ * walk SOI, the header segments and SOS, and find EOI at the end
+ * @return UVC_MJPEG_OK or the first defect found
+ */
+static enum uvc_mjpeg_defect _uvc_mjpeg_parse(const uint8_t *jpeg, size_t bytes,
+	struct uvc_mjpeg_header *hdr) {
+
+	uint32_t hmax = 1, vmax = 1;
+	int components = 0, progressive = 0, i;
+	size_t pos = 2;
+
+	memset(hdr, 0, sizeof(*hdr));
+	// the stream hands out frames with a bus error empty
+	if (UNLIKELY(!jpeg || (bytes < 4)))
+		return UVC_MJPEG_TRUNCATED;
+	if (UNLIKELY((jpeg[0] != 0xff) || (jpeg[1] != 0xd8)))
+		return UVC_MJPEG_NO_SOI;
+	// some cameras pad the payload after EOI with zeros
+	while ((bytes > 4) && !jpeg[bytes - 1])
+		bytes--;
+	if (UNLIKELY((jpeg[bytes - 2] != 0xff) || (jpeg[bytes - 1] != 0xd9)))
+		return UVC_MJPEG_TRUNCATED;
+	hdr->eoi = bytes - 2;
+
+	for ( ; ; ) {
+		if (UNLIKELY((pos + 4 > hdr->eoi) || (jpeg[pos] != 0xff)))
+			return UVC_MJPEG_BAD_SEGMENT;
+		const uint8_t marker = jpeg[pos + 1];
+		if (marker == 0xff) {	// fill byte
+			pos++;
+			continue;
+		}
+		if (UNLIKELY((marker == 0xd8) || ((marker & 0xf8) == 0xd0) || (marker == 0x01) || !marker))
+			return UVC_MJPEG_BAD_SEGMENT;	// markers without a segment do not belong here
+		if (UNLIKELY(marker == 0xd9))
+			return UVC_MJPEG_NO_SCAN;
+		const size_t len = ((size_t)jpeg[pos + 2] << 8) | jpeg[pos + 3];
+		if (UNLIKELY((len < 2) || (pos + 2 + len > hdr->eoi)))
+			return UVC_MJPEG_BAD_SEGMENT;
+		const uint8_t *seg = jpeg + pos + 4;
+		switch (marker) {
+		case 0xc0:	// baseline
+		case 0xc1:	// extended sequential
+		case 0xc2:	// progressive
+		case 0xc9:	// arithmetic sequential
+		case 0xca:	// arithmetic progressive
+			if (UNLIKELY(hdr->sof_height || (len < 8)))
+				return UVC_MJPEG_BAD_SOF;
+			components = seg[5];
+			if (UNLIKELY(!components || (len < 8 + 3 * (size_t)components)))
+				return UVC_MJPEG_BAD_SOF;
+			for (i = 0; i < components; i++) {
+				const uint32_t h = seg[7 + i * 3] >> 4, v = seg[7 + i * 3] & 0x0f;
+				if (UNLIKELY(!h || (h > 4) || !v || (v > 4)))
+					return UVC_MJPEG_BAD_SOF;
+				if (h > hmax)
+					hmax = h;
+				if (v > vmax)
+					vmax = v;
+			}
+			hdr->height = (seg[1] << 8) | seg[2];
+			hdr->width = (seg[3] << 8) | seg[4];
+			hdr->sof_height = pos + 5;
+			progressive = (marker == 0xc2) || (marker == 0xca);
+			break;
+		case 0xc3: case 0xc5: case 0xc6: case 0xc7:
+		case 0xcb: case 0xcd: case 0xce: case 0xcf:
+			return UVC_MJPEG_BAD_SOF;	// lossless or hierarchical
+		case 0xdd:	// DRI
+			if (UNLIKELY(len < 4))
+				return UVC_MJPEG_BAD_SEGMENT;
+			hdr->interval = (seg[0] << 8) | seg[1];
+			break;
+		case 0xdb:	// DQT
+		case 0xc4:	// DHT
+			if (hdr->num_tables >= MAX_TABLE_SEGMENTS) {
+				hdr->num_tables = -1;
+			} else if (hdr->num_tables >= 0) {
+				hdr->table_pos[hdr->num_tables] = pos;
+				hdr->table_bytes[hdr->num_tables++] = 2 + len;
+			}
+			break;
+		}
+		pos += 2 + len;
+		if (marker == 0xda) {	// SOS
+			if (UNLIKELY(!hdr->sof_height))
+				return UVC_MJPEG_BAD_SOF;
+			hdr->sequential = !progressive && (seg[0] == components);
+			break;
+		}
+	}
+	hdr->header_bytes = pos;
+	if (UNLIKELY(pos >= hdr->eoi))
+		return UVC_MJPEG_NO_SCAN;
+	if (UNLIKELY(!hdr->width || !hdr->height))
+		return UVC_MJPEG_BAD_SOF;	// DNL is not supported
+
+	// a single component scan is not interleaved, its MCU is one block
+	if (components == 1)
+		hmax = vmax = 1;
+	const uint32_t mcu_width = 8 * hmax;
+	hdr->mcu_height = 8 * vmax;
+	hdr->mcus_per_row = (hdr->width + mcu_width - 1) / mcu_width;
+	hdr->mcu_rows = (hdr->height + hdr->mcu_height - 1) / hdr->mcu_height;
+	if (hdr->interval)
+		hdr->restarts = (hdr->mcus_per_row * hdr->mcu_rows + hdr->interval - 1) / hdr->interval - 1;
+	return UVC_MJPEG_OK;
+}
 
-	// local copy
-	uint8_t *data = out->data;
-	const int out_step = out->step;
-
-	if (LIKELY(dinfo.output_height == out->height)) {
-		for (; dinfo.output_scanline < dinfo.output_height ;) {
-			buffer[0] = data + (lines_read) * out_step;
-			for (i = 1; i < MAX_READLINE; i++)
-				buffer[i] = buffer[i-1] + out_step;
-			num_scanlines = jpeg_read_scanlines(&dinfo, buffer, MAX_READLINE);
-			lines_read += num_scanlines;
+/** @internal
+ * check the markers in the entropy coded data of a sequential scan: restart
+ * markers in sequence and as many as the MCU count needs, nothing else
+ * @param restarts receives the offset of every restart marker, may be NULL
+ */
+static enum uvc_mjpeg_defect _uvc_mjpeg_scan(const uint8_t *jpeg,
+	const struct uvc_mjpeg_header *hdr, size_t *restarts) {
+
+	const uint8_t *p = jpeg + hdr->header_bytes, *end = jpeg + hdr->eoi;
+	uint32_t n = 0;
+
+	while ((p + 1 < end) && (p = memchr(p, 0xff, end - p - 1))) {
+		const uint8_t marker = p[1];
+		if (!marker) {	// stuffed 0xff
+			p += 2;
+		} else if (marker == 0xff) {	// fill bytes may precede a marker
+			p++;
+		} else if (LIKELY(((marker & 0xf8) == 0xd0) && (n < hdr->restarts) && ((marker & 0x07) == (n & 0x07)))) {
+			if (restarts)
+				restarts[n] = p - jpeg;
+			n++;
+			p += 2;
+		} else {
+			return UVC_MJPEG_BAD_MARKER;
 		}
-		out->actual_bytes = in->width * in->height * 3;	// XXX
 	}
-	jpeg_finish_decompress(&dinfo);
-	jpeg_destroy_decompress(&dinfo);
-	return lines_read == out->height ? UVC_SUCCESS : UVC_ERROR_OTHER;	// XXX
+	return n == hdr->restarts ? UVC_MJPEG_OK : UVC_MJPEG_BAD_MARKER;
+}
 
-fail:
-	jpeg_destroy_decompress(&dinfo);
-	return UVC_ERROR_OTHER+1;
+/** @internal
+ * SOI and EOI of a frame in payload fragments, the header is not contiguous
+ */
+static enum uvc_mjpeg_defect _uvc_mjpeg_validate_ends(const uvc_frame_t *frame) {
+	const uvc_frame_fragment_t *fragment;
+	uint8_t head[2], tail[2];
+	size_t n = 0;
+	int f, zeros = 1;
+
+	if (UNLIKELY(frame->actual_bytes < 4))
+		return UVC_MJPEG_TRUNCATED;	// XXX the stream hands out frames with a bus error empty
+	for (f = 0; (f < frame->num_fragments) && (n < 2); f++) {
+		size_t i;
+		fragment = frame->fragments + f;
+		for (i = 0; (i < fragment->bytes) && (n < 2); i++)
+			head[n++] = fragment->data[i];
+	}
+	if (UNLIKELY((n < 2) || (head[0] != 0xff) || (head[1] != 0xd8)))
+		return UVC_MJPEG_NO_SOI;
+	// the last two bytes before any zero padding, backwards across the fragments
+	n = 0;
+	for (f = frame->num_fragments - 1; (f >= 0) && (n < 2); f--) {
+		size_t i;
+		fragment = frame->fragments + f;
+		for (i = fragment->bytes; i && (n < 2); i--) {
+			const uint8_t c = fragment->data[i - 1];
+			if (zeros && !c)
+				continue;
+			zeros = 0;
+			tail[1 - n++] = c;
+		}
+	}
+	if (UNLIKELY((n < 2) || (tail[0] != 0xff) || (tail[1] != 0xd9)))
+		return UVC_MJPEG_TRUNCATED;
+	return UVC_MJPEG_OK;
 }
 
-/** @brief Convert an MJPEG frame to RGB565
+/** @brief Check the structure of an MJPEG frame without decoding it
  * @ingroup frame
  *
- * @param in MJPEG frame
- * @param out RGB frame
+ * Takes microseconds where a truncated or corrupt frame would otherwise
+ * cost most of a decode before libjpeg gives up on it: SOI and EOI (zero
+ * padding after EOI is allowed), header segments within the frame, a
+ * supported SOF of the frame's width and height, and a non-empty scan.
+ * With UVC_MJPEG_CHECK_SCAN the entropy coded data of a sequential frame is
+ * scanned as well for markers out of place and restart markers out of
+ * sequence or missing, which is what packets lost on the bus leave behind.
+ * A frame in several fragments (UVC_STREAM_FLAG_FRAGMENTS) only gets SOI and
+ * EOI checked, uvc_duplicate_frame gathers it for the full check.
+ *
+ * @param frame MJPEG frame, width and height as negotiated
+ * @param flags 0 or UVC_MJPEG_CHECK_SCAN
+ * @return UVC_MJPEG_OK or the first defect found
  */
-uvc_error_t uvc_mjpeg2rgb565(uvc_frame_t *in, uvc_frame_t *out) {
-	struct jpeg_decompress_struct dinfo;
-	struct error_mgr jerr;
-	size_t lines_read;
+enum uvc_mjpeg_defect uvc_mjpeg_validate(const uvc_frame_t *frame, int flags) {
+	struct uvc_mjpeg_header hdr;
 
-	int num_scanlines, i;
-	lines_read = 0;
-	unsigned char *buffer[MAX_READLINE];
+	return _uvc_mjpeg_validate(frame, flags, &hdr);
+}
 
-	out->actual_bytes = 0;	// XXX
-	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
-		return UVC_ERROR_INVALID_PARAM;
+/** @internal uvc_mjpeg_validate, hdr->header_bytes is 0 unless the header was parsed */
+static enum uvc_mjpeg_defect _uvc_mjpeg_validate(const uvc_frame_t *frame, int flags,
+	struct uvc_mjpeg_header *hdr) {
 
-	if (uvc_ensure_frame_size(out, in->width * in->height * 2) < 0)
-		return UVC_ERROR_NO_MEM;
+	const uint8_t *jpeg = frame->data;
+	size_t bytes = frame->actual_bytes;	// XXX
 
-	out->width = in->width;
-	out->height = in->height;
-	out->frame_format = UVC_FRAME_FORMAT_RGB565;
-	out->step = in->width * 2;
-	out->sequence = in->sequence;
-	out->capture_time = in->capture_time;
-	out->source = in->source;
+	if (frame->num_fragments > 1) {
+		hdr->header_bytes = 0;
+		return _uvc_mjpeg_validate_ends(frame);
+	}
+	if (frame->num_fragments) {	// a bulk transfer carrying the whole frame
+		jpeg = frame->fragments[0].data;
+		if (bytes > frame->fragments[0].bytes)
+			bytes = frame->fragments[0].bytes;
+	}
+	enum uvc_mjpeg_defect defect = _uvc_mjpeg_parse(jpeg, bytes, hdr);
+
+	if (UNLIKELY(defect))
+		return defect;
+	if (UNLIKELY((hdr->width != frame->width) || (hdr->height != frame->height)))
+		return UVC_MJPEG_SIZE_MISMATCH;
+	if ((flags & UVC_MJPEG_CHECK_SCAN) && hdr->sequential)
+		defect = _uvc_mjpeg_scan(jpeg, hdr, NULL);
+	return defect;
+}
 
-	dinfo.err = jpeg_std_error(&jerr.super);
-	jerr.super.error_exit = _error_exit;
+/** @internal
+ * @return 1 when the table segments of the frame (jpeg, parsed into hdr) are
+ * the template's
+ */
+static int _uvc_mjpeg_template_match(const struct uvc_mjpeg_template *template,
+	const uint8_t *jpeg, const struct uvc_mjpeg_header *hdr) {
+
+	size_t n = 0;
+	int i;
+
+	if (!template->segment_bytes || !hdr->header_bytes || (hdr->num_tables <= 0))
+		return 0;
+	for (i = 0; i < hdr->num_tables; i++) {
+		const size_t bytes = hdr->table_bytes[i];
+		if ((n + bytes > template->segment_bytes)
+			|| memcmp(template->segments + n, jpeg + hdr->table_pos[i], bytes))
+			return 0;
+		n += bytes;
+	}
+	return n == template->segment_bytes;
+}
 
-	if (setjmp(jerr.jmp)) {
-		goto fail;
+/** @internal keep the table segments of a frame libjpeg just read whole, and the tables */
+static void _uvc_mjpeg_template_save(struct uvc_mjpeg_template *template,
+	j_decompress_ptr dinfo, const uint8_t *jpeg, const struct uvc_mjpeg_header *hdr) {
+
+	size_t n = 0;
+	int i;
+
+	if (!hdr->header_bytes || (hdr->num_tables <= 0))
+		return;
+	for (i = 0; i < hdr->num_tables; i++) {
+		const size_t bytes = hdr->table_bytes[i];
+		if (UNLIKELY(n + bytes > sizeof(template->segments)))
+			return;	// too big to keep, every frame is read whole
+		memcpy(template->segments + n, jpeg + hdr->table_pos[i], bytes);
+		n += bytes;
+	}
+	for (i = 0; i < NUM_QUANT_TBLS; i++) {
+		template->has_quant[i] = dinfo->quant_tbl_ptrs[i] != NULL;
+		if (dinfo->quant_tbl_ptrs[i])
+			template->quant[i] = *dinfo->quant_tbl_ptrs[i];
+	}
+	for (i = 0; i < NUM_HUFF_TBLS; i++) {
+		template->has_dc_huff[i] = dinfo->dc_huff_tbl_ptrs[i] != NULL;
+		if (dinfo->dc_huff_tbl_ptrs[i])
+			template->dc_huff[i] = *dinfo->dc_huff_tbl_ptrs[i];
+		template->has_ac_huff[i] = dinfo->ac_huff_tbl_ptrs[i] != NULL;
+		if (dinfo->ac_huff_tbl_ptrs[i])
+			template->ac_huff[i] = *dinfo->ac_huff_tbl_ptrs[i];
 	}
+	template->segment_bytes = n;
+}
+
+/** @internal put the tables of the template back into the decompress object */
+static void _uvc_mjpeg_template_restore(const struct uvc_mjpeg_template *template,
+	j_decompress_ptr dinfo) {
 
-	jpeg_create_decompress(&dinfo);
-	jpeg_mem_src(&dinfo, in->data, in->actual_bytes/*in->data_bytes*/);
-	jpeg_read_header(&dinfo, TRUE);
+	int i;
 
-	if (dinfo.dc_huff_tbl_ptrs[0] == NULL) {
-		/* This frame is missing the Huffman tables: fill in the standard ones */
-		insert_huff_tables(&dinfo);
+	for (i = 0; i < NUM_QUANT_TBLS; i++) {
+		if (!template->has_quant[i])
+			continue;
+		if (!dinfo->quant_tbl_ptrs[i])
+			dinfo->quant_tbl_ptrs[i] = jpeg_alloc_quant_table((j_common_ptr)dinfo);
+		*dinfo->quant_tbl_ptrs[i] = template->quant[i];
 	}
+	for (i = 0; i < NUM_HUFF_TBLS; i++) {
+		if (template->has_dc_huff[i]) {
+			if (!dinfo->dc_huff_tbl_ptrs[i])
+				dinfo->dc_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr)dinfo);
+			*dinfo->dc_huff_tbl_ptrs[i] = template->dc_huff[i];
+		}
+		if (template->has_ac_huff[i]) {
+			if (!dinfo->ac_huff_tbl_ptrs[i])
+				dinfo->ac_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr)dinfo);
+			*dinfo->ac_huff_tbl_ptrs[i] = template->ac_huff[i];
+		}
+	}
+}
 
-	dinfo.out_color_space = JCS_RGB565;
-	dinfo.dct_method = JDCT_IFAST;
+/** @internal
+ * point the decoder at in and read its header (hdr from _uvc_mjpeg_validate).
+ * A frame whose table segments match the template skips them, the tables
+ * come from the template; any other frame is read whole and becomes the
+ * template.
+ */
+static void _uvc_mjpeg_read_header(uvc_mjpeg_decoder_t *decoder, const uvc_frame_t *in,
+	const struct uvc_mjpeg_header *hdr) {
+
+	j_decompress_ptr dinfo = &decoder->dinfo;
+	struct uvc_mjpeg_template *template = &decoder->template;
+	struct uvc_mjpeg_src *src = &decoder->src;
+
+	_uvc_mjpeg_src(dinfo, src, in);
+	// a parsed header is in the first and only fragment
+	const uvc_frame_fragment_t whole = src->fragments[0];
+	if (_uvc_mjpeg_template_match(template, whole.data, hdr)) {
+		size_t pos = 0;
+		int i;
+		for (i = 0; i < hdr->num_tables; i++) {
+			template->fragments[i].data = whole.data + pos;
+			template->fragments[i].bytes = hdr->table_pos[i] - pos;
+			pos = hdr->table_pos[i] + hdr->table_bytes[i];
+		}
+		template->fragments[i].data = whole.data + pos;
+		template->fragments[i].bytes = whole.bytes - pos;
+		src->fragments = template->fragments;
+		src->num_fragments = i + 1;
+		_uvc_mjpeg_template_restore(template, dinfo);
+		jpeg_read_header(dinfo, TRUE);
+		return;
+	}
+	// no template while libjpeg rewrites the tables, an error leaves none
+	template->segment_bytes = 0;
+	/* Frames missing the Huffman tables use the standard ones. Tables of an
+	 * earlier frame stay in the object, so put the standard ones back first */
+	insert_huff_tables(dinfo);
+	jpeg_read_header(dinfo, TRUE);
+	_uvc_mjpeg_template_save(template, dinfo, whole.data, hdr);
+}
 
-	jpeg_start_decompress(&dinfo);
+#define MAX_BAND_THREADS 8
+
+/** @internal one band of a frame and the helper decoding it */
+struct uvc_mjpeg_band {
+	uvc_mjpeg_decoder_t decoder;
+	/** the band as a JPEG of its own: header, entropy coded rows, EOI */
+	uint8_t *jpeg;
+	size_t jpeg_bytes;
+	/** first MCU row and restart marker index in front of it, 0 for the top band */
+	uint32_t mcu_row;
+	uint32_t restart;
+	uvc_error_t result;
+	struct uvc_mjpeg_bands *owner;
+};
 
-	// local copy
-	uint8_t *data = out->data;
-	const int out_step = out->step;
-
-	if (LIKELY(dinfo.output_height == out->height)) {
-		for (; dinfo.output_scanline < dinfo.output_height ;) {
-			buffer[0] = data + (lines_read) * out_step;
-			for (i = 1; i < MAX_READLINE; i++)
-				buffer[i] = buffer[i-1] + out_step;
-			num_scanlines = jpeg_read_scanlines(&dinfo, buffer, MAX_READLINE);
-			lines_read += num_scanlines;
+/** @internal
+ * restart interval band decode: a frame whose restart markers fall on MCU
+ * row starts is cut into bands of whole rows there. Every band becomes a
+ * JPEG of its own (the frame header with the band height, the band's
+ * entropy coded segments with the markers renumbered from RST0) that a
+ * helper decoder decodes straight into its rows of out. The calling thread
+ * decodes the first band, the others run on threads kept for the decoder.
+ */
+struct uvc_mjpeg_bands {
+	int threads;
+	pthread_t pthreads[MAX_BAND_THREADS];
+	pthread_mutex_t lock;
+	pthread_cond_t start;	// a frame was handed out or quit
+	pthread_cond_t done;	// a band finished
+	uint32_t generation;
+	int running;
+	int quit;
+	struct uvc_mjpeg_band band[MAX_BAND_THREADS];
+	/** the frame being decoded */
+	int num_bands;
+	uvc_frame_t *in;
+	uvc_frame_t *out;
+	enum uvc_frame_format format;
+	int scale;
+	size_t out_step;
+	size_t header_bytes;	// up to and including SOS
+	size_t sof_height;	// offset of the height in SOF
+	size_t entropy_end;	// EOI or the end of the frame
+	uint32_t mcu_rows;
+	uint32_t mcu_height;
+	/** offsets of every restart marker of the frame */
+	size_t *restarts;
+	uint32_t num_restarts;
+	uint32_t restarts_capacity;
+};
+
+/** @internal
+ * find the frame header and every restart marker, and pick up to
+ * bands->threads bands of about the same number of MCU rows
+ * @return the number of bands, 0 or 1 when the frame has to be decoded whole
+ */
+static int _uvc_mjpeg_bands_split(struct uvc_mjpeg_bands *bands, uvc_frame_t *in) {
+	struct uvc_mjpeg_header hdr;
+	int b;
+
+	if (_uvc_mjpeg_parse(in->data, in->actual_bytes, &hdr) || !hdr.sequential || !hdr.interval)	// XXX
+		return 0;
+	if (hdr.restarts > bands->restarts_capacity) {
+		size_t *restarts = realloc(bands->restarts, hdr.restarts * sizeof(*restarts));
+		if (UNLIKELY(!restarts))
+			return 0;
+		bands->restarts = restarts;
+		bands->restarts_capacity = hdr.restarts;
+	}
+	// out of sequence or missing markers: the whole frame decode resyncs
+	if (_uvc_mjpeg_scan(in->data, &hdr, bands->restarts))
+		return 0;
+	bands->header_bytes = hdr.header_bytes;
+	bands->sof_height = hdr.sof_height;
+	bands->entropy_end = hdr.eoi;
+	bands->mcu_rows = hdr.mcu_rows;
+	bands->mcu_height = hdr.mcu_height;
+	bands->num_restarts = hdr.restarts;
+	const uint32_t mcus_per_row = hdr.mcus_per_row;
+	const uint32_t interval = hdr.interval;
+
+	// band b starts at the row aligned marker closest to b / threads of the frame
+	int num_bands = 1;
+	bands->band[0].mcu_row = 0;
+	bands->band[0].restart = 0;
+	for (b = 1; b < bands->threads; b++) {
+		const uint32_t target = (uint32_t)((uint64_t)bands->mcu_rows * b / bands->threads);
+		uint32_t best_row = 0, best_restart = 0, row;
+		for (row = bands->band[num_bands - 1].mcu_row + 1; row < bands->mcu_rows; row++) {
+			const uint32_t mcu = row * mcus_per_row;
+			if (mcu % interval)
+				continue;
+			if (!best_row || ((row > target ? row - target : target - row)
+				< (best_row > target ? best_row - target : target - best_row))) {
+				best_row = row;
+				best_restart = mcu / interval;
+			}
+			if (row >= target)
+				break;
 		}
-		out->actual_bytes = in->width * in->height * 2;	// XXX
+		if (!best_row)
+			break;
+		bands->band[num_bands].mcu_row = best_row;
+		bands->band[num_bands].restart = best_restart;
+		num_bands++;
 	}
-	jpeg_finish_decompress(&dinfo);
-	jpeg_destroy_decompress(&dinfo);
-	return lines_read == out->height ? UVC_SUCCESS : UVC_ERROR_OTHER;	// XXX
+	return num_bands;
+}
 
-fail:
-	jpeg_destroy_decompress(&dinfo);
-	return UVC_ERROR_OTHER+1;
+/** @internal build band b of the current frame as a JPEG and decode it into its rows of out */
+static uvc_error_t _uvc_mjpeg_bands_decode_one(struct uvc_mjpeg_bands *bands, const int b) {
+	struct uvc_mjpeg_band *band = &bands->band[b];
+	const uint8_t *jpeg = bands->in->data;
+	const uint32_t restart = band->restart;
+	const uint32_t next = b + 1 < bands->num_bands ? bands->band[b + 1].restart : bands->num_restarts + 1;
+	// the segment after restart marker k starts behind it, the top band right after SOS
+	const size_t begin = restart ? bands->restarts[restart - 1] + 2 : bands->header_bytes;
+	const size_t end = next <= bands->num_restarts ? bands->restarts[next - 1] : bands->entropy_end;
+	const size_t need = bands->header_bytes + (end - begin) + 2;
+
+	if (band->jpeg_bytes < need) {
+		uint8_t *buf = realloc(band->jpeg, need);
+		if (UNLIKELY(!buf))
+			return UVC_ERROR_NO_MEM;
+		band->jpeg = buf;
+		band->jpeg_bytes = need;
+	}
+	uint8_t *dst = band->jpeg;
+	memcpy(dst, jpeg, bands->header_bytes);
+	const uint32_t y0 = band->mcu_row * bands->mcu_height;
+	const uint32_t y1 = b + 1 < bands->num_bands
+		? bands->band[b + 1].mcu_row * bands->mcu_height : bands->in->height;
+	dst[bands->sof_height] = (y1 - y0) >> 8;
+	dst[bands->sof_height + 1] = (y1 - y0) & 0xff;
+	dst += bands->header_bytes;
+	memcpy(dst, jpeg + begin, end - begin);
+	if (restart & 0x07) {
+		// the decoder expects RST0 first
+		uint32_t k;
+		for (k = restart + 1; k < next; k++) {
+			uint8_t *marker = dst + (bands->restarts[k - 1] - begin) + 1;
+			*marker = 0xd0 | ((*marker - restart) & 0x07);
+		}
+	}
+	dst += end - begin;
+	dst[0] = 0xff;
+	dst[1] = 0xd9;
+
+	uvc_frame_t in = *bands->in;
+	in.data = band->jpeg;
+	in.data_bytes = in.actual_bytes = need;	// XXX
+	in.height = y1 - y0;
+	// out rows of the band, mcu_height is a multiple of any scale
+	uvc_frame_t out = *bands->out;
+	out.data = (uint8_t *)bands->out->data + (size_t)(y0 / bands->scale) * bands->out_step;
+	out.data_bytes = (size_t)((y1 - y0) / bands->scale) * bands->out_step;
+	out.step = bands->out_step;
+	out.library_owns_data = 0;
+	return _uvc_mjpeg_decoder_decode_stats(&band->decoder, &in, &out, bands->format, bands->scale, NULL);
 }
 
-/** @brief Convert an MJPEG frame to RGBX
- * @ingroup frame
- *
- * @param in MJPEG frame
- * @param out RGBX frame
+/** @internal helper thread of band index (band - bands->band), one band per frame */
+static void *_uvc_mjpeg_bands_thread(void *arg) {
+	struct uvc_mjpeg_band *band = arg;
+	struct uvc_mjpeg_bands *bands = band->owner;
+	const int b = (int)(band - bands->band);
+	uint32_t generation = 0;
+
+	pthread_mutex_lock(&bands->lock);
+	for ( ; ; ) {
+		while (!bands->quit && (bands->generation == generation))
+			pthread_cond_wait(&bands->start, &bands->lock);
+		if (bands->quit)
+			break;
+		generation = bands->generation;
+		if (b < bands->num_bands) {
+			pthread_mutex_unlock(&bands->lock);
+			const uvc_error_t result = _uvc_mjpeg_bands_decode_one(bands, b);
+			pthread_mutex_lock(&bands->lock);
+			band->result = result;
+			bands->running--;
+			pthread_cond_signal(&bands->done);
+		}
+	}
+	pthread_mutex_unlock(&bands->lock);
+	return NULL;
+}
+
+/** @internal
+ * decode in into out (already sized) in bands on the helper threads
+ * @return UVC_ERROR_NOT_SUPPORTED when the frame has no usable restart markers
  */
-uvc_error_t uvc_mjpeg2rgbx(uvc_frame_t *in, uvc_frame_t *out) {
-	struct jpeg_decompress_struct dinfo;
-	struct error_mgr jerr;
-	size_t lines_read;
-	// local copy
-	uint8_t *data = out->data;
-	const int out_step = out->step;
+static uvc_error_t _uvc_mjpeg_bands_decode(struct uvc_mjpeg_bands *bands,
+	uvc_frame_t *in, uvc_frame_t *out, const enum uvc_frame_format format,
+	const int scale, const size_t out_step) {
+
+	const int num_bands = _uvc_mjpeg_bands_split(bands, in);
+	if (num_bands < 2)
+		return UVC_ERROR_NOT_SUPPORTED;
+
+	pthread_mutex_lock(&bands->lock);
+	bands->num_bands = num_bands;
+	bands->in = in;
+	bands->out = out;
+	bands->format = format;
+	bands->scale = scale;
+	bands->out_step = out_step;
+	bands->running = num_bands - 1;
+	bands->generation++;
+	pthread_cond_broadcast(&bands->start);
+	pthread_mutex_unlock(&bands->lock);
+
+	uvc_error_t result = _uvc_mjpeg_bands_decode_one(bands, 0);
+	int b;
+
+	pthread_mutex_lock(&bands->lock);
+	while (bands->running)
+		pthread_cond_wait(&bands->done, &bands->lock);
+	for (b = 1; b < num_bands; b++) {
+		if (bands->band[b].result && !result)
+			result = bands->band[b].result;
+	}
+	bands->in = bands->out = NULL;
+	pthread_mutex_unlock(&bands->lock);
+	return result;
+}
 
-	int num_scanlines, i;
-	lines_read = 0;
-	unsigned char *buffer[MAX_READLINE];
+/** @internal stop the helper threads and free the bands, may be NULL */
+static void _uvc_mjpeg_bands_destroy(struct uvc_mjpeg_bands *bands) {
+	int b;
+
+	if (!bands)
+		return;
+	pthread_mutex_lock(&bands->lock);
+	bands->quit = 1;
+	pthread_cond_broadcast(&bands->start);
+	pthread_mutex_unlock(&bands->lock);
+	for (b = 1; b < bands->threads; b++)
+		pthread_join(bands->pthreads[b], NULL);
+	for (b = 0; b < bands->threads; b++) {
+		_uvc_mjpeg_decoder_term(&bands->band[b].decoder);
+		free(bands->band[b].jpeg);
+	}
+	pthread_cond_destroy(&bands->done);
+	pthread_cond_destroy(&bands->start);
+	pthread_mutex_destroy(&bands->lock);
+	free(bands->restarts);
+	free(bands);
+}
+
+/** @internal @return bands with threads - 1 helper threads running, NULL on failure */
+static struct uvc_mjpeg_bands *_uvc_mjpeg_bands_create(const int threads) {
+	struct uvc_mjpeg_bands *bands = calloc(1, sizeof(*bands));
+	int b;
+
+	if (UNLIKELY(!bands))
+		return NULL;
+	pthread_mutex_init(&bands->lock, NULL);
+	pthread_cond_init(&bands->start, NULL);
+	pthread_cond_init(&bands->done, NULL);
+	for (b = 0; b < threads; b++) {
+		bands->band[b].owner = bands;
+		if (UNLIKELY(_uvc_mjpeg_decoder_init(&bands->band[b].decoder)))
+			break;
+		bands->threads = b + 1;	// destroy terms the decoders set up so far
+		if (b && UNLIKELY(pthread_create(&bands->pthreads[b], NULL, _uvc_mjpeg_bands_thread, &bands->band[b]))) {
+			_uvc_mjpeg_decoder_term(&bands->band[b].decoder);
+			bands->threads = b;
+			break;
+		}
+	}
+	if (bands->threads < threads) {
+		_uvc_mjpeg_bands_destroy(bands);
+		return NULL;
+	}
+	return bands;
+}
+
+/** @internal
+ * decode in into out as format at 1/scale of its size, accumulating stats
+ * (RGBX, RGB565, RGB, BGR and YUYV output, NULL for none) row by row while
+ * the rows are in cache
+ */
+uvc_error_t _uvc_mjpeg_decoder_decode_stats(uvc_mjpeg_decoder_t *decoder,
+	uvc_frame_t *in, uvc_frame_t *out, const enum uvc_frame_format format,
+	const int scale, uvc_frame_stats_t *stats) {
+
+	struct jpeg_decompress_struct *dinfo = &decoder->dinfo;
+	// gray has no colour statistics; volatile as it is live across the setjmp below
+	uvc_frame_stats_t *volatile const row_stats = format != UVC_FRAME_FORMAT_GRAY8 ? stats : NULL;
+	J_COLOR_SPACE color_space;
+	int bpp;
+
+	switch (format) {
+	case UVC_FRAME_FORMAT_RGB:
+		color_space = JCS_RGB;
+		bpp = 3;
+		break;
+	case UVC_FRAME_FORMAT_BGR:
+		color_space = JCS_EXT_BGR;
+		bpp = 3;
+		break;
+	case UVC_FRAME_FORMAT_RGBX:
+		color_space = JCS_EXT_RGBA;
+		bpp = 4;
+		break;
+	case UVC_FRAME_FORMAT_RGB565:
+		color_space = JCS_RGB565;
+		bpp = 2;
+		break;
+	case UVC_FRAME_FORMAT_GRAY8:
+		color_space = JCS_GRAYSCALE;
+		bpp = 1;
+		break;
+	case UVC_FRAME_FORMAT_YUYV:
+		// decoded to YCbCr rows and repacked
+		color_space = JCS_YCbCr;
+		bpp = 2;
+		break;
+	case UVC_FRAME_FORMAT_I420:
+	case UVC_FRAME_FORMAT_YV12:
+	case UVC_FRAME_FORMAT_NV12:
+	case UVC_FRAME_FORMAT_NV21:
+		// the raw planes are only read at full size
+		if (UNLIKELY(scale != 1))
+			return UVC_ERROR_NOT_SUPPORTED;
+		return _uvc_mjpeg_decode_planar(decoder, in, out, format);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
 
 	out->actual_bytes = 0;	// XXX
 	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
 		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY((scale != 1) && (scale != 2) && (scale != 4) && (scale != 8)))
+		return UVC_ERROR_INVALID_PARAM;
 
-	if (uvc_ensure_frame_size(out, in->width * in->height * 4) < 0)
+	const uint32_t width = in->width / scale;
+	const uint32_t height = in->height / scale;
+	if (UNLIKELY(!width || !height))
+		return UVC_ERROR_INVALID_PARAM;
+	// a broken frame is turned down before libjpeg spends any time on it
+	struct uvc_mjpeg_header hdr;
+	if (UNLIKELY(_uvc_mjpeg_validate(in, 0, &hdr)))
+		return UVC_ERROR_OTHER;
+	// rows land step bytes apart in a caller's padded frame
+	const size_t row_bytes = (size_t)width * bpp;
+	const size_t out_step = out->library_owns_data || !out->step ? row_bytes : out->step;
+	if (UNLIKELY(out_step < row_bytes))
+		return UVC_ERROR_INVALID_PARAM;
+	const size_t need = out_step * (height - 1) + row_bytes;
+	if (uvc_ensure_frame_size(out, need) < 0)
 		return UVC_ERROR_NO_MEM;
 
-	out->width = in->width;
-	out->height = in->height;
-	out->frame_format = UVC_FRAME_FORMAT_RGBX;	// XXX
-	out->step = in->width * 4;
+	out->width = width;
+	out->height = height;
+	out->frame_format = format;
+	out->step = out_step;
 	out->sequence = in->sequence;
 	out->capture_time = in->capture_time;
+	out->capture_time_finished = in->capture_time_finished;
 	out->source = in->source;
 
-	dinfo.err = jpeg_std_error(&jerr.super);
-	jerr.super.error_exit = _error_exit;
+	// local copy
+	uint8_t *data = out->data;
+	const int yuyv = format == UVC_FRAME_FORMAT_YUYV;
+	unsigned char *buffer[MAX_READLINE];
+	size_t lines_read = 0;
+	int num_scanlines, i;
 
-	if (setjmp(jerr.jmp)) {
-		goto fail;
+	if (decoder->bands && !row_stats && !in->num_fragments) {
+		// cut at the restart markers and decoded on the helper threads
+		const uvc_error_t result = _uvc_mjpeg_bands_decode(decoder->bands, in, out, format, scale, out_step);
+		if (result != UVC_ERROR_NOT_SUPPORTED) {
+			if (!result)
+				out->actual_bytes = need;	// XXX
+			return result;
+		}
 	}
 
-	jpeg_create_decompress(&dinfo);
-	jpeg_mem_src(&dinfo, in->data, in->actual_bytes/*in->data_bytes*/);	// XXX
-	jpeg_read_header(&dinfo, TRUE);
-
-	if (dinfo.dc_huff_tbl_ptrs[0] == NULL) {
-		/* This frame is missing the Huffman tables: fill in the standard ones */
-		insert_huff_tables(&dinfo);
+	if (setjmp(decoder->jerr.jmp)) {
+		// leaves the object ready for the next frame
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
 	}
 
-	dinfo.out_color_space = JCS_EXT_RGBA;
-	dinfo.dct_method = JDCT_IFAST;
+	decoder->jerr.partial = 0;
+	_uvc_mjpeg_read_header(decoder, in, &hdr);
+
+	dinfo->out_color_space = color_space;
+	dinfo->dct_method = JDCT_IFAST;
+	// reduced size IDCT, 1/2 to 1/8 of the coefficients are transformed
+	dinfo->scale_num = 1;
+	dinfo->scale_denom = scale;
 
-	jpeg_start_decompress(&dinfo);
+	jpeg_start_decompress(dinfo);
+
+	// libjpeg rounds the scaled size up, the planner's geometry step rounds down
+	if (UNLIKELY((dinfo->output_width != (in->width + scale - 1) / scale)
+		|| (dinfo->output_height != (in->height + scale - 1) / scale))) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
+	}
 
-	if (LIKELY(dinfo.output_height == out->height)) {
-		for (; dinfo.output_scanline < dinfo.output_height ;) {
-			buffer[0] = data + (lines_read) * out_step;
-			for (i = 1; i < MAX_READLINE; i++)
-				buffer[i] = buffer[i-1] + out_step;
-			num_scanlines = jpeg_read_scanlines(&dinfo, buffer, MAX_READLINE);
-			lines_read += num_scanlines;
+	/* decoded rows go through scratch when repacked or when they are wider than
+	 * out, a last partial row of the scaled image is decoded there and dropped */
+	const int indirect = yuyv || (dinfo->output_width != width);
+	const size_t row_stride = (size_t)dinfo->output_width * dinfo->output_components;
+	if ((indirect || (dinfo->output_height != height))
+		&& UNLIKELY(!_uvc_mjpeg_decoder_rows(decoder, row_stride * MAX_READLINE))) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_NO_MEM;
+	}
+
+	if (row_stats)
+		_uvc_stats_begin(row_stats, out);
+	for (; dinfo->output_scanline < dinfo->output_height ;) {
+		for (i = 0; i < MAX_READLINE; i++) {
+			buffer[i] = indirect || (lines_read + i >= height)
+				? decoder->rows + i * row_stride : data + (lines_read + i) * out_step;
+		}
+		num_scanlines = jpeg_read_scanlines(dinfo, buffer, MAX_READLINE);
+		for (i = 0; i < num_scanlines; i++) {
+			if (lines_read + i >= height)
+				break;
+			uint8_t *row = data + (lines_read + i) * out_step;
+			if (yuyv) {
+				// YCbCr 4:4:4 to YUYV(YUV422), chroma of each pixel pair averaged
+				const uint8_t *ycbcr = buffer[i];
+				uint8_t *d = row;
+				uint32_t x;
+				for (x = 0; x + 1 < width; x += 2, ycbcr += 6, d += 4) {
+					d[0] = ycbcr[0];
+					d[1] = (ycbcr[1] + ycbcr[4]) >> 1;
+					d[2] = ycbcr[3];
+					d[3] = (ycbcr[2] + ycbcr[5]) >> 1;
+				}
+			} else if (indirect) {
+				memcpy(row, buffer[i], row_bytes);
+			}
+			// the scanlines just decoded are still in cache
+			if (row_stats)
+				_uvc_stats_row(row_stats, out, row, lines_read + i);
 		}
-		out->actual_bytes = in->width * in->height * 4;	// XXX
+		lines_read += num_scanlines;
 	}
-	jpeg_finish_decompress(&dinfo);
-	jpeg_destroy_decompress(&dinfo);
-	return lines_read == out->height ? UVC_SUCCESS : UVC_ERROR_OTHER;	// XXX
+	if (row_stats)
+		_uvc_stats_end(row_stats);
+	jpeg_finish_decompress(dinfo);
+	out->actual_bytes = need;	// XXX
+	// filled in by libjpeg, the image is there but not all of it is the frame's
+	return (lines_read >= height) && !decoder->jerr.partial ? UVC_SUCCESS : UVC_ERROR_OTHER;
+}
 
-fail:
-	jpeg_destroy_decompress(&dinfo);
-	return UVC_ERROR_OTHER+1;
+/** @brief Create an MJPEG decoder to keep for the life of a stream
+ * @ingroup frame
+ *
+ * Reusing one decoder saves setting up and tearing down libjpeg for every
+ * frame, and the quantisation and Huffman tables of a frame that repeats the
+ * DQT/DHT segments of the one before are not read again.
+ * A decoder must not be used by two threads at once.
+ *
+ * @return the decoder, NULL when out of memory
+ */
+uvc_mjpeg_decoder_t *uvc_mjpeg_decoder_create(void) {
+	uvc_mjpeg_decoder_t *decoder = malloc(sizeof(*decoder));
+	if (UNLIKELY(decoder && _uvc_mjpeg_decoder_init(decoder))) {
+		free(decoder);
+		decoder = NULL;
+	}
+	return decoder;
 }
 
-static inline unsigned char sat(int i) {
-	return (unsigned char) (i >= 255 ? 255 : (i < 0 ? 0 : i));
+/** @brief Decode an MJPEG frame with a decoder from uvc_mjpeg_decoder_create
+ * @ingroup frame
+ *
+ * @param decoder decoder of the stream
+ * @param in MJPEG frame
+ * @param out frame receiving the image
+ * @param format RGB, BGR, RGBX, RGB565, GRAY8, YUYV, or I420, YV12, NV12 and
+ *        NV21 straight from the decoded planes
+ */
+uvc_error_t uvc_mjpeg_decoder_decode(uvc_mjpeg_decoder_t *decoder,
+	uvc_frame_t *in, uvc_frame_t *out, enum uvc_frame_format format) {
+
+	return _uvc_mjpeg_decoder_decode_stats(decoder, in, out, format, 1, NULL);
 }
 
-#define YCbCr_YUYV_2(YCbCr, yuyv) \
-	{ \
-		*(yuyv++) = *(YCbCr+0); \
-		*(yuyv++) = (*(YCbCr+1) + *(YCbCr+4)) >> 1; \
-		*(yuyv++) = *(YCbCr+3); \
-		*(yuyv++) = (*(YCbCr+2) + *(YCbCr+5)) >> 1; \
-	}
+/** @brief Decode an MJPEG frame at 1/2, 1/4 or 1/8 of its size
+ * @ingroup frame
+ *
+ * libjpeg transforms only the low frequency coefficients (reduced size IDCT)
+ * and colour converts the small image, which is much cheaper than decoding
+ * at full size and downscaling. The output is in->width / scale by
+ * in->height / scale.
+ *
+ * @param decoder decoder of the stream
+ * @param in MJPEG frame
+ * @param out frame receiving the image
+ * @param format RGB, BGR, RGBX, RGB565, GRAY8 or YUYV
+ * @param scale 1, 2, 4 or 8
+ */
+uvc_error_t uvc_mjpeg_decoder_decode_scaled(uvc_mjpeg_decoder_t *decoder,
+	uvc_frame_t *in, uvc_frame_t *out, enum uvc_frame_format format, int scale) {
 
-uvc_error_t uvc_mjpeg2yuyv(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decoder_decode_stats(decoder, in, out, format, scale, NULL);
+}
 
-	out->actual_bytes = 0;	// XXX
-	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
+/** @brief Decode frames with restart markers in bands on several threads
+ * @ingroup frame
+ *
+ * Many cameras put a restart marker (DRI/RSTn) every MCU row or every few.
+ * With threads > 1 a frame is cut into up to threads bands of whole MCU rows
+ * at those markers and the bands are decoded at once, the calling thread
+ * decoding the first one. That cuts the time to decode one frame, where
+ * decoding whole frames on several threads only raises the frame rate.
+ * Frames without restart markers, planar output, and decodes accumulating
+ * statistics are decoded whole as before.
+ *
+ * Rows next to a band edge upsample chroma without the neighbouring band,
+ * which may differ from a whole frame decode by a few levels on 4:2:0.
+ *
+ * @param decoder decoder of the stream, not decoding at the time
+ * @param threads 1 to decode whole frames only, up to 8
+ */
+uvc_error_t uvc_mjpeg_decoder_set_threads(uvc_mjpeg_decoder_t *decoder, int threads) {
+	if (UNLIKELY((threads < 1) || (threads > MAX_BAND_THREADS)))
 		return UVC_ERROR_INVALID_PARAM;
+	if (decoder->bands && (decoder->bands->threads == threads))
+		return UVC_SUCCESS;
+	_uvc_mjpeg_bands_destroy(decoder->bands);
+	decoder->bands = NULL;
+	if (threads > 1) {
+		decoder->bands = _uvc_mjpeg_bands_create(threads);
+		if (UNLIKELY(!decoder->bands))
+			return UVC_ERROR_NO_MEM;
+	}
+	return UVC_SUCCESS;
+}
+
+/** @brief Free a decoder from uvc_mjpeg_decoder_create
+ * @ingroup frame
+ *
+ * @param decoder decoder to free, may be NULL
+ */
+void uvc_mjpeg_decoder_destroy(uvc_mjpeg_decoder_t *decoder) {
+	if (decoder) {
+		_uvc_mjpeg_decoder_term(decoder);
+		free(decoder);
+	}
+}
+
+/** @internal one shot decode with a decoder on the stack */
+static uvc_error_t _uvc_mjpeg_decode_once(uvc_frame_t *in, uvc_frame_t *out,
+	const enum uvc_frame_format format, uvc_frame_stats_t *stats) {
 
-	if (uvc_ensure_frame_size(out, in->width * in->height * 2) < 0)
+	uvc_mjpeg_decoder_t decoder;
+	if (UNLIKELY(_uvc_mjpeg_decoder_init(&decoder)))
 		return UVC_ERROR_NO_MEM;
+	const uvc_error_t result = _uvc_mjpeg_decoder_decode_stats(&decoder, in, out, format, 1, stats);
+	_uvc_mjpeg_decoder_term(&decoder);
+	return result;
+}
 
-	size_t lines_read = 0;
-	int i, j;
-	int num_scanlines;
-	register uint8_t *yuyv, *ycbcr;
-
-	out->width = in->width;
-	out->height = in->height;
-	out->frame_format = UVC_FRAME_FORMAT_YUYV;
-	out->step = in->width * 2;
-	out->sequence = in->sequence;
-	out->capture_time = in->capture_time;
-	out->source = in->source;
+/** @brief Convert an MJPEG frame to RGB
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out RGB frame
+ */
+uvc_error_t uvc_mjpeg2rgb(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_RGB, NULL);
+}
 
-	struct jpeg_decompress_struct dinfo;
-	struct error_mgr jerr;
-	dinfo.err = jpeg_std_error(&jerr.super);
-	jerr.super.error_exit = _error_exit;
+/** @brief Convert an MJPEG frame to GRAY8
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out GRAY8 frame
+ */
+uvc_error_t uvc_mjpeg2gray(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_GRAY8, NULL);
+}
 
-	if (setjmp(jerr.jmp)) {
-		goto fail;
+/** @brief Convert an MJPEG frame to BGR
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out BGR frame
+ */
+uvc_error_t uvc_mjpeg2bgr(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_BGR, NULL);
+}
+
+/** @internal uvc_mjpeg2rgb565 filling stats in the same pass, NULL stats is allowed */
+uvc_error_t _uvc_mjpeg2rgb565_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_RGB565, stats);
+}
+
+/** @brief Convert an MJPEG frame to RGB565
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out RGB frame
+ */
+uvc_error_t uvc_mjpeg2rgb565(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg2rgb565_stats(in, out, NULL);
+}
+
+/** @internal uvc_mjpeg2rgbx filling stats in the same pass, NULL stats is allowed */
+uvc_error_t _uvc_mjpeg2rgbx_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_RGBX, stats);
+}
+
+/** @brief Convert an MJPEG frame to RGBX
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out RGBX frame
+ */
+uvc_error_t uvc_mjpeg2rgbx(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg2rgbx_stats(in, out, NULL);
+}
+
+/** @brief Convert an MJPEG frame to I420(yuv420P) from the decoded planes
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out I420 frame
+ */
+uvc_error_t uvc_mjpeg2yuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_I420, NULL);
+}
+
+/** @brief Convert an MJPEG frame to YV12(iyuv420P) from the decoded planes
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out YV12 frame
+ */
+uvc_error_t uvc_mjpeg2iyuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_YV12, NULL);
+}
+
+/** @brief Convert an MJPEG frame to NV12(yuv420SP) from the decoded planes
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out NV12 frame
+ */
+uvc_error_t uvc_mjpeg2yuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_NV12, NULL);
+}
+
+/** @brief Convert an MJPEG frame to NV21(iyuv420SP) from the decoded planes
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_mjpeg2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_NV21, NULL);
+}
+
+/** @brief Convert an MJPEG frame to YUYV
+ * @ingroup frame
+ *
+ * @param in MJPEG frame
+ * @param out YUYV frame
+ */
+uvc_error_t uvc_mjpeg2yuyv(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_mjpeg_decode_once(in, out, UVC_FRAME_FORMAT_YUYV, NULL);
+}
+
+/** @internal _uvc_mjpeg2gray_scaled with a decoder */
+static uvc_error_t _uvc_mjpeg_decoder_gray(uvc_mjpeg_decoder_t *decoder, uvc_frame_t *in,
+	uint8_t *dst, const size_t step, const uint32_t width, const uint32_t height,
+	const int scale_denom) {
+
+	j_decompress_ptr dinfo = &decoder->dinfo;
+	struct uvc_mjpeg_header hdr;
+	volatile size_t lines_read = 0;	// counted after the setjmp
+	unsigned char *buffer[MAX_READLINE];
+	int num_scanlines, i;
+
+	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(_uvc_mjpeg_validate(in, 0, &hdr)))
+		return UVC_ERROR_OTHER;
+
+	if (setjmp(decoder->jerr.jmp)) {
+		// leaves the object ready for the next frame
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
 	}
 
-	jpeg_create_decompress(&dinfo);
-	jpeg_mem_src(&dinfo, in->data, in->actual_bytes/*in->data_bytes*/);	// XXX
-	jpeg_read_header(&dinfo, TRUE);
+	_uvc_mjpeg_read_header(decoder, in, &hdr);
+
+	dinfo->out_color_space = JCS_GRAYSCALE;
+	dinfo->dct_method = JDCT_IFAST;
+	dinfo->scale_num = 1;
+	dinfo->scale_denom = scale_denom;
+
+	jpeg_start_decompress(dinfo);
 
-	if (dinfo.dc_huff_tbl_ptrs[0] == NULL) {
-		/* This frame is missing the Huffman tables: fill in the standard ones */
-		insert_huff_tables(&dinfo);
+	if (UNLIKELY((dinfo->output_width != width) || (dinfo->output_height != height))) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
 	}
+	for (; dinfo->output_scanline < dinfo->output_height ;) {
+		buffer[0] = dst + lines_read * step;
+		for (i = 1; i < MAX_READLINE; i++)
+			buffer[i] = buffer[i-1] + step;
+		num_scanlines = jpeg_read_scanlines(dinfo, buffer, MAX_READLINE);
+		lines_read += num_scanlines;
+	}
+	jpeg_finish_decompress(dinfo);
+	return lines_read == height ? UVC_SUCCESS : UVC_ERROR_OTHER;
+}
 
-	dinfo.out_color_space = JCS_YCbCr;
-	dinfo.dct_method = JDCT_IFAST;
+/** @internal
+ * decode only the luma of an MJPEG frame, scaled down by scale_denom (1, 2,
+ * 4 or 8) in the IDCT, into dst rows step bytes apart. The chroma
+ * components are entropy decoded but neither transformed nor upsampled.
+ * @param decoder decoder of the stream, NULL to set one up for this frame only
+ * @param width, height expected output size, ceil(input / scale_denom)
+ */
+uvc_error_t _uvc_mjpeg2gray_scaled(uvc_mjpeg_decoder_t *decoder, uvc_frame_t *in,
+	uint8_t *dst, const size_t step, const uint32_t width, const uint32_t height,
+	const int scale_denom) {
+
+	uvc_mjpeg_decoder_t once;
+	if (decoder)
+		return _uvc_mjpeg_decoder_gray(decoder, in, dst, step, width, height, scale_denom);
+	if (UNLIKELY(_uvc_mjpeg_decoder_init(&once)))
+		return UVC_ERROR_NO_MEM;
+	const uvc_error_t result = _uvc_mjpeg_decoder_gray(&once, in, dst, step, width, height, scale_denom);
+	_uvc_mjpeg_decoder_term(&once);
+	return result;
+}
 
-	// start decompressor
-	jpeg_start_decompress(&dinfo);
+/** @internal _uvc_mjpeg_ac_energy with a decoder */
+static uvc_error_t _uvc_mjpeg_decoder_ac_energy(uvc_mjpeg_decoder_t *decoder,
+	uvc_frame_t *in, double *energy) {
 
-	// these dinfo.xxx valiables are only valid after jpeg_start_decompress
-	const int row_stride = dinfo.output_width * dinfo.output_components;
+	j_decompress_ptr dinfo = &decoder->dinfo;
+	struct uvc_mjpeg_header hdr;
+	jvirt_barray_ptr *coefs;
+	JDIMENSION row, col;
+	int k;
+
+	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(_uvc_mjpeg_validate(in, 0, &hdr)))
+		return UVC_ERROR_OTHER;
 
-	// allocate buffer
-	register JSAMPARRAY buffer = (*dinfo.mem->alloc_sarray)
-		((j_common_ptr) &dinfo, JPOOL_IMAGE, row_stride, MAX_READLINE);
+	if (setjmp(decoder->jerr.jmp)) {
+		jpeg_abort_decompress(dinfo);
+		return UVC_ERROR_OTHER;
+	}
 
-	// local copy
-	uint8_t *data = out->data;
-	const int out_step = out->step;
-
-	if (LIKELY(dinfo.output_height == out->height)) {
-		for (; dinfo.output_scanline < dinfo.output_height ;) {
-			// convert lines of mjpeg data to YCbCr
-			num_scanlines = jpeg_read_scanlines(&dinfo, buffer, MAX_READLINE);
-			// convert YCbCr to yuyv(YUV422)
-			for (j = 0; j < num_scanlines; j++) {
-				yuyv = data + (lines_read + j) * out_step;
-				ycbcr = buffer[j];
-				for (i = 0; i < row_stride; i += 24) {	// step by YCbCr x 8 pixels = 3 x 8 bytes
-					YCbCr_YUYV_2(ycbcr + i, yuyv);
-					YCbCr_YUYV_2(ycbcr + i + 6, yuyv);
-					YCbCr_YUYV_2(ycbcr + i + 12, yuyv);
-					YCbCr_YUYV_2(ycbcr + i + 18, yuyv);
-				}
+	_uvc_mjpeg_read_header(decoder, in, &hdr);
+
+	coefs = jpeg_read_coefficients(dinfo);
+	{
+		jpeg_component_info *comp = &dinfo->comp_info[0];
+		const UINT16 *q = comp->quant_table->quantval;
+		float weight[DCTSIZE2];
+		double sum = 0;
+		// natural order, u + v > 1 skips DC and the two lowest AC terms
+		for (k = 0; k < DCTSIZE2; k++)
+			weight[k] = (k / DCTSIZE + k % DCTSIZE > 1) ? (float)q[k] * q[k] : 0.0f;
+		for (row = 0; row < comp->height_in_blocks; row++) {
+			JBLOCKARRAY rows = (*dinfo->mem->access_virt_barray)((j_common_ptr)dinfo, coefs[0], row, 1, FALSE);
+			const JCOEF *c = rows[0][0];
+			float acc = 0;
+			for (col = 0; col < comp->width_in_blocks; col++, c += DCTSIZE2) {
+				for (k = 2; k < DCTSIZE2; k++)
+					acc += weight[k] * c[k] * c[k];
 			}
-			lines_read += num_scanlines;
+			sum += acc;
 		}
-		out->actual_bytes = in->width * in->height * 2;	// XXX
+		*energy = sum / ((double)comp->width_in_blocks * comp->height_in_blocks * DCTSIZE2);
 	}
+	jpeg_finish_decompress(dinfo);
+	return UVC_SUCCESS;
+}
 
-	jpeg_finish_decompress(&dinfo);
-	jpeg_destroy_decompress(&dinfo);
-	return lines_read == out->height ? UVC_SUCCESS : UVC_ERROR_OTHER;
-
-fail:
-	jpeg_destroy_decompress(&dinfo);
-	return lines_read == out->height ? UVC_SUCCESS : UVC_ERROR_OTHER+1;
-}
\ No newline at end of file
+/** @internal
+ * energy per pixel of the luma DCT coefficients above the first diagonal
+ * (u + v > 1), dequantized, read straight from the entropy decoded
+ * coefficients without any IDCT. The chroma components are entropy decoded
+ * as well, libjpeg has no way to skip them.
+ * @param decoder decoder of the stream, NULL to set one up for this frame only
+ */
+uvc_error_t _uvc_mjpeg_ac_energy(uvc_mjpeg_decoder_t *decoder, uvc_frame_t *in, double *energy) {
+	uvc_mjpeg_decoder_t once;
+	if (decoder)
+		return _uvc_mjpeg_decoder_ac_energy(decoder, in, energy);
+	if (UNLIKELY(_uvc_mjpeg_decoder_init(&once)))
+		return UVC_ERROR_NO_MEM;
+	const uvc_error_t result = _uvc_mjpeg_decoder_ac_energy(&once, in, energy);
+	_uvc_mjpeg_decoder_term(&once);
+	return result;
+}
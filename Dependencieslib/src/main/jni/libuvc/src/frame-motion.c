@@ -0,0 +1,211 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Cheap change detector for mostly static scenes: the luma at 1/8 scale is
+ * compared with that of the previous frame by the sum of absolute
+ * differences over a grid of tiles. Averaging 8x8 blocks first keeps sensor
+ * noise well below the tile threshold, and the comparison itself touches
+ * 1/64 of the pixels.
+ *
+ * Raw frames are reduced with the luma pyramid's box filter; MJPEG has
+ * libjpeg decode the luma at 1/8 scale, which is little more than the
+ * entropy decode and the DC coefficients.
+ */
+#include <stdlib.h>
+
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define USE_NEON 1
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define USE_SSE2 1
+#endif
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+#define MOTION_DEFAULT_TILES 8
+#define MOTION_DEFAULT_THRESHOLD 4
+// 1/2, 1/4 and 1/8 scale
+#define MOTION_PYRAMID_LEVELS 3
+
+/** @internal sum of absolute differences of n bytes */
+static inline uint32_t _uvc_sad_row(const uint8_t *a, const uint8_t *b, const int n) {
+	uint32_t sum = 0;
+	int x = 0;
+#if USE_NEON
+	uint32x4_t acc = vdupq_n_u32(0);
+	for (; x + 16 <= n; x += 16)
+		acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x))));
+	const uint64x2_t s = vpaddlq_u32(acc);
+	sum = (uint32_t)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+#elif USE_SSE2
+	__m128i acc = _mm_setzero_si128();
+	for (; x + 16 <= n; x += 16)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + x)),
+			_mm_loadu_si128((const __m128i *)(b + x))));
+	sum = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+	for (; x < n; x++)
+		sum += abs(a[x] - b[x]);
+	return sum;
+}
+
+/** @internal reduce the luma of in to 1/8 scale into thumb
+ * @param decoder decoder kept for MJPEG input, created on first use
+ * @param offset set to the start of the reduced plane in thumb
+ */
+static uvc_error_t _uvc_motion_thumb(uvc_frame_t *in, uvc_frame_t *thumb,
+	uvc_mjpeg_decoder_t **decoder, size_t *offset, uint32_t *width, uint32_t *height) {
+
+#ifdef LIBUVC_HAS_JPEG
+	if (in->frame_format == UVC_FRAME_FORMAT_MJPEG) {
+		const uint32_t w = (in->width + 7) / 8;
+		const uint32_t h = (in->height + 7) / 8;
+		if (UNLIKELY(!w || !h))
+			return UVC_ERROR_INVALID_PARAM;
+		if (UNLIKELY(uvc_ensure_frame_size(thumb, (size_t)w * h) < 0))
+			return UVC_ERROR_NO_MEM;
+		if (!*decoder) {
+			*decoder = uvc_mjpeg_decoder_create();
+			if (UNLIKELY(!*decoder))
+				return UVC_ERROR_NO_MEM;
+		}
+		*offset = 0;
+		*width = w;
+		*height = h;
+		return _uvc_mjpeg2gray_scaled(*decoder, in, thumb->data, w, w, h, 8);
+	}
+#endif
+	uvc_luma_pyramid_t layout;
+	memset(&layout, 0, sizeof(layout));
+	layout.levels = MOTION_PYRAMID_LEVELS;
+	const uvc_error_t result = uvc_luma_pyramid(in, thumb, &layout);
+	if (UNLIKELY(result))
+		return result;
+	// smaller frames stop at a shallower level, still the same one every frame
+	const int level = layout.num_levels - 1;
+	*offset = layout.offset[level];
+	*width = layout.width[level];
+	*height = layout.height[level];
+	return UVC_SUCCESS;
+}
+
+/** @brief Compare the luma of a frame with that of the previous one
+ * @ingroup frame
+ *
+ * Scores every tile of the grid in motion by the mean absolute difference
+ * of the 1/8 scale luma, 0..255, and marks it dirty at or above
+ * motion->tile_threshold. The first frame, and any frame whose size or
+ * format differs from the previous one, resets the detector and reports
+ * every tile dirty.
+ *
+ * @param in YUYV, UYVY, NV12, NV21, I420, YV12, GRAY8 or MJPEG frame
+ * @param motion detector state and settings, zeroed before the first frame
+ */
+uvc_error_t uvc_motion_update(uvc_frame_t *in, uvc_motion_t *motion) {
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (!motion->thumb[i]) {
+			motion->thumb[i] = uvc_allocate_frame(0);
+			if (UNLIKELY(!motion->thumb[i]))
+				return UVC_ERROR_NO_MEM;
+		}
+	}
+
+	const int cur = motion->current ^ 1;
+	uint32_t width, height;
+	const uvc_error_t result = _uvc_motion_thumb(in, motion->thumb[cur], &motion->decoder,
+		&motion->thumb_offset[cur], &width, &height);
+	if (UNLIKELY(result))
+		return result;
+	const int mjpeg = in->frame_format == UVC_FRAME_FORMAT_MJPEG;
+	const int reset = (width != motion->thumb_width) || (height != motion->thumb_height)
+		|| (mjpeg != motion->thumb_mjpeg);
+	motion->current = cur;
+	motion->thumb_width = width;
+	motion->thumb_height = height;
+	motion->thumb_mjpeg = mjpeg;
+
+	int tiles_x = motion->tiles_x ? motion->tiles_x : MOTION_DEFAULT_TILES;
+	int tiles_y = motion->tiles_y ? motion->tiles_y : MOTION_DEFAULT_TILES;
+	if (tiles_x > UVC_MOTION_MAX_TILES)
+		tiles_x = UVC_MOTION_MAX_TILES;
+	if (tiles_y > UVC_MOTION_MAX_TILES)
+		tiles_y = UVC_MOTION_MAX_TILES;
+	// every tile at least one pixel
+	if ((uint32_t)tiles_x > width)
+		tiles_x = width;
+	if ((uint32_t)tiles_y > height)
+		tiles_y = height;
+	motion->tiles_x = tiles_x;
+	motion->tiles_y = tiles_y;
+	motion->sequence = in->sequence;
+	motion->reset = reset;
+
+	const int tiles = tiles_x * tiles_y;
+	if (reset) {
+		for (i = 0; i < tiles; i++)
+			motion->tile_score[i] = 255.0f;
+		motion->score = motion->mean = 255.0f;
+		motion->dirty = tiles < 64 ? ((uint64_t)1 << tiles) - 1 : ~(uint64_t)0;
+		return UVC_SUCCESS;
+	}
+
+	const uint8_t *a = motion->thumb[cur]->data + motion->thumb_offset[cur];
+	const uint8_t *b = motion->thumb[cur ^ 1]->data + motion->thumb_offset[cur ^ 1];
+	const float threshold = motion->tile_threshold ? motion->tile_threshold : MOTION_DEFAULT_THRESHOLD;
+	uint64_t total = 0, dirty = 0;
+	float score = 0;
+	int tx, ty;
+	uint32_t y, y0 = 0;
+	for (ty = 0; ty < tiles_y; ty++) {
+		const uint32_t y1 = (ty + 1) * height / tiles_y;
+		uint32_t x0 = 0;
+		for (tx = 0; tx < tiles_x; tx++) {
+			const uint32_t x1 = (tx + 1) * width / tiles_x;
+			uint32_t sad = 0;
+			for (y = y0; y < y1; y++)
+				sad += _uvc_sad_row(a + (size_t)y * width + x0, b + (size_t)y * width + x0, x1 - x0);
+			const int tile = ty * tiles_x + tx;
+			const float s = (float)sad / ((x1 - x0) * (y1 - y0));
+			motion->tile_score[tile] = s;
+			if (s >= threshold)
+				dirty |= (uint64_t)1 << tile;
+			if (s > score)
+				score = s;
+			total += sad;
+			x0 = x1;
+		}
+		y0 = y1;
+	}
+	motion->score = score;
+	motion->mean = (float)((double)total / ((uint64_t)width * height));
+	motion->dirty = dirty;
+	return UVC_SUCCESS;
+}
+
+/** @brief Free the frames and the MJPEG decoder held by a change detector
+ * @ingroup frame
+ */
+void uvc_motion_release(uvc_motion_t *motion) {
+	int i;
+	for (i = 0; i < 2; i++) {
+		if (motion->thumb[i])
+			uvc_free_frame(motion->thumb[i]);
+		motion->thumb[i] = NULL;
+	}
+#ifdef LIBUVC_HAS_JPEG
+	uvc_mjpeg_decoder_destroy(motion->decoder);
+#endif
+	motion->decoder = NULL;
+	motion->thumb_width = motion->thumb_height = 0;
+}
@@ -0,0 +1,229 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Luma pyramid for analytics consumers: the Y plane at 1/2, 1/4, 1/8 ...
+ * scale, each level a 2x2 box filter of the one above with rounding,
+ * (a + b + c + d + 2) >> 2, on every target.
+ *
+ * The first level is filtered straight from the luma of the packed 4:2:2
+ * or 4:2:0 source, so the full size Y plane is never written. MJPEG has
+ * libjpeg decode the luma component alone at half size, which scales in
+ * the IDCT instead of box filtering.
+ *
+ * All levels go back to back into one GRAY8 frame so a consumer gets them
+ * with a single copy; uvc_luma_pyramid_t says where each level starts.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define USE_NEON 1
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define USE_SSE2 1
+#endif
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+#define PYRAMID_DEFAULT_LEVELS 3
+
+/** @internal
+ * box filter two source rows into one output row of width pixels
+ * @param ps distance between luma samples in bytes, 1 (planar) or 2 (packed 4:2:2)
+ * @param po offset of the first luma sample, 1 for UYVY
+ */
+static inline __attribute__((always_inline))
+void _uvc_box2_row(const uint8_t *s0, const uint8_t *s1, uint8_t *d,
+	const int width, const int ps, const int po) {
+
+	int x = 0;
+#if USE_NEON
+	if (ps == 1) {
+		for (; x + 16 <= width; x += 16) {
+			uint16x8_t lo = vpaddlq_u8(vld1q_u8(s0 + x * 2));
+			uint16x8_t hi = vpaddlq_u8(vld1q_u8(s0 + x * 2 + 16));
+			lo = vpadalq_u8(lo, vld1q_u8(s1 + x * 2));
+			hi = vpadalq_u8(hi, vld1q_u8(s1 + x * 2 + 16));
+			vst1q_u8(d + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+		}
+	} else {
+		for (; x + 16 <= width; x += 16) {
+			const uint8x16x4_t a = vld4q_u8(s0 + x * 4);
+			const uint8x16x4_t b = vld4q_u8(s1 + x * 4);
+			const uint16x8_t lo = vaddq_u16(
+				vaddl_u8(vget_low_u8(a.val[po]), vget_low_u8(a.val[po + 2])),
+				vaddl_u8(vget_low_u8(b.val[po]), vget_low_u8(b.val[po + 2])));
+			const uint16x8_t hi = vaddq_u16(
+				vaddl_u8(vget_high_u8(a.val[po]), vget_high_u8(a.val[po + 2])),
+				vaddl_u8(vget_high_u8(b.val[po]), vget_high_u8(b.val[po + 2])));
+			vst1q_u8(d + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+		}
+	}
+#elif USE_SSE2
+	const __m128i lo = _mm_set1_epi16(0x00ff);
+	const __m128i two = _mm_set1_epi16(2);
+	if (ps == 1) {
+		for (; x + 16 <= width; x += 16) {
+			const __m128i a0 = _mm_loadu_si128((const __m128i *)(s0 + x * 2));
+			const __m128i a1 = _mm_loadu_si128((const __m128i *)(s0 + x * 2 + 16));
+			const __m128i b0 = _mm_loadu_si128((const __m128i *)(s1 + x * 2));
+			const __m128i b1 = _mm_loadu_si128((const __m128i *)(s1 + x * 2 + 16));
+			// even + odd byte of every pair, both rows, 8 sums per register
+			__m128i l = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, lo), _mm_srli_epi16(a0, 8)),
+				_mm_add_epi16(_mm_and_si128(b0, lo), _mm_srli_epi16(b0, 8)));
+			__m128i h = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, lo), _mm_srli_epi16(a1, 8)),
+				_mm_add_epi16(_mm_and_si128(b1, lo), _mm_srli_epi16(b1, 8)));
+			l = _mm_srli_epi16(_mm_add_epi16(l, two), 2);
+			h = _mm_srli_epi16(_mm_add_epi16(h, two), 2);
+			_mm_storeu_si128((__m128i *)(d + x), _mm_packus_epi16(l, h));
+		}
+	} else {
+		const __m128i ones = _mm_set1_epi16(1);
+		for (; x + 8 <= width; x += 8) {
+			const __m128i a0 = _mm_loadu_si128((const __m128i *)(s0 + x * 4));
+			const __m128i a1 = _mm_loadu_si128((const __m128i *)(s0 + x * 4 + 16));
+			const __m128i b0 = _mm_loadu_si128((const __m128i *)(s1 + x * 4));
+			const __m128i b1 = _mm_loadu_si128((const __m128i *)(s1 + x * 4 + 16));
+			// luma as 16 bit lanes, then adjacent lanes summed into 32 bits
+			const __m128i ya0 = po ? _mm_srli_epi16(a0, 8) : _mm_and_si128(a0, lo);
+			const __m128i ya1 = po ? _mm_srli_epi16(a1, 8) : _mm_and_si128(a1, lo);
+			const __m128i yb0 = po ? _mm_srli_epi16(b0, 8) : _mm_and_si128(b0, lo);
+			const __m128i yb1 = po ? _mm_srli_epi16(b1, 8) : _mm_and_si128(b1, lo);
+			const __m128i s_0 = _mm_madd_epi16(_mm_add_epi16(ya0, yb0), ones);
+			const __m128i s_1 = _mm_madd_epi16(_mm_add_epi16(ya1, yb1), ones);
+			const __m128i s = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(s_0, s_1), two), 2);
+			_mm_storel_epi64((__m128i *)(d + x), _mm_packus_epi16(s, s));
+		}
+	}
+#endif
+	for (; x < width; x++) {
+		const int i = x * 2 * ps + po;
+		d[x] = (s0[i] + s0[i + ps] + s1[i] + s1[i + ps] + 2) >> 2;
+	}
+}
+
+/** @internal one pyramid level from two rows of the level or luma plane above */
+static void _uvc_box2(const uint8_t *src, const size_t src_step, uint8_t *dst,
+	const int width, const int height, const int ps, const int po) {
+
+	int y;
+	for (y = 0; y < height; y++, src += src_step * 2, dst += width) {
+		// constant ps/po so each call site gets its own unrolled loop
+		if (ps == 1)
+			_uvc_box2_row(src, src + src_step, dst, width, 1, 0);
+		else if (po)
+			_uvc_box2_row(src, src + src_step, dst, width, 2, 1);
+		else
+			_uvc_box2_row(src, src + src_step, dst, width, 2, 0);
+	}
+}
+
+/** @brief Build a luma pyramid: the Y plane at 1/2, 1/4, 1/8 ... scale
+ * @ingroup frame
+ *
+ * Level i is (level i - 1) / 2 in each direction, rounded down, starting
+ * from the input size / 2 (rounded up for MJPEG). The levels are stored
+ * back to back in out, without padding; out itself describes level 0 as a
+ * GRAY8 frame and its step is always the level 0 width.
+ *
+ * @param in YUYV, UYVY, NV12, NV21, I420, YV12, GRAY8 or MJPEG frame
+ * @param out GRAY8 frame receiving all levels, reused across calls
+ * @param pyramid levels to build and the resulting layout, NULL for 3 levels
+ */
+uvc_error_t uvc_luma_pyramid(uvc_frame_t *in, uvc_frame_t *out, uvc_luma_pyramid_t *pyramid) {
+	uvc_luma_pyramid_t local;
+	int ps = 1, po = 0, i;
+
+	if (!pyramid) {
+		memset(&local, 0, sizeof(local));
+		pyramid = &local;
+	}
+	int levels = pyramid->levels ? pyramid->levels : PYRAMID_DEFAULT_LEVELS;
+	if (levels > UVC_PYRAMID_MAX_LEVELS)
+		levels = UVC_PYRAMID_MAX_LEVELS;
+	pyramid->num_levels = 0;
+
+	switch (in->frame_format) {
+	case UVC_FRAME_FORMAT_YUYV:
+		ps = 2;
+		break;
+	case UVC_FRAME_FORMAT_UYVY:
+		ps = 2;
+		po = 1;
+		break;
+	case UVC_FRAME_FORMAT_NV12:
+	case UVC_FRAME_FORMAT_NV21:
+	case UVC_FRAME_FORMAT_I420:
+	case UVC_FRAME_FORMAT_YV12:
+	case UVC_FRAME_FORMAT_GRAY8:
+		break;
+#ifdef LIBUVC_HAS_JPEG
+	case UVC_FRAME_FORMAT_MJPEG:
+		break;
+#endif
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+
+	const int mjpeg = in->frame_format == UVC_FRAME_FORMAT_MJPEG;
+	const size_t row_bytes = (size_t)in->width * ps;
+	const size_t in_step = in->step ? in->step : row_bytes;
+	if (UNLIKELY(!in->width || !in->height))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(!mjpeg && ((in_step < row_bytes)
+		|| (in->data_bytes < in_step * (in->height - 1) + row_bytes))))
+		return UVC_ERROR_INVALID_PARAM;
+
+	// geometry first, so out is sized once
+	uint32_t w = mjpeg ? (in->width + 1) / 2 : in->width / 2;
+	uint32_t h = mjpeg ? (in->height + 1) / 2 : in->height / 2;
+	size_t total = 0;
+	for (i = 0; (i < levels) && w && h; i++) {
+		pyramid->width[i] = w;
+		pyramid->height[i] = h;
+		pyramid->offset[i] = total;
+		total += (size_t)w * h;
+		w /= 2;
+		h /= 2;
+	}
+	if (UNLIKELY(!i))
+		return UVC_ERROR_INVALID_PARAM;
+	levels = i;
+
+	if (UNLIKELY(uvc_ensure_frame_size(out, total) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	out->width = pyramid->width[0];
+	out->height = pyramid->height[0];
+	out->frame_format = UVC_FRAME_FORMAT_GRAY8;
+	out->step = pyramid->width[0];
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = total;
+
+	uint8_t *data = out->data;
+#ifdef LIBUVC_HAS_JPEG
+	if (mjpeg) {
+		const uvc_error_t result = _uvc_mjpeg2gray_scaled(pyramid->decoder, in, data, pyramid->width[0],
+			pyramid->width[0], pyramid->height[0], 2);
+		if (UNLIKELY(result))
+			return result;
+	} else
+#endif
+	_uvc_box2(in->data, in_step, data, pyramid->width[0], pyramid->height[0], ps, po);
+
+	for (i = 1; i < levels; i++)
+		_uvc_box2(data + pyramid->offset[i - 1], pyramid->width[i - 1],
+			data + pyramid->offset[i], pyramid->width[i], pyramid->height[i], 1, 0);
+
+	pyramid->num_levels = levels;
+	pyramid->sequence = in->sequence;
+	return UVC_SUCCESS;
+}
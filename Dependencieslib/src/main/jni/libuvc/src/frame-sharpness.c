@@ -0,0 +1,168 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Focus score to drop motion blurred or defocused frames before anything
+ * decodes or uploads them: the variance of the Laplacian of the half scale
+ * luma, or for MJPEG the high frequency energy of the luma DCT
+ * coefficients, which needs the entropy decode only. The Laplacian is the
+ * default for MJPEG as well: libjpeg decodes the luma at half scale faster
+ * than it hands out the coefficients of all components.
+ *
+ * Halving first keeps most of the detail the Laplacian responds to while
+ * averaging away much of the sensor noise it would respond to as well.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define USE_NEON 1
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define USE_SSE2 1
+#endif
+
+/** @internal
+ * sum and sum of squares of the Laplacian 4 * c[x] - c[x - 1] - c[x + 1] - p[x] - n[x]
+ * for x = 1 .. width - 2; |L| <= 1020, so 16 bit lanes hold it and 32 bit
+ * lanes the sums of its squares over rows up to 4K pixels
+ */
+static inline void _uvc_laplacian_row(const uint8_t *p, const uint8_t *c, const uint8_t *n,
+	const int width, int64_t *sum, uint64_t *sum2) {
+
+	int32_t s = 0;
+	uint64_t s2 = 0;
+	int x = 1;
+#if USE_NEON
+	int32x4_t vs = vdupq_n_s32(0);
+	uint32x4_t vs2 = vdupq_n_u32(0);
+	for (; x + 8 < width; x += 8) {
+		const int16x8_t cc = vreinterpretq_s16_u16(vshll_n_u8(vld1_u8(c + x), 2));
+		const uint16x8_t around = vaddq_u16(vaddl_u8(vld1_u8(c + x - 1), vld1_u8(c + x + 1)),
+			vaddl_u8(vld1_u8(p + x), vld1_u8(n + x)));
+		const int16x8_t l = vsubq_s16(cc, vreinterpretq_s16_u16(around));
+		vs = vpadalq_s16(vs, l);
+		vs2 = vreinterpretq_u32_s32(vmlal_s16(vreinterpretq_s32_u32(vs2), vget_low_s16(l), vget_low_s16(l)));
+		vs2 = vreinterpretq_u32_s32(vmlal_s16(vreinterpretq_s32_u32(vs2), vget_high_s16(l), vget_high_s16(l)));
+	}
+	s = vgetq_lane_s32(vs, 0) + vgetq_lane_s32(vs, 1) + vgetq_lane_s32(vs, 2) + vgetq_lane_s32(vs, 3);
+	const uint64x2_t s2x2 = vpaddlq_u32(vs2);
+	s2 = vgetq_lane_u64(s2x2, 0) + vgetq_lane_u64(s2x2, 1);
+#elif USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i vs = zero, vs2 = zero;
+	for (; x + 8 < width; x += 8) {
+		const __m128i cc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(c + x)), zero);
+		const __m128i cl = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(c + x - 1)), zero);
+		const __m128i cr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(c + x + 1)), zero);
+		const __m128i pp = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p + x)), zero);
+		const __m128i nn = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(n + x)), zero);
+		const __m128i l = _mm_sub_epi16(_mm_slli_epi16(cc, 2),
+			_mm_add_epi16(_mm_add_epi16(cl, cr), _mm_add_epi16(pp, nn)));
+		vs = _mm_add_epi32(vs, _mm_madd_epi16(l, ones));
+		vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(l, l));
+	}
+	vs = _mm_add_epi32(vs, _mm_srli_si128(vs, 8));
+	vs = _mm_add_epi32(vs, _mm_srli_si128(vs, 4));
+	// widen the squares before adding the lanes up
+	vs2 = _mm_add_epi64(_mm_unpacklo_epi32(vs2, zero), _mm_unpackhi_epi32(vs2, zero));
+	vs2 = _mm_add_epi64(vs2, _mm_srli_si128(vs2, 8));
+	s = _mm_cvtsi128_si32(vs);
+	_mm_storel_epi64((__m128i *)&s2, vs2);
+#endif
+	for (; x < width - 1; x++) {
+		const int l = 4 * c[x] - c[x - 1] - c[x + 1] - p[x] - n[x];
+		s += l;
+		s2 += l * l;
+	}
+	*sum += s;
+	*sum2 += s2;
+}
+
+/** @internal variance of the Laplacian over the interior of a GRAY8 plane */
+static float _uvc_laplacian_variance(const uint8_t *src, const int width, const int height) {
+	int64_t sum = 0;
+	uint64_t sum2 = 0;
+	int y;
+	for (y = 1; y < height - 1; y++) {
+		const uint8_t *c = src + (size_t)y * width;
+		_uvc_laplacian_row(c - width, c, c + width, width, &sum, &sum2);
+	}
+	const double count = (double)(width - 2) * (height - 2);
+	const double mean = sum / count;
+	return (float)(sum2 / count - mean * mean);
+}
+
+/** @brief Focus score of a frame, higher is sharper
+ * @ingroup frame
+ *
+ * Scores only rank frames of the same stream and method: they depend on the
+ * scene as much as on focus and motion blur.
+ *
+ * @param in YUYV, UYVY, NV12, NV21, I420, YV12, GRAY8 or MJPEG frame, at least 6x6
+ * @param sharpness method to use and the resulting score, zeroed before the first frame
+ */
+uvc_error_t uvc_frame_sharpness(uvc_frame_t *in, uvc_sharpness_t *sharpness) {
+	enum uvc_sharpness_method method = sharpness->method;
+	uvc_error_t result;
+
+	if (method == UVC_SHARPNESS_AUTO)
+		method = UVC_SHARPNESS_LAPLACIAN;
+#ifdef LIBUVC_HAS_JPEG
+	if ((in->frame_format == UVC_FRAME_FORMAT_MJPEG) && !sharpness->decoder) {
+		sharpness->decoder = uvc_mjpeg_decoder_create();
+		if (UNLIKELY(!sharpness->decoder))
+			return UVC_ERROR_NO_MEM;
+	}
+	if (method == UVC_SHARPNESS_DCT) {
+		double energy;
+		if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_MJPEG))
+			return UVC_ERROR_INVALID_PARAM;
+		result = _uvc_mjpeg_ac_energy(sharpness->decoder, in, &energy);
+		if (UNLIKELY(result))
+			return result;
+		sharpness->score = (float)energy;
+	} else
+#endif
+	if (method == UVC_SHARPNESS_LAPLACIAN) {
+		uvc_luma_pyramid_t layout;
+		if (!sharpness->luma) {
+			sharpness->luma = uvc_allocate_frame(0);
+			if (UNLIKELY(!sharpness->luma))
+				return UVC_ERROR_NO_MEM;
+		}
+		memset(&layout, 0, sizeof(layout));
+		layout.levels = 1;
+		layout.decoder = sharpness->decoder;
+		result = uvc_luma_pyramid(in, sharpness->luma, &layout);
+		if (UNLIKELY(result))
+			return result;
+		if (UNLIKELY((layout.width[0] < 3) || (layout.height[0] < 3)))
+			return UVC_ERROR_INVALID_PARAM;
+		sharpness->score = _uvc_laplacian_variance(sharpness->luma->data, layout.width[0], layout.height[0]);
+	} else
+		return UVC_ERROR_NOT_SUPPORTED;
+
+	sharpness->used = method;
+	sharpness->sequence = in->sequence;
+	return UVC_SUCCESS;
+}
+
+/** @brief Free the frame and the MJPEG decoder held by a focus scorer
+ * @ingroup frame
+ */
+void uvc_sharpness_release(uvc_sharpness_t *sharpness) {
+	if (sharpness->luma)
+		uvc_free_frame(sharpness->luma);
+	sharpness->luma = NULL;
+#ifdef LIBUVC_HAS_JPEG
+	uvc_mjpeg_decoder_destroy(sharpness->decoder);
+#endif
+	sharpness->decoder = NULL;
+}
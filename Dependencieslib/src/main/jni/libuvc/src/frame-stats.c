@@ -0,0 +1,252 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Frame statistics for software auto exposure and scene detection:
+ * per-channel histograms (R, G, B and BT.601 luma), from which mean, min,
+ * max and the clipped pixel counts are derived, and the mean luma of a
+ * zone grid.
+ *
+ * The preview kernels call _uvc_stats_row() on each output row right after
+ * writing it, while it is still in L1, so the statistics cost no memory
+ * traffic of their own; uvc_frame_stats() runs the same accumulator over a
+ * finished frame for everything else. The histogram updates are the cost
+ * that remains, which uvc_frame_stats_t.step cuts by sampling.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+/** @internal luma of full range RGB, the inverse of the YUV->RGB factors */
+#define STATS_LUMA(r, g, b) ((77 * (r) + 150 * (g) + 29 * (b) + 128) >> 8)
+
+static inline int _uvc_stats_is_rgb(const enum uvc_frame_format format) {
+	switch (format) {
+	case UVC_FRAME_FORMAT_RGBX:
+	case UVC_FRAME_FORMAT_RGB:
+	case UVC_FRAME_FORMAT_BGR:
+	case UVC_FRAME_FORMAT_RGB565:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/** @internal
+ * accumulate n 8 bit RGB pixels stride bytes apart
+ * @return luma sum of the segment
+ */
+static inline __attribute__((always_inline))
+uint32_t _uvc_stats_rgb(uvc_frame_stats_t *stats, const uint8_t *p, const int n,
+	const int stride, const int ro, const int go, const int bo) {
+
+	uint32_t *hr = stats->histogram[UVC_STATS_R];
+	uint32_t *hg = stats->histogram[UVC_STATS_G];
+	uint32_t *hb = stats->histogram[UVC_STATS_B];
+	uint32_t *hy = stats->histogram[UVC_STATS_Y];
+	uint32_t sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++, p += stride) {
+		const int r = p[ro], g = p[go], b = p[bo];
+		const int y = STATS_LUMA(r, g, b);
+		hr[r]++;
+		hg[g]++;
+		hb[b]++;
+		hy[y]++;
+		sum += y;
+	}
+	return sum;
+}
+
+/** @internal little endian RGB565, channels expanded to 8 bits */
+static uint32_t _uvc_stats_rgb565(uvc_frame_stats_t *stats, const uint8_t *p, const int n, const int stride) {
+	uint32_t *hr = stats->histogram[UVC_STATS_R];
+	uint32_t *hg = stats->histogram[UVC_STATS_G];
+	uint32_t *hb = stats->histogram[UVC_STATS_B];
+	uint32_t *hy = stats->histogram[UVC_STATS_Y];
+	uint32_t sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++, p += stride) {
+		const int v = p[0] | (p[1] << 8);
+		const int r5 = v >> 11, g6 = (v >> 5) & 0x3f, b5 = v & 0x1f;
+		const int r = (r5 << 3) | (r5 >> 2), g = (g6 << 2) | (g6 >> 4), b = (b5 << 3) | (b5 >> 2);
+		const int y = STATS_LUMA(r, g, b);
+		hr[r]++;
+		hg[g]++;
+		hb[b]++;
+		hy[y]++;
+		sum += y;
+	}
+	return sum;
+}
+
+/** @internal n luma samples stride bytes apart */
+static inline __attribute__((always_inline))
+uint32_t _uvc_stats_luma(uvc_frame_stats_t *stats, const uint8_t *p, const int n, const int stride) {
+	uint32_t *hy = stats->histogram[UVC_STATS_Y];
+	uint32_t sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++, p += stride) {
+		hy[*p]++;
+		sum += *p;
+	}
+	return sum;
+}
+
+/** @internal accumulate n sampled pixels from column x, @return luma sum */
+static uint32_t _uvc_stats_segment(uvc_frame_stats_t *stats, const enum uvc_frame_format format,
+	const uint8_t *row, const int x, const int n, const int step) {
+
+	switch (format) {
+	case UVC_FRAME_FORMAT_RGBX:
+		return _uvc_stats_rgb(stats, row + x * 4, n, step * 4, 0, 1, 2);
+	case UVC_FRAME_FORMAT_RGB:
+		return _uvc_stats_rgb(stats, row + x * 3, n, step * 3, 0, 1, 2);
+	case UVC_FRAME_FORMAT_BGR:
+		return _uvc_stats_rgb(stats, row + x * 3, n, step * 3, 2, 1, 0);
+	case UVC_FRAME_FORMAT_RGB565:
+		return _uvc_stats_rgb565(stats, row + x * 2, n, step * 2);
+	case UVC_FRAME_FORMAT_YUYV:
+		return _uvc_stats_luma(stats, row + x * 2, n, step * 2);
+	case UVC_FRAME_FORMAT_UYVY:
+		return _uvc_stats_luma(stats, row + x * 2 + 1, n, step * 2);
+	default:
+		// GRAY8 and the luma plane of the 4:2:0 formats
+		return _uvc_stats_luma(stats, row + x, n, step);
+	}
+}
+
+/** @internal
+ * reset the results for an output frame whose width, height, format and
+ * sequence are already set
+ */
+void _uvc_stats_begin(uvc_frame_stats_t *stats, const uvc_frame_t *frame) {
+	if (stats->zones_x > UVC_STATS_MAX_ZONES)
+		stats->zones_x = UVC_STATS_MAX_ZONES;
+	if (stats->zones_y > UVC_STATS_MAX_ZONES)
+		stats->zones_y = UVC_STATS_MAX_ZONES;
+	if (!stats->zones_x || !stats->zones_y)
+		stats->zones_x = stats->zones_y = 0;
+	if (!stats->step)
+		stats->step = 1;
+	stats->rgb = _uvc_stats_is_rgb(frame->frame_format);
+	stats->sequence = frame->sequence;
+	stats->width = frame->width;
+	stats->height = frame->height;
+	stats->pixels = 0;
+	memset(stats->histogram, 0, sizeof(stats->histogram));
+	memset(stats->zone_sum, 0, sizeof(stats->zone_sum));
+	memset(stats->zone_pixels, 0, sizeof(stats->zone_pixels));
+}
+
+/** @internal accumulate output row y of frame */
+void _uvc_stats_row(uvc_frame_stats_t *stats, const uvc_frame_t *frame, const uint8_t *row, const uint32_t y) {
+	const int step = stats->step;
+	const int width = stats->width;
+	const int zones_x = stats->zones_x;
+
+	if (UNLIKELY((y >= stats->height) || (y % step)))
+		return;
+	if (zones_x) {
+		const int first = (y * stats->zones_y / stats->height) * zones_x;
+		int z, x0 = 0;
+		for (z = 0; z < zones_x; z++) {
+			// sampled columns are the multiples of step within [x0, x1)
+			const int x1 = (z + 1) * width / zones_x;
+			const int xs = (x0 + step - 1) / step * step;
+			const int n = x1 > xs ? (x1 - xs + step - 1) / step : 0;
+			stats->zone_sum[first + z] += _uvc_stats_segment(stats, frame->frame_format, row, xs, n, step);
+			stats->zone_pixels[first + z] += n;
+			stats->pixels += n;
+			x0 = x1;
+		}
+	} else {
+		const int n = (width + step - 1) / step;
+		_uvc_stats_segment(stats, frame->frame_format, row, 0, n, step);
+		stats->pixels += n;
+	}
+}
+
+/** @internal derive means, min/max, clipped counts and zone means from the accumulators */
+void _uvc_stats_end(uvc_frame_stats_t *stats) {
+	int c, i;
+
+	for (c = 0; c < UVC_STATS_CHANNELS; c++) {
+		const uint32_t *h = stats->histogram[c];
+		uint64_t sum = 0;
+		int lo = -1, hi = 0;
+		for (i = 0; i < 256; i++) {
+			if (h[i]) {
+				if (lo < 0)
+					lo = i;
+				hi = i;
+				sum += (uint64_t)h[i] * i;
+			}
+		}
+		stats->min[c] = lo < 0 ? 0 : lo;
+		stats->max[c] = hi;
+		stats->mean[c] = stats->pixels ? (float)sum / stats->pixels : 0;
+		stats->clipped_low[c] = h[0];
+		stats->clipped_high[c] = h[255];
+	}
+
+	for (i = 0; i < stats->zones_x * stats->zones_y; i++)
+		stats->zone_mean[i] = stats->zone_pixels[i] ? (float)stats->zone_sum[i] / stats->zone_pixels[i] : 0;
+}
+
+/** @brief Compute the statistics of a frame in one pass
+ * @ingroup frame
+ *
+ * uvc_convert() fills the same structure while converting when
+ * uvc_convert_opts_t.stats is set, which is cheaper than calling this on
+ * its output. Set zones_x, zones_y and step before the call.
+ *
+ * @param frame RGBX, RGB, BGR, RGB565, YUYV, UYVY, GRAY8 or 4:2:0 (luma only) frame
+ * @param stats statistics to fill
+ */
+uvc_error_t uvc_frame_stats(uvc_frame_t *frame, uvc_frame_stats_t *stats) {
+	int bpp;
+	switch (frame->frame_format) {
+	case UVC_FRAME_FORMAT_RGBX:
+		bpp = 4;
+		break;
+	case UVC_FRAME_FORMAT_RGB:
+	case UVC_FRAME_FORMAT_BGR:
+		bpp = 3;
+		break;
+	case UVC_FRAME_FORMAT_RGB565:
+	case UVC_FRAME_FORMAT_YUYV:
+	case UVC_FRAME_FORMAT_UYVY:
+		bpp = 2;
+		break;
+	case UVC_FRAME_FORMAT_GRAY8:
+	case UVC_FRAME_FORMAT_NV12:
+	case UVC_FRAME_FORMAT_NV21:
+	case UVC_FRAME_FORMAT_I420:
+	case UVC_FRAME_FORMAT_YV12:
+		bpp = 1;
+		break;
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+
+	const size_t row_bytes = (size_t)frame->width * bpp;
+	const size_t step = frame->step ? frame->step : row_bytes;
+	if (UNLIKELY(!frame->width || !frame->height || (step < row_bytes)
+		|| (frame->data_bytes < step * (frame->height - 1) + row_bytes)))
+		return UVC_ERROR_INVALID_PARAM;
+
+	const uint8_t *row = frame->data;
+	uint32_t y;
+	_uvc_stats_begin(stats, frame);
+	for (y = 0; y < frame->height; y += stats->step, row += step * stats->step)
+		_uvc_stats_row(stats, frame, row, y);
+	_uvc_stats_end(stats);
+	return UVC_SUCCESS;
+}
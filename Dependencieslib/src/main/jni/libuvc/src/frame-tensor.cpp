@@ -0,0 +1,409 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Crop, resize and normalise regions of a camera frame into fixed size
+ * tensors for recognition models, e.g. the head/body boxes the NPU reports.
+ *
+ * Every tensor row blends the two source rows it falls between over just
+ * the columns the box needs (a plain loop that gcc and clang vectorise),
+ * then samples that blended row bilinearly at precomputed columns,
+ * converts YUV to RGB at the sample and maps each 8 bit channel through a
+ * 256 entry table that holds the normalised value already in the output
+ * type. No RGB image or per-box bitmap is ever made, and the result does
+ * not depend on the SIMD width. The per-sample pass stays scalar: every
+ * sample gathers from its own taps and three tables, which NEON can only do
+ * one lane at a time.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+#include "frame-layouts.h"
+
+namespace {
+
+using namespace uvc_layout;
+
+/** @internal one horizontal sample: source columns relative to the
+ * blended segment and the weight of the second in 1/256 */
+struct Tap {
+	int32_t x0, x1, f;
+};
+
+static inline int lerp(const int a, const int b, const int f) {
+	return (a * (256 - f) + b * f + 128) >> 8;
+}
+
+template<class M>
+static inline void yuv2rgb(const int y, const int u, const int v, int &r, int &g, int &b) {
+	r = clamp255(y + ((M::RV * (v - 128)) >> 14));
+	g = clamp255(y + ((M::GU * (u - 128) + M::GV * (v - 128)) >> 14));
+	b = clamp255(y + ((M::BU * (u - 128)) >> 14));
+}
+
+/** @internal packed 8 bit RGB sources */
+template<class Src>
+struct SampleRgb {
+	static const int pixel_bytes = Src::pixel_bytes;
+	static const int align = 1;
+	static const bool chroma_plane = false;
+
+	static inline void rgb(const uint8_t *row, const uint8_t *, const Tap &t, int &r, int &g, int &b) {
+		const uint8_t *p0 = row + t.x0 * pixel_bytes;
+		const uint8_t *p1 = row + t.x1 * pixel_bytes;
+		r = lerp(p0[Src::r], p1[Src::r], t.f);
+		g = lerp(p0[Src::g], p1[Src::g], t.f);
+		b = lerp(p0[Src::b], p1[Src::b], t.f);
+	}
+};
+
+/** @internal packed 4:2:2, chroma of the macro pixel each column lies in */
+template<class Src>
+struct SampleYuv422 {
+	static const int pixel_bytes = 2;
+	static const int align = 2;
+	static const bool chroma_plane = false;
+
+	static inline const uint8_t *macro(const uint8_t *row, const int x) {
+		return row + (x >> 1) * 4;
+	}
+
+	static inline void rgb(const uint8_t *row, const uint8_t *, const Tap &t, int &r, int &g, int &b) {
+		const uint8_t *m0 = macro(row, t.x0);
+		const uint8_t *m1 = macro(row, t.x1);
+		const int y = lerp(m0[t.x0 & 1 ? Src::y1 : Src::y0], m1[t.x1 & 1 ? Src::y1 : Src::y0], t.f);
+		yuv2rgb<Bt601Full>(y, lerp(m0[Src::u], m1[Src::u], t.f), lerp(m0[Src::v], m1[Src::v], t.f), r, g, b);
+	}
+};
+
+/** @internal NV12, interleaved chroma row blended separately */
+struct SampleNv12 {
+	static const int pixel_bytes = 1;
+	static const int align = 2;
+	static const bool chroma_plane = true;
+
+	static inline void rgb(const uint8_t *row, const uint8_t *crow, const Tap &t, int &r, int &g, int &b) {
+		const uint8_t *c0 = crow + (t.x0 & ~1);
+		const uint8_t *c1 = crow + (t.x1 & ~1);
+		yuv2rgb<Bt601Full>(lerp(row[t.x0], row[t.x1], t.f),
+			lerp(c0[0], c1[0], t.f), lerp(c0[1], c1[1], t.f), r, g, b);
+	}
+};
+
+struct SampleGray {
+	static const int pixel_bytes = 1;
+	static const int align = 1;
+	static const bool chroma_plane = false;
+
+	static inline void rgb(const uint8_t *row, const uint8_t *, const Tap &t, int &r, int &g, int &b) {
+		r = g = b = lerp(row[t.x0], row[t.x1], t.f);
+	}
+};
+
+/** @internal blend two source rows, weight f of b in 1/256 */
+static void blend_rows(const uint8_t *__restrict a, const uint8_t *__restrict b,
+	uint8_t *__restrict d, const int bytes, const int f) {
+
+	if (!f) {
+		memcpy(d, a, bytes);
+		return;
+	}
+	const int f0 = 256 - f;
+	for (int i = 0; i < bytes; i++)
+		d[i] = (a[i] * f0 + b[i] * f + 128) >> 8;
+}
+
+/** @internal source position of output sample i in 16.16 fixed point, pixel
+ * centres aligned, clamped to [0, size - 1]; origin may be negative */
+static inline int64_t source_pos(const int32_t origin, const int64_t step, const int i, const int size) {
+	int64_t s = (int64_t)origin * 65536 + i * step + step / 2 - 32768;
+	if (s < 0)
+		s = 0;
+	if (s > ((int64_t)(size - 1) << 16))
+		s = (int64_t)(size - 1) << 16;
+	return s;
+}
+
+static inline void split_pos(const int64_t s, const int size, int &p0, int &p1, int &f) {
+	p0 = (int)(s >> 16);
+	f = (int)((s >> 8) & 0xff);
+	p1 = p0 + 1 < size ? p0 + 1 : p0;
+	if (p1 == p0)
+		f = 0;
+}
+
+/** @internal source geometry */
+struct Source {
+	const uint8_t *plane;
+	const uint8_t *chroma;	// NV12 only
+	size_t step;
+	int width, height;
+};
+
+/** @internal one box into one tensor */
+template<class S, typename E>
+void box_tensor(const Source &src, const uvc_rect_t &box, const uvc_tensor_opts_t *opts,
+	const E (*lut)[256], E *out, Tap *taps, uint8_t *row, uint8_t *crow) {
+
+	const int W = opts->width, H = opts->height;
+	const int64_t step_x = ((int64_t)box.width << 16) / W;
+	const int64_t step_y = ((int64_t)box.height << 16) / H;
+	int xmin = src.width, xmax = 0;
+
+	for (int x = 0; x < W; x++) {
+		split_pos(source_pos(box.x, step_x, x, src.width), src.width, taps[x].x0, taps[x].x1, taps[x].f);
+		if (taps[x].x0 < xmin)
+			xmin = taps[x].x0;
+		if (taps[x].x1 > xmax)
+			xmax = taps[x].x1;
+	}
+	// blend only the columns the taps touch, whole macro pixels for 4:2:x
+	const int xs = xmin & ~(S::align - 1);
+	const int xe = (xmax + S::align) & ~(S::align - 1);
+	for (int x = 0; x < W; x++) {
+		taps[x].x0 -= xs;
+		taps[x].x1 -= xs;
+	}
+	const int seg = (xe - xs) * S::pixel_bytes;
+
+	// element strides of the R, G, B outputs
+	const size_t pixel_stride = opts->layout == UVC_TENSOR_CHW ? 1 : 3;
+	const size_t channel_stride = opts->layout == UVC_TENSOR_CHW ? (size_t)W * H : 1;
+	const size_t row_stride = (size_t)W * pixel_stride;
+	E *const oc[3] = {
+		out + channel_stride * (opts->bgr ? 2 : 0),
+		out + channel_stride,
+		out + channel_stride * (opts->bgr ? 0 : 2),
+	};
+
+	for (int y = 0; y < H; y++) {
+		const int64_t sy = source_pos(box.y, step_y, y, src.height);
+		int y0, y1, fy;
+		split_pos(sy, src.height, y0, y1, fy);
+		blend_rows(src.plane + src.step * y0 + xs * S::pixel_bytes,
+			src.plane + src.step * y1 + xs * S::pixel_bytes, row, seg, fy);
+		if (S::chroma_plane) {
+			// chroma sample centres sit between two luma rows
+			const int ch = (src.height + 1) / 2;
+			int64_t cy = (sy >> 1) - 16384;
+			if (cy < 0)
+				cy = 0;
+			int c0, c1, fc;
+			split_pos(cy, ch, c0, c1, fc);
+			blend_rows(src.chroma + src.step * c0 + xs, src.chroma + src.step * c1 + xs, crow, xe - xs, fc);
+		}
+		const size_t o = row_stride * y;
+		for (int x = 0; x < W; x++) {
+			int r, g, b;
+			S::rgb(row, crow, taps[x], r, g, b);
+			oc[0][o + x * pixel_stride] = lut[0][r];
+			oc[1][o + x * pixel_stride] = lut[1][g];
+			oc[2][o + x * pixel_stride] = lut[2][b];
+		}
+	}
+}
+
+/** @internal IEEE 754 binary16 of v, round to nearest even */
+static uint16_t to_half(const float v) {
+	union { uint32_t u; float f; } f, magic;
+	const uint32_t f16max = (127u + 16) << 23;
+	magic.u = ((127u - 15) + (23 - 10) + 1) << 23;
+	f.f = v;
+	const uint32_t sign = f.u & 0x80000000u;
+	uint16_t o;
+	f.u ^= sign;
+	if (f.u >= f16max) {
+		o = f.u > (255u << 23) ? 0x7e00 : 0x7c00;	// NaN / overflow to infinity
+	} else if (f.u < (113u << 23)) {
+		f.f += magic.f;		// subnormal, the FPU rounds
+		o = (uint16_t)(f.u - magic.u);
+	} else {
+		const uint32_t odd = (f.u >> 13) & 1;
+		f.u += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+		o = (uint16_t)(f.u >> 13);
+	}
+	return o | (uint16_t)(sign >> 16);
+}
+
+template<typename E>
+static inline E quantize(const float v);
+
+template<>
+inline uint8_t quantize<uint8_t>(const float v) {
+	const long q = lrintf(v);
+	return q < 0 ? 0 : (q > 255 ? 255 : q);
+}
+
+template<>
+inline int8_t quantize<int8_t>(const float v) {
+	const long q = lrintf(v);
+	return q < -128 ? -128 : (q > 127 ? 127 : q);
+}
+
+template<>
+inline uint16_t quantize<uint16_t>(const float v) {
+	return to_half(v);
+}
+
+template<>
+inline float quantize<float>(const float v) {
+	return v;
+}
+
+template<class S, typename E>
+uvc_error_t tensors(const Source &src, const uvc_rect_t *boxes, const int num_boxes,
+	const uvc_tensor_opts_t *opts, void *out) {
+
+	E lut[3][256];
+	for (int c = 0; c < 3; c++)
+		for (int i = 0; i < 256; i++)
+			lut[c][i] = quantize<E>((i - opts->mean[c]) * opts->scale[c]);
+
+	// taps, the blended row and the blended chroma row
+	const size_t row_bytes = (size_t)src.width * S::pixel_bytes;
+	uint8_t *scratch = static_cast<uint8_t *>(_uvc_frame_scratch(sizeof(Tap) * opts->width + row_bytes * 2));
+	if (UNLIKELY(!scratch))
+		return UVC_ERROR_NO_MEM;
+	Tap *taps = reinterpret_cast<Tap *>(scratch);
+	uint8_t *row = scratch + sizeof(Tap) * opts->width;
+
+	const size_t elements = (size_t)opts->width * opts->height * 3;
+	for (int i = 0; i < num_boxes; i++)
+		box_tensor<S, E>(src, boxes[i], opts, lut, static_cast<E *>(out) + elements * i, taps, row, row + row_bytes);
+	return UVC_SUCCESS;
+}
+
+template<class S>
+uvc_error_t dispatch_type(const Source &src, const uvc_rect_t *boxes, const int num_boxes,
+	const uvc_tensor_opts_t *opts, void *out) {
+
+	switch (opts->type) {
+	case UVC_TENSOR_UINT8:
+		return tensors<S, uint8_t>(src, boxes, num_boxes, opts, out);
+	case UVC_TENSOR_INT8:
+		return tensors<S, int8_t>(src, boxes, num_boxes, opts, out);
+	case UVC_TENSOR_FLOAT16:
+		return tensors<S, uint16_t>(src, boxes, num_boxes, opts, out);
+	case UVC_TENSOR_FLOAT32:
+		return tensors<S, float>(src, boxes, num_boxes, opts, out);
+	default:
+		return UVC_ERROR_INVALID_PARAM;
+	}
+}
+
+static size_t element_bytes(const enum uvc_tensor_type type) {
+	switch (type) {
+	case UVC_TENSOR_UINT8:
+	case UVC_TENSOR_INT8:
+		return 1;
+	case UVC_TENSOR_FLOAT16:
+		return 2;
+	case UVC_TENSOR_FLOAT32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+}	// namespace
+
+/** @brief Size of one tensor written by uvc_frame_tensors
+ * @ingroup frame
+ *
+ * @return bytes per box, 0 when opts is invalid
+ */
+extern "C" size_t uvc_tensor_bytes(const uvc_tensor_opts_t *opts) {
+	return (size_t)opts->width * opts->height * 3 * element_bytes(opts->type);
+}
+
+/** @brief Crop, resize and normalise regions of a frame into tensors
+ * @ingroup frame
+ *
+ * Each box is resampled bilinearly to opts->width x opts->height, converted
+ * to RGB and normalised as opts describes, into consecutive tensors of
+ * uvc_tensor_bytes(opts) bytes. Boxes much larger than the tensor are
+ * point sampled between the bilinear taps, so pick a pyramid level or a
+ * downscaled frame as input for those.
+ *
+ * @param in RGBX, RGB, BGR, YUYV, UYVY, NV12 or GRAY8 frame
+ * @param boxes regions of in, clamped at its edges
+ * @param num_boxes number of boxes
+ * @param opts tensor shape and normalisation
+ * @param out num_boxes tensors
+ * @param out_bytes size of out, at least num_boxes * uvc_tensor_bytes(opts)
+ */
+extern "C" uvc_error_t uvc_frame_tensors(uvc_frame_t *in, const uvc_rect_t *boxes, int num_boxes,
+	const uvc_tensor_opts_t *opts, void *out, size_t out_bytes) {
+
+	const size_t tensor_bytes = uvc_tensor_bytes(opts);
+	if (UNLIKELY(!tensor_bytes || (num_boxes < 0) || (out_bytes < tensor_bytes * num_boxes)
+		|| ((opts->layout != UVC_TENSOR_HWC) && (opts->layout != UVC_TENSOR_CHW))))
+		return UVC_ERROR_INVALID_PARAM;
+	for (int i = 0; i < num_boxes; i++) {
+		if (UNLIKELY(!boxes[i].width || !boxes[i].height))
+			return UVC_ERROR_INVALID_PARAM;
+	}
+
+	int pixel_bytes;
+	switch (in->frame_format) {
+	case UVC_FRAME_FORMAT_RGBX:
+		pixel_bytes = 4;
+		break;
+	case UVC_FRAME_FORMAT_RGB:
+	case UVC_FRAME_FORMAT_BGR:
+		pixel_bytes = 3;
+		break;
+	case UVC_FRAME_FORMAT_YUYV:
+	case UVC_FRAME_FORMAT_UYVY:
+		pixel_bytes = 2;
+		break;
+	case UVC_FRAME_FORMAT_NV12:
+	case UVC_FRAME_FORMAT_GRAY8:
+		pixel_bytes = 1;
+		break;
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+
+	const int nv12 = in->frame_format == UVC_FRAME_FORMAT_NV12;
+	const int subsampled = nv12 || (pixel_bytes == 2);
+	Source src;
+	src.width = in->width;
+	src.height = in->height;
+	src.step = in->step ? in->step : (size_t)in->width * pixel_bytes;
+	const size_t need = nv12
+		? src.step * in->height + src.step * ((in->height + 1) / 2)
+		: src.step * (in->height - 1) + (size_t)in->width * pixel_bytes;
+	if (UNLIKELY(!in->width || !in->height || (subsampled && (in->width & 1))
+		|| (src.step < (size_t)in->width * pixel_bytes) || (in->data_bytes < need)))
+		return UVC_ERROR_INVALID_PARAM;
+	src.plane = static_cast<const uint8_t *>(in->data);
+	src.chroma = nv12 ? src.plane + src.step * in->height : NULL;
+
+	if (!num_boxes)
+		return UVC_SUCCESS;
+
+	switch (in->frame_format) {
+	case UVC_FRAME_FORMAT_RGBX:
+		return dispatch_type<SampleRgb<Rgbx> >(src, boxes, num_boxes, opts, out);
+	case UVC_FRAME_FORMAT_RGB:
+		return dispatch_type<SampleRgb<Rgb> >(src, boxes, num_boxes, opts, out);
+	case UVC_FRAME_FORMAT_BGR:
+		return dispatch_type<SampleRgb<Bgr> >(src, boxes, num_boxes, opts, out);
+	case UVC_FRAME_FORMAT_YUYV:
+		return dispatch_type<SampleYuv422<Yuyv> >(src, boxes, num_boxes, opts, out);
+	case UVC_FRAME_FORMAT_UYVY:
+		return dispatch_type<SampleYuv422<Uyvy> >(src, boxes, num_boxes, opts, out);
+	case UVC_FRAME_FORMAT_NV12:
+		return dispatch_type<SampleNv12>(src, boxes, num_boxes, opts, out);
+	default:
+		return dispatch_type<SampleGray>(src, boxes, num_boxes, opts, out);
+	}
+}
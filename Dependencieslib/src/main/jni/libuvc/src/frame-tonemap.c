@@ -0,0 +1,377 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Tone mapping of the 16-bit formats (GRAY16, and the luma of P010 whose
+ * 10 significant bits sit in the top of each little endian word) down to
+ * GRAY8, RGBX or NV21.
+ *
+ * The linear window is applied with a single unsigned 16x16 high multiply
+ * per sample: the window is normalised by a left shift so that the
+ * multiplier always fits 16 bits. Percentile mode fuses a 1024 bin
+ * histogram into the mapping pass and maps with the window found on the
+ * previous frame of the same opts, so a stream pays one pass per frame;
+ * only the first frame (or a one-shot call with NULL opts) pre-scans.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define USE_NEON 1
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define USE_SSE2 1
+#endif
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+#define HIST_BITS 10
+#define HIST_BINS (1 << HIST_BITS)
+#define HIST_SHIFT (16 - HIST_BITS)
+
+/** @internal per call mapping parameters */
+typedef struct _tonemap_state {
+	uint16_t low;
+	uint16_t range;		// high - low, >= 1
+	int shift;			// (v - low) << shift keeps range << shift in [32768, 65535]
+	uint16_t mul;		// ceil(255 * 65536 / (range << shift))
+	const uint8_t *lut;
+	int lut_shift;
+} tonemap_state_t;
+
+static void _uvc_tonemap_set_window(tonemap_state_t *st, uint16_t low, uint16_t high) {
+	if (high <= low) {
+		if (low == 0xffff)
+			low--;
+		high = low + 1;
+	}
+	st->low = low;
+	st->range = high - low;
+	st->shift = 0;
+	while (((uint32_t)st->range << st->shift) < 32768)
+		st->shift++;
+	// rounded up, so truncating the product never loses more than the fraction
+	const uint32_t norm = (uint32_t)st->range << st->shift;
+	st->mul = (uint16_t)((255u * 65536u + norm - 1) / norm);
+}
+
+/** @internal map one row of 16-bit samples to 8 bits, optionally accumulating a histogram */
+static void _uvc_tonemap_row(const uint16_t *src, uint8_t *dst, const int width,
+	const tonemap_state_t *st, uint32_t *hist) {
+
+	int x = 0;
+	if (st->lut) {
+		for (; x < width; x++)
+			dst[x] = st->lut[src[x] >> st->lut_shift];
+	} else {
+#if USE_NEON
+		const uint16x8_t low = vdupq_n_u16(st->low);
+		const uint16x8_t range = vdupq_n_u16(st->range);
+		const int16x8_t shift = vdupq_n_s16(st->shift);
+		const uint16x4_t mul = vdup_n_u16(st->mul);
+		for (; x + 8 <= width; x += 8) {
+			uint16x8_t v = vminq_u16(vqsubq_u16(vld1q_u16(src + x), low), range);
+			v = vshlq_u16(v, shift);
+			const uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(v), mul), 16);
+			const uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(v), mul), 16);
+			vst1_u8(dst + x, vqmovn_u16(vcombine_u16(lo, hi)));
+		}
+#elif USE_SSE2
+		const __m128i low = _mm_set1_epi16((short)st->low);
+		const __m128i range = _mm_set1_epi16((short)st->range);
+		const __m128i shift = _mm_cvtsi32_si128(st->shift);
+		const __m128i mul = _mm_set1_epi16((short)st->mul);
+		for (; x + 16 <= width; x += 16) {
+			__m128i v0 = _mm_subs_epu16(_mm_loadu_si128((const __m128i *)(src + x)), low);
+			__m128i v1 = _mm_subs_epu16(_mm_loadu_si128((const __m128i *)(src + x + 8)), low);
+			// unsigned min(v, range) = v - sat(v - range)
+			v0 = _mm_sub_epi16(v0, _mm_subs_epu16(v0, range));
+			v1 = _mm_sub_epi16(v1, _mm_subs_epu16(v1, range));
+			v0 = _mm_mulhi_epu16(_mm_sll_epi16(v0, shift), mul);
+			v1 = _mm_mulhi_epu16(_mm_sll_epi16(v1, shift), mul);
+			_mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(v0, v1));
+		}
+#endif
+		for (; x < width; x++) {
+			uint32_t v = src[x] > st->low ? src[x] - st->low : 0;
+			if (v > st->range)
+				v = st->range;
+			v = ((v << st->shift) * st->mul) >> 16;
+			dst[x] = v > 255 ? 255 : (uint8_t)v;
+		}
+	}
+	if (hist) {
+		for (x = 0; x < width; x++)
+			hist[src[x] >> HIST_SHIFT]++;
+	}
+}
+
+/** @internal find the window that clips low/high per-mille of the histogram */
+static void _uvc_tonemap_percentile(const uint32_t *hist, const uint32_t total,
+	const int low_permille, const int high_permille, uint16_t *low, uint16_t *high) {
+
+	const uint64_t low_count = (uint64_t)total * low_permille / 1000;
+	const uint64_t high_count = (uint64_t)total * (1000 - high_permille) / 1000;
+	uint64_t sum = 0;
+	int i;
+	for (i = 0; i < HIST_BINS - 1; i++) {
+		sum += hist[i];
+		if (sum > low_count)
+			break;
+	}
+	*low = (uint16_t)(i << HIST_SHIFT);
+	sum = 0;
+	for (i = HIST_BINS - 1; i > 0; i--) {
+		sum += hist[i];
+		if (sum > high_count)
+			break;
+	}
+	*high = (uint16_t)((i << HIST_SHIFT) + (1 << HIST_SHIFT) - 1);
+}
+
+/** @internal expand a row of gray to RGBX */
+static void _uvc_gray2rgbx_row(const uint8_t *g, uint8_t *dst, const int width) {
+	int x = 0;
+#if USE_NEON
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t px;
+		px.val[0] = px.val[1] = px.val[2] = vld1q_u8(g + x);
+		px.val[3] = vdupq_n_u8(0xff);
+		vst4q_u8(dst + x * 4, px);
+	}
+#elif USE_SSE2
+	const __m128i ff = _mm_set1_epi8(-1);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(g + x));
+		const __m128i gg_lo = _mm_unpacklo_epi8(v, v);
+		const __m128i gg_hi = _mm_unpackhi_epi8(v, v);
+		const __m128i gx_lo = _mm_unpacklo_epi8(v, ff);
+		const __m128i gx_hi = _mm_unpackhi_epi8(v, ff);
+		_mm_storeu_si128((__m128i *)(dst + x * 4), _mm_unpacklo_epi16(gg_lo, gx_lo));
+		_mm_storeu_si128((__m128i *)(dst + x * 4 + 16), _mm_unpackhi_epi16(gg_lo, gx_lo));
+		_mm_storeu_si128((__m128i *)(dst + x * 4 + 32), _mm_unpacklo_epi16(gg_hi, gx_hi));
+		_mm_storeu_si128((__m128i *)(dst + x * 4 + 48), _mm_unpackhi_epi16(gg_hi, gx_hi));
+	}
+#endif
+	for (; x < width; x++) {
+		dst[x * 4 + 0] = dst[x * 4 + 1] = dst[x * 4 + 2] = g[x];
+		dst[x * 4 + 3] = 0xff;
+	}
+}
+
+static inline uint8_t sat8(int i) {
+	return (uint8_t)(i >= 255 ? 255 : (i < 0 ? 0 : i));
+}
+
+/** @internal mapped luma + one row of P010 chroma (16-bit U, V pairs) to RGBX, same matrix as frame.c */
+static void _uvc_p010_rgbx_row(const uint8_t *y8, const uint16_t *uv, uint8_t *dst, const int width) {
+	int x;
+	for (x = 0; x < width; x += 2) {
+		const int u = (uv[x] >> 8) - 128;
+		const int v = (uv[x + 1] >> 8) - 128;
+		const int dr = (22987 * v) >> 14;
+		const int dg = (-5636 * u - 11698 * v) >> 14;
+		const int db = (29049 * u) >> 14;
+		int i;
+		for (i = 0; i < 2 && x + i < width; i++) {
+			const int yy = y8[x + i];
+			uint8_t *p = dst + (x + i) * 4;
+			p[0] = sat8(yy + dr);
+			p[1] = sat8(yy + dg);
+			p[2] = sat8(yy + db);
+			p[3] = 0xff;
+		}
+	}
+}
+
+/** @brief Tone map a GRAY16 or P010 frame to 8 bits
+ * @ingroup frame
+ *
+ * @param in GRAY16 or P010 frame
+ * @param out GRAY8, RGBX or NV21 frame
+ * @param out_format UVC_FRAME_FORMAT_GRAY8, UVC_FRAME_FORMAT_RGBX or UVC_FRAME_FORMAT_NV21
+ * @param opts mapping options, NULL for a one-shot 1%..99% percentile window.
+ *        In UVC_TONEMAP_PERCENTILE mode the window of this frame is stored back
+ *        into opts->window_low/high and used for the next frame.
+ */
+uvc_error_t uvc_tonemap(uvc_frame_t *in, uvc_frame_t *out,
+	enum uvc_frame_format out_format, uvc_tonemap_opts_t *opts) {
+
+	uvc_tonemap_opts_t one_shot;
+	tonemap_state_t st;
+	uint32_t hist[HIST_BINS];
+	uint32_t *phist = NULL;
+
+	const int p010 = in->frame_format == UVC_FRAME_FORMAT_P010;
+	if (UNLIKELY(!p010 && (in->frame_format != UVC_FRAME_FORMAT_GRAY16)))
+		return UVC_ERROR_INVALID_PARAM;
+	const int width = in->width;
+	const int height = in->height;
+	const size_t in_step = in->step ? in->step : (size_t)width * 2;
+	if (UNLIKELY(!width || !height || (in_step < (size_t)width * 2)
+		|| (p010 && ((width & 1) || (height & 1)))
+		|| (in->data_bytes < in_step * height + (p010 ? in_step * height / 2 : 0))))
+		return UVC_ERROR_INVALID_PARAM;
+
+	if (!opts) {
+		memset(&one_shot, 0, sizeof(one_shot));
+		one_shot.mode = UVC_TONEMAP_PERCENTILE;
+		one_shot.low_permille = 10;
+		one_shot.high_permille = 990;
+		opts = &one_shot;
+	}
+
+	size_t out_step;
+	switch (out_format) {
+	case UVC_FRAME_FORMAT_GRAY8:
+		out_step = width;
+		break;
+	case UVC_FRAME_FORMAT_RGBX:
+		out_step = (size_t)width * 4;
+		break;
+	case UVC_FRAME_FORMAT_NV21:
+		if (UNLIKELY((width & 1) || (height & 1)))
+			return UVC_ERROR_INVALID_PARAM;
+		out_step = width;
+		break;
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+	if (!out->library_owns_data && out->step)
+		out_step = out->step;
+	const size_t need = out_step * height + (out_format == UVC_FRAME_FORMAT_NV21 ? out_step * height / 2 : 0);
+	if (UNLIKELY(uvc_ensure_frame_size(out, need) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	memset(&st, 0, sizeof(st));
+	switch (opts->mode) {
+	case UVC_TONEMAP_LUT:
+		if (UNLIKELY(!opts->lut || (opts->lut_bits < 1) || (opts->lut_bits > 16)))
+			return UVC_ERROR_INVALID_PARAM;
+		st.lut = opts->lut;
+		st.lut_shift = 16 - opts->lut_bits;
+		break;
+	case UVC_TONEMAP_PERCENTILE:
+		memset(hist, 0, sizeof(hist));
+		phist = hist;
+		if (opts->window_high <= opts->window_low) {
+			// nothing from a previous frame yet, scan this one first
+			int y, x;
+			for (y = 0; y < height; y++) {
+				const uint16_t *row = (const uint16_t *)((const uint8_t *)in->data + in_step * y);
+				for (x = 0; x < width; x++)
+					hist[row[x] >> HIST_SHIFT]++;
+			}
+			_uvc_tonemap_percentile(hist, (uint32_t)width * height,
+				opts->low_permille, opts->high_permille, &opts->window_low, &opts->window_high);
+			phist = NULL;
+		}
+		_uvc_tonemap_set_window(&st, opts->window_low, opts->window_high);
+		break;
+	default:
+		_uvc_tonemap_set_window(&st, opts->window_low, opts->window_high);
+		break;
+	}
+
+	out->width = width;
+	out->height = height;
+	out->frame_format = out_format;
+	out->step = out_step;
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = need;
+
+	uint8_t *row8 = NULL;
+	if (out_format == UVC_FRAME_FORMAT_RGBX) {
+		row8 = _uvc_frame_scratch(width);
+		if (UNLIKELY(!row8))
+			return UVC_ERROR_NO_MEM;
+	}
+	const uint8_t *src = in->data;
+	const uint8_t *src_uv = src + in_step * height;
+	uint8_t *dst = out->data;
+	int y, x;
+	for (y = 0; y < height; y++) {
+		const uint16_t *row = (const uint16_t *)(src + in_step * y);
+		uint8_t *d = dst + out_step * y;
+		if (out_format == UVC_FRAME_FORMAT_RGBX) {
+			_uvc_tonemap_row(row, row8, width, &st, phist);
+			if (p010)
+				_uvc_p010_rgbx_row(row8, (const uint16_t *)(src_uv + in_step * (y / 2)), d, width);
+			else
+				_uvc_gray2rgbx_row(row8, d, width);
+		} else {
+			_uvc_tonemap_row(row, d, width, &st, phist);
+		}
+	}
+
+	if (out_format == UVC_FRAME_FORMAT_NV21) {
+		uint8_t *vu = dst + out_step * height;
+		for (y = 0; y < height / 2; y++, vu += out_step) {
+			if (p010) {
+				const uint16_t *uv = (const uint16_t *)(src_uv + in_step * y);
+				for (x = 0; x < width; x += 2) {
+					vu[x] = uv[x + 1] >> 8;
+					vu[x + 1] = uv[x] >> 8;
+				}
+			} else {
+				memset(vu, 128, width);
+			}
+		}
+	}
+
+	if (phist) {
+		// window for the next frame of this stream
+		_uvc_tonemap_percentile(hist, (uint32_t)width * height,
+			opts->low_permille, opts->high_permille, &opts->window_low, &opts->window_high);
+	}
+	return UVC_SUCCESS;
+}
+
+/** @brief Convert a GRAY16 frame to GRAY8 with a one-shot percentile window
+ * @ingroup frame
+ */
+uvc_error_t uvc_gray16_2gray8(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_tonemap(in, out, UVC_FRAME_FORMAT_GRAY8, NULL);
+}
+
+/** @brief Convert a GRAY16 frame to RGBX with a one-shot percentile window
+ * @ingroup frame
+ */
+uvc_error_t uvc_gray16_2rgbx(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_tonemap(in, out, UVC_FRAME_FORMAT_RGBX, NULL);
+}
+
+/** @brief Convert a GRAY16 frame to NV21 with a one-shot percentile window
+ * @ingroup frame
+ */
+uvc_error_t uvc_gray16_2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_tonemap(in, out, UVC_FRAME_FORMAT_NV21, NULL);
+}
+
+/** @brief Convert a P010 frame to GRAY8 with a one-shot percentile window
+ * @ingroup frame
+ */
+uvc_error_t uvc_p010_2gray8(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_tonemap(in, out, UVC_FRAME_FORMAT_GRAY8, NULL);
+}
+
+/** @brief Convert a P010 frame to RGBX with a one-shot percentile window
+ * @ingroup frame
+ */
+uvc_error_t uvc_p010_2rgbx(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_tonemap(in, out, UVC_FRAME_FORMAT_RGBX, NULL);
+}
+
+/** @brief Convert a P010 frame to NV21 with a one-shot percentile window
+ * @ingroup frame
+ */
+uvc_error_t uvc_p010_2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return uvc_tonemap(in, out, UVC_FRAME_FORMAT_NV21, NULL);
+}
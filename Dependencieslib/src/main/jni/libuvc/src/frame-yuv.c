@@ -0,0 +1,813 @@
+/*********************************************************************
+ * Software License Agreement (BSD License), see frame.c
+ *********************************************************************/
+/**
+ * @file
+ * @ingroup frame
+ */
+/*
+ * Conversion into the 4:2:0 planar / semi-planar family.
+ * Naming follows the older helpers in frame.c:
+ *   yuv420P   = I420 (Y plane, U plane, V plane)
+ *   iyuv420P  = YV12 (Y plane, V plane, U plane)
+ *   yuv420SP  = NV12 (Y plane, interleaved UV)
+ *   iyuv420SP = NV21 (Y plane, interleaved VU)
+ *
+ * Chroma is produced from each 2x2 block; packed 4:2:2 sources already
+ * carry one chroma pair per two pixels, so the two rows are averaged
+ * vertically with rounding. A trailing odd row is paired with itself.
+ * Output step is the luma stride; for frames the library does not own the
+ * caller's step is honoured and the chroma planes follow at step*height.
+ *
+ * NV12 sources are also expanded to RGBX / RGB565 / YUYV here, with each
+ * chroma sample computed once and shared by the two luma rows it covers.
+ */
+#include "libuvc/libuvc.h"
+#include "libuvc/libuvc_internal.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define USE_NEON 1
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+	#define USE_SSE2 1
+#endif
+
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
+/** @internal plane pointers of a 4:2:0 output frame */
+typedef struct _yuv420_planes {
+	uint8_t *y;
+	uint8_t *u;		// U plane (planar) / interleaved chroma (semi-planar)
+	uint8_t *v;		// V plane (planar) / unused (semi-planar)
+	int y_stride;
+	int c_stride;
+} yuv420_planes_t;
+
+/** @internal
+ * validate the input, size the output and set its header fields
+ * @param semi non-zero for NV12/NV21 layout
+ */
+static uvc_error_t _uvc_prepare_yuv420(uvc_frame_t *in, uvc_frame_t *out,
+	enum uvc_frame_format out_format, const int semi, yuv420_planes_t *planes) {
+
+	const int width = in->width;
+	const int height = in->height;
+	const size_t in_need = in->frame_format == UVC_FRAME_FORMAT_NV12
+		? (size_t)in->step * height + (size_t)in->step * ((height + 1) / 2)
+		: (size_t)in->step * height;
+
+	if (UNLIKELY(!width || !height || (width & 1)
+		|| (in->step < (size_t)(in->frame_format == UVC_FRAME_FORMAT_NV12 ? width : width * 2))
+		|| (in->data_bytes < in_need)))
+		return UVC_ERROR_INVALID_PARAM;
+
+	const int y_stride = out->library_owns_data || !out->step ? width : (int)out->step;
+	if (UNLIKELY(y_stride < width))
+		return UVC_ERROR_INVALID_PARAM;
+	const int c_stride = semi ? y_stride : y_stride / 2;
+	const int ch = (height + 1) / 2;
+	const size_t need = (size_t)y_stride * height + (size_t)c_stride * ch * (semi ? 1 : 2);
+
+	if (UNLIKELY(uvc_ensure_frame_size(out, need) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	out->width = width;
+	out->height = height;
+	out->frame_format = out_format;
+	out->step = y_stride;
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = need;
+
+	planes->y = out->data;
+	planes->u = planes->y + (size_t)y_stride * height;
+	planes->v = semi ? NULL : planes->u + (size_t)c_stride * ch;
+	planes->y_stride = y_stride;
+	planes->c_stride = c_stride;
+
+	return UVC_SUCCESS;
+}
+
+/** @internal
+ * split a pair of packed 4:2:2 rows into two luma rows and one row of
+ * vertically averaged chroma.
+ * @param uyvy 0: YUYV, 1: UYVY
+ * @param pv NULL for interleaved (semi-planar) output into pu
+ * @param swap_uv for semi-planar output, write VU (NV21) instead of UV (NV12)
+ */
+static inline __attribute__((always_inline))
+void _uvc_packed422_rows(const uint8_t *s0, const uint8_t *s1,
+	uint8_t *y0, uint8_t *y1, uint8_t *pu, uint8_t *pv,
+	const int width, const int uyvy, const int swap_uv) {
+
+	int x = 0;
+#if USE_NEON
+	const int yi = uyvy ? 1 : 0;	// index of the first luma lane
+	const int ui = uyvy ? 0 : 1;	// index of the U lane
+	for (; x + 32 <= width; x += 32) {
+		const uint8x16x4_t a = vld4q_u8(s0 + x * 2);
+		const uint8x16x4_t b = vld4q_u8(s1 + x * 2);
+		uint8x16x2_t ya, yb;
+		ya.val[0] = a.val[yi]; ya.val[1] = a.val[yi + 2];
+		yb.val[0] = b.val[yi]; yb.val[1] = b.val[yi + 2];
+		vst2q_u8(y0 + x, ya);
+		vst2q_u8(y1 + x, yb);
+		const uint8x16_t u = vrhaddq_u8(a.val[ui], b.val[ui]);
+		const uint8x16_t v = vrhaddq_u8(a.val[ui + 2], b.val[ui + 2]);
+		if (pv) {
+			vst1q_u8(pu + x / 2, u);
+			vst1q_u8(pv + x / 2, v);
+		} else {
+			uint8x16x2_t c;
+			c.val[0] = swap_uv ? v : u;
+			c.val[1] = swap_uv ? u : v;
+			vst2q_u8(pu + x, c);
+		}
+	}
+#elif USE_SSE2
+	const __m128i lo = _mm_set1_epi16(0x00ff);
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 16 <= width; x += 16) {
+		const __m128i a0 = _mm_loadu_si128((const __m128i *)(s0 + x * 2));
+		const __m128i a1 = _mm_loadu_si128((const __m128i *)(s0 + x * 2 + 16));
+		const __m128i b0 = _mm_loadu_si128((const __m128i *)(s1 + x * 2));
+		const __m128i b1 = _mm_loadu_si128((const __m128i *)(s1 + x * 2 + 16));
+		__m128i ya, yb, ca, cb;
+		if (uyvy) {
+			ya = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+			yb = _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8));
+			ca = _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(a1, lo));
+			cb = _mm_packus_epi16(_mm_and_si128(b0, lo), _mm_and_si128(b1, lo));
+		} else {
+			ya = _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(a1, lo));
+			yb = _mm_packus_epi16(_mm_and_si128(b0, lo), _mm_and_si128(b1, lo));
+			ca = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8));
+			cb = _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8));
+		}
+		_mm_storeu_si128((__m128i *)(y0 + x), ya);
+		_mm_storeu_si128((__m128i *)(y1 + x), yb);
+		// c = u0 v0 u1 v1 ... (8 chroma pairs)
+		const __m128i c = _mm_avg_epu8(ca, cb);
+		if (pv) {
+			_mm_storel_epi64((__m128i *)(pu + x / 2), _mm_packus_epi16(_mm_and_si128(c, lo), zero));
+			_mm_storel_epi64((__m128i *)(pv + x / 2), _mm_packus_epi16(_mm_srli_epi16(c, 8), zero));
+		} else if (swap_uv) {
+			_mm_storeu_si128((__m128i *)(pu + x), _mm_or_si128(_mm_slli_epi16(c, 8), _mm_srli_epi16(c, 8)));
+		} else {
+			_mm_storeu_si128((__m128i *)(pu + x), c);
+		}
+	}
+#endif
+	const int yo = uyvy ? 1 : 0;
+	const int uo = uyvy ? 0 : 1;
+	for (; x < width; x += 2) {
+		const uint8_t *a = s0 + x * 2;
+		const uint8_t *b = s1 + x * 2;
+		y0[x] = a[yo]; y0[x + 1] = a[yo + 2];
+		y1[x] = b[yo]; y1[x + 1] = b[yo + 2];
+		const uint8_t u = (a[uo] + b[uo] + 1) >> 1;
+		const uint8_t v = (a[uo + 2] + b[uo + 2] + 1) >> 1;
+		if (pv) {
+			pu[x / 2] = u;
+			pv[x / 2] = v;
+		} else {
+			pu[x] = swap_uv ? v : u;
+			pu[x + 1] = swap_uv ? u : v;
+		}
+	}
+}
+
+/** @internal
+ * copy / reorder one row of NV12 interleaved chroma
+ * @param pv NULL for interleaved output into pu
+ * @param width luma width (= bytes of interleaved chroma)
+ */
+static inline __attribute__((always_inline))
+void _uvc_nv12_chroma_row(const uint8_t *src, uint8_t *pu, uint8_t *pv,
+	const int width, const int swap_uv) {
+
+	int x = 0;
+	if (!pv && !swap_uv) {
+		memcpy(pu, src, width);
+		return;
+	}
+#if USE_NEON
+	for (; x + 32 <= width; x += 32) {
+		uint8x16x2_t c = vld2q_u8(src + x);
+		if (pv) {
+			vst1q_u8(pu + x / 2, c.val[0]);
+			vst1q_u8(pv + x / 2, c.val[1]);
+		} else {
+			const uint8x16_t t = c.val[0];
+			c.val[0] = c.val[1];
+			c.val[1] = t;
+			vst2q_u8(pu + x, c);
+		}
+	}
+#elif USE_SSE2
+	const __m128i lo = _mm_set1_epi16(0x00ff);
+	for (; x + 32 <= width; x += 32) {
+		const __m128i c0 = _mm_loadu_si128((const __m128i *)(src + x));
+		const __m128i c1 = _mm_loadu_si128((const __m128i *)(src + x + 16));
+		if (pv) {
+			_mm_storeu_si128((__m128i *)(pu + x / 2),
+				_mm_packus_epi16(_mm_and_si128(c0, lo), _mm_and_si128(c1, lo)));
+			_mm_storeu_si128((__m128i *)(pv + x / 2),
+				_mm_packus_epi16(_mm_srli_epi16(c0, 8), _mm_srli_epi16(c1, 8)));
+		} else {
+			_mm_storeu_si128((__m128i *)(pu + x), _mm_or_si128(_mm_slli_epi16(c0, 8), _mm_srli_epi16(c0, 8)));
+			_mm_storeu_si128((__m128i *)(pu + x + 16), _mm_or_si128(_mm_slli_epi16(c1, 8), _mm_srli_epi16(c1, 8)));
+		}
+	}
+#endif
+	for (; x < width; x += 2) {
+		if (pv) {
+			pu[x / 2] = src[x];
+			pv[x / 2] = src[x + 1];
+		} else {
+			pu[x] = src[x + 1];
+			pu[x + 1] = src[x];
+		}
+	}
+}
+
+/** @internal
+ * packed 4:2:2 (YUYV/UYVY) to any member of the 4:2:0 family
+ * @param swap_uv planar: V plane first (YV12), semi-planar: VU order (NV21)
+ */
+static inline __attribute__((always_inline))
+uvc_error_t _uvc_packed422_to_420(uvc_frame_t *in, uvc_frame_t *out,
+	const enum uvc_frame_format in_format, const enum uvc_frame_format out_format,
+	const int semi, const int swap_uv) {
+
+	yuv420_planes_t p;
+	uvc_error_t ret;
+
+	if (UNLIKELY(in->frame_format != in_format))
+		return UVC_ERROR_INVALID_PARAM;
+	ret = _uvc_prepare_yuv420(in, out, out_format, semi, &p);
+	if (UNLIKELY(ret))
+		return ret;
+
+	const int uyvy = in_format == UVC_FRAME_FORMAT_UYVY;
+	const int width = in->width;
+	const int height = in->height;
+	const size_t src_step = in->step;
+	const uint8_t *src = in->data;
+	uint8_t *pu = semi ? p.u : (swap_uv ? p.v : p.u);
+	uint8_t *pv = semi ? NULL : (swap_uv ? p.u : p.v);
+	int h;
+	for (h = 0; h < height; h += 2) {
+		const uint8_t *s0 = src + src_step * h;
+		const uint8_t *s1 = h + 1 < height ? s0 + src_step : s0;
+		uint8_t *y0 = p.y + (size_t)p.y_stride * h;
+		uint8_t *y1 = h + 1 < height ? y0 + p.y_stride : y0;
+		const size_t c_offset = (size_t)p.c_stride * (h / 2);
+		_uvc_packed422_rows(s0, s1, y0, y1, pu + c_offset, pv ? pv + c_offset : NULL,
+			width, uyvy, semi && swap_uv);
+	}
+	return UVC_SUCCESS;
+}
+
+/** @internal
+ * NV12 to any member of the 4:2:0 family (no resampling needed)
+ */
+static inline __attribute__((always_inline))
+uvc_error_t _uvc_nv12_to_420(uvc_frame_t *in, uvc_frame_t *out,
+	const enum uvc_frame_format out_format, const int semi, const int swap_uv) {
+
+	yuv420_planes_t p;
+	uvc_error_t ret;
+
+	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_NV12))
+		return UVC_ERROR_INVALID_PARAM;
+	ret = _uvc_prepare_yuv420(in, out, out_format, semi, &p);
+	if (UNLIKELY(ret))
+		return ret;
+
+	const int width = in->width;
+	const int height = in->height;
+	const size_t src_step = in->step;
+	const uint8_t *src_y = in->data;
+	const uint8_t *src_uv = src_y + src_step * height;
+	uint8_t *pu = semi ? p.u : (swap_uv ? p.v : p.u);
+	uint8_t *pv = semi ? NULL : (swap_uv ? p.u : p.v);
+	int h;
+	for (h = 0; h < height; h++)
+		memcpy(p.y + (size_t)p.y_stride * h, src_y + src_step * h, width);
+	for (h = 0; h < (height + 1) / 2; h++) {
+		const size_t c_offset = (size_t)p.c_stride * h;
+		_uvc_nv12_chroma_row(src_uv + src_step * h, pu + c_offset, pv ? pv + c_offset : NULL,
+			width, semi && swap_uv);
+	}
+	return UVC_SUCCESS;
+}
+
+/** @brief Convert a frame from YUYV to I420(yuv420P)
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out I420 frame
+ */
+uvc_error_t uvc_yuyv2yuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_YUYV, UVC_FRAME_FORMAT_I420, 0, 0);
+}
+
+/** @brief Convert a frame from YUYV to YV12(iyuv420P)
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out YV12 frame
+ */
+uvc_error_t uvc_yuyv2iyuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_YUYV, UVC_FRAME_FORMAT_YV12, 0, 1);
+}
+
+/** @brief Convert a frame from YUYV to NV12(yuv420SP)
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out NV12 frame
+ */
+uvc_error_t uvc_yuyv2yuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_YUYV, UVC_FRAME_FORMAT_NV12, 1, 0);
+}
+
+/** @brief Convert a frame from YUYV to NV21(iyuv420SP)
+ * @ingroup frame
+ *
+ * @param in YUYV frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_yuyv2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_YUYV, UVC_FRAME_FORMAT_NV21, 1, 1);
+}
+
+/** @brief Convert a frame from UYVY to I420(yuv420P)
+ * @ingroup frame
+ *
+ * @param in UYVY frame
+ * @param out I420 frame
+ */
+uvc_error_t uvc_uyvy2yuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_UYVY, UVC_FRAME_FORMAT_I420, 0, 0);
+}
+
+/** @brief Convert a frame from UYVY to YV12(iyuv420P)
+ * @ingroup frame
+ *
+ * @param in UYVY frame
+ * @param out YV12 frame
+ */
+uvc_error_t uvc_uyvy2iyuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_UYVY, UVC_FRAME_FORMAT_YV12, 0, 1);
+}
+
+/** @brief Convert a frame from UYVY to NV12(yuv420SP)
+ * @ingroup frame
+ *
+ * @param in UYVY frame
+ * @param out NV12 frame
+ */
+uvc_error_t uvc_uyvy2yuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_UYVY, UVC_FRAME_FORMAT_NV12, 1, 0);
+}
+
+/** @brief Convert a frame from UYVY to NV21(iyuv420SP)
+ * @ingroup frame
+ *
+ * @param in UYVY frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_uyvy2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_packed422_to_420(in, out, UVC_FRAME_FORMAT_UYVY, UVC_FRAME_FORMAT_NV21, 1, 1);
+}
+
+/** @brief Convert a frame from NV12 to I420(yuv420P)
+ * @ingroup frame
+ *
+ * @param in NV12 frame
+ * @param out I420 frame
+ */
+uvc_error_t uvc_nv12_2yuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_nv12_to_420(in, out, UVC_FRAME_FORMAT_I420, 0, 0);
+}
+
+/** @brief Convert a frame from NV12 to YV12(iyuv420P)
+ * @ingroup frame
+ *
+ * @param in NV12 frame
+ * @param out YV12 frame
+ */
+uvc_error_t uvc_nv12_2iyuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_nv12_to_420(in, out, UVC_FRAME_FORMAT_YV12, 0, 1);
+}
+
+/** @brief Convert a frame from NV12 to NV21(iyuv420SP)
+ * @ingroup frame
+ *
+ * @param in NV12 frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_nv12_2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_nv12_to_420(in, out, UVC_FRAME_FORMAT_NV21, 1, 1);
+}
+
+/** @internal packed outputs of the NV12 expanders */
+enum _nv12_packed_kind {
+	NV12_PACKED_RGBX,
+	NV12_PACKED_RGB565,
+	NV12_PACKED_YUYV,
+};
+
+static inline uint8_t _uvc_sat8(const int i) {
+	return i < 0 ? 0 : (i > 255 ? 255 : i);
+}
+
+/** @internal
+ * store one scalar pixel; chroma offsets use the fixed point factors of
+ * frame.c, the green term is floored per component like the SIMD paths
+ */
+static inline __attribute__((always_inline))
+void _uvc_nv12_put_pixel(uint8_t *d, const int y, const int r, const int g, const int b,
+	const enum _nv12_packed_kind kind) {
+
+	const uint8_t rr = _uvc_sat8(y + r);
+	const uint8_t gg = _uvc_sat8(y + g);
+	const uint8_t bb = _uvc_sat8(y + b);
+	if (kind == NV12_PACKED_RGBX) {
+		d[0] = rr;
+		d[1] = gg;
+		d[2] = bb;
+		d[3] = 0xff;
+	} else {
+		d[0] = ((gg << 3) & 0xe0) | (bb >> 3);
+		d[1] = (rr & 0xf8) | (gg >> 5);
+	}
+}
+
+/** @internal
+ * expand two NV12 luma rows sharing one chroma row into packed pixels.
+ * For a trailing odd row s1/d1 alias s0/d0.
+ */
+static inline __attribute__((always_inline))
+void _uvc_nv12_packed_rows(const uint8_t *s0, const uint8_t *s1, const uint8_t *suv,
+	uint8_t *d0, uint8_t *d1, const int width, const enum _nv12_packed_kind kind) {
+
+	const int pixel_bytes = kind == NV12_PACKED_RGBX ? 4 : 2;
+	const uint8_t *s[2] = { s0, s1 };
+	uint8_t *d[2] = { d0, d1 };
+	int x = 0, i;
+
+#if USE_NEON
+	for (; x + 16 <= width; x += 16) {
+		if (kind == NV12_PACKED_YUYV) {
+			const uint8x16_t uv = vld1q_u8(suv + x);
+			for (i = 0; i < 2; i++) {
+				const uint8x16x2_t z = vzipq_u8(vld1q_u8(s[i] + x), uv);
+				vst1q_u8(d[i] + x * 2, z.val[0]);
+				vst1q_u8(d[i] + x * 2 + 16, z.val[1]);
+			}
+			continue;
+		}
+		const uint8x8x2_t uv = vld2_u8(suv + x);
+		const uint8x8_t c128 = vdup_n_u8(128);
+		// (d << 1) * c * 2 >> 16 == d * c >> 14
+		const int16x8_t du = vshlq_n_s16(vreinterpretq_s16_u16(vsubl_u8(uv.val[0], c128)), 1);
+		const int16x8_t dv = vshlq_n_s16(vreinterpretq_s16_u16(vsubl_u8(uv.val[1], c128)), 1);
+		const int16x8x2_t r = vzipq_s16(vqdmulhq_n_s16(dv, 22987), vqdmulhq_n_s16(dv, 22987));
+		// G floors the sum of both products, as frame-kernels.cpp does
+		const int16x8_t u0 = vreinterpretq_s16_u16(vsubl_u8(uv.val[0], c128));
+		const int16x8_t v0 = vreinterpretq_s16_u16(vsubl_u8(uv.val[1], c128));
+		const int32x4_t gs_lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(u0), -5636), vget_low_s16(v0), -11698);
+		const int32x4_t gs_hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(u0), -5636), vget_high_s16(v0), -11698);
+		const int16x8_t gc = vcombine_s16(vshrn_n_s32(gs_lo, 14), vshrn_n_s32(gs_hi, 14));
+		const int16x8x2_t g = vzipq_s16(gc, gc);
+		const int16x8x2_t b = vzipq_s16(vqdmulhq_n_s16(du, 29049), vqdmulhq_n_s16(du, 29049));
+		for (i = 0; i < 2; i++) {
+			const uint8x16_t y = vld1q_u8(s[i] + x);
+			const int16x8_t ylo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y)));
+			const int16x8_t yhi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y)));
+			const uint8x16_t rr = vcombine_u8(vqmovun_s16(vaddq_s16(ylo, r.val[0])), vqmovun_s16(vaddq_s16(yhi, r.val[1])));
+			const uint8x16_t gg = vcombine_u8(vqmovun_s16(vaddq_s16(ylo, g.val[0])), vqmovun_s16(vaddq_s16(yhi, g.val[1])));
+			const uint8x16_t bb = vcombine_u8(vqmovun_s16(vaddq_s16(ylo, b.val[0])), vqmovun_s16(vaddq_s16(yhi, b.val[1])));
+			if (kind == NV12_PACKED_RGBX) {
+				uint8x16x4_t o;
+				o.val[0] = rr;
+				o.val[1] = gg;
+				o.val[2] = bb;
+				o.val[3] = vdupq_n_u8(0xff);
+				vst4q_u8(d[i] + x * 4, o);
+			} else {
+				uint16x8_t lo = vshll_n_u8(vget_low_u8(rr), 8);
+				uint16x8_t hi = vshll_n_u8(vget_high_u8(rr), 8);
+				lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(gg), 8), 5);
+				hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(gg), 8), 5);
+				lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(bb), 8), 11);
+				hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(bb), 8), 11);
+				vst1q_u8(d[i] + x * 2, vreinterpretq_u8_u16(lo));
+				vst1q_u8(d[i] + x * 2 + 16, vreinterpretq_u8_u16(hi));
+			}
+		}
+	}
+#elif USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lo8 = _mm_set1_epi16(0x00ff);
+	const __m128i c128 = _mm_set1_epi16(128);
+	const __m128i k_rv = _mm_set1_epi16(22987);
+	// u, v pairs times GU, GV summed in 32 bits
+	const __m128i k_g = _mm_set1_epi32((int)((uint32_t)-11698 << 16 | (uint16_t)-5636));
+	const __m128i k_bu = _mm_set1_epi16(29049);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i uv = _mm_loadu_si128((const __m128i *)(suv + x));
+		if (kind == NV12_PACKED_YUYV) {
+			for (i = 0; i < 2; i++) {
+				const __m128i y = _mm_loadu_si128((const __m128i *)(s[i] + x));
+				_mm_storeu_si128((__m128i *)(d[i] + x * 2), _mm_unpacklo_epi8(y, uv));
+				_mm_storeu_si128((__m128i *)(d[i] + x * 2 + 16), _mm_unpackhi_epi8(y, uv));
+			}
+			continue;
+		}
+		// (d << 2) * c >> 16 == d * c >> 14
+		const __m128i du = _mm_slli_epi16(_mm_sub_epi16(_mm_and_si128(uv, lo8), c128), 2);
+		const __m128i dv = _mm_slli_epi16(_mm_sub_epi16(_mm_srli_epi16(uv, 8), c128), 2);
+		const __m128i rc = _mm_mulhi_epi16(dv, k_rv);
+		// G floors the sum of both products, as frame-kernels.cpp does
+		const __m128i gs_lo = _mm_srai_epi32(_mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(uv, zero), c128), k_g), 14);
+		const __m128i gs_hi = _mm_srai_epi32(_mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(uv, zero), c128), k_g), 14);
+		const __m128i gc = _mm_packs_epi32(gs_lo, gs_hi);
+		const __m128i bc = _mm_mulhi_epi16(du, k_bu);
+		const __m128i r_lo = _mm_unpacklo_epi16(rc, rc), r_hi = _mm_unpackhi_epi16(rc, rc);
+		const __m128i g_lo = _mm_unpacklo_epi16(gc, gc), g_hi = _mm_unpackhi_epi16(gc, gc);
+		const __m128i b_lo = _mm_unpacklo_epi16(bc, bc), b_hi = _mm_unpackhi_epi16(bc, bc);
+		for (i = 0; i < 2; i++) {
+			const __m128i y = _mm_loadu_si128((const __m128i *)(s[i] + x));
+			const __m128i ylo = _mm_unpacklo_epi8(y, zero);
+			const __m128i yhi = _mm_unpackhi_epi8(y, zero);
+			const __m128i rr = _mm_packus_epi16(_mm_add_epi16(ylo, r_lo), _mm_add_epi16(yhi, r_hi));
+			const __m128i gg = _mm_packus_epi16(_mm_add_epi16(ylo, g_lo), _mm_add_epi16(yhi, g_hi));
+			const __m128i bb = _mm_packus_epi16(_mm_add_epi16(ylo, b_lo), _mm_add_epi16(yhi, b_hi));
+			uint8_t *p = d[i] + x * pixel_bytes;
+			if (kind == NV12_PACKED_RGBX) {
+				const __m128i ff = _mm_set1_epi8((char)0xff);
+				const __m128i rg_lo = _mm_unpacklo_epi8(rr, gg), rg_hi = _mm_unpackhi_epi8(rr, gg);
+				const __m128i bx_lo = _mm_unpacklo_epi8(bb, ff), bx_hi = _mm_unpackhi_epi8(bb, ff);
+				_mm_storeu_si128((__m128i *)(p), _mm_unpacklo_epi16(rg_lo, bx_lo));
+				_mm_storeu_si128((__m128i *)(p + 16), _mm_unpackhi_epi16(rg_lo, bx_lo));
+				_mm_storeu_si128((__m128i *)(p + 32), _mm_unpacklo_epi16(rg_hi, bx_hi));
+				_mm_storeu_si128((__m128i *)(p + 48), _mm_unpackhi_epi16(rg_hi, bx_hi));
+			} else {
+				const __m128i m_r = _mm_set1_epi16((short)0xf800);
+				const __m128i m_g = _mm_set1_epi16(0x07e0);
+				const __m128i lo = _mm_or_si128(_mm_or_si128(
+					_mm_and_si128(_mm_slli_epi16(_mm_unpacklo_epi8(rr, zero), 8), m_r),
+					_mm_and_si128(_mm_slli_epi16(_mm_unpacklo_epi8(gg, zero), 3), m_g)),
+					_mm_srli_epi16(_mm_unpacklo_epi8(bb, zero), 3));
+				const __m128i hi = _mm_or_si128(_mm_or_si128(
+					_mm_and_si128(_mm_slli_epi16(_mm_unpackhi_epi8(rr, zero), 8), m_r),
+					_mm_and_si128(_mm_slli_epi16(_mm_unpackhi_epi8(gg, zero), 3), m_g)),
+					_mm_srli_epi16(_mm_unpackhi_epi8(bb, zero), 3));
+				_mm_storeu_si128((__m128i *)(p), lo);
+				_mm_storeu_si128((__m128i *)(p + 16), hi);
+			}
+		}
+	}
+#endif
+	for (; x < width; x += 2) {
+		const int u = suv[x];
+		const int v = suv[x + 1];
+		if (kind == NV12_PACKED_YUYV) {
+			for (i = 0; i < 2; i++) {
+				uint8_t *p = d[i] + x * 2;
+				p[0] = s[i][x];
+				p[1] = u;
+				p[2] = s[i][x + 1];
+				p[3] = v;
+			}
+			continue;
+		}
+		const int r = (22987 * (v - 128)) >> 14;
+		const int g = (-5636 * (u - 128) - 11698 * (v - 128)) >> 14;
+		const int b = (29049 * (u - 128)) >> 14;
+		for (i = 0; i < 2; i++) {
+			_uvc_nv12_put_pixel(d[i] + x * pixel_bytes, s[i][x], r, g, b, kind);
+			_uvc_nv12_put_pixel(d[i] + (x + 1) * pixel_bytes, s[i][x + 1], r, g, b, kind);
+		}
+	}
+}
+
+/** @internal
+ * NV12 to a packed format; honours the caller's step on frames the library
+ * does not own, like the 4:2:0 writers above. Each pair of output rows goes
+ * to stats right after it is written when stats is not NULL.
+ */
+static inline __attribute__((always_inline))
+uvc_error_t _uvc_nv12_to_packed(uvc_frame_t *in, uvc_frame_t *out,
+	const enum uvc_frame_format out_format, const enum _nv12_packed_kind kind,
+	uvc_frame_stats_t *stats) {
+
+	const int pixel_bytes = kind == NV12_PACKED_RGBX ? 4 : 2;
+	const int width = in->width;
+	const int height = in->height;
+	const size_t src_step = in->step;
+
+	if (UNLIKELY(in->frame_format != UVC_FRAME_FORMAT_NV12))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(!width || !height || (width & 1) || (src_step < (size_t)width)
+		|| (in->data_bytes < src_step * height + src_step * ((height + 1) / 2))))
+		return UVC_ERROR_INVALID_PARAM;
+
+	const size_t dst_step = out->library_owns_data || !out->step
+		? (size_t)width * pixel_bytes : out->step;
+	if (UNLIKELY(dst_step < (size_t)width * pixel_bytes))
+		return UVC_ERROR_INVALID_PARAM;
+	if (UNLIKELY(uvc_ensure_frame_size(out, dst_step * height) < 0))
+		return UVC_ERROR_NO_MEM;
+
+	out->width = width;
+	out->height = height;
+	out->frame_format = out_format;
+	out->step = dst_step;
+	out->sequence = in->sequence;
+	out->capture_time = in->capture_time;
+	out->source = in->source;
+	out->actual_bytes = dst_step * height;
+
+	const uint8_t *src_y = in->data;
+	const uint8_t *src_uv = src_y + src_step * height;
+	uint8_t *dst = out->data;
+	int h;
+	if (stats)
+		_uvc_stats_begin(stats, out);
+	for (h = 0; h < height; h += 2) {
+		const uint8_t *s0 = src_y + src_step * h;
+		const uint8_t *s1 = h + 1 < height ? s0 + src_step : s0;
+		uint8_t *d0 = dst + dst_step * h;
+		uint8_t *d1 = h + 1 < height ? d0 + dst_step : d0;
+		_uvc_nv12_packed_rows(s0, s1, src_uv + src_step * (h / 2), d0, d1, width, kind);
+		if (stats) {
+			_uvc_stats_row(stats, out, d0, h);
+			if (d1 != d0)
+				_uvc_stats_row(stats, out, d1, h + 1);
+		}
+	}
+	if (stats)
+		_uvc_stats_end(stats);
+	return UVC_SUCCESS;
+}
+
+/** @brief Convert a frame from NV12 to RGBX8888
+ * @ingroup frame
+ *
+ * @param in NV12 frame
+ * @param out RGBX8888 frame
+ */
+uvc_error_t uvc_nv12_2rgbx(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_nv12_to_packed(in, out, UVC_FRAME_FORMAT_RGBX, NV12_PACKED_RGBX, NULL);
+}
+
+/** @internal uvc_nv12_2rgbx filling stats in the same pass */
+uvc_error_t _uvc_nv12_2rgbx_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats) {
+	return _uvc_nv12_to_packed(in, out, UVC_FRAME_FORMAT_RGBX, NV12_PACKED_RGBX, stats);
+}
+
+/** @brief Convert a frame from NV12 to RGB565
+ * @ingroup frame
+ *
+ * @param in NV12 frame
+ * @param out RGB565 frame
+ */
+uvc_error_t uvc_nv12_2rgb565(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_nv12_to_packed(in, out, UVC_FRAME_FORMAT_RGB565, NV12_PACKED_RGB565, NULL);
+}
+
+/** @internal uvc_nv12_2rgb565 filling stats in the same pass */
+uvc_error_t _uvc_nv12_2rgb565_stats(uvc_frame_t *in, uvc_frame_t *out, uvc_frame_stats_t *stats) {
+	return _uvc_nv12_to_packed(in, out, UVC_FRAME_FORMAT_RGB565, NV12_PACKED_RGB565, stats);
+}
+
+/** @brief Convert a frame from NV12 to YUYV
+ * @ingroup frame
+ *
+ * Each chroma row is repeated for both luma rows it covers.
+ * @param in NV12 frame
+ * @param out YUYV frame
+ */
+uvc_error_t uvc_nv12_2yuyv(uvc_frame_t *in, uvc_frame_t *out) {
+	return _uvc_nv12_to_packed(in, out, UVC_FRAME_FORMAT_YUYV, NV12_PACKED_YUYV, NULL);
+}
+
+/** @brief Convert a frame to I420(yuv420P)
+ * @ingroup frame
+ *
+ * @param in YUYV, UYVY, NV12, I420 or MJPEG frame
+ * @param out I420 frame
+ */
+uvc_error_t uvc_any2yuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+
+	switch (in->frame_format) {
+#ifdef LIBUVC_HAS_JPEG
+	case UVC_FRAME_FORMAT_MJPEG:
+		return uvc_mjpeg2yuv420P(in, out);
+#endif
+	case UVC_FRAME_FORMAT_YUYV:
+		return uvc_yuyv2yuv420P(in, out);
+	case UVC_FRAME_FORMAT_UYVY:
+		return uvc_uyvy2yuv420P(in, out);
+	case UVC_FRAME_FORMAT_NV12:
+		return uvc_nv12_2yuv420P(in, out);
+	case UVC_FRAME_FORMAT_I420:
+		return uvc_duplicate_frame(in, out);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+}
+
+/** @brief Convert a frame to YV12(iyuv420P)
+ * @ingroup frame
+ *
+ * @param in YUYV, UYVY, NV12, YV12 or MJPEG frame
+ * @param out YV12 frame
+ */
+uvc_error_t uvc_any2iyuv420P(uvc_frame_t *in, uvc_frame_t *out) {
+
+	switch (in->frame_format) {
+#ifdef LIBUVC_HAS_JPEG
+	case UVC_FRAME_FORMAT_MJPEG:
+		return uvc_mjpeg2iyuv420P(in, out);
+#endif
+	case UVC_FRAME_FORMAT_YUYV:
+		return uvc_yuyv2iyuv420P(in, out);
+	case UVC_FRAME_FORMAT_UYVY:
+		return uvc_uyvy2iyuv420P(in, out);
+	case UVC_FRAME_FORMAT_NV12:
+		return uvc_nv12_2iyuv420P(in, out);
+	case UVC_FRAME_FORMAT_YV12:
+		return uvc_duplicate_frame(in, out);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+}
+
+/** @brief Convert a frame to NV12(yuv420SP)
+ * @ingroup frame
+ *
+ * @param in YUYV, UYVY, NV12 or MJPEG frame
+ * @param out NV12 frame
+ */
+uvc_error_t uvc_any2yuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+
+	switch (in->frame_format) {
+#ifdef LIBUVC_HAS_JPEG
+	case UVC_FRAME_FORMAT_MJPEG:
+		return uvc_mjpeg2yuv420SP(in, out);
+#endif
+	case UVC_FRAME_FORMAT_YUYV:
+		return uvc_yuyv2yuv420SP(in, out);
+	case UVC_FRAME_FORMAT_UYVY:
+		return uvc_uyvy2yuv420SP(in, out);
+	case UVC_FRAME_FORMAT_NV12:
+		return uvc_duplicate_frame(in, out);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+}
+
+/** @brief Convert a frame to NV21(iyuv420SP)
+ * @ingroup frame
+ *
+ * @param in YUYV, UYVY, NV12, NV21, raw Bayer, GRAY16, P010 or MJPEG frame
+ * @param out NV21 frame
+ */
+uvc_error_t uvc_any2iyuv420SP(uvc_frame_t *in, uvc_frame_t *out) {
+
+	switch (in->frame_format) {
+#ifdef LIBUVC_HAS_JPEG
+	case UVC_FRAME_FORMAT_MJPEG:
+		return uvc_mjpeg2iyuv420SP(in, out);
+#endif
+	case UVC_FRAME_FORMAT_YUYV:
+		return uvc_yuyv2iyuv420SP(in, out);
+	case UVC_FRAME_FORMAT_UYVY:
+		return uvc_uyvy2iyuv420SP(in, out);
+	case UVC_FRAME_FORMAT_NV12:
+		return uvc_nv12_2iyuv420SP(in, out);
+	case UVC_FRAME_FORMAT_NV21:
+		return uvc_duplicate_frame(in, out);
+	case UVC_FRAME_FORMAT_SGRBG8:
+	case UVC_FRAME_FORMAT_SGBRG8:
+	case UVC_FRAME_FORMAT_SRGGB8:
+	case UVC_FRAME_FORMAT_SBGGR8:
+	case UVC_FRAME_FORMAT_BA81:
+	case UVC_FRAME_FORMAT_BY8:
+		return uvc_bayer2iyuv420SP(in, out);
+	case UVC_FRAME_FORMAT_GRAY16:
+		return uvc_gray16_2iyuv420SP(in, out);
+	case UVC_FRAME_FORMAT_P010:
+		return uvc_p010_2iyuv420SP(in, out);
+	default:
+		return UVC_ERROR_NOT_SUPPORTED;
+	}
+}
@@ -69,6 +69,8 @@ uvc_frame_desc_t *uvc_find_frame_desc_stream(uvc_stream_handle_t *strmh,
 uvc_frame_desc_t *uvc_find_frame_desc(uvc_device_handle_t *devh,
                                       uint16_t format_id, uint16_t frame_id);
 
+extern uvc_error_t uvc_ensure_frame_size(uvc_frame_t *frame, size_t need_bytes);
+
 static void *_uvc_user_caller(void *arg);
 
 static void _uvc_populate_frame(uvc_stream_handle_t *strmh);
@@ -643,6 +645,94 @@ uvc_error_t uvc_probe_still_ctrl(
     return res;
 }
 
+/** @internal
+ * @brief Index of a transfer in strmh->transfers, -1 if it is not there
+ */
+static int _uvc_transfer_index(uvc_stream_handle_t *strmh, struct libusb_transfer *transfer) {
+    int i;
+    for (i = 0; i < LIBUVC_NUM_TRANSFER_BUFS; i++) {
+        if (strmh->transfers[i] == transfer)
+            return i;
+    }
+    return -1;
+}
+
+/** @internal
+ * @brief Hand a transfer no fragment points into any more back to libusb
+ * frees it instead when it failed or the stream is stopping.
+ * must be called with stream cb lock held!
+ */
+static void _uvc_recycle_transfer(uvc_stream_handle_t *strmh, const int i) {
+    struct libusb_transfer *transfer = strmh->transfers[i];
+
+    if (LIKELY(strmh->running && !strmh->xfer_failed[i])
+        && LIKELY(!libusb_submit_transfer(transfer)))
+        return;
+    UVC_DEBUG("Freeing lent transfer %d (%p)", i, transfer);
+    free(transfer->buffer);
+    // libusb_free_transfer(transfer);
+    strmh->transfers[i] = NULL;
+    pthread_cond_broadcast(&strmh->cb_cond);
+}
+
+/** @internal
+ * @brief Drop the fragments of a frame, recycling the transfers left unused
+ * must be called with stream cb lock held!
+ */
+static void _uvc_release_fragments(uvc_stream_handle_t *strmh, struct uvc_fragment_list *list) {
+    int f;
+    for (f = 0; f < list->num; f++) {
+        const int i = list->xfer[f];
+        // the transfer being processed is settled when its callback ends
+        if (!--strmh->xfer_refs[i] && (i != strmh->cur_xfer)) {
+            strmh->xfer_lent--;
+            _uvc_recycle_transfer(strmh, i);
+        }
+    }
+    list->num = 0;
+}
+
+/** @internal
+ * @brief Append a payload to the frame being assembled, in place
+ */
+static void _uvc_add_fragment(uvc_stream_handle_t *strmh, const uint8_t *data, const size_t bytes) {
+    struct uvc_fragment_list *list = strmh->frag_out;
+
+    if (UNLIKELY(strmh->bfh_err))
+        return;    // the frame is lost already, lend nothing for it
+    if (!strmh->cur_xfer_added) {
+        // first payload from this transfer: lending it must leave enough in flight
+        pthread_mutex_lock(&strmh->cb_mutex);
+        const int full = strmh->xfer_lent >= LIBUVC_NUM_TRANSFER_BUFS - LIBUVC_NUM_TRANSFER_RESERVE;
+        if (UNLIKELY(full))
+            _uvc_release_fragments(strmh, list);
+        pthread_mutex_unlock(&strmh->cb_mutex);
+        if (UNLIKELY(full)) {
+            UVC_DEBUG("too many transfers lent, dropping the frame");
+            strmh->bfh_err |= UVC_STREAM_ERR;
+            return;
+        }
+    }
+    if (UNLIKELY(list->num == list->capacity)) {
+        // grows to the most payloads a frame had, all lists take turns here
+        const int capacity = list->capacity ? list->capacity * 2 : 64;
+        uvc_frame_fragment_t *frags = realloc(list->frags, capacity * sizeof(*frags));
+        if (frags)
+            list->frags = frags;
+        uint16_t *xfer = frags ? realloc(list->xfer, capacity * sizeof(*xfer)) : NULL;
+        if (UNLIKELY(!xfer)) {
+            strmh->bfh_err |= UVC_STREAM_ERR;
+            return;
+        }
+        list->xfer = xfer;
+        list->capacity = capacity;
+    }
+    list->frags[list->num].data = data;
+    list->frags[list->num].bytes = bytes;
+    list->xfer[list->num++] = strmh->cur_xfer;
+    strmh->cur_xfer_added++;
+}
+
 /** @internal
  * @brief Swap the working buffer with the presented buffer and notify consumers
  */
@@ -668,6 +758,14 @@ static void _uvc_swap_buffers(uvc_stream_handle_t *strmh) {
         strmh->meta_outbuf = tmp_buf;
         strmh->meta_hold_bytes = strmh->meta_got_bytes;
 
+        if (strmh->fragments) {
+            // the callback thread did not get to the frame held so far
+            struct uvc_fragment_list *tmp_list = strmh->frag_hold;
+            _uvc_release_fragments(strmh, tmp_list);
+            strmh->frag_hold = strmh->frag_out;
+            strmh->frag_out = tmp_list;
+        }
+
         pthread_cond_broadcast(&strmh->cb_cond);
     }
     pthread_mutex_unlock(&strmh->cb_mutex);
@@ -791,7 +889,10 @@ _uvc_process_payload(uvc_stream_handle_t *strmh, const uint8_t *payload, size_t
 
     if (LIKELY(data_len > 0)) {
         if (LIKELY(strmh->got_bytes + data_len < strmh->cur_ctrl.dwMaxVideoFrameSize)) {
-            memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
+            if (strmh->fragments)
+                _uvc_add_fragment(strmh, payload + header_len, data_len);
+            else
+                memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
             strmh->got_bytes += data_len;
         } else
             strmh->bfh_err |= UVC_STREAM_ERR;
@@ -846,6 +947,17 @@ static void _uvc_stream_callback(struct libusb_transfer *transfer) {
 
     int resubmit = 1;
 
+    if (strmh->fragments) {
+        pthread_mutex_lock(&strmh->cb_mutex);
+        strmh->cur_xfer = _uvc_transfer_index(strmh, transfer);
+        pthread_mutex_unlock(&strmh->cb_mutex);
+        strmh->cur_xfer_added = 0;
+        if (UNLIKELY(strmh->cur_xfer < 0)) {
+            UVC_DEBUG("transfer %p not found; not resubmitting!", transfer);
+            return;
+        }
+    }
+
 #ifndef NDEBUG
     static int cnt = 0;
     if UNLIKELY((++cnt % 1000) == 0)
@@ -874,6 +986,27 @@ static void _uvc_stream_callback(struct libusb_transfer *transfer) {
             MARK("retrying transfer, status = %d", transfer->status);
             break;
     }
+    if (strmh->fragments) {
+        // lent out while a frame still points into it
+        pthread_mutex_lock(&strmh->cb_mutex);
+        const int i = strmh->cur_xfer;
+        if (!resubmit)
+            strmh->xfer_failed[i] = 1;
+        if (UNLIKELY(!strmh->running)) {
+            // these frames will not reach the callback any more
+            _uvc_release_fragments(strmh, strmh->frag_hold);
+            _uvc_release_fragments(strmh, strmh->frag_out);
+            strmh->hold_bytes = 0;
+        }
+        strmh->cur_xfer = -1;
+        strmh->xfer_refs[i] += strmh->cur_xfer_added;
+        if (!strmh->xfer_refs[i])
+            _uvc_recycle_transfer(strmh, i);
+        else
+            strmh->xfer_lent++;
+        pthread_mutex_unlock(&strmh->cb_mutex);
+        return;
+    }
     if (resubmit && strmh->running) {
         int libusbRet = libusb_submit_transfer(transfer);
         if (0 == libusbRet)
@@ -904,7 +1037,7 @@ static void _uvc_stream_callback(struct libusb_transfer *transfer) {
  * @param ctrl Control block, processed using {uvc_probe_stream_ctrl} or
  *             {uvc_get_stream_ctrl_format_size}
  * @param cb   User callback function. See {uvc_frame_callback_t} for restrictions.
- * @param flags Stream setup flags, currently undefined. Set this to zero. The lower bit
+ * @param flags Stream setup flags, 0 or UVC_STREAM_FLAG_FRAGMENTS. The lower bit
  * is reserved for backward compatibility.
  */
 uvc_error_t uvc_start_streaming(uvc_device_handle_t *devh,
@@ -921,7 +1054,7 @@ uvc_error_t uvc_start_streaming(uvc_device_handle_t *devh,
  *             {uvc_get_stream_ctrl_format_size}
  * @param cb   User callback function. See {uvc_frame_callback_t} for restrictions.
  * @param bandwidth_factor [0.0f, 1.0f]
- * @param flags Stream setup flags, currently undefined. Set this to zero. The lower bit
+ * @param flags Stream setup flags, 0 or UVC_STREAM_FLAG_FRAGMENTS. The lower bit
  * is reserved for backward compatibility.
  */
 uvc_error_t uvc_start_streaming_bandwidth(uvc_device_handle_t *devh,
@@ -1065,7 +1198,7 @@ uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh,
  *
  * @param strmh UVC stream
  * @param cb   User callback function. See {uvc_frame_callback_t} for restrictions.
- * @param flags Stream setup flags, currently undefined. Set this to zero. The lower bit
+ * @param flags Stream setup flags, 0 or UVC_STREAM_FLAG_FRAGMENTS. The lower bit
  * is reserved for backward compatibility.
  */
 uvc_error_t uvc_stream_start(uvc_stream_handle_t *strmh,
@@ -1079,7 +1212,7 @@ uvc_error_t uvc_stream_start(uvc_stream_handle_t *strmh,
  * @param strmh UVC stream
  * @param cb   User callback function. See {uvc_frame_callback_t} for restrictions.
  * @param bandwidth_factor [0.0f, 1.0f]
- * @param flags Stream setup flags, currently undefined. Set this to zero. The lower bit
+ * @param flags Stream setup flags, 0 or UVC_STREAM_FLAG_FRAGMENTS. The lower bit
  * is reserved for backward compatibility.
  */
 uvc_error_t uvc_stream_start_bandwidth(uvc_stream_handle_t *strmh,
@@ -1129,6 +1262,18 @@ uvc_error_t uvc_stream_start_bandwidth(uvc_stream_handle_t *strmh,
         goto fail;
     }
 
+    strmh->fragments = (flags & UVC_STREAM_FLAG_FRAGMENTS) && cb
+                       && (strmh->frame_format == UVC_FRAME_FORMAT_MJPEG);
+    strmh->frag_out = &strmh->frag_lists[0];
+    strmh->frag_hold = &strmh->frag_lists[1];
+    strmh->frag_user = &strmh->frag_lists[2];
+    strmh->frag_out->num = strmh->frag_hold->num = strmh->frag_user->num = 0;
+    strmh->got_bytes = 0;    // of a frame the last stop cut short
+    memset(strmh->xfer_refs, 0, sizeof(strmh->xfer_refs));
+    strmh->xfer_lent = 0;
+    memset(strmh->xfer_failed, 0, sizeof(strmh->xfer_failed));
+    strmh->cur_xfer = -1;
+
     const uint32_t dwMaxVideoFrameSize =
             ctrl->dwMaxVideoFrameSize <= frame_desc->dwMaxVideoFrameBufferSize
             ? ctrl->dwMaxVideoFrameSize : frame_desc->dwMaxVideoFrameBufferSize;
@@ -1247,6 +1392,19 @@ uvc_error_t uvc_stream_start_bandwidth(uvc_stream_handle_t *strmh,
                                       _uvc_stream_callback,
                                       (void *) strmh, 5000);
         }
+        total_transfer_size = strmh->cur_ctrl.dwMaxPayloadTransferSize;
+    }
+
+    if (strmh->fragments) {
+        /* a frame as large as the device may send has to fit the transfers that can
+         * be lent, otherwise every frame would be dropped: copy those instead */
+        const size_t frame_transfers = total_transfer_size
+                                       ? (dwMaxVideoFrameSize + total_transfer_size - 1) / total_transfer_size
+                                       : LIBUVC_NUM_TRANSFER_BUFS;
+        if (frame_transfers > LIBUVC_NUM_TRANSFER_BUFS - LIBUVC_NUM_TRANSFER_RESERVE) {
+            UVC_DEBUG("frames span %zu transfers, not lending them", frame_transfers);
+            strmh->fragments = 0;
+        }
     }
 
     strmh->user_cb = cb;
@@ -1334,6 +1492,12 @@ static void *_uvc_user_caller(void *arg) {
         }
         pthread_mutex_unlock(&strmh->cb_mutex);
         strmh->user_cb(&strmh->frame, strmh->user_ptr);    // call user callback function
+        if (strmh->fragments) {
+            // the callback is done with the transfer buffers
+            pthread_mutex_lock(&strmh->cb_mutex);
+            _uvc_release_fragments(strmh, strmh->frag_user);
+            pthread_mutex_unlock(&strmh->cb_mutex);
+        }
     } while (1);
 
     return NULL; // return value ignored
@@ -1369,9 +1533,17 @@ void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
             frame->step = frame->width * 2;
             break;
         case UVC_FRAME_FORMAT_NV12:
+        case UVC_FRAME_FORMAT_GRAY8:
+        case UVC_FRAME_FORMAT_BY8:
+        case UVC_FRAME_FORMAT_BA81:
+        case UVC_FRAME_FORMAT_SGRBG8:
+        case UVC_FRAME_FORMAT_SGBRG8:
+        case UVC_FRAME_FORMAT_SRGGB8:
+        case UVC_FRAME_FORMAT_SBGGR8:
             frame->step = frame->width;
             break;
         case UVC_FRAME_FORMAT_P010:
+        case UVC_FRAME_FORMAT_GRAY16:
             frame->step = frame->width * 2;
             break;
         case UVC_FRAME_FORMAT_MJPEG:
@@ -1388,18 +1560,37 @@ void _uvc_populate_frame(uvc_stream_handle_t *strmh) {
     frame->sequence = strmh->hold_seq;
     frame->capture_time_finished = strmh->capture_time_finished;
 
-    /* copy the image data from the hold buffer to the frame (unnecessary extra buf?) */
-    if (UNLIKELY(frame->data_bytes < strmh->hold_bytes)) {
-        frame->data = realloc(frame->data,
-                              strmh->hold_bytes);    // TODO add error handling when failed realloc
+    if (strmh->fragments) {
+        /* the payloads stay where they are, the callback owns them until it returns */
+        struct uvc_fragment_list *list = strmh->frag_hold;
+        strmh->frag_hold = strmh->frag_user;
+        strmh->frag_user = list;
+        frame->fragments = list->frags;
+        frame->num_fragments = list->num;
+        frame->data_bytes = 0;
+    } else {
+        /* copy the image data from the hold buffer to the frame (unnecessary extra buf?)
+         * the frame buffer only grows, so varying MJPEG sizes stop reallocating */
+        const size_t actual_bytes = frame->actual_bytes;
+        frame->fragments = NULL;
+        frame->num_fragments = 0;
+        if (UNLIKELY(!strmh->hold_bytes || uvc_ensure_frame_size(frame, strmh->hold_bytes))) {
+            frame->data_bytes = frame->actual_bytes = 0;    // rejected by the frame callbacks
+            return;
+        }
+        frame->actual_bytes = actual_bytes;
+        memcpy(frame->data, strmh->holdbuf, frame->data_bytes);    // XXX
     }
-    frame->data_bytes = strmh->hold_bytes;
-    memcpy(frame->data, strmh->holdbuf, frame->data_bytes);    // XXX
 
     /** @todo set the frame time */
     if (strmh->meta_hold_bytes > 0) {
-        if (frame->metadata_bytes < strmh->meta_hold_bytes) {
-            frame->metadata = realloc(frame->metadata, strmh->meta_hold_bytes);
+        // meta_hold_bytes never exceeds LIBUVC_XFER_META_BUF_SIZE, allocate that once
+        if (UNLIKELY(!frame->metadata)) {
+            frame->metadata = malloc(LIBUVC_XFER_META_BUF_SIZE);
+            if (UNLIKELY(!frame->metadata)) {
+                frame->metadata_bytes = 0;
+                return;
+            }
         }
         frame->metadata_bytes = strmh->meta_hold_bytes;
         memcpy(frame->metadata, strmh->meta_holdbuf, frame->metadata_bytes);
@@ -1532,6 +1723,15 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
                     UVC_DEBUG("libusb_cancel_transfer failed");
             }
         }
+        if (strmh->fragments) {
+            /* lent transfers are not cancelled, they are freed once the frames
+             * pointing into them are dropped. A transfer callback still running
+             * drops the frame being assembled itself. */
+            _uvc_release_fragments(strmh, strmh->frag_hold);
+            strmh->hold_bytes = 0;
+            if (strmh->cur_xfer < 0)
+                _uvc_release_fragments(strmh, strmh->frag_out);
+        }
 
         /* Wait for transfers to complete/cancel */
         for (; 1;) {
@@ -1566,6 +1766,7 @@ uvc_error_t uvc_stream_stop(uvc_stream_handle_t *strmh) {
  * @param strmh UVC stream handle
  */
 void uvc_stream_close(uvc_stream_handle_t *strmh) {
+    int i;
     UVC_ENTER();
 
     if (!strmh) { UVC_EXIT_VOID(); }
@@ -1579,6 +1780,10 @@ void uvc_stream_close(uvc_stream_handle_t *strmh) {
         free(strmh->frame.data);
         strmh->frame.data = NULL;
     }
+    if (strmh->frame.metadata) {
+        free(strmh->frame.metadata);
+        strmh->frame.metadata = NULL;
+    }
 
     if (strmh->outbuf) {
         free(strmh->outbuf);
@@ -1596,6 +1801,10 @@ void uvc_stream_close(uvc_stream_handle_t *strmh) {
         free(strmh->meta_holdbuf);
         strmh->meta_holdbuf = NULL;
     }
+    for (i = 0; i < 3; i++) {
+        free(strmh->frag_lists[i].frags);
+        free(strmh->frag_lists[i].xfer);
+    }
 
     pthread_cond_destroy(&strmh->cb_cond);
     pthread_mutex_destroy(&strmh->cb_mutex);
@@ -0,0 +1,516 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (C) 2010-2012 Ken Tossell
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the author nor other contributors may be
+ *     used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+/*
+ * Golden image and performance regression test for the frame conversion
+ * and MJPEG decode kernels.
+ *
+ * Every kernel in bench/bench_kernels.c runs on the synthetic frames from
+ * bench/bench_frames.c at two sizes, one of them deliberately not a
+ * multiple of the SIMD width so the scalar tails are covered as well.
+ * Integer kernels must match golden.txt bit for bit on every target (the
+ * NEON, SSE2 and plain C paths are written to give identical results);
+ * MJPEG decodes depend on the libjpeg build and are held to a minimum
+ * PSNR against the pattern they were encoded from instead.
+ *
+ * With -b the best-of-5 time per frame of every kernel in baseline.txt is
+ * compared against the recorded one and the test fails when it is slower
+ * by more than the threshold. Baselines only mean something on the host
+ * they were recorded on, so re-record them (-R) when the runner changes.
+ *
+ *   uvc_golden [-g golden.txt] [-b baseline.txt] [-p percent] [-f filter] [-R]
+ */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libuvc/libuvc.h"
+#include "bench_frames.h"
+#include "bench_kernels.h"
+
+#define NUM_ELEMENTS(a) (sizeof(a) / sizeof((a)[0]))
+#define MAX_ENTRIES 512
+/** margin below the recorded PSNR written by -R */
+#define PSNR_MARGIN 0.5
+#define PERF_RUNS 5
+/** a kernel over the limit is timed again this often before it fails, so a
+ * busy moment on a shared runner is not reported as a regression */
+#define PERF_ATTEMPTS 3
+#define PERF_RESOLUTION 0	// index into resolutions
+
+typedef struct {
+	const char *name;
+	int width;
+	int height;
+} golden_resolution_t;
+
+static const golden_resolution_t resolutions[] = {
+	{ "vga", 640, 480 },
+	// not a multiple of 16 or 8 in either direction, so the SIMD loops leave a
+	// scalar tail; half of it is still even for the subsampled NV21 outputs
+	{ "odd", 356, 204 },
+};
+
+enum golden_check {
+	CHECK_HASH = 0,
+	CHECK_PSNR,
+	CHECK_MS,
+};
+
+typedef struct {
+	char kernel[64];
+	char resolution[16];
+	enum golden_check check;
+	uint64_t hash;
+	double value;
+	int seen;
+} golden_entry_t;
+
+static const char *check_names[] = { "hash", "psnr", "ms" };
+
+/** CPU time of the calling thread, so time spent preempted on a busy host
+ * does not count against the kernel */
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/** FNV-1a over the geometry, format and payload of a frame */
+static uint64_t frame_hash(const uvc_frame_t *frame) {
+	uint64_t h = 0xcbf29ce484222325ull;
+	const uint32_t header[3] = { frame->width, frame->height, frame->frame_format };
+	const uint8_t *p;
+	size_t i;
+
+	for (p = (const uint8_t *)header, i = 0; i < sizeof(header); i++)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	for (p = frame->data, i = 0; i < frame->data_bytes; i++)
+		h = (h ^ p[i]) * 0x100000001b3ull;
+	return h;
+}
+
+/** PSNR of a decoded frame against the same pattern synthesized directly
+ * in the output format; RGB565 is compared per expanded channel */
+static double frame_psnr(const uvc_frame_t *frame, const uvc_frame_t *ref) {
+	const uint8_t *a = frame->data, *b = ref->data;
+	const size_t bytes = frame->data_bytes < ref->data_bytes ? frame->data_bytes : ref->data_bytes;
+	double sse = 0;
+	size_t i, n = 0;
+
+	if (frame->frame_format == UVC_FRAME_FORMAT_RGB565) {
+		for (i = 0; i + 1 < bytes; i += 2) {
+			const int pa = a[i] | (a[i + 1] << 8), pb = b[i] | (b[i + 1] << 8);
+			const int da[3] = { (pa >> 11) << 3, ((pa >> 5) & 0x3f) << 2, (pa & 0x1f) << 3 };
+			const int db[3] = { (pb >> 11) << 3, ((pb >> 5) & 0x3f) << 2, (pb & 0x1f) << 3 };
+			int c;
+			for (c = 0; c < 3; c++, n++)
+				sse += (double)(da[c] - db[c]) * (da[c] - db[c]);
+		}
+	} else {
+		for (i = 0; i < bytes; i++, n++)
+			sse += (double)(a[i] - b[i]) * (a[i] - b[i]);
+	}
+	if (!n || (bytes != ref->data_bytes))
+		return 0;
+	return sse ? 10 * log10(255.0 * 255.0 * n / sse) : 99;
+}
+
+static int load_entries(const char *path, golden_entry_t *entries, const int max) {
+	FILE *f = fopen(path, "r");
+	char line[256], check[16];
+	int n = 0, i;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f) && (n < max)) {
+		golden_entry_t *e = &entries[n];
+		char value[32];
+		if ((line[0] == '#') || (line[0] == '\n'))
+			continue;
+		memset(e, 0, sizeof(*e));
+		if (sscanf(line, "%63s %15s %15s %31s", e->kernel, e->resolution, check, value) != 4) {
+			fprintf(stderr, "%s: malformed line: %s", path, line);
+			continue;
+		}
+		for (i = 0; i < (int)NUM_ELEMENTS(check_names); i++) {
+			if (!strcmp(check, check_names[i]))
+				break;
+		}
+		e->check = (enum golden_check)i;
+		if (e->check == CHECK_HASH)
+			e->hash = strtoull(value, NULL, 16);
+		else
+			e->value = atof(value);
+		n++;
+	}
+	fclose(f);
+	return n;
+}
+
+static golden_entry_t *find_entry(golden_entry_t *entries, const int n,
+	const char *kernel, const char *resolution) {
+
+	int i;
+	for (i = 0; i < n; i++) {
+		if (!strcmp(entries[i].kernel, kernel) && !strcmp(entries[i].resolution, resolution))
+			return &entries[i];
+	}
+	return NULL;
+}
+
+/** MJPEG decodes; the structure checks give the same answer on every build */
+static int is_lossy(const uvc_bench_kernel_t *kernel) {
+	return (kernel->src == UVC_FRAME_FORMAT_MJPEG) && !strstr(kernel->name, "validate");
+}
+
+/** box filter a packed frame down by scale in place, per byte */
+static void box_downscale(uvc_frame_t *frame, const int scale) {
+	const int bpp = (int)(frame->step / frame->width);
+	const int w = frame->width / scale, h = frame->height / scale;
+	uint8_t *data = frame->data;
+	int x, y, c, i, j;
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			for (c = 0; c < bpp; c++) {
+				int sum = 0;
+				for (j = 0; j < scale; j++) {
+					for (i = 0; i < scale; i++)
+						sum += data[(size_t)(y * scale + j) * frame->step + (x * scale + i) * bpp + c];
+				}
+				// rows already written are never read again
+				data[((size_t)y * w + x) * bpp + c] = (sum + scale * scale / 2) / (scale * scale);
+			}
+		}
+	}
+	frame->width = w;
+	frame->height = h;
+	frame->step = w * bpp;
+	frame->data_bytes = frame->actual_bytes = frame->step * h;
+}
+
+/** the pattern a lossy kernel is compared against, synthesized directly in its
+ * output format; pyramids against the box filtered pyramid of the gray pattern,
+ * quarter size decodes against the box filtered pattern */
+static uvc_frame_t *make_reference(const uvc_bench_kernel_t *kernel, const golden_resolution_t *res) {
+	if (strstr(kernel->name, "quarter")) {
+		uvc_frame_t *ref = uvc_bench_make_frame(kernel->dst, UVC_BENCH_JPEG_422, res->width, res->height);
+		if (ref)
+			box_downscale(ref, 4);
+		return ref;
+	}
+	if (!strstr(kernel->name, "pyramid"))
+		return uvc_bench_make_frame(kernel->dst, UVC_BENCH_JPEG_422, res->width, res->height);
+	uvc_frame_t *gray = uvc_bench_make_frame(UVC_FRAME_FORMAT_GRAY8, UVC_BENCH_JPEG_422, res->width, res->height);
+	uvc_frame_t *ref = uvc_allocate_frame(0);
+	if (gray && ref && !uvc_luma_pyramid(gray, ref, NULL)) {
+		uvc_free_frame(gray);
+		return ref;
+	}
+	if (gray)
+		uvc_free_frame(gray);
+	if (ref)
+		uvc_free_frame(ref);
+	return NULL;
+}
+
+/** statistics uvc_convert() accumulates while converting must equal a
+ * separate uvc_frame_stats() pass over its output
+ * @return 0 when they match or the conversion is not planned for the kernel's formats
+ */
+static int check_stats(const uvc_bench_kernel_t *kernel, uvc_frame_t *in) {
+	static uvc_frame_stats_t fused, pass;
+	uvc_convert_opts_t opts;
+	uvc_frame_t *out = uvc_allocate_frame(0);
+	int result = 0;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.format = kernel->dst;
+	opts.stats = &fused;
+	fused.zones_x = pass.zones_x = 5;
+	fused.zones_y = pass.zones_y = 3;
+	fused.step = pass.step = 1;
+	if (out && !uvc_convert(in, out, &opts) && !uvc_frame_stats(out, &pass)) {
+		result = (fused.pixels != pass.pixels) || (fused.pixels != out->width * out->height)
+			|| memcmp(fused.histogram, pass.histogram, sizeof(fused.histogram))
+			|| memcmp(fused.zone_sum, pass.zone_sum, sizeof(fused.zone_sum))
+			|| memcmp(fused.zone_pixels, pass.zone_pixels, sizeof(fused.zone_pixels));
+	}
+	uvc_convert_release(&opts);
+	if (out)
+		uvc_free_frame(out);
+	return result;
+}
+
+/** run every kernel at every golden resolution and check or record the output */
+static int run_golden(const char *path, const char *filter, const int record) {
+	static golden_entry_t entries[MAX_ENTRIES];
+	int num_entries = 0, failures = 0, i;
+	size_t k, r;
+	FILE *out = NULL;
+
+	if (record) {
+		out = fopen(path, "w");
+		if (!out) {
+			perror(path);
+			return 1;
+		}
+		fprintf(out, "# golden outputs of the frame kernels, regenerate with uvc_golden -R -g <this file>\n"
+			"# <kernel> <resolution> hash <fnv1a64> | psnr <minimum dB>\n");
+	} else if ((num_entries = load_entries(path, entries, MAX_ENTRIES)) < 0) {
+		return 1;
+	}
+
+	for (k = 0; k < uvc_bench_num_kernels; k++) {
+		const uvc_bench_kernel_t *kernel = &uvc_bench_kernels[k];
+		if (filter && !strstr(kernel->name, filter))
+			continue;
+		for (r = 0; r < NUM_ELEMENTS(resolutions); r++) {
+			const golden_resolution_t *res = &resolutions[r];
+			uvc_frame_t *in = uvc_bench_make_frame(kernel->src, kernel->sampling, res->width, res->height);
+			uvc_frame_t *frame = uvc_allocate_frame(0);
+			uvc_error_t error = in && frame ? kernel->func(in, frame) : UVC_ERROR_NO_MEM;
+			uint64_t hash = 0;
+			double psnr = 0;
+
+			if (!error) {
+				hash = frame_hash(frame);
+				// a second conversion into the same, already sized frame must not differ
+				error = kernel->func(in, frame);
+				if (!error && (frame_hash(frame) != hash)) {
+					fprintf(stderr, "FAIL %s %s: output differs when the frame is reused\n", kernel->name, res->name);
+					failures++;
+				}
+				if (!error && check_stats(kernel, in)) {
+					fprintf(stderr, "FAIL %s %s: fused statistics differ from a separate pass\n", kernel->name, res->name);
+					failures++;
+				}
+			}
+			if (!error && is_lossy(kernel)) {
+				uvc_frame_t *ref = make_reference(kernel, res);
+				psnr = ref ? frame_psnr(frame, ref) : 0;
+				if (ref)
+					uvc_free_frame(ref);
+			}
+			if (in)
+				uvc_free_frame(in);
+			if (frame)
+				uvc_free_frame(frame);
+
+			if (error) {
+				fprintf(stderr, "FAIL %s %s: error %d\n", kernel->name, res->name, error);
+				failures++;
+				continue;
+			}
+			if (record) {
+				if (is_lossy(kernel))
+					fprintf(out, "%s %s psnr %.1f\n", kernel->name, res->name, floor((psnr - PSNR_MARGIN) * 10) / 10);
+				else
+					fprintf(out, "%s %s hash %016llx\n", kernel->name, res->name, (unsigned long long)hash);
+				continue;
+			}
+			golden_entry_t *e = find_entry(entries, num_entries, kernel->name, res->name);
+			if (!e) {
+				fprintf(stderr, "FAIL %s %s: no golden entry, record one with -R\n", kernel->name, res->name);
+				failures++;
+				continue;
+			}
+			e->seen = 1;
+			if ((e->check == CHECK_HASH) && (hash != e->hash)) {
+				fprintf(stderr, "FAIL %s %s: hash %016llx, expected %016llx\n", kernel->name, res->name,
+					(unsigned long long)hash, (unsigned long long)e->hash);
+				failures++;
+			} else if ((e->check == CHECK_PSNR) && (psnr < e->value)) {
+				fprintf(stderr, "FAIL %s %s: PSNR %.2f dB, expected at least %.1f dB\n", kernel->name, res->name,
+					psnr, e->value);
+				failures++;
+			} else if (e->check == CHECK_MS) {
+				fprintf(stderr, "FAIL %s %s: timing entry in the golden file\n", kernel->name, res->name);
+				failures++;
+			}
+		}
+	}
+	if (!filter) {
+		for (i = 0; i < num_entries; i++) {
+			if (!entries[i].seen) {
+				fprintf(stderr, "FAIL %s %s: golden entry without a kernel\n", entries[i].kernel, entries[i].resolution);
+				failures++;
+			}
+		}
+	}
+	if (out)
+		fclose(out);
+	fprintf(stderr, "golden: %d failure(s)%s\n", failures, record ? ", recorded" : "");
+	return failures ? 1 : 0;
+}
+
+/** best of PERF_RUNS, each at least min_ms long, in ms per frame */
+static double time_kernel(const uvc_bench_kernel_t *kernel, uvc_frame_t *in, const int min_ms, uvc_error_t *error) {
+	uvc_frame_t *out = uvc_allocate_frame(0);
+	double best = 0;
+	int iterations = 1, run, i;
+
+	*error = out ? kernel->func(in, out) : UVC_ERROR_NO_MEM;
+	for (run = 0; !*error && (run < PERF_RUNS); run++) {
+		uint64_t start, elapsed;
+		for (;;) {
+			start = now_ns();
+			for (i = 0; !*error && (i < iterations); i++)
+				*error = kernel->func(in, out);
+			elapsed = now_ns() - start;
+			// calibrate on the first run only so every run does the same work
+			if (*error || run || (elapsed >= (uint64_t)min_ms * 1000000ull))
+				break;
+			iterations *= 2;
+		}
+		const double ms = elapsed / 1e6 / iterations;
+		if (!run || (ms < best))
+			best = ms;
+	}
+	if (out)
+		uvc_free_frame(out);
+	return best;
+}
+
+static int run_perf(const char *path, const char *filter, const int record, const double percent, const int min_ms) {
+	static golden_entry_t entries[MAX_ENTRIES];
+	const golden_resolution_t *res = &resolutions[PERF_RESOLUTION];
+	int num_entries = 0, failures = 0;
+	size_t k;
+	FILE *out = NULL;
+
+	if (record) {
+		out = fopen(path, "w");
+		if (!out) {
+			perror(path);
+			return 1;
+		}
+		fprintf(out, "# best-of-%d ms/frame, regenerate with uvc_golden -R -b <this file> on the test host\n"
+			"# <kernel> <resolution> ms <ms per frame>\n", PERF_RUNS);
+	} else if ((num_entries = load_entries(path, entries, MAX_ENTRIES)) < 0) {
+		return 1;
+	}
+
+	for (k = 0; k < uvc_bench_num_kernels; k++) {
+		const uvc_bench_kernel_t *kernel = &uvc_bench_kernels[k];
+		golden_entry_t *e = NULL;
+		if (filter && !strstr(kernel->name, filter))
+			continue;
+		if (!record) {
+			e = find_entry(entries, num_entries, kernel->name, res->name);
+			if (!e || (e->check != CHECK_MS))
+				continue;	// kernels without a baseline are not timed
+		}
+		uvc_frame_t *in = uvc_bench_make_frame(kernel->src, kernel->sampling, res->width, res->height);
+		uvc_error_t error = in ? UVC_SUCCESS : UVC_ERROR_NO_MEM;
+		double ms = 0;
+		int attempt;
+		for (attempt = 0; !error && (attempt < PERF_ATTEMPTS); attempt++) {
+			const double t = time_kernel(kernel, in, min_ms, &error);
+			if (!attempt || (t < ms))
+				ms = t;
+			if (!record && (ms <= e->value * (1 + percent / 100)))
+				break;
+		}
+		if (in)
+			uvc_free_frame(in);
+		if (error) {
+			fprintf(stderr, "FAIL %s %s: error %d\n", kernel->name, res->name, error);
+			failures++;
+			continue;
+		}
+		if (record) {
+			fprintf(out, "%s %s ms %.4f\n", kernel->name, res->name, ms);
+			continue;
+		}
+		const double limit = e->value * (1 + percent / 100);
+		fprintf(stderr, "%s %-22s %-4s %8.4f ms (baseline %8.4f, %+6.1f%%)\n", ms > limit ? "FAIL" : "  ok",
+			kernel->name, res->name, ms, e->value, (ms / e->value - 1) * 100);
+		if (ms > limit)
+			failures++;
+	}
+	if (out)
+		fclose(out);
+	else
+		fprintf(stderr, "perf: %d regression(s) over %.0f%%\n", failures, percent);
+	return failures ? 1 : 0;
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+		"usage: %s [-g golden.txt] [-b baseline.txt] [-p percent] [-m min_ms] [-f filter] [-R]\n"
+		"  -g  check (or with -R record) the outputs against the golden file\n"
+		"  -b  check (or with -R record) the timings against the baseline file\n"
+		"  -p  allowed slowdown against the baseline in percent (default 25)\n"
+		"  -m  minimum time of each timed run in ms (default 50)\n"
+		"  -f  only run kernels whose name contains the filter\n"
+		"  -R  record instead of checking\n",
+		prog);
+}
+
+int main(int argc, char *argv[]) {
+	const char *golden_path = NULL, *baseline_path = NULL, *filter = NULL;
+	double percent = 25;
+	int min_ms = 50, record = 0, result = 0, opt;
+
+	while ((opt = getopt(argc, argv, "g:b:p:m:f:Rh")) != -1) {
+		switch (opt) {
+		case 'g': golden_path = optarg; break;
+		case 'b': baseline_path = optarg; break;
+		case 'p': percent = atof(optarg); break;
+		case 'm': min_ms = atoi(optarg); break;
+		case 'f': filter = optarg; break;
+		case 'R': record = 1; break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (!golden_path && !baseline_path) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (golden_path)
+		result |= run_golden(golden_path, filter, record);
+	if (baseline_path)
+		result |= run_perf(baseline_path, filter, record, percent, min_ms);
+	return result;
+}
@@ -110,6 +110,13 @@ int UVCCamera::setPreviewDisplay(ANativeWindow *previewWindow) {
     return result;
 }
 
+int UVCCamera::setPreviewFormat(int pixelFormat) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setPreviewFormat(pixelFormat);
+    return result;
+}
+
 int UVCCamera::setFrameCallback(JNIEnv *env, jobject frameCallbackObj, int pixelFormat) {
     int result = EXIT_FAILURE;
     if (mPreview)
@@ -117,6 +124,112 @@ int UVCCamera::setFrameCallback(JNIEnv *env, jobject frameCallbackObj, int pixel
     return result;
 }
 
+int UVCCamera::setFrameStats(bool enabled, int zonesX, int zonesY, int step) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setFrameStats(enabled, zonesX, zonesY, step);
+    return result;
+}
+
+int UVCCamera::getFrameStats(uvc_frame_stats_t *stats) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getFrameStats(stats);
+    return result;
+}
+
+int UVCCamera::setLumaPyramid(bool enabled, int levels) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setLumaPyramid(enabled, levels);
+    return result;
+}
+
+int UVCCamera::getLumaPyramid(uint8_t *dst, size_t capacity, uvc_luma_pyramid_t *layout, size_t *bytes) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getLumaPyramid(dst, capacity, layout, bytes);
+    return result;
+}
+
+int UVCCamera::requestTensors(const uvc_rect_t *boxes, int count, const uvc_tensor_opts_t *opts) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->requestTensors(boxes, count, opts);
+    return result;
+}
+
+int UVCCamera::getTensors(uint8_t *dst, size_t capacity, int *request, uint32_t *sequence, int *count, size_t *bytes) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getTensors(dst, capacity, request, sequence, count, bytes);
+    return result;
+}
+
+int UVCCamera::setMotionDetection(bool enabled, int tilesX, int tilesY, int tileThreshold, float gate, int gateFlags) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setMotionDetection(enabled, tilesX, tilesY, tileThreshold, gate, gateFlags);
+    return result;
+}
+
+int UVCCamera::getMotion(uvc_motion_t *motion) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getMotion(motion);
+    return result;
+}
+
+int UVCCamera::setSharpness(bool enabled, int method, int window) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setSharpness(enabled, method, window);
+    return result;
+}
+
+int UVCCamera::getSharpness(uvc_sharpness_t *sharpness) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getSharpness(sharpness);
+    return result;
+}
+
+int UVCCamera::getBestFrame(uint8_t *dst, size_t capacity, uint32_t *sequence, float *score,
+                            int *mode, int *width, int *height, size_t *bytes) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getBestFrame(dst, capacity, sequence, score, mode, width, height, bytes);
+    return result;
+}
+
+int UVCCamera::setDecodeThreads(int threads) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setDecodeThreads(threads);
+    return result;
+}
+
+int UVCCamera::getDecodeThreads(int *active, float *decodeMs) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getDecodeThreads(active, decodeMs);
+    return result;
+}
+
+int UVCCamera::setDecodeBands(int bands) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->setDecodeBands(bands);
+    return result;
+}
+
+int UVCCamera::getMjpegErrors(uint32_t counts[UVC_MJPEG_DEFECT_COUNT]) {
+    int result = EXIT_FAILURE;
+    if (mPreview)
+        result = mPreview->getMjpegErrors(counts);
+    return result;
+}
+
 int UVCCamera::startPreview() {
     int result = EXIT_FAILURE;
     if (mPreview)
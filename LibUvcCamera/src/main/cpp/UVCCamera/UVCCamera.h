@@ -39,8 +39,41 @@ public:
 
     int setPreviewDisplay(ANativeWindow *previewWindow);
 
+    int setPreviewFormat(int pixelFormat);
+
     int setFrameCallback(JNIEnv *env, jobject frameCallbackObj, int pixelFormat);
 
+    int setFrameStats(bool enabled, int zonesX, int zonesY, int step);
+
+    int getFrameStats(uvc_frame_stats_t *stats);
+
+    int setLumaPyramid(bool enabled, int levels);
+
+    int getLumaPyramid(uint8_t *dst, size_t capacity, uvc_luma_pyramid_t *layout, size_t *bytes);
+
+    int requestTensors(const uvc_rect_t *boxes, int count, const uvc_tensor_opts_t *opts);
+
+    int getTensors(uint8_t *dst, size_t capacity, int *request, uint32_t *sequence, int *count, size_t *bytes);
+
+    int setMotionDetection(bool enabled, int tilesX, int tilesY, int tileThreshold, float gate, int gateFlags);
+
+    int getMotion(uvc_motion_t *motion);
+
+    int setSharpness(bool enabled, int method, int window);
+
+    int getSharpness(uvc_sharpness_t *sharpness);
+
+    int getBestFrame(uint8_t *dst, size_t capacity, uint32_t *sequence, float *score,
+                     int *mode, int *width, int *height, size_t *bytes);
+
+    int setDecodeThreads(int threads);
+
+    int getDecodeThreads(int *active, float *decodeMs);
+
+    int setDecodeBands(int bands);
+
+    int getMjpegErrors(uint32_t counts[UVC_MJPEG_DEFECT_COUNT]);
+
     int startPreview();
 
     int stopPreview();
@@ -14,9 +14,55 @@
 #include "UVCPreview.h"
 
 #define MAX_FRAME 4
-#define PREVIEW_PIXEL_BYTES 4    // RGBA/RGBX
+#define PREVIEW_PIXEL_BYTES 4    // RGBA/RGBX, the capture window
 #define FRAME_POOL_SZ (MAX_FRAME + 2)
 
+// any other non-zero mode is MJPEG, as before NV12 was added
+static enum uvc_frame_format previewModeFormat(int mode) {
+    switch (mode) {
+        case PREVIEW_MODE_YUYV:
+            return UVC_FRAME_FORMAT_YUYV;
+        case PREVIEW_MODE_NV12:
+            return UVC_FRAME_FORMAT_NV12;
+        default:
+            return UVC_FRAME_FORMAT_MJPEG;
+    }
+}
+
+static const char *previewModeName(int mode) {
+    switch (mode) {
+        case PREVIEW_MODE_YUYV:
+            return "YUYV";
+        case PREVIEW_MODE_NV12:
+            return "NV12";
+        default:
+            return "MJPEG";
+    }
+}
+
+// preview mode of a camera frame's format
+static int previewModeOf(enum uvc_frame_format format) {
+    switch (format) {
+        case UVC_FRAME_FORMAT_YUYV:
+            return PREVIEW_MODE_YUYV;
+        case UVC_FRAME_FORMAT_NV12:
+            return PREVIEW_MODE_NV12;
+        default:
+            return PREVIEW_MODE_MJPEG;
+    }
+}
+
+static size_t previewModeBytes(int mode, int width, int height) {
+    switch (mode) {
+        case PREVIEW_MODE_YUYV:
+            return width * height * 2;
+        case PREVIEW_MODE_NV12:
+            return width * height * 3 / 2;
+        default:
+            return width * height * 4;
+    }
+}
+
 UVCPreview::UVCPreview(uvc_device_handle_t *deviceHandle)
         : mDeviceHandle(deviceHandle),
           mPreviewWindow(nullptr),
@@ -30,19 +76,77 @@ UVCPreview::UVCPreview(uvc_device_handle_t *deviceHandle)
           frameHeight(DEFAULT_PREVIEW_HEIGHT),
           frameBytes(DEFAULT_PREVIEW_WIDTH * DEFAULT_PREVIEW_HEIGHT * 2),    // YUYV
           frameMode(0),
-          previewBytes(DEFAULT_PREVIEW_WIDTH * DEFAULT_PREVIEW_HEIGHT * PREVIEW_PIXEL_BYTES),
           previewFormat(WINDOW_FORMAT_RGBA_8888),
           bIsRunning(false),
           bIsCapturing(false),
           captureQueue(nullptr),
           mFrameCallbackObj(nullptr),
           mFrameCallbackFunc(nullptr),
-          callbackPixelBytes(2) {
+          callbackPixelBytes(2),
+          bStatsEnabled(false),
+          statsZonesX(0),
+          statsZonesY(0),
+          statsStep(1),
+          bPyramidEnabled(false),
+          pyramidLevels(0),
+          mTensorBoxCount(0),
+          mTensorRequest(0),
+          mTensorBuilt(0),
+          mTensorServed(0),
+          mTensorFrontSequence(0),
+          mTensorFrontCount(0),
+          bMotionEnabled(false),
+          motionTilesX(0),
+          motionTilesY(0),
+          motionTileThreshold(0),
+          motionGate(0),
+          motionGateFlags(0),
+          bSharpEnabled(false),
+          sharpMethod(UVC_SHARPNESS_AUTO),
+          sharpWindow(0),
+          mSharpCount(0),
+          mSharpCounter(0),
+          mSharpSpareCount(0),
+          requestDecodeThreads(1),
+          requestDecodeBands(1),
+          mDecodeThreadCount(0),
+          mDecodeActive(0),
+          mDecodePending(0),
+          mDecodeTicket(0),
+          mDecodeShown(0),
+          mDecodeMs(0),
+          mFrameIntervalMs(0) {
     pthread_cond_init(&previewSync, nullptr);
     pthread_mutex_init(&previewMutex, nullptr);
     pthread_cond_init(&captureSync, nullptr);
     pthread_mutex_init(&captureMutex, nullptr);
     pthread_mutex_init(&poolMutex, nullptr);
+    pthread_mutex_init(&statsMutex, nullptr);
+    pthread_mutex_init(&pyramidMutex, nullptr);
+    mPyramidBack = uvc_allocate_frame(0);
+    mPyramidFront = uvc_allocate_frame(0);
+    memset(&mPyramidBackLayout, 0, sizeof(mPyramidBackLayout));
+    memset(&mPyramidFrontLayout, 0, sizeof(mPyramidFrontLayout));
+    pthread_mutex_init(&tensorMutex, nullptr);
+    memset(&mTensorOpts, 0, sizeof(mTensorOpts));
+    mTensorBack = uvc_allocate_frame(0);
+    mTensorFront = uvc_allocate_frame(0);
+    mTensorSource = uvc_allocate_frame(0);
+    pthread_mutex_init(&motionMutex, nullptr);
+    memset(&mMotion, 0, sizeof(mMotion));
+    memset(&mLatestMotion, 0, sizeof(mLatestMotion));
+    pthread_mutex_init(&sharpMutex, nullptr);
+    memset(&mSharpness, 0, sizeof(mSharpness));
+    memset(&mLatestSharpness, 0, sizeof(mLatestSharpness));
+    memset(&mPreviewConvert, 0, sizeof(mPreviewConvert));
+    memset(&mPreviewStats, 0, sizeof(mPreviewStats));
+    memset(&mLatestStats, 0, sizeof(mLatestStats));
+    mPreviewConvert.format = UVC_FRAME_FORMAT_RGBX;
+    mMjpegDecoder = nullptr;
+    pthread_mutex_init(&decodeMutex, nullptr);
+    pthread_cond_init(&decodeSync, nullptr);
+    memset(mDecodeSlots, 0, sizeof(mDecodeSlots));
+    memset(mMjpegFrames, 0, sizeof(mMjpegFrames));
 }
 
 UVCPreview::~UVCPreview() {
@@ -55,11 +159,31 @@ UVCPreview::~UVCPreview() {
     clearPreviewFrame();
     clearCaptureFrame();
     clearPool();
+    uvc_convert_release(&mPreviewConvert);
     pthread_mutex_destroy(&previewMutex);
     pthread_cond_destroy(&previewSync);
     pthread_mutex_destroy(&captureMutex);
     pthread_cond_destroy(&captureSync);
     pthread_mutex_destroy(&poolMutex);
+    pthread_mutex_destroy(&statsMutex);
+    if (mPyramidBack)
+        uvc_free_frame(mPyramidBack);
+    if (mPyramidFront)
+        uvc_free_frame(mPyramidFront);
+    pthread_mutex_destroy(&pyramidMutex);
+    if (mTensorBack)
+        uvc_free_frame(mTensorBack);
+    if (mTensorFront)
+        uvc_free_frame(mTensorFront);
+    if (mTensorSource)
+        uvc_free_frame(mTensorSource);
+    pthread_mutex_destroy(&tensorMutex);
+    uvc_motion_release(&mMotion);
+    pthread_mutex_destroy(&motionMutex);
+    clearSharpFrames();
+    pthread_mutex_destroy(&sharpMutex);
+    pthread_mutex_destroy(&decodeMutex);
+    pthread_cond_destroy(&decodeSync);
 }
 
 uvc_frame_t *UVCPreview::getFrame(size_t dataBytes) {
@@ -125,7 +249,7 @@ int UVCPreview::setPreviewSize(int width, int height, int minFps, int maxFps, in
         result =
                 uvc_get_stream_ctrl_format_size_fps(
                         mDeviceHandle, &ctrl,
-                        !requestMode ? UVC_FRAME_FORMAT_YUYV : UVC_FRAME_FORMAT_MJPEG,
+                        previewModeFormat(requestMode),
                         requestWidth, requestHeight,
                         requestMinFps, requestMaxFps
                 );
@@ -152,6 +276,38 @@ int UVCPreview::setPreviewDisplay(ANativeWindow *previewWindow) {
     return EXIT_SUCCESS;
 }
 
+/**
+ * pixel format of the preview window, PIXEL_FORMAT_RGBX (default) or
+ * PIXEL_FORMAT_RGB565; MJPEG frames are decoded straight into it in either
+ * format and RGB565 halves the bytes written to the window
+ */
+int UVCPreview::setPreviewFormat(int pixelFormat) {
+    int format;
+    switch (pixelFormat) {
+        case PIXEL_FORMAT_RGBX:
+            format = WINDOW_FORMAT_RGBA_8888;
+            break;
+        case PIXEL_FORMAT_RGB565:
+            format = WINDOW_FORMAT_RGB_565;
+            break;
+        default:
+            return UVC_ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&previewMutex);
+
+    if (previewFormat != format) {
+        previewFormat = format;
+        if (mPreviewWindow)
+            ANativeWindow_setBuffersGeometry(
+                    mPreviewWindow,
+                    frameWidth, frameHeight, previewFormat
+            );
+    }
+
+    pthread_mutex_unlock(&previewMutex);
+    return EXIT_SUCCESS;
+}
+
 int UVCPreview::setFrameCallback(JNIEnv *env, jobject frameCallbackObj, int pixelFormat) {
     // Capture used...
     pthread_mutex_lock(&captureMutex);
@@ -185,12 +341,428 @@ int UVCPreview::setFrameCallback(JNIEnv *env, jobject frameCallbackObj, int pixe
     }
     if (frameCallbackObj) {
         mPixelFormat = pixelFormat;
-//        callbackPixelFormatChanged();
+        callbackPixelFormatChanged();
     }
     pthread_mutex_unlock(&captureMutex);
     return 0;
 }
 
+/**
+ * enable or disable the statistics accumulated by the preview conversion,
+ * the preview thread picks the change up on its next frame
+ */
+int UVCPreview::setFrameStats(bool enabled, int zonesX, int zonesY, int step) {
+    if (zonesX < 0 || zonesX > UVC_STATS_MAX_ZONES || zonesY < 0 || zonesY > UVC_STATS_MAX_ZONES
+        || step < 1 || step > 255)
+        return UVC_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&statsMutex);
+    statsZonesX = zonesX;
+    statsZonesY = zonesY;
+    statsStep = step;
+    bStatsEnabled = enabled;
+    if (!enabled)
+        mLatestStats.pixels = 0;
+    pthread_mutex_unlock(&statsMutex);
+    return 0;
+}
+
+/**
+ * copy the statistics of the latest previewed frame
+ * @return 0 on success, UVC_ERROR_NOT_FOUND when no frame has been measured yet
+ */
+int UVCPreview::getFrameStats(uvc_frame_stats_t *stats) {
+    int result = UVC_ERROR_NOT_FOUND;
+    pthread_mutex_lock(&statsMutex);
+    if (bStatsEnabled && mLatestStats.pixels) {
+        memcpy(stats, &mLatestStats, sizeof(*stats));
+        result = 0;
+    }
+    pthread_mutex_unlock(&statsMutex);
+    return result;
+}
+
+// preview thread only
+void UVCPreview::prepareStats(uvc_convert_opts_t *opts) {
+    if (bStatsEnabled) {
+        pthread_mutex_lock(&statsMutex);
+        mPreviewStats.zones_x = statsZonesX;
+        mPreviewStats.zones_y = statsZonesY;
+        mPreviewStats.step = statsStep;
+        pthread_mutex_unlock(&statsMutex);
+        mPreviewStats.pixels = 0;    // stays 0 when there is no window to convert into
+        opts->stats = &mPreviewStats;
+    } else
+        opts->stats = nullptr;
+}
+
+// preview thread only
+void UVCPreview::publishStats() {
+    if (mPreviewConvert.stats && mPreviewStats.pixels) {
+        pthread_mutex_lock(&statsMutex);
+        if (bStatsEnabled)
+            memcpy(&mLatestStats, &mPreviewStats, sizeof(mLatestStats));
+        pthread_mutex_unlock(&statsMutex);
+    }
+}
+
+/**
+ * build the luma pyramid (1/2 .. 1/2^levels scale) of every previewed frame,
+ * levels 0 for the library default
+ */
+int UVCPreview::setLumaPyramid(bool enabled, int levels) {
+    if (levels < 0 || levels > UVC_PYRAMID_MAX_LEVELS)
+        return UVC_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&pyramidMutex);
+    pyramidLevels = levels;
+    bPyramidEnabled = enabled;
+    if (!enabled)
+        mPyramidFrontLayout.num_levels = 0;
+    pthread_mutex_unlock(&pyramidMutex);
+    return 0;
+}
+
+/**
+ * copy the latest luma pyramid, all levels back to back as described by layout
+ * @param bytes set to the size of the pyramid, also when dst is too small
+ * @return 0 on success, UVC_ERROR_NOT_FOUND when none has been built yet,
+ *         UVC_ERROR_NO_MEM when capacity is less than bytes
+ */
+int UVCPreview::getLumaPyramid(uint8_t *dst, size_t capacity, uvc_luma_pyramid_t *layout, size_t *bytes) {
+    int result = UVC_ERROR_NOT_FOUND;
+    *bytes = 0;
+    pthread_mutex_lock(&pyramidMutex);
+    if (bPyramidEnabled && mPyramidFrontLayout.num_levels) {
+        *bytes = mPyramidFront->actual_bytes;
+        if (capacity >= *bytes) {
+            memcpy(dst, mPyramidFront->data, *bytes);
+            memcpy(layout, &mPyramidFrontLayout, sizeof(*layout));
+            layout->decoder = nullptr;
+            result = 0;
+        } else
+            result = UVC_ERROR_NO_MEM;
+    }
+    pthread_mutex_unlock(&pyramidMutex);
+    return result;
+}
+
+// preview thread only, from the camera frame so it does not depend on the display format
+void UVCPreview::buildPyramid(uvc_frame_t *frame) {
+    if (!bPyramidEnabled || UNLIKELY(!mPyramidBack || !mPyramidFront))
+        return;
+    mPyramidBackLayout.levels = pyramidLevels;
+    mPyramidBackLayout.decoder = mMjpegDecoder;
+    if (LIKELY(!uvc_luma_pyramid(frame, mPyramidBack, &mPyramidBackLayout))) {
+        pthread_mutex_lock(&pyramidMutex);
+        uvc_frame_t *t = mPyramidFront;
+        mPyramidFront = mPyramidBack;
+        mPyramidBack = t;
+        mPyramidFrontLayout = mPyramidBackLayout;
+        pthread_mutex_unlock(&pyramidMutex);
+    }
+}
+
+/**
+ * crop, resize and normalise boxes of the next previewed frame into tensors,
+ * replacing any request that has not been served yet
+ * @return id of the request (> 0) to match against getTensors, or an error
+ */
+int UVCPreview::requestTensors(const uvc_rect_t *boxes, int count, const uvc_tensor_opts_t *opts) {
+    if (count < 1 || count > MAX_TENSOR_BOXES || !uvc_tensor_bytes(opts))
+        return UVC_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&tensorMutex);
+    memcpy(mTensorBoxes, boxes, sizeof(*boxes) * count);
+    mTensorBoxCount = count;
+    mTensorOpts = *opts;
+    if (++mTensorRequest <= 0)
+        mTensorRequest = 1;
+    const int request = mTensorRequest;
+    pthread_mutex_unlock(&tensorMutex);
+    return request;
+}
+
+/**
+ * copy the tensors of the latest served request
+ * @param bytes set to their size, also when dst is too small
+ * @return 0 on success, UVC_ERROR_NOT_FOUND when no request has been served yet,
+ *         UVC_ERROR_NO_MEM when capacity is less than bytes
+ */
+int UVCPreview::getTensors(uint8_t *dst, size_t capacity, int *request, uint32_t *sequence, int *count, size_t *bytes) {
+    int result = UVC_ERROR_NOT_FOUND;
+    *bytes = 0;
+    pthread_mutex_lock(&tensorMutex);
+    if (mTensorBuilt) {
+        *bytes = mTensorFront->actual_bytes;
+        if (capacity >= *bytes) {
+            memcpy(dst, mTensorFront->data, *bytes);
+            *request = mTensorBuilt;
+            *sequence = mTensorFrontSequence;
+            *count = mTensorFrontCount;
+            result = 0;
+        } else
+            result = UVC_ERROR_NO_MEM;
+    }
+    pthread_mutex_unlock(&tensorMutex);
+    return result;
+}
+
+// preview thread only
+void UVCPreview::buildTensors(uvc_frame_t *frame) {
+    uvc_tensor_opts_t opts;
+    uvc_rect_t boxes[MAX_TENSOR_BOXES];
+    int count, request;
+
+    pthread_mutex_lock(&tensorMutex);
+    request = mTensorRequest;
+    count = mTensorBoxCount;
+    opts = mTensorOpts;
+    memcpy(boxes, mTensorBoxes, sizeof(boxes[0]) * count);
+    pthread_mutex_unlock(&tensorMutex);
+    if (LIKELY(request == mTensorServed) || UNLIKELY(!mTensorBack || !mTensorSource))
+        return;
+    mTensorServed = request;    // a request that cannot be served is not retried
+
+    uvc_frame_t *src = frame;
+    if (frame->frame_format == UVC_FRAME_FORMAT_MJPEG) {
+        // only frames that serve a request pay for this decode
+        if (UNLIKELY(mMjpegDecoder
+                ? uvc_mjpeg_decoder_decode(mMjpegDecoder, frame, mTensorSource, UVC_FRAME_FORMAT_RGBX)
+                : uvc_mjpeg2rgbx(frame, mTensorSource)))
+            return;
+        src = mTensorSource;
+    }
+    const size_t bytes = uvc_tensor_bytes(&opts) * count;
+    if (UNLIKELY(uvc_ensure_frame_size(mTensorBack, bytes) < 0))
+        return;
+    if (LIKELY(!uvc_frame_tensors(src, boxes, count, &opts, mTensorBack->data, bytes))) {
+        mTensorBack->actual_bytes = bytes;
+        pthread_mutex_lock(&tensorMutex);
+        uvc_frame_t *t = mTensorFront;
+        mTensorFront = mTensorBack;
+        mTensorBack = t;
+        mTensorBuilt = request;
+        mTensorFrontSequence = frame->sequence;
+        mTensorFrontCount = count;
+        pthread_mutex_unlock(&tensorMutex);
+    } else
+        LOGW("failed making tensors of request %d", request);
+}
+
+/**
+ * score every previewed frame against the previous one on a tile grid and,
+ * with a gate threshold above 0, skip the work selected by gateFlags
+ * (MOTION_GATE_*) for frames whose score stays below it
+ * @param tileThreshold mean absolute luma difference that marks a tile dirty, 0 for the library default
+ */
+int UVCPreview::setMotionDetection(bool enabled, int tilesX, int tilesY, int tileThreshold, float gate, int gateFlags) {
+    if (tilesX < 0 || tilesX > UVC_MOTION_MAX_TILES || tilesY < 0 || tilesY > UVC_MOTION_MAX_TILES
+        || tileThreshold < 0 || tileThreshold > 255 || gate < 0)
+        return UVC_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&motionMutex);
+    motionTilesX = tilesX;
+    motionTilesY = tilesY;
+    motionTileThreshold = tileThreshold;
+    motionGate = gate;
+    motionGateFlags = gateFlags & (MOTION_GATE_PREVIEW | MOTION_GATE_ANALYTICS | MOTION_GATE_CAPTURE);
+    bMotionEnabled = enabled;
+    if (!enabled)
+        mLatestMotion.sequence = 0;
+    pthread_mutex_unlock(&motionMutex);
+    return 0;
+}
+
+/**
+ * copy the change score and dirty tiles of the latest previewed frame
+ * @return 0 on success, UVC_ERROR_NOT_FOUND when no frame has been scored yet
+ */
+int UVCPreview::getMotion(uvc_motion_t *motion) {
+    int result = UVC_ERROR_NOT_FOUND;
+    pthread_mutex_lock(&motionMutex);
+    if (bMotionEnabled && mLatestMotion.sequence) {
+        memcpy(motion, &mLatestMotion, sizeof(*motion));
+        result = 0;
+    }
+    pthread_mutex_unlock(&motionMutex);
+    // the detector's frames and decoder stay with the preview thread
+    motion->thumb[0] = motion->thumb[1] = nullptr;
+    motion->decoder = nullptr;
+    return result;
+}
+
+/**
+ * preview thread only
+ * @return MOTION_GATE_* bits of the work to skip for this frame
+ */
+int UVCPreview::updateMotion(uvc_frame_t *frame) {
+    if (!bMotionEnabled) {
+        if (mMotion.thumb_width)
+            uvc_motion_release(&mMotion);    // start over when enabled again
+        return 0;
+    }
+    pthread_mutex_lock(&motionMutex);
+    mMotion.tiles_x = motionTilesX;
+    mMotion.tiles_y = motionTilesY;
+    mMotion.tile_threshold = motionTileThreshold;
+    const float gate = motionGate;
+    const int gateFlags = motionGateFlags;
+    pthread_mutex_unlock(&motionMutex);
+
+    if (UNLIKELY(uvc_motion_update(frame, &mMotion))) {
+        uvc_motion_release(&mMotion);
+        return 0;    // unmeasured frames are never skipped
+    }
+    // sequence 0 means no result to readers
+    if (UNLIKELY(!mMotion.sequence))
+        mMotion.sequence = 1;
+    pthread_mutex_lock(&motionMutex);
+    if (bMotionEnabled)
+        memcpy(&mLatestMotion, &mMotion, sizeof(mLatestMotion));
+    pthread_mutex_unlock(&motionMutex);
+    return (gate > 0) && (mMotion.score < gate) ? gateFlags : 0;
+}
+
+/**
+ * score the focus of every previewed frame and keep the sharpest of the last
+ * window (0..MAX_SHARPNESS_WINDOW) frames as it came from the camera, so a
+ * snapshot or recognition consumer decodes that one only
+ * @param method uvc_sharpness_method
+ */
+int UVCPreview::setSharpness(bool enabled, int method, int window) {
+    if (method < UVC_SHARPNESS_AUTO || method > UVC_SHARPNESS_DCT
+        || window < 0 || window > MAX_SHARPNESS_WINDOW)
+        return UVC_ERROR_INVALID_PARAM;
+    pthread_mutex_lock(&sharpMutex);
+    sharpMethod = method;
+    sharpWindow = window;
+    bSharpEnabled = enabled;
+    if (!enabled)
+        mLatestSharpness.sequence = 0;
+    pthread_mutex_unlock(&sharpMutex);
+    return 0;
+}
+
+/**
+ * copy the focus score of the latest previewed frame
+ * @return 0 on success, UVC_ERROR_NOT_FOUND when no frame has been scored yet
+ */
+int UVCPreview::getSharpness(uvc_sharpness_t *sharpness) {
+    int result = UVC_ERROR_NOT_FOUND;
+    pthread_mutex_lock(&sharpMutex);
+    if (bSharpEnabled && mLatestSharpness.sequence) {
+        memcpy(sharpness, &mLatestSharpness, sizeof(*sharpness));
+        result = 0;
+    }
+    pthread_mutex_unlock(&sharpMutex);
+    sharpness->luma = nullptr;
+    sharpness->decoder = nullptr;
+    return result;
+}
+
+/**
+ * copy the sharpest of the last window frames, MJPEG as it came from the camera
+ * @param mode PREVIEW_MODE_* of the copied data
+ * @param bytes set to the size of the frame, also when dst is too small
+ * @return 0 on success, UVC_ERROR_NOT_FOUND when no frame is kept,
+ *         UVC_ERROR_NO_MEM when capacity is less than bytes
+ */
+int UVCPreview::getBestFrame(uint8_t *dst, size_t capacity, uint32_t *sequence, float *score,
+                             int *mode, int *width, int *height, size_t *bytes) {
+    int result = UVC_ERROR_NOT_FOUND;
+    *bytes = 0;
+    pthread_mutex_lock(&sharpMutex);
+    if (bSharpEnabled && mSharpCount) {
+        const uvc_frame_t *best = mSharpFrames[0];
+        *bytes = best->actual_bytes;
+        if (capacity >= *bytes) {
+            memcpy(dst, best->data, *bytes);
+            *sequence = best->sequence;
+            *score = mSharpScores[0];
+            *mode = previewModeOf(best->frame_format);
+            *width = best->width;
+            *height = best->height;
+            result = 0;
+        } else
+            result = UVC_ERROR_NO_MEM;
+    }
+    pthread_mutex_unlock(&sharpMutex);
+    return result;
+}
+
+// preview thread only, with sharpMutex held
+void UVCPreview::dropSharpFrame(int i) {
+    uvc_frame_t *frame = mSharpFrames[i];
+    for (; i + 1 < mSharpCount; i++) {
+        mSharpFrames[i] = mSharpFrames[i + 1];
+        mSharpScores[i] = mSharpScores[i + 1];
+        mSharpIndex[i] = mSharpIndex[i + 1];
+    }
+    mSharpCount--;
+    if (mSharpSpareCount < MAX_SHARPNESS_WINDOW + 1)
+        mSharpSpare[mSharpSpareCount++] = frame;
+    else
+        uvc_free_frame(frame);
+}
+
+// preview thread only, or after it ended
+void UVCPreview::clearSharpFrames() {
+    pthread_mutex_lock(&sharpMutex);
+    for (int i = 0; i < mSharpCount; i++)
+        uvc_free_frame(mSharpFrames[i]);
+    mSharpCount = 0;
+    pthread_mutex_unlock(&sharpMutex);
+    for (int i = 0; i < mSharpSpareCount; i++)
+        uvc_free_frame(mSharpSpare[i]);
+    mSharpSpareCount = 0;
+    uvc_sharpness_release(&mSharpness);
+}
+
+// preview thread only
+void UVCPreview::updateSharpness(uvc_frame_t *frame) {
+    if (!bSharpEnabled) {
+        if (mSharpCount || mSharpSpareCount || mSharpness.luma)
+            clearSharpFrames();
+        return;
+    }
+    pthread_mutex_lock(&sharpMutex);
+    mSharpness.method = (enum uvc_sharpness_method) sharpMethod;
+    const int window = sharpWindow;
+    pthread_mutex_unlock(&sharpMutex);
+
+    if (UNLIKELY(uvc_frame_sharpness(frame, &mSharpness)))
+        return;
+    if (UNLIKELY(!mSharpness.sequence))
+        mSharpness.sequence = 1;    // sequence 0 means no result to readers
+    const uint32_t index = ++mSharpCounter;
+    const float score = mSharpness.score;
+
+    // every new frame is a candidate, it may outlive all sharper ones
+    uvc_frame_t *copy = nullptr;
+    if (window > 0) {
+        copy = mSharpSpareCount ? mSharpSpare[--mSharpSpareCount] : uvc_allocate_frame(0);
+        if (UNLIKELY(copy && uvc_duplicate_frame(frame, copy))) {
+            uvc_free_frame(copy);
+            copy = nullptr;
+        }
+    }
+
+    pthread_mutex_lock(&sharpMutex);
+    if (bSharpEnabled) {
+        mLatestSharpness.used = mSharpness.used;
+        mLatestSharpness.sequence = mSharpness.sequence;
+        mLatestSharpness.score = score;
+    }
+    while (mSharpCount && (index - mSharpIndex[0] >= (uint32_t) window))
+        dropSharpFrame(0);
+    if (copy) {
+        while (mSharpCount && (mSharpScores[mSharpCount - 1] <= score))
+            dropSharpFrame(mSharpCount - 1);
+        mSharpFrames[mSharpCount] = copy;
+        mSharpScores[mSharpCount] = score;
+        mSharpIndex[mSharpCount] = index;
+        mSharpCount++;
+    }
+    pthread_mutex_unlock(&sharpMutex);
+}
+
 int UVCPreview::startPreview() {
     int result = EXIT_FAILURE;
     if (!isRunning()) {
@@ -225,6 +797,10 @@ int UVCPreview::stopPreview() {
     if (isRunning()) {
         bIsRunning = false;
         pthread_cond_signal(&previewSync);
+        // the preview thread may be waiting for a decode worker
+        pthread_mutex_lock(&decodeMutex);
+        pthread_cond_broadcast(&decodeSync);
+        pthread_mutex_unlock(&decodeMutex);
         pthread_join(previewPthread, nullptr);
     }
 
@@ -253,7 +829,7 @@ int UVCPreview::preparePreview(uvc_stream_ctrl_t *ctrl) {
     uvc_error_t result;
     result = uvc_get_stream_ctrl_format_size_fps(
             mDeviceHandle, ctrl,
-            !requestMode ? UVC_FRAME_FORMAT_YUYV : UVC_FRAME_FORMAT_MJPEG,
+            previewModeFormat(requestMode),
             requestWidth, requestHeight,
             requestMinFps, requestMaxFps
     );
@@ -264,7 +840,7 @@ int UVCPreview::preparePreview(uvc_stream_ctrl_t *ctrl) {
             frameWidth = frame_desc->wWidth;
             frameHeight = frame_desc->wHeight;
             LOGI("frameSize=(%d,%d)@%s", frameWidth, frameHeight,
-                 (!requestMode ? "YUYV" : "MJPEG"));
+                 previewModeName(requestMode));
             pthread_mutex_lock(&previewMutex);
 
             if (mPreviewWindow)
@@ -279,8 +855,7 @@ int UVCPreview::preparePreview(uvc_stream_ctrl_t *ctrl) {
             frameHeight = requestHeight;
         }
         frameMode = requestMode;
-        frameBytes = frameWidth * frameHeight * (!requestMode ? 2 : 4);
-        previewBytes = frameWidth * frameHeight * PREVIEW_PIXEL_BYTES;
+        frameBytes = previewModeBytes(requestMode, frameWidth, frameHeight);
     } else {
         LOGE("could not negotiate with camera:err=%d", result);
     }
@@ -288,41 +863,280 @@ int UVCPreview::preparePreview(uvc_stream_ctrl_t *ctrl) {
     return result;
 }
 
+/**
+ * MJPEG decode threads: 1 (default) decodes on the preview thread straight into
+ * the window, n > 1 decodes up to n consecutive frames in parallel, 0 starts as
+ * many workers as there are spare cores and keeps enough of them busy for the
+ * measured decode time to fit the frame interval. Applies from the next start.
+ */
+int UVCPreview::setDecodeThreads(int threads) {
+    if ((threads < 0) || (threads > MAX_DECODE_THREADS))
+        return UVC_ERROR_INVALID_PARAM;
+    requestDecodeThreads = threads;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * workers currently taking frames (0 when decoding on the preview thread) and
+ * the average decode time of a frame on them
+ */
+int UVCPreview::getDecodeThreads(int *active, float *decodeMs) {
+    pthread_mutex_lock(&decodeMutex);
+    *active = mDecodeThreadCount ? mDecodeActive : 0;
+    *decodeMs = mDecodeMs;
+    pthread_mutex_unlock(&decodeMutex);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * decode each MJPEG frame on the preview thread in up to bands bands at once,
+ * split at its restart markers; 1 (default) decodes whole frames. Cuts the
+ * latency of a frame where setDecodeThreads only raises the frame rate.
+ * Applies from the next start.
+ */
+int UVCPreview::setDecodeBands(int bands) {
+    if ((bands < 1) || (bands > MAX_DECODE_BANDS))
+        return UVC_ERROR_INVALID_PARAM;
+    requestDecodeBands = bands;
+    return EXIT_SUCCESS;
+}
+
+// preview thread only, @return true when MJPEG frames are decoded by workers
+bool UVCPreview::startDecodeThreads(uvc_stream_ctrl_t *ctrl) {
+    const int request = requestDecodeThreads;
+    if ((previewModeFormat(frameMode) != UVC_FRAME_FORMAT_MJPEG) || (request == 1))
+        return false;
+    int count = request;
+    if (!count) {
+        const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cores > 2 ? (int) cores - 1 : 2;    // leave one core to the preview thread
+        if (count > MAX_DECODE_THREADS)
+            count = MAX_DECODE_THREADS;
+    }
+    pthread_mutex_lock(&decodeMutex);
+    for (int i = 0; i < MAX_DECODE_THREADS; i++) {
+        mDecodeSlots[i].done = false;
+        mDecodeSlots[i].frame = nullptr;
+        if (!mDecodeSlots[i].decoded)
+            mDecodeSlots[i].decoded = uvc_allocate_frame(0);
+    }
+    mDecodePending = 0;
+    mDecodeShown = 0;
+    mDecodeMs = 0;
+    mDecodeThreadCount = count;
+    mDecodeActive = request ? count : 1;    // adapting starts with one and grows
+    mFrameIntervalMs = ctrl->dwFrameInterval ? ctrl->dwFrameInterval / 10000.0f : 1000.0f / 30;
+    pthread_mutex_unlock(&decodeMutex);
+    pthread_mutex_lock(&previewMutex);
+    mDecodeTicket = 0;
+    pthread_mutex_unlock(&previewMutex);
+
+    int started = 0;
+    for (; started < count; started++) {
+        mDecodeWorkers[started].preview = this;
+        mDecodeWorkers[started].index = started;
+        if (pthread_create(&mDecodeWorkers[started].thread, nullptr, decodeThreadFunc, &mDecodeWorkers[started]))
+            break;
+    }
+    if (started < count) {
+        pthread_mutex_lock(&decodeMutex);
+        mDecodeThreadCount = started;
+        if (mDecodeActive > started)
+            mDecodeActive = started ? started : 1;
+        pthread_cond_broadcast(&decodeSync);
+        pthread_mutex_unlock(&decodeMutex);
+        if (!started)
+            LOGW("could not start decode threads, decoding on the preview thread");
+    }
+    return started > 0;
+}
+
+// preview thread only, after bIsRunning was cleared
+void UVCPreview::stopDecodeThreads() {
+    if (!mDecodeThreadCount)
+        return;
+    // wake the workers waiting for a frame or for a slot
+    pthread_mutex_lock(&previewMutex);
+    pthread_cond_broadcast(&previewSync);
+    pthread_mutex_unlock(&previewMutex);
+    pthread_mutex_lock(&decodeMutex);
+    pthread_cond_broadcast(&decodeSync);
+    pthread_mutex_unlock(&decodeMutex);
+    for (int i = 0; i < mDecodeThreadCount; i++)
+        pthread_join(mDecodeWorkers[i].thread, nullptr);
+    pthread_mutex_lock(&decodeMutex);
+    mDecodeThreadCount = 0;
+    for (int i = 0; i < MAX_DECODE_THREADS; i++) {
+        if (mDecodeSlots[i].frame)
+            recycleFrame(mDecodeSlots[i].frame);
+        mDecodeSlots[i].frame = nullptr;
+        mDecodeSlots[i].done = false;
+        if (mDecodeSlots[i].decoded)
+            uvc_free_frame(mDecodeSlots[i].decoded);
+        mDecodeSlots[i].decoded = nullptr;
+    }
+    pthread_mutex_unlock(&decodeMutex);
+}
+
+void *UVCPreview::decodeThreadFunc(void *vptrArgs) {
+    auto *worker = reinterpret_cast<DecodeWorker *>(vptrArgs);
+    worker->preview->doDecode(worker->index);
+    pthread_exit(nullptr);
+}
+
+void UVCPreview::doDecode(int index) {
+    uvc_mjpeg_decoder_t *decoder = uvc_mjpeg_decoder_create();
+    while (isRunning()) {
+        // reserve a slot before taking a ticket, so that every ticket not yet
+        // shown is within MAX_DECODE_THREADS of mDecodeShown
+        pthread_mutex_lock(&decodeMutex);
+        while (isRunning() && ((index >= mDecodeActive) || (mDecodePending >= MAX_DECODE_THREADS)))
+            pthread_cond_wait(&decodeSync, &decodeMutex);
+        mDecodePending++;
+        pthread_mutex_unlock(&decodeMutex);
+
+        uint32_t ticket = 0;
+        uvc_frame_t *frame = isRunning() ? waitPreviewFrame(&ticket) : nullptr;
+        if (!frame) {
+            pthread_mutex_lock(&decodeMutex);
+            mDecodePending--;
+            pthread_cond_broadcast(&decodeSync);
+            pthread_mutex_unlock(&decodeMutex);
+            continue;
+        }
+        pthread_mutex_lock(&previewMutex);
+        const enum uvc_frame_format format = previewFormat == WINDOW_FORMAT_RGB_565
+                                             ? UVC_FRAME_FORMAT_RGB565 : UVC_FRAME_FORMAT_RGBX;
+        pthread_mutex_unlock(&previewMutex);
+
+        // the slot belongs to this ticket until it is shown
+        DecodeSlot *slot = &mDecodeSlots[ticket % MAX_DECODE_THREADS];
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const uvc_error_t result = LIKELY(decoder && slot->decoded)
+                                   ? uvc_mjpeg_decoder_decode(decoder, frame, slot->decoded, format)
+                                   : UVC_ERROR_NO_MEM;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        const float ms = (end.tv_sec - start.tv_sec) * 1000.0f + (end.tv_nsec - start.tv_nsec) / 1000000.0f;
+
+        pthread_mutex_lock(&decodeMutex);
+        slot->ticket = ticket;
+        slot->result = result;
+        slot->frame = frame;
+        slot->done = true;
+        mDecodeMs = mDecodeMs > 0 ? mDecodeMs * 0.9f + ms * 0.1f : ms;
+        if (!requestDecodeThreads) {
+            // enough workers for a frame every interval, with some headroom
+            int active = (int) (mDecodeMs * 1.25f / mFrameIntervalMs) + 1;
+            mDecodeActive = active < mDecodeThreadCount ? active : mDecodeThreadCount;
+        }
+        pthread_cond_broadcast(&decodeSync);
+        pthread_mutex_unlock(&decodeMutex);
+    }
+    uvc_mjpeg_decoder_destroy(decoder);
+}
+
+/**
+ * next frame in arrival order once a worker has decoded it, decoded is set to
+ * the decoded image or to nullptr when decoding failed; preview thread only,
+ * call releaseDecodedFrame when done with decoded
+ */
+uvc_frame_t *UVCPreview::waitDecodedFrame(uvc_frame_t **decoded) {
+    uvc_frame_t *frame = nullptr;
+    pthread_mutex_lock(&decodeMutex);
+    DecodeSlot *slot = &mDecodeSlots[mDecodeShown % MAX_DECODE_THREADS];
+    while (isRunning() && !(slot->done && (slot->ticket == mDecodeShown)))
+        pthread_cond_wait(&decodeSync, &decodeMutex);
+    if (isRunning()) {
+        frame = slot->frame;
+        slot->frame = nullptr;
+        *decoded = slot->result ? nullptr : slot->decoded;
+    }
+    pthread_mutex_unlock(&decodeMutex);
+    return frame;
+}
+
+// hand the slot of the frame from waitDecodedFrame back to the workers
+void UVCPreview::releaseDecodedFrame() {
+    pthread_mutex_lock(&decodeMutex);
+    mDecodeSlots[mDecodeShown % MAX_DECODE_THREADS].done = false;
+    mDecodeShown++;
+    mDecodePending--;
+    pthread_cond_broadcast(&decodeSync);
+    pthread_mutex_unlock(&decodeMutex);
+}
+
+/**
+ * MJPEG frames the frame callback checked since the preview started: counts[0]
+ * passed, counts[defect] were dropped for an uvc_mjpeg_defect
+ */
+int UVCPreview::getMjpegErrors(uint32_t counts[UVC_MJPEG_DEFECT_COUNT]) {
+    pthread_mutex_lock(&previewMutex);
+    memcpy(counts, mMjpegFrames, sizeof(mMjpegFrames));
+    pthread_mutex_unlock(&previewMutex);
+    return EXIT_SUCCESS;
+}
+
 void UVCPreview::doPreview(uvc_stream_ctrl_t *ctrl) {
     uvc_frame_t *frame = nullptr;
-    uvc_frame_t *frameMjpeg = nullptr;
+    pthread_mutex_lock(&previewMutex);
+    memset(mMjpegFrames, 0, sizeof(mMjpegFrames));
+    pthread_mutex_unlock(&previewMutex);
+    // MJPEG payloads are gathered straight from the transfers by the frame callback
     uvc_error_t result = uvc_start_streaming_bandwidth(
             mDeviceHandle, ctrl, uvcPreviewFrameCallback,
-            (void *) this, requestBandwidth, 0
+            (void *) this, requestBandwidth, UVC_STREAM_FLAG_FRAGMENTS
     );
     if (!result) {
         clearPreviewFrame();
-        if (frameMode) { // MJPEG mode
-            while (isRunning()) {
-                LOGD("MJPEG Mode...");
-                frameMjpeg = waitPreviewFrame();
-                if (frameMjpeg) {
-                    frame = getFrame(frameMjpeg->width * frameMjpeg->height * 2);
-                    result = uvc_mjpeg2yuyv(frameMjpeg, frame);
-                    recycleFrame(frameMjpeg);
-                    if (!result) {
-                        frame = drawPreviewOne(frame, &mPreviewWindow, uvc_any2rgbx, 4);
-                        addCaptureFrame(frame);
-                    } else
-                        recycleFrame(frame);
+        // one decoder for the whole stream, shared by the preview and the tensor decode
+        mMjpegDecoder = uvc_mjpeg_decoder_create();
+        if (mMjpegDecoder && (requestDecodeBands > 1)
+            && uvc_mjpeg_decoder_set_threads(mMjpegDecoder, requestDecodeBands))
+            LOGW("could not start band decode threads, decoding whole frames");
+        mPreviewConvert.decoder = mMjpegDecoder;
+        const bool parallel = startDecodeThreads(ctrl);
+        // MJPEG frames go to the planner as they are, so it can pick a fused decode
+        while (isRunning()) {
+            uvc_frame_t *decoded = nullptr;
+            frame = parallel ? waitDecodedFrame(&decoded) : waitPreviewFrame();
+            if (frame) {
+                const int skip = updateMotion(frame);
+                if (skip & MOTION_GATE_ANALYTICS)
+                    mPreviewConvert.stats = nullptr;
+                else
+                    prepareStats(&mPreviewConvert);
+                if (parallel) {
+                    // already decoded by a worker, in arrival order
+                    if (decoded && !(skip & MOTION_GATE_PREVIEW))
+                        drawPreviewOne(decoded, &mPreviewWindow, nullptr);
+                    if (mPreviewConvert.stats && (!decoded || uvc_frame_stats(decoded, mPreviewConvert.stats)))
+                        mPreviewConvert.stats->pixels = 0;
+                    releaseDecodedFrame();
+                } else if (!(skip & MOTION_GATE_PREVIEW)) {
+                    frame = drawPreviewOne(frame, &mPreviewWindow, &mPreviewConvert);
                 }
-            }
-        } else { // YUYV mode
-            while (isRunning()) {
-                LOGD("YUYV Mode...");
-                frame = waitPreviewFrame();
-                if (frame) {
-                    frame = drawPreviewOne(frame, &mPreviewWindow, uvc_any2rgbx, 4);
-                    addCaptureFrame(frame);
+                publishStats();
+                if (!(skip & MOTION_GATE_ANALYTICS)) {
+                    buildPyramid(frame);
+                    updateSharpness(frame);
                 }
+                // a pending request is served regardless, it would otherwise wait for motion
+                buildTensors(frame);
+                if (skip & MOTION_GATE_CAPTURE)
+                    recycleFrame(frame);
+                else
+                    addCaptureFrame(frame);
             }
         }
+        stopDecodeThreads();
         uvc_stop_streaming(mDeviceHandle);
+        uvc_convert_release(&mPreviewConvert);
+        mPreviewConvert.decoder = nullptr;
+        uvc_mjpeg_decoder_destroy(mMjpegDecoder);
+        mMjpegDecoder = nullptr;
+        uvc_motion_release(&mMotion);
+        clearSharpFrames();
     } else {
         uvc_perror(result, "failed start streaming");
     }
@@ -331,69 +1145,68 @@ void UVCPreview::doPreview(uvc_stream_ctrl_t *ctrl) {
 uvc_frame_t *UVCPreview::drawPreviewOne(
         uvc_frame_t *frame,
         ANativeWindow **window,
-        convFunc_t func,
-        int pixelBytes
+        uvc_convert_opts_t *opts
 ) {
-    int b = 0;
+    // hold a reference of its own to the window and draw outside previewMutex,
+    // a full MJPEG decode must not hold up the frame callback and setPreviewDisplay
     pthread_mutex_lock(&previewMutex);
-    b = *window != nullptr;
+    ANativeWindow *target = *window;
+    if (target)
+        ANativeWindow_acquire(target);
+    const int format = previewFormat;
     pthread_mutex_unlock(&previewMutex);
-    if (b) {
-        uvc_frame_t *converted;
-        if (func) {
-            converted = getFrame(frame->width * frame->height * pixelBytes);
-            if (converted) {
-                b = func(frame, converted);
-                if (!b) {
-                    pthread_mutex_lock(&previewMutex);
-                    copyToSurface(converted, window);
-                    pthread_mutex_unlock(&previewMutex);
-                } else
-                    LOGE("failed converting");
-                recycleFrame(converted);
+    if (target) {
+        if (opts) {
+            // convert straight into the locked window buffer, no intermediate frame;
+            // a format change just makes uvc_convert plan again
+            opts->format = format == WINDOW_FORMAT_RGB_565
+                           ? UVC_FRAME_FORMAT_RGB565 : UVC_FRAME_FORMAT_RGBX;
+            if (UNLIKELY(convertToSurface(frame, &target, opts))) {
+                LOGE("failed converting");
+                if (opts->stats)
+                    opts->stats->pixels = 0;
             }
-        } else {
-            pthread_mutex_lock(&previewMutex);
-            copyToSurface(frame, window);
-            pthread_mutex_unlock(&previewMutex);
-        }
+        } else
+            copyToSurface(frame, &target);
+        ANativeWindow_release(target);
     }
     return frame;
 }
 
 void UVCPreview::callbackPixelFormatChanged() {
-//    mFrameCallbackFunc = nullptr;
-//    const size_t sz = requestWidth * requestHeight;
-//    switch (mPixelFormat) {
-//        case PIXEL_FORMAT_RAW:
-//            LOGI("PIXEL_FORMAT_RAW:");
-//            callbackPixelBytes = sz * 2;
-//            break;
-//        case PIXEL_FORMAT_YUV:
-//            LOGI("PIXEL_FORMAT_YUV:");
-//            callbackPixelBytes = sz * 2;
-//            break;
-//        case PIXEL_FORMAT_RGB565:
-//            LOGI("PIXEL_FORMAT_RGB565:");
-//            mFrameCallbackFunc = uvc_any2rgb565;
-//            callbackPixelBytes = sz * 2;
-//            break;
-//        case PIXEL_FORMAT_RGBX:
-//            LOGI("PIXEL_FORMAT_RGBX:");
-//            mFrameCallbackFunc = uvc_any2rgbx;
-//            callbackPixelBytes = sz * 4;
-//            break;
-//        case PIXEL_FORMAT_YUV20SP:
-//            LOGI("PIXEL_FORMAT_YUV20SP:");
-//            mFrameCallbackFunc = uvc_yuyv2iyuv420SP;
-//            callbackPixelBytes = (sz * 3) / 2;
-//            break;
-//        case PIXEL_FORMAT_NV21:
-//            LOGI("PIXEL_FORMAT_NV21:");
-//            mFrameCallbackFunc = uvc_yuyv2yuv420SP;
-//            callbackPixelBytes = (sz * 3) / 2;
-//            break;
-//    }
+    mFrameCallbackFunc = nullptr;
+    const size_t sz = requestWidth * requestHeight;
+    switch (mPixelFormat) {
+        case PIXEL_FORMAT_RAW:
+            LOGI("PIXEL_FORMAT_RAW:");
+            callbackPixelBytes = sz * 2;
+            break;
+        case PIXEL_FORMAT_YUV:
+            LOGI("PIXEL_FORMAT_YUV:");
+            mFrameCallbackFunc = uvc_any2yuyv;
+            callbackPixelBytes = sz * 2;
+            break;
+        case PIXEL_FORMAT_RGB565:
+            LOGI("PIXEL_FORMAT_RGB565:");
+            mFrameCallbackFunc = uvc_any2rgb565;
+            callbackPixelBytes = sz * 2;
+            break;
+        case PIXEL_FORMAT_RGBX:
+            LOGI("PIXEL_FORMAT_RGBX:");
+            mFrameCallbackFunc = uvc_any2rgbx;
+            callbackPixelBytes = sz * 4;
+            break;
+        case PIXEL_FORMAT_YUV20SP:
+            LOGI("PIXEL_FORMAT_YUV20SP:");
+            mFrameCallbackFunc = uvc_any2yuv420SP;    // NV12
+            callbackPixelBytes = (sz * 3) / 2;
+            break;
+        case PIXEL_FORMAT_NV21:
+            LOGI("PIXEL_FORMAT_NV21:");
+            mFrameCallbackFunc = uvc_any2iyuv420SP;   // NV21
+            callbackPixelBytes = (sz * 3) / 2;
+            break;
+    }
 }
 
 void UVCPreview::uvcPreviewFrameCallback(uvc_frame_t *frame, void *vptrArgs) {
@@ -401,8 +1214,7 @@ void UVCPreview::uvcPreviewFrameCallback(uvc_frame_t *frame, void *vptrArgs) {
     auto *preview = reinterpret_cast<UVCPreview *>(vptrArgs);
     if UNLIKELY(!preview->isRunning() ||
                 !frame || !frame->frame_format ||
-                !frame->data ||
-                !frame->data_bytes) {
+                ((!frame->data || !frame->data_bytes) && !frame->num_fragments)) {
         return;
     }
     if (UNLIKELY(((frame->frame_format != UVC_FRAME_FORMAT_MJPEG) &&
@@ -415,16 +1227,29 @@ void UVCPreview::uvcPreviewFrameCallback(uvc_frame_t *frame, void *vptrArgs) {
         return;
     }
     if (preview->isRunning()) {
-        uvc_frame_t *copy = preview->getFrame(frame->data_bytes);
+        uvc_frame_t *copy = preview->getFrame(frame->num_fragments ? frame->actual_bytes : frame->data_bytes);
         if (!copy) {
             LOGE("uvc_callback:unable to allocate duplicate frame!");
             return;
         }
+        // gathers the MJPEG payloads out of the transfer buffers in one copy
         uvc_error_t ret = uvc_duplicate_frame(frame, copy);
 //        if (UNLIKELY(ret)) {
 //            preview->recycleFrame(copy);
 //            return;
 //        }
+        if (copy->frame_format == UVC_FRAME_FORMAT_MJPEG) {
+            // microseconds, where a broken frame would cost most of a decode downstream
+            const enum uvc_mjpeg_defect defect = uvc_mjpeg_validate(copy, UVC_MJPEG_CHECK_SCAN);
+            pthread_mutex_lock(&preview->previewMutex);
+            preview->mMjpegFrames[defect]++;
+            pthread_mutex_unlock(&preview->previewMutex);
+            if (UNLIKELY(defect)) {
+                LOGD("broken MJPEG frame!: sequence = %d, defect = %d", frame->sequence, defect);
+                preview->recycleFrame(copy);
+                return;
+            }
+        }
         preview->addPreviewFrame(copy);
     }
     EXIT();
@@ -445,14 +1270,18 @@ void UVCPreview::addPreviewFrame(uvc_frame_t *frame) {
         recycleFrame(frame);
 }
 
-uvc_frame_t *UVCPreview::waitPreviewFrame() {
+// ticket, when not null, numbers the frames in the order they are taken
+uvc_frame_t *UVCPreview::waitPreviewFrame(uint32_t *ticket) {
     uvc_frame_t *frame = nullptr;
     pthread_mutex_lock(&previewMutex);
 
     if (!previewFrames.size())
         pthread_cond_wait(&previewSync, &previewMutex);
-    if ((isRunning() && previewFrames.size()) > 0)
+    if ((isRunning() && previewFrames.size()) > 0) {
         frame = previewFrames.remove(0);
+        if (ticket)
+            *ticket = mDecodeTicket++;
+    }
 
     pthread_mutex_unlock(&previewMutex);
     return frame;
@@ -563,12 +1392,18 @@ int copyToSurface(uvc_frame_t *frame, ANativeWindow **window) {
     if (*window) {
         ANativeWindow_Buffer buffer;
         if (ANativeWindow_lock(*window, &buffer, nullptr) == 0) {
+            // RGBX or RGB565; a frame decoded before a setPreviewFormat is dropped
+            const int bytes = frame->frame_format == UVC_FRAME_FORMAT_RGB565 ? 2 : PREVIEW_PIXEL_BYTES;
+            if (bytes != (buffer.format == WINDOW_FORMAT_RGB_565 ? 2 : PREVIEW_PIXEL_BYTES)) {
+                ANativeWindow_unlockAndPost(*window);
+                return -1;
+            }
             const uint8_t *src = (uint8_t *) frame->data;
-            const int srcW = (int) frame->width * PREVIEW_PIXEL_BYTES;
-            const int srcStep = (int) frame->width * PREVIEW_PIXEL_BYTES;
+            const int srcW = (int) frame->width * bytes;
+            const int srcStep = frame->step ? (int) frame->step : srcW;
             auto *dest = (uint8_t *) buffer.bits;
-            const int destW = buffer.width * PREVIEW_PIXEL_BYTES;
-            const int destStep = buffer.stride * PREVIEW_PIXEL_BYTES;
+            const int destW = buffer.width * bytes;
+            const int destStep = buffer.stride * bytes;
             const int w = srcW < destW ? srcW : destW;
             const int h = frame->height < buffer.height ? (int) frame->height : buffer.height;
             copyFrame(
@@ -586,3 +1421,43 @@ int copyToSurface(uvc_frame_t *frame, ANativeWindow **window) {
 
     return result;
 }
+
+int convertToSurface(uvc_frame_t *frame, ANativeWindow **window, uvc_convert_opts_t *opts) {
+    int result = 0;
+    if (*window) {
+        ANativeWindow_Buffer buffer;
+        if (ANativeWindow_lock(*window, &buffer, nullptr) == 0) {
+            // the format may change between reading previewFormat and this lock; drop the frame then
+            const int bytes = opts->format == UVC_FRAME_FORMAT_RGB565 ? 2 : PREVIEW_PIXEL_BYTES;
+            if (bytes != (buffer.format == WINDOW_FORMAT_RGB_565 ? 2 : PREVIEW_PIXEL_BYTES)) {
+                ANativeWindow_unlockAndPost(*window);
+                return -1;
+            }
+            const uint32_t scale = opts->scale > 1 ? opts->scale : 1;
+            const bool transpose = (opts->rotation == 90) || (opts->rotation == 270);
+            const uint32_t w = (transpose ? frame->height : frame->width) / scale;
+            const uint32_t h = (transpose ? frame->width : frame->height) / scale;
+            if (LIKELY((buffer.width >= w) && (buffer.height >= h))) {
+                // wrap the locked buffer so that the converter writes into it using its stride
+                uvc_frame_t surface;
+                memset(&surface, 0, sizeof(surface));
+                surface.data = buffer.bits;
+                surface.step = buffer.stride * bytes;
+                surface.data_bytes = surface.actual_bytes = surface.step * buffer.height;
+                surface.width = buffer.width;
+                surface.height = buffer.height;
+                surface.library_owns_data = 0;
+                result = uvc_convert(frame, &surface, opts);
+            } else {
+                result = -1;
+            }
+            ANativeWindow_unlockAndPost(*window);
+        } else {
+            result = -1;
+        }
+    } else {
+        result = -1;
+    }
+
+    return result;
+}
@@ -15,9 +15,13 @@
 #define DEFAULT_PREVIEW_HEIGHT 2320
 #define DEFAULT_PREVIEW_FPS_MIN 1
 #define DEFAULT_PREVIEW_FPS_MAX 25
-#define DEFAULT_PREVIEW_MODE 0
+#define DEFAULT_PREVIEW_MODE PREVIEW_MODE_YUYV
 #define DEFAULT_BANDWIDTH 1.0f
 
+#define PREVIEW_MODE_YUYV 0
+#define PREVIEW_MODE_MJPEG 1
+#define PREVIEW_MODE_NV12 2        // 12bpp, fits more frames than YUYV on a busy bus
+
 #define PIXEL_FORMAT_RAW 0        // same as PIXEL_FORMAT_YUV
 #define PIXEL_FORMAT_YUV 1
 #define PIXEL_FORMAT_RGB565 2
@@ -25,6 +29,20 @@
 #define PIXEL_FORMAT_YUV20SP 4
 #define PIXEL_FORMAT_NV21 5        // YVU420SemiPlanar
 
+#define MAX_TENSOR_BOXES 16
+
+// work skipped for frames whose motion score is below the gate threshold
+#define MOTION_GATE_PREVIEW 1      // leave the last frame on the preview window
+#define MOTION_GATE_ANALYTICS 2    // statistics, luma pyramid and focus score keep the last result
+#define MOTION_GATE_CAPTURE 4      // frame callback and capture window
+
+#define MAX_SHARPNESS_WINDOW 8
+
+// frame-parallel MJPEG decode, at most this many frames are decoded or waiting to be shown
+#define MAX_DECODE_THREADS 4
+// bands of one MJPEG frame decoded at once, the limit of uvc_mjpeg_decoder_set_threads
+#define MAX_DECODE_BANDS 8
+
 typedef uvc_error_t (*convFunc_t)(uvc_frame_t *in, uvc_frame_t *out);
 
 // for callback to Java object
@@ -34,6 +52,8 @@ typedef struct {
 
 int copyToSurface(uvc_frame_t *frame, ANativeWindow **window);
 
+int convertToSurface(uvc_frame_t *frame, ANativeWindow **window, uvc_convert_opts_t *opts);
+
 class UVCPreview {
 private:
     uvc_device_handle_t *mDeviceHandle;
@@ -49,7 +69,82 @@ private:
     pthread_cond_t previewSync;
     ObjectArray<uvc_frame_t *> previewFrames;
     int previewFormat;
-    size_t previewBytes;
+    uvc_convert_opts_t mPreviewConvert;    // only touched on the preview thread
+    uvc_mjpeg_decoder_t *mMjpegDecoder;    // lives as long as the stream, preview thread only
+    uvc_frame_stats_t mPreviewStats;       // filled by the preview conversion, preview thread only
+    uvc_frame_stats_t mLatestStats;        // last completed statistics, guarded by statsMutex
+    pthread_mutex_t statsMutex;
+    volatile bool bStatsEnabled;
+    int statsZonesX, statsZonesY, statsStep;
+    // luma pyramid, built into the back frame and swapped with the front one under pyramidMutex
+    uvc_frame_t *mPyramidBack, *mPyramidFront;
+    uvc_luma_pyramid_t mPyramidBackLayout, mPyramidFrontLayout;
+    pthread_mutex_t pyramidMutex;
+    volatile bool bPyramidEnabled;
+    int pyramidLevels;
+    // tensors for the boxes of the latest request, made from the next frame
+    pthread_mutex_t tensorMutex;
+    uvc_tensor_opts_t mTensorOpts;                 // request, guarded by tensorMutex
+    uvc_rect_t mTensorBoxes[MAX_TENSOR_BOXES];
+    int mTensorBoxCount;
+    int mTensorRequest, mTensorBuilt;              // ids of the latest request and of the front buffer
+    int mTensorServed;                             // last request attempted, preview thread only
+    uvc_frame_t *mTensorBack, *mTensorFront;       // swapped under tensorMutex like the pyramid
+    uint32_t mTensorFrontSequence;
+    int mTensorFrontCount;
+    uvc_frame_t *mTensorSource;                    // MJPEG frames decoded for cropping
+    // change detection against the previous frame, gating the work above
+    uvc_motion_t mMotion;                          // preview thread only
+    uvc_motion_t mLatestMotion;                    // results of the last frame, guarded by motionMutex
+    pthread_mutex_t motionMutex;
+    volatile bool bMotionEnabled;
+    int motionTilesX, motionTilesY, motionTileThreshold;
+    float motionGate;
+    int motionGateFlags;
+    // focus score of every frame, and copies of the frames that may still
+    // turn out the sharpest of the last sharpWindow ones
+    uvc_sharpness_t mSharpness;                    // preview thread only
+    uvc_sharpness_t mLatestSharpness;              // results of the last frame, guarded by sharpMutex
+    pthread_mutex_t sharpMutex;
+    volatile bool bSharpEnabled;
+    int sharpMethod, sharpWindow;
+    // candidates in arrival order with falling scores, the first is the best; guarded by sharpMutex
+    uvc_frame_t *mSharpFrames[MAX_SHARPNESS_WINDOW];
+    float mSharpScores[MAX_SHARPNESS_WINDOW];
+    uint32_t mSharpIndex[MAX_SHARPNESS_WINDOW];    // mSharpCounter when the frame arrived
+    int mSharpCount;
+    uint32_t mSharpCounter;                        // preview thread only
+    uvc_frame_t *mSharpSpare[MAX_SHARPNESS_WINDOW + 1];    // dropped copies for reuse, preview thread only
+    int mSharpSpareCount;
+    // MJPEG frames checked by the frame callback, by uvc_mjpeg_defect, guarded by previewMutex
+    uint32_t mMjpegFrames[UVC_MJPEG_DEFECT_COUNT];
+    // MJPEG decode workers: they take frames from previewFrames in arrival order with a
+    // ticket and the preview thread shows them in ticket order from the slot ring
+    struct DecodeSlot {
+        uint32_t ticket;
+        bool done;
+        uvc_error_t result;
+        uvc_frame_t *frame;      // MJPEG frame, passed on to analytics and capture
+        uvc_frame_t *decoded;    // owned by the slot, in the preview window format
+    };
+    struct DecodeWorker {
+        UVCPreview *preview;
+        int index;
+        pthread_t thread;
+    };
+    pthread_mutex_t decodeMutex;
+    pthread_cond_t decodeSync;                     // a slot was filled or emptied, or the worker count changed
+    volatile int requestDecodeThreads;             // 0 adapts to the load, 1 decodes on the preview thread
+    volatile int requestDecodeBands;               // restart interval bands of one frame decoded at once
+    DecodeWorker mDecodeWorkers[MAX_DECODE_THREADS];
+    int mDecodeThreadCount;                        // workers running for this stream
+    int mDecodeActive;                             // workers allowed to take frames, guarded by decodeMutex
+    int mDecodePending;                            // tickets reserved and not yet shown, guarded by decodeMutex
+    uint32_t mDecodeTicket;                        // next ticket, guarded by previewMutex
+    uint32_t mDecodeShown;                         // next ticket to show, guarded by decodeMutex
+    float mDecodeMs;                               // moving average of one decode, guarded by decodeMutex
+    float mFrameIntervalMs;                        // nominal frame interval of the stream
+    DecodeSlot mDecodeSlots[MAX_DECODE_THREADS];
 
     volatile bool bIsCapturing;
     ANativeWindow *mCaptureWindow;
@@ -85,15 +180,14 @@ private:
 
     void addPreviewFrame(uvc_frame_t *frame);
 
-    uvc_frame_t *waitPreviewFrame();
+    uvc_frame_t *waitPreviewFrame(uint32_t *ticket = nullptr);
 
     void clearPreviewFrame();
 
     uvc_frame_t *drawPreviewOne(
             uvc_frame_t *frame,
             ANativeWindow **window,
-            convFunc_t func,
-            int pixelBytes
+            uvc_convert_opts_t *opts
     );
 
     void addCaptureFrame(uvc_frame_t *frame);
@@ -105,6 +199,20 @@ private:
     void doCaptureIdleLoop(JNIEnv *env);
     void doCaptureCallback(JNIEnv *env, uvc_frame_t *frame);
     void callbackPixelFormatChanged();
+    void prepareStats(uvc_convert_opts_t *opts);
+    void publishStats();
+    void buildPyramid(uvc_frame_t *frame);
+    void buildTensors(uvc_frame_t *frame);
+    int updateMotion(uvc_frame_t *frame);
+    void updateSharpness(uvc_frame_t *frame);
+    void dropSharpFrame(int i);
+    void clearSharpFrames();
+    bool startDecodeThreads(uvc_stream_ctrl_t *ctrl);
+    void stopDecodeThreads();
+    static void *decodeThreadFunc(void *vptrArgs);
+    void doDecode(int index);
+    uvc_frame_t *waitDecodedFrame(uvc_frame_t **decoded);
+    void releaseDecodedFrame();
 
 public:
     UVCPreview(uvc_device_handle_t *deviceHandle);
@@ -121,8 +229,41 @@ public:
 
     int setPreviewDisplay(ANativeWindow *previewWindow);
 
+    int setPreviewFormat(int pixelFormat);
+
+    int setDecodeThreads(int threads);
+
+    int getDecodeThreads(int *active, float *decodeMs);
+
+    int setDecodeBands(int bands);
+
     int setFrameCallback(JNIEnv *env, jobject frameCallbackObj, int pixelFormat);
 
+    int setFrameStats(bool enabled, int zonesX, int zonesY, int step);
+
+    int getFrameStats(uvc_frame_stats_t *stats);
+
+    int setLumaPyramid(bool enabled, int levels);
+
+    int getLumaPyramid(uint8_t *dst, size_t capacity, uvc_luma_pyramid_t *layout, size_t *bytes);
+
+    int requestTensors(const uvc_rect_t *boxes, int count, const uvc_tensor_opts_t *opts);
+
+    int getTensors(uint8_t *dst, size_t capacity, int *request, uint32_t *sequence, int *count, size_t *bytes);
+
+    int setMotionDetection(bool enabled, int tilesX, int tilesY, int tileThreshold, float gate, int gateFlags);
+
+    int getMotion(uvc_motion_t *motion);
+
+    int setSharpness(bool enabled, int method, int window);
+
+    int getSharpness(uvc_sharpness_t *sharpness);
+
+    int getBestFrame(uint8_t *dst, size_t capacity, uint32_t *sequence, float *score,
+                     int *mode, int *width, int *height, size_t *bytes);
+
+    int getMjpegErrors(uint32_t counts[UVC_MJPEG_DEFECT_COUNT]);
+
     int startPreview();
 
     int stopPreview();
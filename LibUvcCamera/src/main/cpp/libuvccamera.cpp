@@ -107,6 +107,55 @@ JNIEXPORT jint JNICALL nativeSetPreviewDisplay(
     return result;
 }
 
+JNIEXPORT jint JNICALL nativeSetPreviewFormat(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera, jint pixelFormat
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setPreviewFormat(pixelFormat);
+    return JNI_ERR;
+}
+
+JNIEXPORT jint JNICALL nativeSetDecodeThreads(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera, jint threads
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setDecodeThreads(threads);
+    return JNI_ERR;
+}
+
+// @return the number of decode workers taking frames, 0 when decoding on the preview thread
+JNIEXPORT jint JNICALL nativeGetDecodeThreads(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera, jfloatArray jDecodeMs
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    if (env->GetArrayLength(jDecodeMs) < 1)
+        return UVC_ERROR_INVALID_PARAM;
+    int active;
+    float decodeMs;
+    int result = camera->getDecodeThreads(&active, &decodeMs);
+    if (result)
+        return result;
+    env->SetFloatArrayRegion(jDecodeMs, 0, 1, &decodeMs);
+    return active;
+}
+
+JNIEXPORT jint JNICALL nativeSetDecodeBands(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera, jint bands
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setDecodeBands(bands);
+    return JNI_ERR;
+}
+
 JNIEXPORT jint JNICALL nativeStartPreview(JNIEnv *env, jobject, ID_TYPE idCamera) {
 #if LOCAL_DEBUG
     LOGD("StartPreview...");
@@ -144,6 +193,346 @@ JNIEXPORT jint JNICALL nativeSetFrameCallback(
     return result;
 }
 
+JNIEXPORT jint JNICALL nativeSetFrameStats(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jboolean enabled, jint zonesX, jint zonesY, jint step
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setFrameStats(enabled, zonesX, zonesY, step);
+    return JNI_ERR;
+}
+
+// info layout, keep in sync with FrameStats.kt
+#define STATS_INFO_SEQUENCE 0
+#define STATS_INFO_WIDTH 1
+#define STATS_INFO_HEIGHT 2
+#define STATS_INFO_PIXELS 3
+#define STATS_INFO_RGB 4
+#define STATS_INFO_ZONES_X 5
+#define STATS_INFO_ZONES_Y 6
+#define STATS_INFO_MIN 7
+#define STATS_INFO_MAX (STATS_INFO_MIN + UVC_STATS_CHANNELS)
+#define STATS_INFO_CLIPPED_LOW (STATS_INFO_MAX + UVC_STATS_CHANNELS)
+#define STATS_INFO_CLIPPED_HIGH (STATS_INFO_CLIPPED_LOW + UVC_STATS_CHANNELS)
+#define STATS_INFO_SIZE (STATS_INFO_CLIPPED_HIGH + UVC_STATS_CHANNELS)
+
+JNIEXPORT jint JNICALL nativeGetFrameStats(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jintArray jInfo, jintArray jHistogram, jfloatArray jMean, jfloatArray jZoneMean
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    if (env->GetArrayLength(jInfo) < STATS_INFO_SIZE
+        || env->GetArrayLength(jHistogram) < UVC_STATS_CHANNELS * 256
+        || env->GetArrayLength(jMean) < UVC_STATS_CHANNELS)
+        return UVC_ERROR_INVALID_PARAM;
+    // ~7KB, keep it off the JNI thread's stack
+    static thread_local uvc_frame_stats_t stats;
+    int result = camera->getFrameStats(&stats);
+    if (result)
+        return result;
+
+    jint info[STATS_INFO_SIZE];
+    info[STATS_INFO_SEQUENCE] = stats.sequence;
+    info[STATS_INFO_WIDTH] = stats.width;
+    info[STATS_INFO_HEIGHT] = stats.height;
+    info[STATS_INFO_PIXELS] = stats.pixels;
+    info[STATS_INFO_RGB] = stats.rgb;
+    info[STATS_INFO_ZONES_X] = stats.zones_x;
+    info[STATS_INFO_ZONES_Y] = stats.zones_y;
+    for (int c = 0; c < UVC_STATS_CHANNELS; c++) {
+        info[STATS_INFO_MIN + c] = stats.min[c];
+        info[STATS_INFO_MAX + c] = stats.max[c];
+        info[STATS_INFO_CLIPPED_LOW + c] = stats.clipped_low[c];
+        info[STATS_INFO_CLIPPED_HIGH + c] = stats.clipped_high[c];
+    }
+    env->SetIntArrayRegion(jInfo, 0, STATS_INFO_SIZE, info);
+    env->SetIntArrayRegion(jHistogram, 0, UVC_STATS_CHANNELS * 256,
+                           reinterpret_cast<const jint *>(stats.histogram));
+    env->SetFloatArrayRegion(jMean, 0, UVC_STATS_CHANNELS, stats.mean);
+    const jsize zones = stats.zones_x * stats.zones_y;
+    if (jZoneMean && zones && env->GetArrayLength(jZoneMean) >= zones)
+        env->SetFloatArrayRegion(jZoneMean, 0, zones, stats.zone_mean);
+    return 0;
+}
+
+JNIEXPORT jint JNICALL nativeSetLumaPyramid(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jboolean enabled, jint levels
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setLumaPyramid(enabled, levels);
+    return JNI_ERR;
+}
+
+// layout: sequence, total bytes, number of levels, then width, height, offset per level;
+// keep in sync with LumaPyramid.kt
+#define PYRAMID_LAYOUT_SEQUENCE 0
+#define PYRAMID_LAYOUT_BYTES 1
+#define PYRAMID_LAYOUT_LEVELS 2
+#define PYRAMID_LAYOUT_LEVEL 3
+#define PYRAMID_LAYOUT_SIZE (PYRAMID_LAYOUT_LEVEL + UVC_PYRAMID_MAX_LEVELS * 3)
+
+JNIEXPORT jint JNICALL nativeGetLumaPyramid(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jobject jBuffer, jintArray jLayout
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    auto *dst = static_cast<uint8_t *>(env->GetDirectBufferAddress(jBuffer));
+    const jlong capacity = env->GetDirectBufferCapacity(jBuffer);
+    // an empty buffer may have no address, the size is still reported back
+    if (capacity < 0 || (!dst && capacity) || env->GetArrayLength(jLayout) < PYRAMID_LAYOUT_SIZE)
+        return UVC_ERROR_INVALID_PARAM;
+
+    uvc_luma_pyramid_t pyramid;
+    size_t bytes;
+    jint layout[PYRAMID_LAYOUT_SIZE] = {0};
+    int result = camera->getLumaPyramid(dst, (size_t) capacity, &pyramid, &bytes);
+    layout[PYRAMID_LAYOUT_BYTES] = (jint) bytes;    // tells the caller how much to allocate
+    if (!result) {
+        layout[PYRAMID_LAYOUT_SEQUENCE] = pyramid.sequence;
+        layout[PYRAMID_LAYOUT_LEVELS] = pyramid.num_levels;
+        for (int i = 0; i < pyramid.num_levels; i++) {
+            layout[PYRAMID_LAYOUT_LEVEL + i * 3] = pyramid.width[i];
+            layout[PYRAMID_LAYOUT_LEVEL + i * 3 + 1] = pyramid.height[i];
+            layout[PYRAMID_LAYOUT_LEVEL + i * 3 + 2] = (jint) pyramid.offset[i];
+        }
+    }
+    env->SetIntArrayRegion(jLayout, 0, PYRAMID_LAYOUT_SIZE, layout);
+    return result;
+}
+
+/**
+ * @param jBoxes x, y, width, height per box
+ * @param jMean, jScale per R, G, B
+ * @return request id (> 0) or an error
+ */
+JNIEXPORT jint JNICALL nativeRequestTensors(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jintArray jBoxes, jint count,
+        jint width, jint height, jint type, jint layout, jboolean bgr,
+        jfloatArray jMean, jfloatArray jScale
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    if (count < 1 || count > MAX_TENSOR_BOXES || env->GetArrayLength(jBoxes) < count * 4
+        || env->GetArrayLength(jMean) < 3 || env->GetArrayLength(jScale) < 3
+        || width < 1 || width > UINT16_MAX || height < 1 || height > UINT16_MAX)
+        return UVC_ERROR_INVALID_PARAM;
+
+    jint values[MAX_TENSOR_BOXES * 4];
+    uvc_rect_t boxes[MAX_TENSOR_BOXES];
+    env->GetIntArrayRegion(jBoxes, 0, count * 4, values);
+    for (int i = 0; i < count; i++) {
+        if (values[i * 4 + 2] <= 0 || values[i * 4 + 3] <= 0)
+            return UVC_ERROR_INVALID_PARAM;
+        boxes[i].x = values[i * 4];
+        boxes[i].y = values[i * 4 + 1];
+        boxes[i].width = values[i * 4 + 2];
+        boxes[i].height = values[i * 4 + 3];
+    }
+    uvc_tensor_opts_t opts;
+    opts.width = width;
+    opts.height = height;
+    opts.type = static_cast<enum uvc_tensor_type>(type);
+    opts.layout = static_cast<enum uvc_tensor_layout>(layout);
+    opts.bgr = bgr;
+    env->GetFloatArrayRegion(jMean, 0, 3, opts.mean);
+    env->GetFloatArrayRegion(jScale, 0, 3, opts.scale);
+    return camera->requestTensors(boxes, count, &opts);
+}
+
+// info: request id, frame sequence, number of tensors, total bytes; keep in sync with TensorBatch.kt
+#define TENSOR_INFO_REQUEST 0
+#define TENSOR_INFO_SEQUENCE 1
+#define TENSOR_INFO_COUNT 2
+#define TENSOR_INFO_BYTES 3
+#define TENSOR_INFO_SIZE 4
+
+JNIEXPORT jint JNICALL nativeGetTensors(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jobject jBuffer, jintArray jInfo
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    auto *dst = static_cast<uint8_t *>(env->GetDirectBufferAddress(jBuffer));
+    const jlong capacity = env->GetDirectBufferCapacity(jBuffer);
+    if (capacity < 0 || (!dst && capacity) || env->GetArrayLength(jInfo) < TENSOR_INFO_SIZE)
+        return UVC_ERROR_INVALID_PARAM;
+
+    int request = 0, count = 0;
+    uint32_t sequence = 0;
+    size_t bytes;
+    const int result = camera->getTensors(dst, (size_t) capacity, &request, &sequence, &count, &bytes);
+    jint info[TENSOR_INFO_SIZE];
+    info[TENSOR_INFO_REQUEST] = request;
+    info[TENSOR_INFO_SEQUENCE] = sequence;
+    info[TENSOR_INFO_COUNT] = count;
+    info[TENSOR_INFO_BYTES] = (jint) bytes;
+    env->SetIntArrayRegion(jInfo, 0, TENSOR_INFO_SIZE, info);
+    return result;
+}
+
+JNIEXPORT jint JNICALL nativeSetMotionDetection(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jboolean enabled, jint tilesX, jint tilesY, jint tileThreshold, jfloat gate, jint gateFlags
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setMotionDetection(enabled, tilesX, tilesY, tileThreshold, gate, gateFlags);
+    return JNI_ERR;
+}
+
+// info and score layouts, keep in sync with FrameMotion.kt
+#define MOTION_INFO_SEQUENCE 0
+#define MOTION_INFO_RESET 1
+#define MOTION_INFO_TILES_X 2
+#define MOTION_INFO_TILES_Y 3
+#define MOTION_INFO_DIRTY_LOW 4
+#define MOTION_INFO_DIRTY_HIGH 5
+#define MOTION_INFO_SIZE 6
+#define MOTION_SCORE_MAX 0
+#define MOTION_SCORE_MEAN 1
+#define MOTION_SCORE_TILES 2
+#define MOTION_SCORE_SIZE (MOTION_SCORE_TILES + UVC_MOTION_MAX_TILES * UVC_MOTION_MAX_TILES)
+
+JNIEXPORT jint JNICALL nativeGetMotion(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jintArray jInfo, jfloatArray jScore
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    if (env->GetArrayLength(jInfo) < MOTION_INFO_SIZE
+        || env->GetArrayLength(jScore) < MOTION_SCORE_SIZE)
+        return UVC_ERROR_INVALID_PARAM;
+    uvc_motion_t motion;
+    int result = camera->getMotion(&motion);
+    if (result)
+        return result;
+
+    jint info[MOTION_INFO_SIZE];
+    info[MOTION_INFO_SEQUENCE] = motion.sequence;
+    info[MOTION_INFO_RESET] = motion.reset;
+    info[MOTION_INFO_TILES_X] = motion.tiles_x;
+    info[MOTION_INFO_TILES_Y] = motion.tiles_y;
+    info[MOTION_INFO_DIRTY_LOW] = (jint) (motion.dirty & 0xffffffffu);
+    info[MOTION_INFO_DIRTY_HIGH] = (jint) (motion.dirty >> 32);
+    env->SetIntArrayRegion(jInfo, 0, MOTION_INFO_SIZE, info);
+    env->SetFloatArrayRegion(jScore, MOTION_SCORE_MAX, 1, &motion.score);
+    env->SetFloatArrayRegion(jScore, MOTION_SCORE_MEAN, 1, &motion.mean);
+    env->SetFloatArrayRegion(jScore, MOTION_SCORE_TILES, motion.tiles_x * motion.tiles_y, motion.tile_score);
+    return 0;
+}
+
+JNIEXPORT jint JNICALL nativeSetSharpness(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jboolean enabled, jint method, jint window
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (camera)
+        return camera->setSharpness(enabled, method, window);
+    return JNI_ERR;
+}
+
+// info layouts, keep in sync with FrameSharpness.kt
+#define SHARPNESS_INFO_SEQUENCE 0
+#define SHARPNESS_INFO_METHOD 1
+#define SHARPNESS_INFO_SIZE 2
+#define BEST_FRAME_INFO_SEQUENCE 0
+#define BEST_FRAME_INFO_MODE 1
+#define BEST_FRAME_INFO_WIDTH 2
+#define BEST_FRAME_INFO_HEIGHT 3
+#define BEST_FRAME_INFO_BYTES 4
+#define BEST_FRAME_INFO_SIZE 5
+
+JNIEXPORT jint JNICALL nativeGetSharpness(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jintArray jInfo, jfloatArray jScore
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    if (env->GetArrayLength(jInfo) < SHARPNESS_INFO_SIZE || env->GetArrayLength(jScore) < 1)
+        return UVC_ERROR_INVALID_PARAM;
+    uvc_sharpness_t sharpness;
+    int result = camera->getSharpness(&sharpness);
+    if (result)
+        return result;
+
+    jint info[SHARPNESS_INFO_SIZE];
+    info[SHARPNESS_INFO_SEQUENCE] = sharpness.sequence;
+    info[SHARPNESS_INFO_METHOD] = sharpness.used;
+    env->SetIntArrayRegion(jInfo, 0, SHARPNESS_INFO_SIZE, info);
+    env->SetFloatArrayRegion(jScore, 0, 1, &sharpness.score);
+    return 0;
+}
+
+JNIEXPORT jint JNICALL nativeGetBestFrame(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera,
+        jobject jBuffer, jintArray jInfo, jfloatArray jScore
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    auto *dst = static_cast<uint8_t *>(env->GetDirectBufferAddress(jBuffer));
+    const jlong capacity = env->GetDirectBufferCapacity(jBuffer);
+    if (capacity < 0 || (!dst && capacity)
+        || env->GetArrayLength(jInfo) < BEST_FRAME_INFO_SIZE || env->GetArrayLength(jScore) < 1)
+        return UVC_ERROR_INVALID_PARAM;
+
+    uint32_t sequence = 0;
+    float score = 0;
+    int mode = 0, width = 0, height = 0;
+    size_t bytes;
+    const int result = camera->getBestFrame(dst, (size_t) capacity, &sequence, &score,
+                                            &mode, &width, &height, &bytes);
+    jint info[BEST_FRAME_INFO_SIZE];
+    info[BEST_FRAME_INFO_SEQUENCE] = sequence;
+    info[BEST_FRAME_INFO_MODE] = mode;
+    info[BEST_FRAME_INFO_WIDTH] = width;
+    info[BEST_FRAME_INFO_HEIGHT] = height;
+    info[BEST_FRAME_INFO_BYTES] = (jint) bytes;
+    env->SetIntArrayRegion(jInfo, 0, BEST_FRAME_INFO_SIZE, info);
+    env->SetFloatArrayRegion(jScore, 0, 1, &score);
+    return result;
+}
+
+JNIEXPORT jint JNICALL nativeGetMjpegErrors(
+        JNIEnv *env, jobject,
+        ID_TYPE idCamera, jintArray jCounts
+) {
+    auto *camera = reinterpret_cast<UVCCamera *>(idCamera);
+    if (!camera)
+        return JNI_ERR;
+    if (env->GetArrayLength(jCounts) < UVC_MJPEG_DEFECT_COUNT)
+        return UVC_ERROR_INVALID_PARAM;
+    uint32_t counts[UVC_MJPEG_DEFECT_COUNT];
+    int result = camera->getMjpegErrors(counts);
+    if (result)
+        return result;
+    env->SetIntArrayRegion(jCounts, 0, UVC_MJPEG_DEFECT_COUNT, reinterpret_cast<const jint *>(counts));
+    return 0;
+}
+
 static JNINativeMethod gMethods[] = {
         {"nativeCreate",            "()J",                                               (void *) nativeCreate},
         {"nativeDestroy",           "(J)I",                                              (void *) nativeDestroy},
@@ -152,9 +541,25 @@ static JNINativeMethod gMethods[] = {
         {"nativeConnect",           "(JIIIII)I",                                         (void *) nativeConnect},
         {"nativeSetPreviewSize",    "(JIIIIIF)I",                                        (void *) nativeSetPreviewSize},
         {"nativeSetPreviewDisplay", "(JLandroid/view/Surface;)I",                        (void *) nativeSetPreviewDisplay},
+        {"nativeSetPreviewFormat",  "(JI)I",                                             (void *) nativeSetPreviewFormat},
+        {"nativeSetDecodeThreads",  "(JI)I",                                             (void *) nativeSetDecodeThreads},
+        {"nativeGetDecodeThreads",  "(J[F)I",                                            (void *) nativeGetDecodeThreads},
+        {"nativeSetDecodeBands",    "(JI)I",                                             (void *) nativeSetDecodeBands},
         {"nativeStartPreview",      "(J)I",                                              (void *) nativeStartPreview},
         {"nativeStopPreview",       "(J)I",                                              (void *) nativeStopPreview},
         {"nativeSetFrameCallback",  "(JLcom/luxvisions/libuvccamera/IFrameCallback;I)I", (void *) nativeSetFrameCallback},
+        {"nativeSetFrameStats",     "(JZIII)I",                                          (void *) nativeSetFrameStats},
+        {"nativeGetFrameStats",     "(J[I[I[F[F)I",                                      (void *) nativeGetFrameStats},
+        {"nativeSetLumaPyramid",    "(JZI)I",                                            (void *) nativeSetLumaPyramid},
+        {"nativeGetLumaPyramid",    "(JLjava/nio/ByteBuffer;[I)I",                       (void *) nativeGetLumaPyramid},
+        {"nativeRequestTensors",    "(J[IIIIIIZ[F[F)I",                                  (void *) nativeRequestTensors},
+        {"nativeGetTensors",        "(JLjava/nio/ByteBuffer;[I)I",                       (void *) nativeGetTensors},
+        {"nativeSetMotionDetection", "(JZIIIFI)I",                                       (void *) nativeSetMotionDetection},
+        {"nativeGetMotion",         "(J[I[F)I",                                          (void *) nativeGetMotion},
+        {"nativeSetSharpness",      "(JZII)I",                                           (void *) nativeSetSharpness},
+        {"nativeGetSharpness",      "(J[I[F)I",                                          (void *) nativeGetSharpness},
+        {"nativeGetBestFrame",      "(JLjava/nio/ByteBuffer;[I[F)I",                     (void *) nativeGetBestFrame},
+        {"nativeGetMjpegErrors",    "(J[I)I",                                            (void *) nativeGetMjpegErrors},
 };
 
 static const char *const kClassPathName = "com/luxvisions/libuvccamera/LibUvcCamera";
@@ -0,0 +1,51 @@
+package com.luxvisions.libuvccamera
+
+/**
+ * Change score of the latest previewed frame against the one before it, on a
+ * grid of tiles. Allocate once and pass to LibUvcCamera.getMotion() for every
+ * poll; the arrays are reused.
+ */
+class FrameMotion {
+    /** packed scalars, see the INFO_ indices */
+    val info = IntArray(INFO_SIZE)
+    /** largest tile score, whole frame mean, then one score per tile */
+    val score = FloatArray(SCORE_TILES + MAX_TILES * MAX_TILES)
+
+    val sequence get() = info[INFO_SEQUENCE]
+    /** true when there was no comparable previous frame and every tile is dirty */
+    val isReset get() = info[INFO_RESET] != 0
+    val tilesX get() = info[INFO_TILES_X]
+    val tilesY get() = info[INFO_TILES_Y]
+    /** bit (y * tilesX + x) set for every tile that changed */
+    val dirtyMask get() = (info[INFO_DIRTY_HIGH].toLong() shl 32) or (info[INFO_DIRTY_LOW].toLong() and 0xffffffffL)
+    /** mean absolute luma difference of the most changed tile, 0..255 */
+    val maxScore get() = score[SCORE_MAX]
+    /** mean absolute luma difference over the whole frame, 0..255 */
+    val meanScore get() = score[SCORE_MEAN]
+
+    fun tileScore(x: Int, y: Int) = score[SCORE_TILES + y * tilesX + x]
+    fun isDirty(x: Int, y: Int) = (dirtyMask ushr (y * tilesX + x)) and 1L != 0L
+
+    companion object {
+        const val MAX_TILES = 8
+
+        /** leave the last frame on the preview window */
+        const val GATE_PREVIEW = 1
+        /** frame statistics, luma pyramid and focus score keep their last result */
+        const val GATE_ANALYTICS = 2
+        /** frame callback and capture window */
+        const val GATE_CAPTURE = 4
+
+        // keep in sync with libuvccamera.cpp
+        private const val INFO_SEQUENCE = 0
+        private const val INFO_RESET = 1
+        private const val INFO_TILES_X = 2
+        private const val INFO_TILES_Y = 3
+        private const val INFO_DIRTY_LOW = 4
+        private const val INFO_DIRTY_HIGH = 5
+        private const val INFO_SIZE = 6
+        private const val SCORE_MAX = 0
+        private const val SCORE_MEAN = 1
+        private const val SCORE_TILES = 2
+    }
+}
@@ -0,0 +1,71 @@
+package com.luxvisions.libuvccamera
+
+import java.nio.ByteBuffer
+
+/**
+ * Focus score of the latest previewed frame, higher is sharper. Scores only
+ * rank frames of the same stream and method. Allocate once and pass to
+ * LibUvcCamera.getSharpness() for every poll.
+ */
+class FrameSharpness {
+    internal val info = IntArray(INFO_SIZE)
+    internal val score = FloatArray(1)
+
+    val sequence get() = info[INFO_SEQUENCE]
+    /** METHOD_LAPLACIAN or METHOD_DCT */
+    val method get() = info[INFO_METHOD]
+    val value get() = score[0]
+
+    companion object {
+        /** currently METHOD_LAPLACIAN for every format */
+        const val METHOD_AUTO = 0
+        /** variance of the Laplacian of the half scale luma */
+        const val METHOD_LAPLACIAN = 1
+        /** MJPEG only, high frequency energy of the luma DCT coefficients */
+        const val METHOD_DCT = 2
+        const val MAX_WINDOW = 8
+
+        // keep in sync with libuvccamera.cpp
+        private const val INFO_SEQUENCE = 0
+        private const val INFO_METHOD = 1
+        private const val INFO_SIZE = 2
+    }
+}
+
+/**
+ * The sharpest of the last frames, as the camera sent it: a complete JPEG
+ * for LibUvcCamera.PREVIEW_MODE_MJPEG, raw YUYV or NV12 otherwise. Allocate
+ * once and pass to LibUvcCamera.getBestFrame(); the buffer grows on demand.
+ */
+class BestFrame {
+    var buffer: ByteBuffer = ByteBuffer.allocateDirect(0)
+        internal set
+    internal val info = IntArray(INFO_SIZE)
+    internal val score = FloatArray(1)
+
+    val sequence get() = info[INFO_SEQUENCE]
+    /** LibUvcCamera.PREVIEW_MODE_* of the data */
+    val mode get() = info[INFO_MODE]
+    val width get() = info[INFO_WIDTH]
+    val height get() = info[INFO_HEIGHT]
+    val bytes get() = info[INFO_BYTES]
+    val sharpness get() = score[0]
+
+    /** a view of the frame data, position 0 at its first byte */
+    fun data(): ByteBuffer {
+        val view = buffer.duplicate()
+        view.position(0)
+        view.limit(bytes)
+        return view.slice()
+    }
+
+    companion object {
+        // keep in sync with libuvccamera.cpp
+        private const val INFO_SEQUENCE = 0
+        private const val INFO_MODE = 1
+        private const val INFO_WIDTH = 2
+        private const val INFO_HEIGHT = 3
+        private const val INFO_BYTES = 4
+        private const val INFO_SIZE = 5
+    }
+}
@@ -0,0 +1,55 @@
+package com.luxvisions.libuvccamera
+
+/**
+ * Statistics of the latest previewed frame, accumulated while the preview is
+ * converted for display. Allocate once and pass to LibUvcCamera.getFrameStats()
+ * for every poll; the arrays are reused.
+ */
+class FrameStats {
+    /** packed scalars, see the INFO_ indices */
+    val info = IntArray(INFO_SIZE)
+    /** CHANNELS x 256 bins, channel major */
+    val histogram = IntArray(CHANNELS * 256)
+    val mean = FloatArray(CHANNELS)
+    /** mean luma per zone, row major zonesX * zonesY */
+    val zoneMean = FloatArray(MAX_ZONES * MAX_ZONES)
+
+    val sequence get() = info[INFO_SEQUENCE]
+    val width get() = info[INFO_WIDTH]
+    val height get() = info[INFO_HEIGHT]
+    /** number of pixels sampled */
+    val pixels get() = info[INFO_PIXELS]
+    /** false when only CHANNEL_Y is valid */
+    val isRgb get() = info[INFO_RGB] != 0
+    val zonesX get() = info[INFO_ZONES_X]
+    val zonesY get() = info[INFO_ZONES_Y]
+
+    fun min(channel: Int) = info[INFO_MIN + channel]
+    fun max(channel: Int) = info[INFO_MAX + channel]
+    fun clippedLow(channel: Int) = info[INFO_CLIPPED_LOW + channel]
+    fun clippedHigh(channel: Int) = info[INFO_CLIPPED_HIGH + channel]
+    fun histogram(channel: Int, value: Int) = histogram[channel * 256 + value]
+
+    companion object {
+        const val CHANNEL_R = 0
+        const val CHANNEL_G = 1
+        const val CHANNEL_B = 2
+        const val CHANNEL_Y = 3
+        const val CHANNELS = 4
+        const val MAX_ZONES = 16
+
+        // keep in sync with libuvccamera.cpp
+        private const val INFO_SEQUENCE = 0
+        private const val INFO_WIDTH = 1
+        private const val INFO_HEIGHT = 2
+        private const val INFO_PIXELS = 3
+        private const val INFO_RGB = 4
+        private const val INFO_ZONES_X = 5
+        private const val INFO_ZONES_Y = 6
+        private const val INFO_MIN = 7
+        private const val INFO_MAX = INFO_MIN + CHANNELS
+        private const val INFO_CLIPPED_LOW = INFO_MAX + CHANNELS
+        private const val INFO_CLIPPED_HIGH = INFO_CLIPPED_LOW + CHANNELS
+        private const val INFO_SIZE = INFO_CLIPPED_HIGH + CHANNELS
+    }
+}
@@ -2,6 +2,7 @@ package com.luxvisions.libuvccamera
 
 import android.util.Log
 import android.view.Surface
+import java.nio.ByteBuffer
 
 class LibUvcCamera {
     private val mNativePtr: Long
@@ -52,6 +53,50 @@ class LibUvcCamera {
         nativeSetPreviewDisplay(mNativePtr, surface)
     }
 
+    /**
+     * Pixel format of the preview surface, PREVIEW_FORMAT_RGBX (default) or
+     * PREVIEW_FORMAT_RGB565. Frames are converted or decoded straight into the
+     * surface; RGB565 halves the bytes written per frame.
+     */
+    fun setPreviewFormat(format: Int) {
+        val result = nativeSetPreviewFormat(mNativePtr, format)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set preview format: result: $result")
+    }
+
+    /**
+     * Threads decoding MJPEG frames for the preview, DECODE_THREADS_SERIAL (default)
+     * decodes on the preview thread, up to DECODE_THREADS_MAX workers decode
+     * consecutive frames in parallel and show them in order, DECODE_THREADS_AUTO
+     * uses as many workers as the measured decode time needs to keep up with the
+     * frame rate. Applies from the next startPreview.
+     */
+    fun setDecodeThreads(threads: Int) {
+        val result = nativeSetDecodeThreads(mNativePtr, threads)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set decode threads: result: $result")
+    }
+
+    /**
+     * Workers currently decoding, 0 when decoding on the preview thread; the average
+     * decode time of a frame in milliseconds goes to decodeMs[0]
+     */
+    fun getDecodeThreads(decodeMs: FloatArray = FloatArray(1)): Int {
+        return nativeGetDecodeThreads(mNativePtr, decodeMs)
+    }
+
+    /**
+     * Decode each MJPEG frame in up to bands horizontal bands at once, split at the
+     * restart markers the camera puts in the stream; 1 (default) decodes whole frames.
+     * Lowers the latency of a frame on cameras that send restart markers, frames
+     * without them decode as before. Applies from the next startPreview.
+     */
+    fun setDecodeBands(bands: Int) {
+        val result = nativeSetDecodeBands(mNativePtr, bands)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set decode bands: result: $result")
+    }
+
     fun startPreview() {
         nativeStartPreview(mNativePtr)
     }
@@ -64,6 +109,150 @@ class LibUvcCamera {
         nativeSetFrameCallback(mNativePtr, iFrameCallback, pixelFormat)
     }
 
+    /**
+     * Accumulate statistics while the preview is converted for display.
+     * zonesX/zonesY (0..16) set the grid of FrameStats.zoneMean, step samples
+     * every step-th pixel of every step-th row.
+     */
+    fun setFrameStatsEnabled(enabled: Boolean, zonesX: Int = 0, zonesY: Int = 0, step: Int = 1) {
+        val result = nativeSetFrameStats(mNativePtr, enabled, zonesX, zonesY, step)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set frame stats: result: $result")
+    }
+
+    /**
+     * Copy the statistics of the latest previewed frame into stats.
+     * @return false when statistics are disabled or no frame has been shown yet
+     */
+    fun getFrameStats(stats: FrameStats): Boolean {
+        return nativeGetFrameStats(
+            mNativePtr,
+            stats.info, stats.histogram, stats.mean, stats.zoneMean
+        ) == 0
+    }
+
+    /**
+     * Build the luma pyramid of every previewed frame, levels (1..4) planes
+     * from 1/2 scale down; 0 for the default of 3 (1/2, 1/4 and 1/8).
+     */
+    fun setLumaPyramidEnabled(enabled: Boolean, levels: Int = 0) {
+        val result = nativeSetLumaPyramid(mNativePtr, enabled, levels)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set luma pyramid: result: $result")
+    }
+
+    /**
+     * Copy the luma pyramid of the latest previewed frame into pyramid.
+     * @return false when the pyramid is disabled or no frame has been shown yet
+     */
+    fun getLumaPyramid(pyramid: LumaPyramid): Boolean {
+        var result = nativeGetLumaPyramid(mNativePtr, pyramid.buffer, pyramid.layout)
+        if (result == UVC_ERROR_NO_MEM) {
+            // first poll, or the preview size grew
+            pyramid.buffer = ByteBuffer.allocateDirect(pyramid.bytes)
+            result = nativeGetLumaPyramid(mNativePtr, pyramid.buffer, pyramid.layout)
+        }
+        return result == 0
+    }
+
+    /**
+     * Crop, resize and normalise boxes of the next previewed frame into
+     * tensors, e.g. the head/body boxes of the NPU detection results, in
+     * frame pixels. Replaces a request that has not been served yet.
+     * @param boxes x, y, width, height per box, up to 16 boxes
+     * @return id to match against TensorBatch.request, or a negative error
+     */
+    fun requestTensors(boxes: IntArray, spec: TensorSpec): Int {
+        val result = nativeRequestTensors(
+            mNativePtr,
+            boxes, boxes.size / 4,
+            spec.width, spec.height, spec.type, spec.layout, spec.bgr,
+            spec.mean, spec.scale
+        )
+        if (result <= 0)
+            Log.e(sTAG, "Failed to request tensors: result: $result")
+        return result
+    }
+
+    /**
+     * Copy the tensors of the latest served request into batch.
+     * @return false when no request has been served yet
+     */
+    fun getTensors(batch: TensorBatch): Boolean {
+        var result = nativeGetTensors(mNativePtr, batch.buffer, batch.info)
+        if (result == UVC_ERROR_NO_MEM) {
+            batch.allocate()
+            result = nativeGetTensors(mNativePtr, batch.buffer, batch.info)
+        }
+        return result == 0
+    }
+
+    /**
+     * Score every previewed frame against the previous one on a tilesX x tilesY
+     * grid (1..8, 0 for 8). A tile is dirty when its mean absolute luma
+     * difference reaches tileThreshold (0 for the default of 4). With gate
+     * above 0, frames whose largest tile score stays below it skip the work
+     * selected by gateFlags, FrameMotion.GATE_*; tensor requests are always served.
+     */
+    fun setMotionDetectionEnabled(
+        enabled: Boolean,
+        tilesX: Int = 0, tilesY: Int = 0, tileThreshold: Int = 0,
+        gate: Float = 0f, gateFlags: Int = 0
+    ) {
+        val result = nativeSetMotionDetection(mNativePtr, enabled, tilesX, tilesY, tileThreshold, gate, gateFlags)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set motion detection: result: $result")
+    }
+
+    /**
+     * Copy the change score of the latest previewed frame into motion.
+     * @return false when motion detection is disabled or no frame has been scored yet
+     */
+    fun getMotion(motion: FrameMotion): Boolean {
+        return nativeGetMotion(mNativePtr, motion.info, motion.score) == 0
+    }
+
+    /**
+     * Score the focus of every previewed frame with method, FrameSharpness.METHOD_*,
+     * and keep the sharpest of the last window (0..8) frames for getBestFrame().
+     * Each kept candidate is a copy of the camera frame.
+     */
+    fun setSharpnessEnabled(enabled: Boolean, method: Int = FrameSharpness.METHOD_AUTO, window: Int = 0) {
+        val result = nativeSetSharpness(mNativePtr, enabled, method, window)
+        if (result != 0)
+            Log.e(sTAG, "Failed to set sharpness: result: $result")
+    }
+
+    /**
+     * Copy the focus score of the latest previewed frame into sharpness.
+     * @return false when scoring is disabled or no frame has been scored yet
+     */
+    fun getSharpness(sharpness: FrameSharpness): Boolean {
+        return nativeGetSharpness(mNativePtr, sharpness.info, sharpness.score) == 0
+    }
+
+    /**
+     * Copy the sharpest of the last window frames into frame, undecoded.
+     * @return false when no window is set or no frame has been scored yet
+     */
+    fun getBestFrame(frame: BestFrame): Boolean {
+        var result = nativeGetBestFrame(mNativePtr, frame.buffer, frame.info, frame.score)
+        if (result == UVC_ERROR_NO_MEM) {
+            frame.buffer = ByteBuffer.allocateDirect(frame.bytes)
+            result = nativeGetBestFrame(mNativePtr, frame.buffer, frame.info, frame.score)
+        }
+        return result == 0
+    }
+
+    /**
+     * Copy the counts of MJPEG frames checked since the preview started into
+     * errors, frames found broken are dropped before they are decoded.
+     * @return false when there is no preview
+     */
+    fun getMjpegErrors(errors: MjpegErrors): Boolean {
+        return nativeGetMjpegErrors(mNativePtr, errors.counts) == 0
+    }
+
     /**
      * A native method that is implemented by the 'libuvccamera' native library,
      * which is packaged with this application.
@@ -84,6 +273,10 @@ class LibUvcCamera {
         mode: Int, bandwidth: Float
     ): Int
     private external fun nativeSetPreviewDisplay(idCamera: Long, surface: Surface): Int
+    private external fun nativeSetPreviewFormat(idCamera: Long, format: Int): Int
+    private external fun nativeSetDecodeThreads(idCamera: Long, threads: Int): Int
+    private external fun nativeGetDecodeThreads(idCamera: Long, decodeMs: FloatArray): Int
+    private external fun nativeSetDecodeBands(idCamera: Long, bands: Int): Int
     private external fun nativeStartPreview(idCamera: Long): Int
     private external fun nativeStopPreview(idCamera: Long): Int
     private external fun nativeSetFrameCallback(
@@ -91,9 +284,53 @@ class LibUvcCamera {
         iFrameCallback: IFrameCallback,
         pixelFormat: Int
     ): Int
+    private external fun nativeSetFrameStats(
+        idCamera: Long,
+        enabled: Boolean,
+        zonesX: Int, zonesY: Int, step: Int
+    ): Int
+    private external fun nativeGetFrameStats(
+        idCamera: Long,
+        info: IntArray, histogram: IntArray,
+        mean: FloatArray, zoneMean: FloatArray
+    ): Int
+    private external fun nativeSetLumaPyramid(idCamera: Long, enabled: Boolean, levels: Int): Int
+    private external fun nativeGetLumaPyramid(idCamera: Long, buffer: ByteBuffer, layout: IntArray): Int
+    private external fun nativeRequestTensors(
+        idCamera: Long,
+        boxes: IntArray, count: Int,
+        width: Int, height: Int, type: Int, layout: Int, bgr: Boolean,
+        mean: FloatArray, scale: FloatArray
+    ): Int
+    private external fun nativeGetTensors(idCamera: Long, buffer: ByteBuffer, info: IntArray): Int
+    private external fun nativeSetMotionDetection(
+        idCamera: Long,
+        enabled: Boolean,
+        tilesX: Int, tilesY: Int, tileThreshold: Int,
+        gate: Float, gateFlags: Int
+    ): Int
+    private external fun nativeGetMotion(idCamera: Long, info: IntArray, score: FloatArray): Int
+    private external fun nativeSetSharpness(idCamera: Long, enabled: Boolean, method: Int, window: Int): Int
+    private external fun nativeGetSharpness(idCamera: Long, info: IntArray, score: FloatArray): Int
+    private external fun nativeGetBestFrame(idCamera: Long, buffer: ByteBuffer, info: IntArray, score: FloatArray): Int
+    private external fun nativeGetMjpegErrors(idCamera: Long, counts: IntArray): Int
 
     companion object {
         private val sTAG = LibUvcCamera::class.java.name
+        // values for the mode argument of setPreviewSize
+        const val PREVIEW_MODE_YUYV = 0
+        const val PREVIEW_MODE_MJPEG = 1
+        const val PREVIEW_MODE_NV12 = 2
+        // values for setPreviewFormat, keep in sync with PIXEL_FORMAT_* in UVCPreview.h
+        const val PREVIEW_FORMAT_RGB565 = 2
+        const val PREVIEW_FORMAT_RGBX = 3
+        // values for setDecodeThreads, keep in sync with MAX_DECODE_THREADS in UVCPreview.h
+        const val DECODE_THREADS_AUTO = 0
+        const val DECODE_THREADS_SERIAL = 1
+        const val DECODE_THREADS_MAX = 4
+        // limit of setDecodeBands, keep in sync with MAX_DECODE_BANDS in UVCPreview.h
+        const val DECODE_BANDS_MAX = 8
+        private const val UVC_ERROR_NO_MEM = -11
         // Used to load the 'libuvccamera' library on application startup.
         init {
             System.loadLibrary("libuvccamera")
@@ -0,0 +1,43 @@
+package com.luxvisions.libuvccamera
+
+import java.nio.ByteBuffer
+
+/**
+ * Luma (Y) planes of the latest previewed frame at 1/2, 1/4, 1/8 ... scale,
+ * all levels back to back in one direct buffer, one byte per pixel and rows
+ * width(level) bytes apart. Allocate once and pass to
+ * LibUvcCamera.getLumaPyramid() for every poll; the buffer grows on demand.
+ */
+class LumaPyramid {
+    var buffer: ByteBuffer = ByteBuffer.allocateDirect(0)
+        internal set
+    /** packed layout, see the LAYOUT_ indices */
+    internal val layout = IntArray(LAYOUT_SIZE)
+
+    val sequence get() = layout[LAYOUT_SEQUENCE]
+    val levels get() = layout[LAYOUT_LEVELS]
+    val bytes get() = layout[LAYOUT_BYTES]
+
+    fun width(level: Int) = layout[LAYOUT_LEVEL + level * 3]
+    fun height(level: Int) = layout[LAYOUT_LEVEL + level * 3 + 1]
+    fun offset(level: Int) = layout[LAYOUT_LEVEL + level * 3 + 2]
+
+    /** a view of one level, position 0 at its first pixel */
+    fun level(level: Int): ByteBuffer {
+        val view = buffer.duplicate()
+        view.position(offset(level))
+        view.limit(offset(level) + width(level) * height(level))
+        return view.slice()
+    }
+
+    companion object {
+        const val MAX_LEVELS = 4
+
+        // keep in sync with libuvccamera.cpp
+        private const val LAYOUT_SEQUENCE = 0
+        private const val LAYOUT_BYTES = 1
+        private const val LAYOUT_LEVELS = 2
+        private const val LAYOUT_LEVEL = 3
+        private const val LAYOUT_SIZE = LAYOUT_LEVEL + MAX_LEVELS * 3
+    }
+}
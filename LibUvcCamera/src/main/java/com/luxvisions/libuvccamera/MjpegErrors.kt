@@ -0,0 +1,39 @@
+package com.luxvisions.libuvccamera
+
+/**
+ * MJPEG frames the preview checked on arrival, counted by what was found.
+ * Broken frames are dropped before they cost a decode; a rising count hints
+ * at a marginal USB link. Allocate once and pass to
+ * LibUvcCamera.getMjpegErrors() for every poll.
+ */
+class MjpegErrors {
+    internal val counts = IntArray(DEFECT_COUNT)
+
+    /** frames that passed */
+    val good get() = counts[DEFECT_NONE]
+    /** frames dropped for any reason */
+    val dropped get() = counts.sum() - counts[DEFECT_NONE]
+
+    /** frames dropped for defect, one of DEFECT_* */
+    fun count(defect: Int) = counts[defect]
+
+    companion object {
+        // keep in sync with enum uvc_mjpeg_defect in libuvc.h
+        const val DEFECT_NONE = 0
+        /** does not start with SOI */
+        const val DEFECT_NO_SOI = 1
+        /** does not end with EOI, the frame was cut short */
+        const val DEFECT_TRUNCATED = 2
+        /** a header segment is cut short or overruns the frame */
+        const val DEFECT_BAD_SEGMENT = 3
+        /** no SOF or one that cannot be decoded */
+        const val DEFECT_BAD_SOF = 4
+        /** the SOF size is not the negotiated frame size */
+        const val DEFECT_SIZE_MISMATCH = 5
+        /** no scan data */
+        const val DEFECT_NO_SCAN = 6
+        /** markers out of place or restart markers out of sequence in the scan */
+        const val DEFECT_BAD_MARKER = 7
+        private const val DEFECT_COUNT = 8
+    }
+}
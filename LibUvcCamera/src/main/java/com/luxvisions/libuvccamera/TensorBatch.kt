@@ -0,0 +1,79 @@
+package com.luxvisions.libuvccamera
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Shape and normalisation of the tensors LibUvcCamera.requestTensors() makes:
+ * every box is resized to width x height and each channel becomes
+ * (pixel - mean[c]) * scale[c] for c = R, G, B, rounded and saturated for the
+ * integer types.
+ */
+class TensorSpec(
+    val width: Int,
+    val height: Int,
+    val type: Int = TYPE_FLOAT16,
+    val layout: Int = LAYOUT_CHW,
+    val bgr: Boolean = false,
+    val mean: FloatArray = floatArrayOf(0f, 0f, 0f),
+    val scale: FloatArray = floatArrayOf(1f, 1f, 1f)
+) {
+    /** bytes of one tensor */
+    val bytes get() = width * height * 3 * ELEMENT_BYTES[type]
+
+    companion object {
+        // values of type
+        const val TYPE_UINT8 = 0
+        const val TYPE_INT8 = 1
+        const val TYPE_FLOAT16 = 2
+        const val TYPE_FLOAT32 = 3
+        // values of layout
+        /** height x width x channels, channels interleaved */
+        const val LAYOUT_HWC = 0
+        /** channels x height x width, one plane per channel */
+        const val LAYOUT_CHW = 1
+
+        private val ELEMENT_BYTES = intArrayOf(1, 1, 2, 4)
+    }
+}
+
+/**
+ * Tensors of one served request, back to back in one direct buffer in native
+ * byte order. Allocate once and pass to LibUvcCamera.getTensors() for every
+ * poll; the buffer grows on demand.
+ */
+class TensorBatch {
+    var buffer: ByteBuffer = ByteBuffer.allocateDirect(0)
+        internal set
+    /** packed info, see the INFO_ indices */
+    internal val info = IntArray(INFO_SIZE)
+
+    /** id returned by the requestTensors() call these tensors answer */
+    val request get() = info[INFO_REQUEST]
+    /** sequence number of the frame they were cropped from */
+    val sequence get() = info[INFO_SEQUENCE]
+    val count get() = info[INFO_COUNT]
+    val bytes get() = info[INFO_BYTES]
+
+    /** a view of tensor i, position 0 at its first element */
+    fun tensor(i: Int): ByteBuffer {
+        val size = bytes / count
+        val view = buffer.duplicate()
+        view.position(size * i)
+        view.limit(size * (i + 1))
+        return view.slice().order(ByteOrder.nativeOrder())
+    }
+
+    internal fun allocate() {
+        buffer = ByteBuffer.allocateDirect(bytes).order(ByteOrder.nativeOrder())
+    }
+
+    companion object {
+        // keep in sync with libuvccamera.cpp
+        private const val INFO_REQUEST = 0
+        private const val INFO_SEQUENCE = 1
+        private const val INFO_COUNT = 2
+        private const val INFO_BYTES = 3
+        private const val INFO_SIZE = 4
+    }
+}